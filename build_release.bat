@@ -13,6 +13,7 @@ if not exist "Release" mkdir Release
 :: Копирование файлов
 echo Copying files...
 xcopy "x64\Release\NBapp.exe" "Release\" /Y
+xcopy "x64\Release\NBcli.exe" "Release\" /Y
 xcopy "x64\Release\*.dll" "Release\" /Y
 
 :: Создание папки для данных
@@ -6,6 +6,7 @@ if not exist "Release" mkdir Release
 
 rem Copy the executable and DLLs
 xcopy /Y "x64\Release\NBapp.exe" "Release\"
+xcopy /Y "x64\Release\NBcli.exe" "Release\"
 xcopy /Y "x64\Release\*.dll" "Release\"
 
 rem Create an empty contacts.json file if it doesn't exist
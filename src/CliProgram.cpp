@@ -0,0 +1,9 @@
+#include "cli/BatchCommands.h"
+
+using namespace System;
+
+// Консольная версия без Windows Forms для пакетной обработки и серверов
+int main(array<String^>^ args)
+{
+    return BatchCommands::Run(args);
+}
\ No newline at end of file
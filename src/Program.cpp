@@ -11,7 +11,11 @@ int main(array<String^>^ args)
     Application::SetCompatibleTextRenderingDefault(false);
     
     // Запускаем главную форму
-    Application::Run(gcnew NBapp::MainForm());
+    NBapp::MainForm^ form = gcnew NBapp::MainForm();
+    if (Array::IndexOf(args, "--startup-bench") >= 0) {
+        form->EnableStartupBenchmark();
+    }
+    Application::Run(form);
     
     return 0;
 } 
\ No newline at end of file
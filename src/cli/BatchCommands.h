@@ -0,0 +1,1688 @@
+#pragma once
+#include "../controllers/NotebookManager.h"
+#include "../controllers/NotebookWorkspace.h"
+#include "../controllers/EntryPager.h"
+#include "../controllers/PagedNotebook.h"
+#include "../controllers/NotebookMerger.h"
+#include "../controllers/ExternalSorter.h"
+#include "../controllers/FieldCompletions.h"
+#include "../utils/ParallelExporter.h"
+#include "../server/LoadGenerator.h"
+#include "../utils/SampleDataGenerator.h"
+#include "BenchSupport.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Diagnostics;
+using namespace System::Globalization;
+using namespace System::IO;
+using namespace System::Text;
+using namespace System::Threading;
+using namespace Newtonsoft::Json;
+
+// Разобранные аргументы командной строки: команда, позиционные
+// аргументы, опции вида --name value и флаги вида --name
+public ref class CommandArguments {
+private:
+    static array<String^>^ knownFlags = gcnew array<String^> { "--desc", "--append", "--timing", "--drop-removed", "--compact" };
+
+public:
+    String^ command;
+    List<String^>^ positional;
+    Dictionary<String^, String^>^ options;
+    HashSet<String^>^ flags;
+
+    CommandArguments() {
+        positional = gcnew List<String^>();
+        options = gcnew Dictionary<String^, String^>(StringComparer::OrdinalIgnoreCase);
+        flags = gcnew HashSet<String^>(StringComparer::OrdinalIgnoreCase);
+    }
+
+    static CommandArguments^ Parse(array<String^>^ args) {
+        CommandArguments^ parsed = gcnew CommandArguments();
+        for (int i = 0; i < args->Length; i++) {
+            String^ arg = args[i];
+            if (arg->StartsWith("--")) {
+                if (Array::IndexOf(knownFlags, arg->ToLower()) >= 0) {
+                    parsed->flags->Add(arg);
+                }
+                else if (i + 1 < args->Length) {
+                    parsed->options[arg] = args[++i];
+                }
+                else {
+                    throw gcnew ArgumentException("Missing value for option " + arg);
+                }
+            }
+            else if (parsed->command == nullptr) {
+                parsed->command = arg->ToLower();
+            }
+            else {
+                parsed->positional->Add(arg);
+            }
+        }
+        return parsed;
+    }
+
+    String^ GetOption(String^ name, String^ defaultValue) {
+        String^ value;
+        return options->TryGetValue(name, value) ? value : defaultValue;
+    }
+
+    bool HasFlag(String^ name) {
+        return flags->Contains(name);
+    }
+
+    String^ Require(int index, String^ name) {
+        if (index >= positional->Count) {
+            throw gcnew ArgumentException("Missing argument: " + name);
+        }
+        return positional[index];
+    }
+};
+
+// Замеры времени по фазам команды для машинно-читаемого отчета
+public ref class CommandTimer {
+private:
+    Stopwatch^ total;
+    Stopwatch^ phase;
+    List<KeyValuePair<String^, double>>^ phases;
+
+public:
+    CommandTimer() {
+        total = Stopwatch::StartNew();
+        phase = Stopwatch::StartNew();
+        phases = gcnew List<KeyValuePair<String^, double>>();
+    }
+
+    // Завершение текущей фазы и начало следующей
+    void Mark(String^ name) {
+        phases->Add(KeyValuePair<String^, double>(name, phase->Elapsed.TotalMilliseconds));
+        phase->Restart();
+    }
+
+    // Одна строка JSON: {"command":..,"rows":..,"total_ms":..,"phases":{..}}
+    String^ ToJson(String^ command, int rows) {
+        StringWriter^ text = gcnew StringWriter();
+        JsonTextWriter^ json = gcnew JsonTextWriter(text);
+        json->WriteStartObject();
+        json->WritePropertyName("command");
+        json->WriteValue(command);
+        json->WritePropertyName("rows");
+        json->WriteValue(rows);
+        json->WritePropertyName("total_ms");
+        json->WriteValue(Math::Round(total->Elapsed.TotalMilliseconds, 3));
+        json->WritePropertyName("phases");
+        json->WriteStartObject();
+        for each (KeyValuePair<String^, double> item in phases) {
+            json->WritePropertyName(item.Key + "_ms");
+            json->WriteValue(Math::Round(item.Value, 3));
+        }
+        json->WriteEndObject();
+        json->WriteEndObject();
+        json->Flush();
+        return text->ToString();
+    }
+};
+
+// Остановка серверного режима по Ctrl+C и сообщения сервера
+public ref class ServeStopper {
+private:
+    ManualResetEvent^ stopped;
+public:
+    ServeStopper(ManualResetEvent^ stopped) : stopped(stopped) {}
+    void OnCancel(Object^ sender, ConsoleCancelEventArgs^ e) {
+        e->Cancel = true;
+        stopped->Set();
+    }
+    void OnListenFailed(Object^ sender, ErrorEventArgs^ e) {
+        Console::Error->WriteLine("Cannot accept connections: {0}", e->GetException()->Message);
+    }
+};
+
+// Консольный интерфейс к NotebookManager для пакетной обработки.
+// Не использует Windows Forms; "-" вместо пути означает stdin/stdout.
+public ref class BatchCommands {
+private:
+    CommandArguments^ arguments;
+    CommandTimer^ timer;
+    int rows;
+    // Временные файлы команды; удаляются после нее, в том числе при ошибке
+    List<String^>^ tempFiles;
+    String^ tempPrefix;
+
+    BatchCommands(CommandArguments^ arguments) {
+        this->arguments = arguments;
+        timer = gcnew CommandTimer();
+        rows = 0;
+        tempFiles = gcnew List<String^>();
+    }
+
+    // Формат по расширению файла; для stdin/stdout - из опции
+    String^ ResolveFormat(String^ path, String^ optionName) {
+        if (path == "-") {
+            return arguments->GetOption(optionName, arguments->GetOption("--format", "json"));
+        }
+        return path->EndsWith(".json", StringComparison::OrdinalIgnoreCase) ? "json" : "tsv";
+    }
+
+    NotebookManager^ LoadBook(String^ path) {
+        NotebookManager^ manager = gcnew NotebookManager(nullptr, false);
+        if (path == "-") {
+            manager->LoadFromStream(Console::OpenStandardInput(), ResolveFormat(path, "--from"));
+        }
+        else {
+            manager->LoadFromFile(path);
+        }
+        timer->Mark("load");
+        return manager;
+    }
+
+    void SaveBook(NotebookManager^ manager, String^ path) {
+        if (path == "-") {
+            Stream^ output = Console::OpenStandardOutput();
+            manager->SaveToStream(output, ResolveFormat(path, "--to"), !arguments->HasFlag("--compact"));
+            output->Flush();
+        }
+        else if (arguments->HasFlag("--compact") && path->EndsWith(".json", StringComparison::OrdinalIgnoreCase)) {
+            manager->SaveToJsonFile(path, false);
+        }
+        else {
+            manager->SaveToFile(path);
+        }
+        timer->Mark("save");
+    }
+
+    // Книга из результатов поиска или отчета для вывода
+    static NotebookManager^ FromEntries(List<NotebookEntry<int>^>^ selected) {
+        NotebookManager^ result = gcnew NotebookManager(nullptr, false);
+        result->AddEntries(selected);
+        return result;
+    }
+
+    static int ParseSearchField(String^ field) {
+        array<String^>^ names = { "first", "last", "phone", "email", "address", "sounds", "tags" };
+        int index = Array::IndexOf(names, field->ToLower());
+        if (index < 0) {
+            throw gcnew ArgumentException("Unknown search field: " + field);
+        }
+        return index;
+    }
+
+    static EntryOrder ParseOrder(String^ by) {
+        String^ key = by->ToLower();
+        if (key == "id") return EntryOrder::Id;
+        if (key == "first") return EntryOrder::FirstName;
+        if (key == "last") return EntryOrder::LastName;
+        if (key == "book") return EntryOrder::Book;
+        throw gcnew ArgumentException("Unknown sort key: " + by);
+    }
+
+    static TextWriter^ OpenStandardWriter() {
+        return gcnew StreamWriter(Console::OpenStandardOutput(), gcnew UTF8Encoding(false), 1 << 16);
+    }
+
+    // Размер сгенерированной книги замера (--rows)
+    int RowsOption(String^ defaultRows) {
+        return Int32::Parse(arguments->GetOption("--rows", defaultRows));
+    }
+
+    // Путь временного файла: общий префикс команды плюс suffix
+    String^ TempPath(String^ suffix) {
+        if (tempPrefix == nullptr) {
+            tempPrefix = Path::Combine(Path::GetTempPath(), "nbcli-" + arguments->command + "-" + Guid::NewGuid().ToString("N"));
+        }
+        String^ path = tempPrefix + suffix;
+        tempFiles->Add(path);
+        return path;
+    }
+
+    void DeleteTempFiles() {
+        for each (String^ path in tempFiles) {
+            File::Delete(path);
+        }
+        tempFiles->Clear();
+    }
+
+    // Отчет замера в stdout; код завершения - по проверкам отчета
+    int Finish(BenchReport^ report) {
+        rows = report->GetRows();
+        return report->Write(OpenStandardWriter());
+    }
+
+    int LoadCommand() {
+        NotebookManager^ manager = LoadBook(arguments->Require(0, "file"));
+        rows = manager->GetCount();
+        TextWriter^ output = OpenStandardWriter();
+        output->WriteLine("entries\t{0}", manager->GetCount());
+        output->WriteLine("max_id\t{0}", manager->GetMaxId());
+        output->Flush();
+        return 0;
+    }
+
+    int ConvertCommand() {
+        NotebookManager^ manager = LoadBook(arguments->Require(0, "input"));
+        rows = manager->GetCount();
+        SaveBook(manager, arguments->Require(1, "output"));
+        return 0;
+    }
+
+    int SearchCommand() {
+        NotebookManager^ manager = LoadBook(arguments->Require(0, "file"));
+        int searchType = ParseSearchField(arguments->GetOption("--field", "first"));
+        List<NotebookEntry<int>^>^ results = manager->SearchByAnyField(arguments->GetOption("--query", ""), searchType);
+        timer->Mark("search");
+        rows = results->Count;
+        SaveBook(FromEntries(results), arguments->GetOption("--out", "-"));
+        return 0;
+    }
+
+    // Поиск по всем JSON книгам каталога: книги загружаются по мере
+    // обхода, в памяти одновременно не больше --max-resident
+    int WorkspaceSearchCommand() {
+        NotebookWorkspace^ workspace = gcnew NotebookWorkspace(Int32::Parse(arguments->GetOption("--max-resident", "4")));
+        workspace->OpenDirectory(arguments->Require(0, "directory"));
+        timer->Mark("open");
+        int searchType = ParseSearchField(arguments->GetOption("--field", "first"));
+        List<NotebookEntry<int>^>^ results = workspace->SearchAll(arguments->GetOption("--query", ""), searchType);
+        timer->Mark("search");
+        rows = results->Count;
+        SaveBook(FromEntries(results), arguments->GetOption("--out", "-"));
+        return 0;
+    }
+
+    // Сортировка потоком, без загрузки книги: части по --memory-mb
+    // сортируются во временных файлах и сливаются прямо в output.
+    // formatter - формат экспорта, nullptr - формат хранения книги
+    int ExternalSort(String^ input, String^ output, IRecordFormatter^ formatter) {
+        ExternalSorter^ sorter = gcnew ExternalSorter(ParseOrder(arguments->GetOption("--by", "last")),
+            arguments->HasFlag("--desc"), Int64::Parse(arguments->GetOption("--memory-mb", "256")) * 1024 * 1024);
+        try {
+            if (input == "-") {
+                EntryStreamReader^ reader = gcnew EntryStreamReader(
+                    gcnew StreamReader(Console::OpenStandardInput(), Encoding::UTF8, true, 1 << 16), ResolveFormat(input, "--from"));
+                NotebookEntry<int>^ entry;
+                while (reader->Read(entry)) sorter->Add(entry);
+            }
+            else {
+                sorter->AddFile(input);
+            }
+            timer->Mark("runs");
+
+            SortReport^ report;
+            if (output != "-") {
+                report = formatter == nullptr ? sorter->WriteTo(output) : WriteSorted(sorter, formatter, output);
+            }
+            else if (formatter != nullptr) {
+                report = sorter->WriteTo(formatter, Console::OpenStandardOutput());
+            }
+            else {
+                Stream^ stream = Console::OpenStandardOutput();
+                EntryStreamWriter^ writer = ResolveFormat(output, "--to") == "tsv"
+                    ? gcnew EntryStreamWriter(gcnew StreamWriter(stream, gcnew UTF8Encoding(false), 1 << 16))
+                    : gcnew EntryStreamWriter(stream, !arguments->HasFlag("--compact"));
+                report = sorter->WriteTo(writer);
+                writer->Close();
+            }
+            timer->Mark("merge");
+            rows = (int)report->rows;
+        }
+        finally {
+            delete sorter;
+        }
+        return 0;
+    }
+
+    static SortReport^ WriteSorted(ExternalSorter^ sorter, IRecordFormatter^ formatter, String^ path) {
+        FileStream^ file = gcnew FileStream(path, FileMode::Create, FileAccess::Write, FileShare::None, 1 << 20);
+        try {
+            return sorter->WriteTo(formatter, file);
+        }
+        finally {
+            file->Close();
+        }
+    }
+
+    int SortCommand() {
+        if (arguments->GetOption("--memory-mb", nullptr) != nullptr) {
+            return ExternalSort(arguments->Require(0, "file"), arguments->GetOption("--out", "-"), nullptr);
+        }
+        NotebookManager^ manager = LoadBook(arguments->Require(0, "file"));
+        String^ by = arguments->GetOption("--by", "last")->ToLower();
+        bool ascending = !arguments->HasFlag("--desc");
+        if (by == "first") {
+            manager->SortByFirstName(ascending);
+        }
+        else if (by == "last") {
+            manager->SortByLastName(ascending);
+        }
+        else if (by == "id") {
+            manager->SortById();
+        }
+        else {
+            throw gcnew ArgumentException("Unknown sort key: " + by);
+        }
+        timer->Mark("sort");
+        rows = manager->GetCount();
+        SaveBook(manager, arguments->GetOption("--out", "-"));
+        return 0;
+    }
+
+    // Одна страница представления в TSV; токен следующей страницы - в stderr
+    int PageCommand() {
+        NotebookManager^ manager = LoadBook(arguments->Require(0, "file"));
+        EntryOrder order = ParseOrder(arguments->GetOption("--by", "id"));
+        String^ search = arguments->GetOption("--query", nullptr);
+        EntryQuery^ query = search == nullptr
+            ? gcnew EntryQuery(order, arguments->HasFlag("--desc"))
+            : gcnew EntryQuery(order, arguments->HasFlag("--desc"), search,
+                ParseSearchField(arguments->GetOption("--field", "first")));
+        EntryPage^ page = (gcnew EntryPager(manager))->GetPage(query,
+            arguments->GetOption("--after", nullptr), Int32::Parse(arguments->GetOption("--size", "50")));
+        timer->Mark("page");
+        rows = page->rows->Count;
+
+        TextWriter^ output = OpenStandardWriter();
+        NotebookManager::WriteTsv(page->rows, output);
+        output->Flush();
+        if (page->nextToken != nullptr) {
+            Console::Error->WriteLine("next\t{0}", page->nextToken);
+        }
+        return 0;
+    }
+
+    int ExportCommand() {
+        // Книга больше памяти: сортированный экспорт внешней сортировкой
+        if (arguments->GetOption("--memory-mb", nullptr) != nullptr) {
+            String^ target = arguments->Require(1, "output");
+            String^ format = arguments->GetOption("--to", nullptr);
+            IRecordFormatter^ sortedFormatter = format != nullptr ? RecordFormatters::ByName(format) : RecordFormatters::ForPath(target);
+            if (sortedFormatter == nullptr || arguments->GetOption("--by", nullptr) == nullptr ||
+                arguments->GetOption("--query", nullptr) != nullptr) {
+                throw gcnew ArgumentException("--memory-mb needs --by and applies to csv|ndjson|vcard|tsv export without --query");
+            }
+            return ExternalSort(arguments->Require(0, "file"), target, sortedFormatter);
+        }
+        NotebookManager^ manager = LoadBook(arguments->Require(0, "file"));
+        String^ output = arguments->Require(1, "output");
+        rows = manager->GetCount();
+        // CSV, JSON Lines, vCard, TSV: формат из --to или по расширению файла;
+        // остальное (.xlsx) уходит в Excel
+        String^ to = arguments->GetOption("--to", nullptr);
+        IRecordFormatter^ formatter = to != nullptr ? RecordFormatters::ByName(to) : RecordFormatters::ForPath(output);
+        if (formatter == nullptr && (to != nullptr || output == "-")) {
+            throw gcnew ArgumentException("Unknown export format; use --to csv|ndjson|vcard|tsv");
+        }
+        // Выборка и порядок (--query, --by) - через кэш запросов книги
+        String^ search = arguments->GetOption("--query", nullptr);
+        String^ by = arguments->GetOption("--by", nullptr);
+        if (formatter != nullptr) {
+            List<NotebookEntry<int>^>^ selected = search == nullptr && by == nullptr
+                ? manager->GetSnapshot()->ToList()
+                : manager->Query(search, ParseSearchField(arguments->GetOption("--field", "first")),
+                    ParseOrder(by == nullptr ? "book" : by), arguments->HasFlag("--desc"));
+            rows = selected->Count;
+            ParallelExporter^ exporter = gcnew ParallelExporter(formatter);
+            if (output == "-") {
+                exporter->Export(selected, Console::OpenStandardOutput());
+            }
+            else {
+                exporter->Export(selected, output);
+            }
+            timer->Mark("export");
+            return 0;
+        }
+        if (search != nullptr || by != nullptr) {
+            throw gcnew ArgumentException("--query and --by apply to csv|ndjson|vcard|tsv export only");
+        }
+
+        // Excel требует абсолютный путь
+        String^ target = Path::GetFullPath(output);
+        manager->ExportToExcel(target, arguments->HasFlag("--append"));
+        timer->Mark("export");
+        return 0;
+    }
+
+    // Добавление записей из файлов-источников в целевую книгу.
+    // Совпадающие ID получают новые номера; сохранение - один раз в конце
+    int ImportCommand() {
+        String^ targetPath = arguments->Require(0, "target");
+        if (arguments->positional->Count < 2) {
+            throw gcnew ArgumentException("Missing argument: source");
+        }
+        NotebookManager^ target = gcnew NotebookManager(targetPath, false);
+        if (File::Exists(targetPath)) {
+            target->LoadFromFile(targetPath);
+        }
+        timer->Mark("load");
+
+        HashSet<int>^ usedIds = gcnew HashSet<int>();
+        for each (NotebookEntry<int>^ entry in target->GetAllEntries()) {
+            usedIds->Add(entry->GetId());
+        }
+        int nextId = target->GetMaxId() + 1;
+
+        List<NotebookEntry<int>^>^ incoming = gcnew List<NotebookEntry<int>^>();
+        for (int i = 1; i < arguments->positional->Count; i++) {
+            NotebookManager^ source = gcnew NotebookManager(nullptr, false);
+            if (arguments->positional[i] == "-") {
+                source->LoadFromStream(Console::OpenStandardInput(), ResolveFormat("-", "--from"));
+            }
+            else {
+                source->LoadFromFile(arguments->positional[i]);
+            }
+            for each (NotebookEntry<int>^ entry in source->GetAllEntries()) {
+                if (!usedIds->Add(entry->GetId())) {
+                    entry->SetId(nextId);
+                    usedIds->Add(nextId);
+                }
+                nextId = Math::Max(nextId, entry->GetId() + 1);
+                incoming->Add(entry);
+            }
+        }
+        timer->Mark("read_sources");
+
+        rows = target->AddEntries(incoming);
+        timer->Mark("merge");
+        SaveBook(target, targetPath);
+        return 0;
+    }
+
+    int DedupeCommand() {
+        String^ path = arguments->Require(0, "file");
+        NotebookManager^ manager = LoadBook(path);
+        rows = manager->RemoveDuplicates();
+        timer->Mark("dedupe");
+        SaveBook(manager, arguments->GetOption("--out", "-"));
+        return 0;
+    }
+
+    // Отчет о ближайших днях рождения в формате TSV
+    int BirthdaysCommand() {
+        NotebookManager^ manager = LoadBook(arguments->Require(0, "file"));
+        int days = Int32::Parse(arguments->GetOption("--days", "7"));
+        DateTime today = DateTime::Today;
+        List<NotebookEntry<int>^>^ upcoming = manager->GetUpcomingBirthdays(today, days);
+        timer->Mark("scan");
+
+        TextWriter^ output = OpenStandardWriter();
+        for each (NotebookEntry<int>^ entry in upcoming) {
+            DateTime next = NotebookManager::GetNextBirthday(DateTime::Parse(entry->GetBirthDate()), today);
+            output->WriteLine("{0}\t{1}\t{2}\t{3}\t{4:yyyy-MM-dd}\t{5}",
+                entry->GetId(),
+                entry->GetFirstName(),
+                entry->GetLastName(),
+                entry->GetPhoneNumber(),
+                next,
+                (int)(next - today).TotalDays);
+        }
+        output->Flush();
+        timer->Mark("report");
+        rows = upcoming->Count;
+        return 0;
+    }
+
+    // Серверный режим: книга остается в памяти и обслуживает клиентов
+    // через именованный канал до нажатия Ctrl+C
+    int ServeCommand() {
+        String^ path = Path::GetFullPath(arguments->Require(0, "file.json"));
+        NotebookManager^ manager = gcnew NotebookManager(path);
+        // ADD и DEL пишутся в журнал, а файл публикует сервер после паузы
+        // в изменениях и при остановке
+        manager->EnableJournal();
+        timer->Mark("load");
+        rows = manager->GetCount();
+
+        String^ pipeName = arguments->GetOption("--pipe", NotebookServer::DefaultPipeName);
+        NotebookServer^ server = gcnew NotebookServer(manager, pipeName);
+        ManualResetEvent^ stopped = gcnew ManualResetEvent(false);
+        ServeStopper^ stopper = gcnew ServeStopper(stopped);
+        Console::CancelKeyPress += gcnew ConsoleCancelEventHandler(stopper, &ServeStopper::OnCancel);
+        server->ListenFailed += gcnew ErrorEventHandler(stopper, &ServeStopper::OnListenFailed);
+        server->Start();
+        Console::Error->WriteLine("Serving {0} entries on \\\\.\\pipe\\{1}. Press Ctrl+C to stop.", rows, pipeName);
+        stopped->WaitOne();
+        server->Stop();
+        timer->Mark("serve");
+        return 0;
+    }
+
+    // Нагрузочный прогон против запущенного сервера; отчет - JSON в stdout
+    int BenchServerCommand() {
+        LoadGenerator^ generator = gcnew LoadGenerator(
+            arguments->GetOption("--pipe", NotebookServer::DefaultPipeName),
+            Int32::Parse(arguments->GetOption("--clients", "8")),
+            Int32::Parse(arguments->GetOption("--requests", "10000")),
+            Int32::Parse(arguments->GetOption("--depth", "16")),
+            Double::Parse(arguments->GetOption("--search-ratio", "0.1"), CultureInfo::InvariantCulture));
+        LoadReport^ report = generator->Run();
+        timer->Mark("bench");
+        rows = (int)report->requests;
+        TextWriter^ output = OpenStandardWriter();
+        output->WriteLine(report->ToJson());
+        output->Flush();
+        return 0;
+    }
+
+    // Страничная книга для команд paged-*; --cache-mb ограничивает буферный пул
+    PagedNotebook^ OpenPagedBook(String^ path) {
+        long long cacheBytes = Int64::Parse(arguments->GetOption("--cache-mb", "64")) * 1024 * 1024;
+        PagedNotebook^ book = gcnew PagedNotebook(path, cacheBytes);
+        timer->Mark("open");
+        return book;
+    }
+
+    void ClosePagedBook(PagedNotebook^ book) {
+        BufferPool^ pool = book->GetPool();
+        book->Close();
+        timer->Mark("flush");
+        if (arguments->HasFlag("--timing")) {
+            Console::Error->WriteLine("{{\"pool_pages\":{0},\"hits\":{1},\"misses\":{2},\"writes\":{3}}}",
+                pool->GetCapacityPages(), pool->GetHits(), pool->GetMisses(), pool->GetWrites());
+        }
+    }
+
+    // Потоковый вывод курсора в файл или stdout
+    void WriteCursor(IEnumerable<NotebookEntry<int>^>^ source, String^ path) {
+        if (path == "-") {
+            Stream^ output = Console::OpenStandardOutput();
+            NotebookManager::WriteEntries(source, output, ResolveFormat(path, "--to"), !arguments->HasFlag("--compact"));
+            output->Flush();
+        }
+        else {
+            FileStream^ output = gcnew FileStream(path, FileMode::Create, FileAccess::Write, FileShare::None, 1 << 16);
+            try {
+                NotebookManager::WriteEntries(source, output, ResolveFormat(path, "--to"), !arguments->HasFlag("--compact"));
+            }
+            finally {
+                output->Close();
+            }
+        }
+        timer->Mark("write");
+    }
+
+    // Добавление записей из JSON/TSV в страничную книгу без загрузки в память
+    int PagedImportCommand() {
+        PagedNotebook^ book = OpenPagedBook(arguments->Require(0, "book.nbp"));
+        try {
+            if (arguments->positional->Count < 2) {
+                throw gcnew ArgumentException("Missing argument: source");
+            }
+            for (int i = 1; i < arguments->positional->Count; i++) {
+                String^ source = arguments->positional[i];
+                TextReader^ reader = source == "-"
+                    ? gcnew StreamReader(Console::OpenStandardInput(), Encoding::UTF8, true, 1 << 16)
+                    : gcnew StreamReader(source, Encoding::UTF8, true, 1 << 16);
+                try {
+                    rows += book->ImportFrom(reader, ResolveFormat(source, "--from"));
+                }
+                finally {
+                    reader->Close();
+                }
+            }
+            timer->Mark("import");
+            if (book->GetOversizedCount() > 0) {
+                Console::Error->WriteLine("Skipped {0} entries larger than a storage page ({1} bytes)",
+                    book->GetOversizedCount(), SlottedPage::MaxRecordBytes);
+            }
+        }
+        finally {
+            ClosePagedBook(book);
+        }
+        return 0;
+    }
+
+    int PagedSearchCommand() {
+        PagedNotebook^ book = OpenPagedBook(arguments->Require(0, "book.nbp"));
+        try {
+            int searchType = ParseSearchField(arguments->GetOption("--field", "first"));
+            WriteCursor(book->SearchByAnyField(arguments->GetOption("--query", ""), searchType), arguments->GetOption("--out", "-"));
+            rows = book->GetCount();
+        }
+        finally {
+            ClosePagedBook(book);
+        }
+        return 0;
+    }
+
+    int PagedSortCommand() {
+        PagedNotebook^ book = OpenPagedBook(arguments->Require(0, "book.nbp"));
+        try {
+            String^ by = arguments->GetOption("--by", "last")->ToLower();
+            bool ascending = !arguments->HasFlag("--desc");
+            PagedNotebook::Cursor^ sorted;
+            if (by == "first" || by == "last") {
+                sorted = book->SortByName(by == "last", ascending);
+            }
+            else if (by == "id") {
+                sorted = book->SortById(ascending);
+            }
+            else {
+                throw gcnew ArgumentException("Unknown sort key: " + by);
+            }
+            timer->Mark("sort");
+            WriteCursor(sorted, arguments->GetOption("--out", "-"));
+            rows = book->GetCount();
+        }
+        finally {
+            ClosePagedBook(book);
+        }
+        return 0;
+    }
+
+    int PagedExportCommand() {
+        PagedNotebook^ book = OpenPagedBook(arguments->Require(0, "book.nbp"));
+        try {
+            WriteCursor(book->GetAllEntries(), arguments->Require(1, "output"));
+            rows = book->GetCount();
+        }
+        finally {
+            ClosePagedBook(book);
+        }
+        return 0;
+    }
+
+    // Сжатие колонок на сгенерированной книге: память, размер снимка и
+    // скорость поиска по обычному и сжатому представлению. Отчет - JSON в stdout
+    int BenchCompressCommand() {
+        BenchReport^ report = gcnew BenchReport(RowsOption("1000000"));
+        int count = report->GetRows();
+        String^ tsvPath = TempPath(".txt");
+        String^ snapshotPath = TempPath(".nbz");
+        (gcnew SampleDataGenerator(42))->WriteTsv(tsvPath, count);
+        timer->Mark("generate");
+
+        long long baseline = GC::GetTotalMemory(true);
+        List<NotebookEntry<int>^>^ entries = TsvChunkLoader::Load(tsvPath);
+        long long plainBytes = GC::GetTotalMemory(true) - baseline;
+        timer->Mark("load");
+
+        CompressedBook^ book = CompressedBook::Build(entries);
+        long long compressedBytes = GC::GetTotalMemory(true) - baseline - plainBytes;
+        timer->Mark("compress");
+
+        FileStream^ snapshot = gcnew FileStream(snapshotPath, FileMode::Create);
+        try {
+            book->Save(snapshot);
+        }
+        finally {
+            snapshot->Close();
+        }
+        timer->Mark("snapshot");
+
+        report->Add("plain_bytes", plainBytes);
+        report->Add("compressed_bytes", compressedBytes);
+        report->Add("compressed_estimate_bytes", book->EstimateBytes());
+        report->Add("tsv_file_bytes", (gcnew FileInfo(tsvPath))->Length);
+        report->Add("snapshot_file_bytes", (gcnew FileInfo(snapshotPath))->Length);
+
+        // Один и тот же запрос к обоим представлениям; результаты должны совпасть
+        array<int>^ types = { 0, 1, 2, 3, 4 };
+        array<String^>^ queries = { "ann", "ov", "912", "gmail", "lenina" };
+        report->BeginArray("scans");
+        for (int i = 0; i < types->Length; i++) {
+            Stopwatch^ clock = Stopwatch::StartNew();
+            int plainMatches = NotebookManager::SearchIn(entries, queries[i], types[i])->Count;
+            double plainMs = clock->Elapsed.TotalMilliseconds;
+            clock->Restart();
+            int compressedMatches = book->Search(queries[i], types[i])->Count;
+            double compressedMs = clock->Elapsed.TotalMilliseconds;
+            report->Check(plainMatches == compressedMatches, "Compressed search results differ from the plain search");
+
+            report->BeginItem();
+            report->Add("type", types[i]);
+            report->Add("query", queries[i]);
+            report->Add("matches", compressedMatches);
+            report->Add("plain_rows_per_s", Math::Round(BenchReport::PerSecond(count, plainMs)));
+            report->Add("compressed_rows_per_s", Math::Round(BenchReport::PerSecond(count, compressedMs)));
+            report->EndItem();
+        }
+        report->EndArray();
+        timer->Mark("scan");
+        GC::KeepAlive(entries);
+        return Finish(report);
+    }
+
+    // Холодные поля на сгенерированной книге: память записей до и после
+    // переноса адресов и заметок в ColdFieldStore, скорость поиска по
+    // горячим полям и по адресу, совпадение результатов и значений
+    int BenchColdCommand() {
+        BenchReport^ report = gcnew BenchReport(RowsOption("1000000"));
+        int count = report->GetRows();
+        String^ tsvPath = TempPath(".txt");
+        (gcnew SampleDataGenerator(42))->WriteTsv(tsvPath, count);
+        timer->Mark("generate");
+
+        long long baseline = GC::GetTotalMemory(true);
+        List<NotebookEntry<int>^>^ entries = TsvChunkLoader::Load(tsvPath);
+        long long plainBytes = GC::GetTotalMemory(true) - baseline;
+        array<unsigned long long>^ hashes = gcnew array<unsigned long long>(entries->Count);
+        for (int i = 0; i < entries->Count; i++) {
+            hashes[i] = RecordHasher::Hash(entries[i]);
+        }
+        timer->Mark("load");
+
+        array<int>^ types = { 0, 1, 2, 3, 4, 4 };
+        array<String^>^ queries = { "ann", "ov", "912", "gmail", "lenina", "kv. 12" };
+        array<double>^ plainMs = gcnew array<double>(types->Length);
+        array<List<int>^>^ expected = gcnew array<List<int>^>(types->Length);
+        for (int i = 0; i < types->Length; i++) {
+            expected[i] = BenchSupport::TimeFind(entries, types[i], queries[i], plainMs[i]);
+        }
+        timer->Mark("plain_scan");
+
+        Stopwatch^ clock = Stopwatch::StartNew();
+        ColdFieldStore^ store = gcnew ColdFieldStore();
+        int moved = 0;
+        for each (NotebookEntry<int>^ entry in entries) {
+            if (entry->MoveCold(store)) moved++;
+        }
+        double moveMs = clock->Elapsed.TotalMilliseconds;
+        // Сжатие кучи: горячие строки соседних записей ложатся подряд
+        GC::Collect(2, GCCollectionMode::Forced, true, true);
+        long long coldBytes = GC::GetTotalMemory(true) - baseline - 8LL * hashes->Length;
+        timer->Mark("move");
+
+        String^ failure = "Cold field values or search results differ from the plain entries";
+        report->Add("moved", moved);
+        report->Add("move_ms", Math::Round(moveMs, 1));
+        report->Add("plain_bytes", plainBytes);
+        report->Add("cold_bytes", coldBytes);
+        report->Add("store_bytes", store->EstimateBytes());
+        report->Add("cold_utf8_bytes", store->GetRawBytes());
+        report->Add("cold_stored_bytes", store->GetStoredBytes());
+        report->BeginArray("scans");
+        for (int i = 0; i < types->Length; i++) {
+            double coldMs;
+            List<int>^ found = BenchSupport::TimeFind(entries, types[i], queries[i], coldMs);
+            report->Check(BenchSupport::SameRows(found, expected[i]), failure);
+
+            report->BeginItem();
+            report->Add("type", types[i]);
+            report->Add("query", queries[i]);
+            report->Add("matches", found->Count);
+            report->Add("plain_rows_per_s", Math::Round(BenchReport::PerSecond(count, plainMs[i])));
+            report->Add("cold_rows_per_s", Math::Round(BenchReport::PerSecond(count, coldMs)));
+            report->EndItem();
+        }
+        report->EndArray();
+        timer->Mark("cold_scan");
+
+        int changed = 0;
+        for (int i = 0; i < entries->Count; i++) {
+            if (RecordHasher::Hash(entries[i]) != hashes[i]) changed++;
+        }
+        report->Check(changed == 0, failure);
+        report->Add("changed_values", changed);
+        timer->Mark("verify");
+        GC::KeepAlive(entries);
+        return Finish(report);
+    }
+
+    // Метки на сгенерированной книге: построение индекса меток, выражения
+    // над множествами строк против проверки каждой записи (время в
+    // микросекундах), совпадение результатов и их же по снимку .nbz
+    int BenchTagsCommand() {
+        BenchReport^ report = gcnew BenchReport(RowsOption("1000000"));
+        int count = report->GetRows();
+        // Метки и доля записей с каждой: от редких до почти всех
+        array<String^>^ tags = { "family", "friends", "work", "vip", "archived", "newsletter", "client", "supplier" };
+        array<double>^ shares = { 0.1, 0.2, 0.4, 0.01, 0.3, 0.6, 0.05, 0.005 };
+        List<NotebookEntry<int>^>^ entries = BenchSupport::Generate(count);
+        Random^ random = gcnew Random(7);
+        List<String^>^ entryTags = gcnew List<String^>();
+        for each (NotebookEntry<int>^ entry in entries) {
+            entryTags->Clear();
+            for (int t = 0; t < tags->Length; t++) {
+                if (random->NextDouble() < shares[t]) entryTags->Add(tags[t]);
+            }
+            entry->SetTags(entryTags->ToArray());
+        }
+        timer->Mark("generate");
+
+        TagIndex^ index = gcnew TagIndex();
+        Stopwatch^ clock = Stopwatch::StartNew();
+        index->Count("vip", entries);
+        double buildMs = clock->Elapsed.TotalMilliseconds;
+        timer->Mark("index");
+
+        String^ failure = "Tag index or snapshot results differ from the per-entry scan";
+        array<String^>^ queries = { "vip", "work & !archived", "(family | friends) newsletter",
+                                    "client | supplier", "!newsletter", "work and not (vip or client)",
+                                    "vip address:lenina", "friends sounds:ivanov" };
+        array<array<int>^>^ expected = gcnew array<array<int>^>(queries->Length);
+        report->Add("index_build_ms", Math::Round(buildMs, 1));
+        report->Add("index_bytes", index->GetUsedBytes());
+        report->BeginArray("queries");
+        for (int i = 0; i < queries->Length; i++) {
+            // Лучшее из пяти: число совпадений и номера строк по множествам
+            double countUs = Double::MaxValue;
+            double rowsUs = Double::MaxValue;
+            int matches = 0;
+            for (int attempt = 0; attempt < 5; attempt++) {
+                clock->Restart();
+                matches = index->Count(queries[i], entries);
+                countUs = Math::Min(countUs, clock->Elapsed.TotalMilliseconds * 1000);
+                clock->Restart();
+                expected[i] = index->FindRows(queries[i], entries);
+                rowsUs = Math::Min(rowsUs, clock->Elapsed.TotalMilliseconds * 1000);
+            }
+            double scanMs;
+            List<int>^ scanned = BenchSupport::TimeFind(entries, EntrySchema::TagSearchType, queries[i], scanMs);
+            report->Check(BenchSupport::SameRows(scanned, expected[i]) && matches == expected[i]->Length, failure);
+
+            report->BeginItem();
+            report->Add("query", queries[i]);
+            report->Add("matches", matches);
+            report->Add("count_us", Math::Round(countUs, 1));
+            report->Add("rows_us", Math::Round(rowsUs, 1));
+            report->Add("scan_us", Math::Round(scanMs * 1000, 1));
+            report->EndItem();
+        }
+        report->EndArray();
+        timer->Mark("query");
+
+        // Снимок: множества меток сохраняются и читаются вместе с колонками
+        MemoryStream^ snapshot = gcnew MemoryStream();
+        CompressedBook::Build(entries)->Save(snapshot);
+        snapshot->Position = 0;
+        CompressedBook^ loaded = CompressedBook::Load(snapshot);
+        int snapshotMismatches = 0;
+        for (int i = 0; i < queries->Length; i++) {
+            List<int>^ found = loaded->Search(queries[i], EntrySchema::TagSearchType);
+            if (!BenchSupport::SameRows(found, expected[i])) snapshotMismatches++;
+        }
+        // Поиск "звучит как" по словарям имен снимка
+        List<int>^ soundsFound = loaded->Search("ivanov", EntrySchema::SoundsLikeSearchType);
+        List<NotebookEntry<int>^>^ soundsScanned = NotebookManager::SearchIn(entries, "ivanov", EntrySchema::SoundsLikeSearchType);
+        bool soundsSame = soundsFound->Count == soundsScanned->Count;
+        for (int j = 0; soundsSame && j < soundsFound->Count; j++) {
+            soundsSame = loaded->GetEntry(soundsFound[j])->GetId() == soundsScanned[j]->GetId();
+        }
+        if (!soundsSame) snapshotMismatches++;
+        for (int row = 0; row < count; row += Math::Max(1, count / 1000)) {
+            if (RecordHasher::Hash(loaded->GetEntry(row)) != RecordHasher::Hash(entries[row])) snapshotMismatches++;
+        }
+        report->Check(snapshotMismatches == 0, failure);
+        report->Add("snapshot_bytes", snapshot->Length);
+        report->Add("snapshot_mismatches", snapshotMismatches);
+        timer->Mark("snapshot");
+        return Finish(report);
+    }
+
+    NotebookMerger^ CreateMerger() {
+        return gcnew NotebookMerger(
+            NotebookMerger::ParsePolicy(arguments->GetOption("--policy", "incoming")),
+            arguments->HasFlag("--drop-removed"),
+            Int64::Parse(arguments->GetOption("--memory-mb", "256")) * 1024 * 1024);
+    }
+
+    // Слияние основного файла с входящим: итоги - JSON в stdout
+    int MergeCommand() {
+        String^ master = arguments->Require(0, "master");
+        String^ incoming = arguments->Require(1, "incoming");
+        String^ output = arguments->GetOption("--out", nullptr);
+        if (output == nullptr) {
+            throw gcnew ArgumentException("Missing option: --out");
+        }
+        MergeReport^ report = CreateMerger()->Merge(master, incoming, output, arguments->GetOption("--report", nullptr));
+        timer->Mark("merge");
+        rows = (int)report->written;
+        TextWriter^ writer = OpenStandardWriter();
+        writer->WriteLine(report->ToJson());
+        writer->Flush();
+        return 0;
+    }
+
+    // Слияние двух сгенерированных книг: во входящей часть записей изменена,
+    // удалена, заменена другим человеком и добавлена
+    int BenchMergeCommand() {
+        int count = RowsOption("1000000");
+        String^ extension = "." + arguments->GetOption("--format", "json");
+        String^ masterPath = TempPath("-master" + extension);
+        String^ incomingPath = TempPath("-incoming" + extension);
+        String^ outputPath = TempPath("-merged" + extension);
+        String^ reportPath = TempPath("-diff.tsv");
+        SampleDataGenerator^ generator = gcnew SampleDataGenerator(42);
+        SampleDataGenerator^ replacements = gcnew SampleDataGenerator(7);
+        Random^ random = gcnew Random(1);
+        EntryStreamWriter^ master = EntryStreamWriter::Create(masterPath);
+        EntryStreamWriter^ incoming = EntryStreamWriter::Create(incomingPath);
+        try {
+            for (int id = 1; id <= count; id++) {
+                NotebookEntry<int>^ entry = generator->Next(id);
+                master->Write(entry);
+                int roll = random->Next(100);
+                if (roll == 0) continue;                        // удалена во входящем
+                if (roll < 6) {
+                    entry = gcnew NotebookEntry<int>(id, entry->GetFirstName(), entry->GetLastName(),
+                        replacements->Next(id)->GetPhoneNumber(), entry->GetBirthDate(),
+                        entry->GetEmail(), entry->GetAddress(), "Updated in the field");
+                }
+                else if (roll == 6) {
+                    entry = replacements->Next(id);             // другой человек под тем же ID
+                }
+                incoming->Write(entry);
+            }
+            for (int id = count + 1; id <= count + count / 50; id++) {
+                incoming->Write(replacements->Next(id));
+            }
+        }
+        finally {
+            master->Close();
+            incoming->Close();
+        }
+        timer->Mark("generate");
+
+        MergeReport^ report = CreateMerger()->Merge(masterPath, incomingPath, outputPath, reportPath);
+        timer->Mark("merge");
+        rows = (int)report->written;
+        TextWriter^ writer = OpenStandardWriter();
+        writer->WriteLine(report->ToJson());
+        writer->Flush();
+        return 0;
+    }
+
+    // Виды операций crash-test: добавление, удаление, правка, отмена,
+    // контрольная точка, сортировка
+    literal int CrashTestOperations = 11;
+
+    // Одна случайная операция над книгой для crash-test
+    static void RandomOperation(NotebookManager^ manager, int kind, Random^ random, SampleDataGenerator^ generator) {
+        System::Collections::ObjectModel::ReadOnlyCollection<NotebookEntry<int>^>^ entries = manager->GetAllEntries();
+        if (kind < 4 || entries->Count == 0) {
+            List<NotebookEntry<int>^>^ added = gcnew List<NotebookEntry<int>^>();
+            int nextId = manager->GetMaxId() + 1;
+            for (int i = random->Next(1, 4); i > 0; i--) {
+                added->Add(generator->Next(nextId++));
+            }
+            manager->AddEntries(added);
+        }
+        else if (kind < 6) {
+            manager->RemoveEntry(entries[random->Next(entries->Count)]->GetId());
+        }
+        else if (kind < 8) {
+            NotebookEntry<int>^ entry = entries[random->Next(entries->Count)];
+            manager->UpdateEntry(gcnew NotebookEntry<int>(entry->GetId(), entry->GetFirstName(), entry->GetLastName(),
+                entry->GetPhoneNumber(), entry->GetBirthDate(), entry->GetEmail(), entry->GetAddress(),
+                "Edited " + random->Next()));
+        }
+        else if (kind == 8) {
+            manager->Undo();
+        }
+        else if (kind == 9) {
+            manager->Checkpoint();
+        }
+        else {
+            manager->SortById();
+        }
+    }
+
+    static String^ Fingerprint(NotebookManager^ manager) {
+        return JsonConvert::SerializeObject(manager->GetAllEntries());
+    }
+
+    // Проверка восстановления: операции над книгой в журнальном режиме
+    // обрываются на случайном байте записи, после чего книга открывается
+    // заново. Восстановленное состояние должно совпасть с состоянием до или
+    // после оборванной операции. Отчет - JSON в stdout
+    int CrashTestCommand() {
+        int iterations = Int32::Parse(arguments->GetOption("--iterations", "500"));
+        int count = Int32::Parse(arguments->GetOption("--rows", "2000"));
+        Random^ random = gcnew Random(Int32::Parse(arguments->GetOption("--seed", "1")));
+        SampleDataGenerator^ generator = gcnew SampleDataGenerator(42);
+        String^ directory = Path::Combine(Path::GetTempPath(), "nbcli-crash-" + Guid::NewGuid().ToString("N"));
+        Directory::CreateDirectory(directory);
+        String^ path = Path::Combine(directory, "contacts.json");
+        try {
+            NotebookManager^ manager = gcnew NotebookManager(path);
+            manager->EnableJournal();
+            List<NotebookEntry<int>^>^ initial = gcnew List<NotebookEntry<int>^>(count);
+            for (int id = 1; id <= count; id++) {
+                initial->Add(generator->Next(id));
+            }
+            manager->AddEntries(initial);
+            manager->Checkpoint();
+            timer->Mark("generate");
+
+            // Сколько байт записывает операция каждого вида - по последнему замеру
+            array<long long>^ operationBytes = gcnew array<long long>(CrashTestOperations);
+            for (int i = 0; i < CrashTestOperations; i++) operationBytes[i] = 4096;
+
+            int crashes = 0;
+            int lostOperations = 0;
+            int failures = 0;
+            double totalRecoveryMs = 0;
+            double maxRecoveryMs = 0;
+            long long maxDiscardedBytes = 0;
+            long long maxJournalBytes = 0;
+            for (int iteration = 0; iteration < iterations; iteration++) {
+                int kind = random->Next(CrashTestOperations);
+                String^ before = Fingerprint(manager);
+                long long crashAt = (long long)(random->NextDouble() * operationBytes[kind] * 1.25);
+                long long written = StorageFaults::GetWrittenBytes();
+                bool crashed = false;
+                StorageFaults::ArmAfter(crashAt);
+                try {
+                    RandomOperation(manager, kind, random, generator);
+                }
+                catch (SimulatedCrashException^) {
+                    crashed = true;
+                }
+                finally {
+                    StorageFaults::Disarm();
+                }
+                if (!crashed) {
+                    operationBytes[kind] = Math::Max(1LL, StorageFaults::GetWrittenBytes() - written);
+                }
+                String^ after = Fingerprint(manager);
+                maxJournalBytes = Math::Max(maxJournalBytes, (gcnew FileInfo(path + ".journal"))->Length);
+
+                // Перезапуск после сбоя
+                Stopwatch^ clock = Stopwatch::StartNew();
+                NotebookManager^ recovered = gcnew NotebookManager(path);
+                double recoveryMs = clock->Elapsed.TotalMilliseconds;
+                recovered->EnableJournal();
+                String^ state = Fingerprint(recovered);
+                JournalRecovery^ recovery = recovered->GetRecovery();
+
+                if (crashed) crashes++;
+                totalRecoveryMs += recoveryMs;
+                maxRecoveryMs = Math::Max(maxRecoveryMs, recoveryMs);
+                if (recovery != nullptr) {
+                    maxDiscardedBytes = Math::Max(maxDiscardedBytes, recovery->discardedBytes);
+                }
+                if (state == after) {
+                    // Операция сохранилась целиком
+                }
+                else if (crashed && state == before) {
+                    lostOperations++;
+                }
+                else {
+                    failures++;
+                    Console::Error->WriteLine("Iteration {0}: operation {1} crashed at byte {2}; recovered state matches neither side",
+                        iteration, kind, crashAt);
+                }
+                manager = recovered;
+            }
+            timer->Mark("crash");
+
+            StringWriter^ text = gcnew StringWriter();
+            JsonTextWriter^ json = gcnew JsonTextWriter(text);
+            json->WriteStartObject();
+            json->WritePropertyName("iterations");
+            json->WriteValue(iterations);
+            json->WritePropertyName("rows");
+            json->WriteValue(manager->GetCount());
+            json->WritePropertyName("crashes");
+            json->WriteValue(crashes);
+            json->WritePropertyName("lost_operations");
+            json->WriteValue(lostOperations);
+            json->WritePropertyName("failures");
+            json->WriteValue(failures);
+            json->WritePropertyName("avg_recovery_ms");
+            json->WriteValue(Math::Round(totalRecoveryMs / Math::Max(iterations, 1), 3));
+            json->WritePropertyName("max_recovery_ms");
+            json->WriteValue(Math::Round(maxRecoveryMs, 3));
+            json->WritePropertyName("max_discarded_tail_bytes");
+            json->WriteValue(maxDiscardedBytes);
+            json->WritePropertyName("max_journal_bytes");
+            json->WriteValue(maxJournalBytes);
+            json->WriteEndObject();
+            json->Flush();
+
+            rows = iterations;
+            TextWriter^ output = OpenStandardWriter();
+            output->WriteLine(text->ToString());
+            output->Flush();
+            return failures == 0 ? 0 : 1;
+        }
+        finally {
+            Directory::Delete(directory, true);
+        }
+    }
+
+    // Сохранение книги в JSON: JsonConvert::SerializeObject с записью текста
+    // целиком против EntryJsonWriter. Часть записей получает символы, которые
+    // нужно экранировать, и не-ASCII текст; файлы должны совпасть побайтно.
+    // Отчет - JSON в stdout
+    int BenchSaveCommand() {
+        BenchReport^ report = gcnew BenchReport(RowsOption("1000000"));
+        bool indented = !arguments->HasFlag("--compact");
+        List<NotebookEntry<int>^>^ entries = BenchSupport::Generate(report->GetRows());
+        String^ special = String::Concat("\"quoted\" \\ tab\t line\r\n", gcnew String((wchar_t)0x0416, 1),
+            gcnew String((wchar_t)0x2028, 1), gcnew String((wchar_t)0x01, 1));
+        for each (NotebookEntry<int>^ entry in entries) {
+            if (entry->GetId() % 100 == 0) entry->SetNotes(special);
+            if (entry->GetId() % 1000 == 0) entry->SetEmail(nullptr);
+        }
+        timer->Mark("generate");
+
+        String^ serializerPath = TempPath("-serializer.json");
+        String^ writerPath = TempPath("-writer.json");
+        int collections = GC::CollectionCount(0);
+        Stopwatch^ clock = Stopwatch::StartNew();
+        String^ json = JsonConvert::SerializeObject(entries, indented ? Formatting::Indented : Formatting::None);
+        File::WriteAllText(serializerPath, json, gcnew UTF8Encoding(true));
+        double serializerMs = clock->Elapsed.TotalMilliseconds;
+        int serializerCollections = GC::CollectionCount(0) - collections;
+        json = nullptr;
+        timer->Mark("serializer");
+
+        GC::Collect();
+        collections = GC::CollectionCount(0);
+        clock->Restart();
+        FileStream^ stream = gcnew FileStream(writerPath, FileMode::Create, FileAccess::Write, FileShare::None, 1 << 16);
+        try {
+            array<Byte>^ preamble = (gcnew UTF8Encoding(true))->GetPreamble();
+            stream->Write(preamble, 0, preamble->Length);
+            EntryJsonWriter::WriteAll(entries, stream, indented, false);
+        }
+        finally {
+            stream->Close();
+        }
+        double writerMs = clock->Elapsed.TotalMilliseconds;
+        int writerCollections = GC::CollectionCount(0) - collections;
+        timer->Mark("writer");
+
+        long long fileBytes = (gcnew FileInfo(writerPath))->Length;
+        bool identical = BenchSupport::SameFiles(serializerPath, writerPath);
+        timer->Mark("compare");
+
+        double megabytes = BenchReport::Megabytes(fileBytes);
+        report->Add("indented", indented);
+        report->Add("file_bytes", fileBytes);
+        report->Add("serializer_mb_per_s", Math::Round(BenchReport::PerSecond(megabytes, serializerMs), 1));
+        report->Add("serializer_gen0_collections", serializerCollections);
+        report->Add("writer_mb_per_s", Math::Round(BenchReport::PerSecond(megabytes, writerMs), 1));
+        report->Add("writer_gen0_collections", writerCollections);
+        report->Add("identical", identical);
+        report->Check(identical, "EntryJsonWriter output differs from JsonConvert::SerializeObject");
+        return Finish(report);
+    }
+
+    // Экспорт сгенерированной книги во все форматы: по одному потоку и
+    // параллельно. Время форматирования (сумма по потокам) и записи
+    // показывает, во что упирается экспорт. Отчет - JSON в stdout
+    int BenchExportCommand() {
+        BenchReport^ report = gcnew BenchReport(RowsOption("5000000"));
+        List<NotebookEntry<int>^>^ entries = BenchSupport::Generate(report->GetRows());
+        timer->Mark("generate");
+
+        String^ path = TempPath("");
+        array<String^>^ formats = { "csv", "ndjson", "vcard" };
+        array<int>^ threads = { 1, Environment::ProcessorCount };
+        report->BeginArray("runs");
+        for each (String^ format in formats) {
+            for each (int threadCount in threads) {
+                ParallelExporter^ exporter = gcnew ParallelExporter(RecordFormatters::ByName(format), threadCount);
+                ExportResult^ result = exporter->Export(entries, path);
+                report->BeginItem();
+                report->Add("format", format);
+                report->Add("threads", threadCount);
+                report->Add("bytes", result->bytes);
+                report->Add("mb_per_s", Math::Round(BenchReport::PerSecond(BenchReport::Megabytes(result->bytes), result->elapsedMilliseconds), 1));
+                report->Add("format_ms", Math::Round(result->formatMilliseconds));
+                report->Add("write_ms", Math::Round(result->writeMilliseconds));
+                report->Add("elapsed_ms", Math::Round(result->elapsedMilliseconds));
+                report->EndItem();
+                timer->Mark(format + "-" + threadCount);
+            }
+        }
+        report->EndArray();
+        return Finish(report);
+    }
+
+    // Импорт vCard: файл из сгенерированной книги (экспорт в vCard), затем
+    // только разбор - скорость и рост кучи по ходу чтения, - и импорт в
+    // книгу с проверкой, что записи вернулись без изменений. Отчет - JSON в stdout
+    int BenchVCardCommand() {
+        BenchReport^ report = gcnew BenchReport(RowsOption("1000000"));
+        int count = report->GetRows();
+        bool samplesOk = BenchSupport::CheckVCardSamples();
+        List<NotebookEntry<int>^>^ source = BenchSupport::Generate(count);
+        String^ path = TempPath(".vcf");
+        (gcnew ParallelExporter(gcnew VCardFormatter()))->Export(source, path);
+        long long fileBytes = (gcnew FileInfo(path))->Length;
+        timer->Mark("generate");
+
+        // Разбор без сохранения записей: куча не должна расти с размером файла
+        long long baseline = GC::GetTotalMemory(true);
+        long long peakGrowth = 0;
+        int parsed = 0;
+        Stopwatch^ clock = Stopwatch::StartNew();
+        VCardReader^ reader = VCardReader::Open(path);
+        try {
+            NotebookEntry<int>^ entry;
+            while (reader->Read(entry)) {
+                if (++parsed % 100000 == 0) {
+                    peakGrowth = Math::Max(peakGrowth, GC::GetTotalMemory(false) - baseline);
+                }
+            }
+        }
+        finally {
+            reader->Close();
+        }
+        double parseMs = clock->Elapsed.TotalMilliseconds;
+        timer->Mark("parse");
+
+        NotebookManager^ manager = gcnew NotebookManager(nullptr, false);
+        clock->Restart();
+        int imported = manager->ImportVCard(path);
+        double importMs = clock->Elapsed.TotalMilliseconds;
+        timer->Mark("import");
+
+        int mismatches = 0;
+        System::Collections::ObjectModel::ReadOnlyCollection<NotebookEntry<int>^>^ loaded = manager->GetAllEntries();
+        for (int i = 0; i < Math::Min(loaded->Count, source->Count); i++) {
+            if (BenchSupport::TsvLine(loaded[i]) != BenchSupport::TsvLine(source[i])) mismatches++;
+        }
+        timer->Mark("verify");
+
+        report->Add("file_bytes", fileBytes);
+        report->Add("parse_cards_per_s", Math::Round(BenchReport::PerSecond(parsed, parseMs)));
+        report->Add("parse_mb_per_s", Math::Round(BenchReport::PerSecond(BenchReport::Megabytes(fileBytes), parseMs), 1));
+        report->Add("parse_heap_growth_bytes", peakGrowth);
+        report->Add("import_ms", Math::Round(importMs));
+        report->Add("imported", imported);
+        report->Add("mismatches", mismatches);
+        report->Add("samples_ok", samplesOk);
+        report->Check(samplesOk && imported == count && mismatches == 0, "vCard import did not reproduce the source entries");
+        return Finish(report);
+    }
+
+    // Поиск "звучит как": индекс имен против просмотра книги. Часть фамилий
+    // Ivanov записана кириллицей и как Ivanoff - все они должны найтись
+    int BenchNamesCommand() {
+        BenchReport^ report = gcnew BenchReport(RowsOption("1000000"));
+        bool samplesOk = BenchSupport::CheckNameKeySamples();
+        List<NotebookEntry<int>^>^ source = BenchSupport::Generate(report->GetRows());
+        for each (NotebookEntry<int>^ entry in source) {
+            if (entry->GetLastName() == "Ivanov") {
+                if (entry->GetId() % 3 == 0) entry->SetLastName(L"\u0418\u0432\u0430\u043d\u043e\u0432");
+                else if (entry->GetId() % 3 == 1) entry->SetLastName("Ivanoff");
+            }
+        }
+        NotebookManager^ manager = FromEntries(source);
+        array<String^>^ queries = { "Ivanov", L"\u0418\u0432\u0430\u043d\u043e\u0432", "Smirnoff", "Julia", "Iwan Iwanow", "Zaytsev" };
+        timer->Mark("generate");
+
+        Stopwatch^ clock = Stopwatch::StartNew();
+        manager->SearchByAnyField("Ivanov", EntrySchema::SoundsLikeSearchType);
+        double buildMs = clock->Elapsed.TotalMilliseconds;
+        timer->Mark("index");
+
+        int mismatches = 0;
+        int found = 0;
+        double indexMs = 0;
+        double scanMs = 0;
+        for each (String^ query in queries) {
+            clock->Restart();
+            List<NotebookEntry<int>^>^ indexed = manager->SearchByAnyField(query, EntrySchema::SoundsLikeSearchType);
+            indexMs += clock->Elapsed.TotalMilliseconds;
+            clock->Restart();
+            List<NotebookEntry<int>^>^ scanned = NotebookManager::SearchIn(manager->GetAllEntries(), query, EntrySchema::SoundsLikeSearchType);
+            scanMs += clock->Elapsed.TotalMilliseconds;
+            if (!BenchSupport::SameEntries(indexed, scanned)) mismatches++;
+            found += indexed->Count;
+        }
+        timer->Mark("search");
+
+        // Ivanov, Иванов, Ivanoff и Ivanova - один результат
+        int ivanovs = 0;
+        for each (NotebookEntry<int>^ entry in source) {
+            if (NameKeys::Phonetic(entry->GetLastName()) == NameKeys::Phonetic("Ivanov")) ivanovs++;
+        }
+        bool variantsOk = manager->SearchByAnyField(L"\u0418\u0432\u0430\u043d\u043e\u0432", EntrySchema::SoundsLikeSearchType)->Count >= ivanovs;
+
+        report->Add("index_build_ms", Math::Round(buildMs, 1));
+        report->Add("index_bytes", manager->EstimateNameIndexBytes());
+        report->Add("indexed_query_ms", Math::Round(indexMs / queries->Length, 3));
+        report->Add("scan_query_ms", Math::Round(scanMs / queries->Length, 3));
+        report->Add("rows_found", found);
+        report->Add("mismatches", mismatches);
+        report->Add("variants_ok", variantsOk);
+        report->Add("samples_ok", samplesOk);
+        report->Check(samplesOk && variantsOk && mismatches == 0, "Sounds-like search missed name variants");
+        return Finish(report);
+    }
+
+    // Внешняя сортировка сгенерированного файла в заданном бюджете памяти:
+    // время построения частей и слияния, объем временных файлов, пиковый
+    // рабочий набор и проверка порядка результата
+    int BenchSortCommand() {
+        BenchReport^ report = gcnew BenchReport(RowsOption("10000000"));
+        int count = report->GetRows();
+        long long budget = Int64::Parse(arguments->GetOption("--memory-mb", "256")) * 1024 * 1024;
+        EntryOrder order = ParseOrder(arguments->GetOption("--by", "last"));
+        bool descending = arguments->HasFlag("--desc");
+        String^ extension = "." + arguments->GetOption("--format", "tsv");
+        String^ inputPath = TempPath("-input" + extension);
+        String^ outputPath = TempPath("-sorted" + extension);
+        // Файл пишется потоком: книга может не помещаться в бюджет памяти
+        SampleDataGenerator^ generator = gcnew SampleDataGenerator(42);
+        EntryStreamWriter^ input = EntryStreamWriter::Create(inputPath);
+        try {
+            for (int id = 1; id <= count; id++) {
+                input->Write(generator->Next(id));
+            }
+        }
+        finally {
+            input->Close();
+        }
+        timer->Mark("generate");
+
+        ExternalSorter^ sorter = gcnew ExternalSorter(order, descending, budget);
+        SortReport^ sorted;
+        try {
+            sorter->AddFile(inputPath);
+            timer->Mark("runs");
+            sorted = sorter->WriteTo(outputPath);
+            timer->Mark("merge");
+        }
+        finally {
+            delete sorter;
+        }
+        long long peakBytes = Process::GetCurrentProcess()->PeakWorkingSet64;
+
+        long long written;
+        long long disorder = BenchSupport::CountDisorder(outputPath, order, descending, written);
+        timer->Mark("verify");
+
+        double seconds = (sorted->runMilliseconds + sorted->mergeMilliseconds) / 1000;
+        report->Add("memory_mb", budget / (1024 * 1024));
+        report->Add("input_mb", Math::Round(BenchReport::Megabytes((gcnew FileInfo(inputPath))->Length), 1));
+        report->Add("runs", sorted->runs);
+        report->Add("merge_passes", sorted->mergePasses);
+        report->Add("run_mb", Math::Round(BenchReport::Megabytes(sorted->runBytes), 1));
+        report->Add("run_ms", Math::Round(sorted->runMilliseconds, 1));
+        report->Add("merge_ms", Math::Round(sorted->mergeMilliseconds, 1));
+        report->Add("rows_per_sec", seconds == 0 ? 0.0 : Math::Round(count / seconds));
+        report->Add("peak_working_set_mb", Math::Round(BenchReport::Megabytes(peakBytes), 1));
+        report->Add("rows_written", written);
+        report->Add("out_of_order", disorder);
+        report->Check(disorder == 0 && written == count, "External sort lost rows or broke the order");
+        return Finish(report);
+    }
+
+    int BenchCompleteCommand() {
+        BenchReport^ report = gcnew BenchReport(RowsOption("1000000"));
+        int count = report->GetRows();
+        SampleDataGenerator^ generator = gcnew SampleDataGenerator(42);
+        List<NotebookEntry<int>^>^ source = BenchSupport::Generate(generator, count);
+        timer->Mark("generate");
+
+        Stopwatch^ clock = Stopwatch::StartNew();
+        FieldCompletions^ completions = gcnew FieldCompletions();
+        completions->Rebuild(source);
+        double buildMs = clock->Elapsed.TotalMilliseconds;
+        timer->Mark("build");
+
+        int distinct = 0;
+        for (int i = 0; i < FieldCompletions::FieldCount; i++) {
+            distinct += completions->GetTrie((CompletionField)i)->GetDistinctCount();
+        }
+
+        // Префиксы длиной 1-4 из значений случайных записей
+        Random^ random = gcnew Random(7);
+        List<String^>^ prefixes = gcnew List<String^>();
+        List<CompletionField>^ fields = gcnew List<CompletionField>();
+        for (int i = 0; i < 2000; i++) {
+            NotebookEntry<int>^ entry = source[random->Next(source->Count)];
+            CompletionField field = (CompletionField)(i % FieldCompletions::FieldCount);
+            String^ value = field == CompletionField::FirstName ? entry->GetFirstName() :
+                field == CompletionField::LastName ? entry->GetLastName() :
+                field == CompletionField::Email ? entry->GetEmail() : entry->GetAddress();
+            if (value->Length == 0) continue;
+            prefixes->Add(value->Substring(0, Math::Min(value->Length, 1 + i % 4))->ToLowerInvariant());
+            fields->Add(field);
+        }
+        int suggested = 0;
+        clock->Restart();
+        for (int i = 0; i < prefixes->Count; i++) {
+            suggested += completions->Complete(fields[i], prefixes[i], 10)->Count;
+        }
+        double completeUs = clock->Elapsed.TotalMilliseconds * 1000 / Math::Max(prefixes->Count, 1);
+        timer->Mark("complete");
+
+        // Инкрементальная правка: удаление части записей и добавление новых
+        int changed = Math::Min(10000, count / 2);
+        List<NotebookEntry<int>^>^ current = gcnew List<NotebookEntry<int>^>(source);
+        clock->Restart();
+        for (int i = 0; i < changed; i++) {
+            completions->Remove(current[i]);
+        }
+        current->RemoveRange(0, changed);
+        for (int i = 0; i < changed; i++) {
+            NotebookEntry<int>^ entry = generator->Next(count + i + 1);
+            // Редкие значения: новые узлы и разделения меток
+            if (i % 10 == 0) entry->SetLastName(entry->GetLastName() + "a" + i.ToString(CultureInfo::InvariantCulture));
+            completions->Add(entry);
+            current->Add(entry);
+        }
+        double updateUs = changed == 0 ? 0.0 : clock->Elapsed.TotalMilliseconds * 1000 / (2.0 * changed);
+        timer->Mark("update");
+
+        array<String^>^ checks = { "i", "Iv", "s", "SM", "Smirnova", "k", "Ko", "W", "Zai", "x", "Ivanova1" };
+        int mismatches = BenchSupport::CountCompletionMismatches(completions, current, checks);
+        timer->Mark("verify");
+
+        report->Add("build_ms", Math::Round(buildMs, 1));
+        report->Add("distinct_values", distinct);
+        report->Add("trie_bytes", completions->EstimateBytes());
+        report->Add("bytes_per_value", distinct == 0 ? 0.0 : Math::Round((double)completions->EstimateBytes() / distinct, 1));
+        report->Add("top10_us", Math::Round(completeUs, 2));
+        report->Add("update_us", Math::Round(updateUs, 2));
+        report->Add("suggestions", suggested);
+        report->Add("mismatches", mismatches);
+        report->Check(mismatches == 0, "Completions differ from a full scan");
+        return Finish(report);
+    }
+
+    // Кэш запросов: поиск без кэша и из кэша, сортировка и возврат к
+    // посчитанному порядку, правка результатов пакетами изменений
+    int BenchQueryCommand() {
+        BenchReport^ report = gcnew BenchReport(RowsOption("1000000"));
+        int count = report->GetRows();
+        int edits = Int32::Parse(arguments->GetOption("--edits", "200"));
+        SampleDataGenerator^ generator = gcnew SampleDataGenerator(42);
+        NotebookManager^ manager = FromEntries(BenchSupport::Generate(generator, count));
+        QueryCache^ cache = manager->GetQueryCache();
+        array<String^>^ queries = { "a", "an", "ann", "ol", "iv", "ma", "dmi", "ele", "ni", "xyz" };
+        timer->Mark("generate");
+
+        Stopwatch^ clock = Stopwatch::StartNew();
+        for each (String^ query in queries) {
+            manager->SearchByAnyField(query, 0);
+        }
+        double searchColdMs = clock->Elapsed.TotalMilliseconds;
+        clock->Restart();
+        for each (String^ query in queries) {
+            manager->SearchByAnyField(query, 0);
+        }
+        double searchWarmMs = clock->Elapsed.TotalMilliseconds;
+        timer->Mark("search");
+
+        clock->Restart();
+        manager->SortByFirstName(true);
+        double sortFirstMs = clock->Elapsed.TotalMilliseconds;
+        clock->Restart();
+        manager->SortByLastName(true);
+        double sortLastMs = clock->Elapsed.TotalMilliseconds;
+        // Порядок по имени посчитан и переведен на новые номера - только перестановка
+        clock->Restart();
+        manager->SortByFirstName(true);
+        double sortBackMs = clock->Elapsed.TotalMilliseconds;
+        timer->Mark("sort");
+
+        // Правки, вставки и удаления: результаты правятся, а не считаются заново
+        Random^ random = gcnew Random(7);
+        int nextId = count + 1;
+        clock->Restart();
+        for (int i = 0; i < edits; i++) {
+            int id = random->Next(1, count + 1);
+            switch (i % 3) {
+                case 0: manager->UpdateEntry(generator->Next(id)); break;
+                case 1: manager->AddEntry(generator->Next(nextId++)); break;
+                default: manager->RemoveEntry(id); break;
+            }
+        }
+        double editMs = clock->Elapsed.TotalMilliseconds;
+        long long missesBefore = cache->GetMisses();
+        clock->Restart();
+        for each (String^ query in queries) {
+            manager->SearchByAnyField(query, 0);
+        }
+        double searchPatchedMs = clock->Elapsed.TotalMilliseconds;
+        long long patchedMisses = cache->GetMisses() - missesBefore;
+        timer->Mark("edit");
+
+        int mismatches = BenchSupport::CountQueryMismatches(manager, queries);
+        timer->Mark("verify");
+
+        report->Add("search_cold_ms", Math::Round(searchColdMs, 1));
+        report->Add("search_cached_ms", Math::Round(searchWarmMs, 1));
+        report->Add("sort_first_ms", Math::Round(sortFirstMs, 1));
+        report->Add("sort_last_ms", Math::Round(sortLastMs, 1));
+        report->Add("sort_back_to_first_ms", Math::Round(sortBackMs, 1));
+        report->Add("edits", edits);
+        report->Add("edit_ms_per_op", Math::Round(editMs / Math::Max(edits, 1), 3));
+        report->Add("search_after_edits_ms", Math::Round(searchPatchedMs, 1));
+        report->Add("misses_after_edits", patchedMisses);
+        report->Add("hits", cache->GetHits());
+        report->Add("misses", cache->GetMisses());
+        report->Add("patches", cache->GetPatches());
+        report->Add("cache_bytes", cache->GetUsedBytes());
+        report->Add("mismatches", mismatches);
+        report->Check(mismatches == 0, "Cached query results differ from a fresh search");
+        return Finish(report);
+    }
+
+    int Dispatch() {
+        try {
+            return DispatchCommand();
+        }
+        finally {
+            DeleteTempFiles();
+        }
+    }
+
+    int DispatchCommand() {
+        if (arguments->command == "load") return LoadCommand();
+        if (arguments->command == "convert") return ConvertCommand();
+        if (arguments->command == "search") return SearchCommand();
+        if (arguments->command == "workspace-search") return WorkspaceSearchCommand();
+        if (arguments->command == "sort") return SortCommand();
+        if (arguments->command == "page") return PageCommand();
+        if (arguments->command == "export") return ExportCommand();
+        if (arguments->command == "import") return ImportCommand();
+        if (arguments->command == "dedupe") return DedupeCommand();
+        if (arguments->command == "birthdays") return BirthdaysCommand();
+        if (arguments->command == "serve") return ServeCommand();
+        if (arguments->command == "bench-server") return BenchServerCommand();
+        if (arguments->command == "paged-import") return PagedImportCommand();
+        if (arguments->command == "paged-search") return PagedSearchCommand();
+        if (arguments->command == "paged-sort") return PagedSortCommand();
+        if (arguments->command == "paged-export") return PagedExportCommand();
+        if (arguments->command == "bench-compress") return BenchCompressCommand();
+        if (arguments->command == "merge") return MergeCommand();
+        if (arguments->command == "bench-merge") return BenchMergeCommand();
+        if (arguments->command == "crash-test") return CrashTestCommand();
+        if (arguments->command == "bench-save") return BenchSaveCommand();
+        if (arguments->command == "bench-export") return BenchExportCommand();
+        if (arguments->command == "bench-vcard") return BenchVCardCommand();
+        if (arguments->command == "bench-query") return BenchQueryCommand();
+        if (arguments->command == "bench-names") return BenchNamesCommand();
+        if (arguments->command == "bench-complete") return BenchCompleteCommand();
+        if (arguments->command == "bench-sort") return BenchSortCommand();
+        if (arguments->command == "bench-cold") return BenchColdCommand();
+        if (arguments->command == "bench-tags") return BenchTagsCommand();
+        PrintUsage();
+        return 2;
+    }
+
+    static void PrintUsage() {
+        TextWriter^ error = Console::Error;
+        error->WriteLine("Usage: NBcli <command> [arguments] [--timing]");
+        error->WriteLine("  load <file>                                   print entry count and max id");
+        error->WriteLine("  convert <input> <output>                      convert between JSON and TSV");
+        error->WriteLine("  search <file> --field first|last|phone|email|address|sounds|tags --query <text> [--out <file>]");
+        error->WriteLine("        sounds: first or last name sounds like the query, in Cyrillic or Latin");
+        error->WriteLine("        tags: tag expression, e.g. \"work & !archived\" or \"(family | friends) address:moscow\"");
+        error->WriteLine("  workspace-search <dir> --field <f> --query <text> [--max-resident 4] [--out <file>]");
+        error->WriteLine("        search every *.json book of a directory, loading at most --max-resident at a time");
+        error->WriteLine("  sort <file> --by first|last|id [--desc] [--out <file>] [--memory-mb 256]");
+        error->WriteLine("        --memory-mb: stream the book through an external sort instead of loading it");
+        error->WriteLine("  page <file> [--by id|first|last] [--desc] [--size 50] [--after <token>] [--field <f> --query <text>]");
+        error->WriteLine("        one page as TSV; the token for the next page goes to stderr");
+        error->WriteLine("  export <file> <output.xlsx> [--append]        export to Excel");
+        error->WriteLine("  export <file> <output.csv|.jsonl|.vcf> [--to csv|ndjson|vcard|tsv]");
+        error->WriteLine("        [--field <f> --query <text>] [--by book|id|first|last] [--desc]");
+        error->WriteLine("        parallel export to CSV, JSON Lines or vCard, optionally of a search in a sort order");
+        error->WriteLine("        with --by and --memory-mb the book is not loaded: sorted export of books larger than RAM");
+        error->WriteLine("  import <target.json> <source>...              append entries (JSON, TSV, vCard), renumbering clashing ids");
+        error->WriteLine("  dedupe <file> [--out <file>]                  remove duplicate contacts");
+        error->WriteLine("  birthdays <file> [--days 7]                   upcoming birthdays as TSV");
+        error->WriteLine("  serve <file.json> [--pipe NBnotebook]         keep the book resident and answer queries");
+        error->WriteLine("  bench-server [--pipe] [--clients 8] [--requests 10000] [--depth 16] [--search-ratio 0.1]");
+        error->WriteLine("  paged-import <book.nbp> <source>...           append to a paged book larger than RAM");
+        error->WriteLine("  paged-search <book.nbp> --field <f> --query <text> [--out <file>]");
+        error->WriteLine("  paged-sort <book.nbp> --by first|last|id [--desc] [--out <file>]");
+        error->WriteLine("  paged-export <book.nbp> <output>              stream all entries to JSON or TSV");
+        error->WriteLine("  paged-* commands accept --cache-mb 64 to cap the page cache.");
+        error->WriteLine("  merge <master> <incoming> --out <file> [--report diff.tsv] [--policy incoming|master|keep-both]");
+        error->WriteLine("        [--drop-removed] [--memory-mb 256]          reconcile two books by id and content hash");
+        error->WriteLine("  bench-merge [--rows 1000000] [--format json|tsv] [--policy] [--memory-mb]");
+        error->WriteLine("  bench-compress [--rows 1000000]               column compression: memory, snapshot size, scan speed");
+        error->WriteLine("  crash-test [--iterations 500] [--rows 2000] [--seed 1]");
+        error->WriteLine("        cut journal and file writes at random bytes and check recovery");
+        error->WriteLine("  bench-save [--rows 1000000] [--compact]       JSON save speed: serializer vs streaming writer");
+        error->WriteLine("  bench-export [--rows 5000000]                 export throughput per format, 1 thread vs all cores");
+        error->WriteLine("  bench-vcard [--rows 1000000]                  vCard parse speed, heap growth and round trip");
+        error->WriteLine("  bench-query [--rows 1000000] [--edits 200]    query cache: cold vs cached search and sort, patching");
+        error->WriteLine("  bench-names [--rows 1000000]                  sounds-like search: name index vs scan, script variants");
+        error->WriteLine("  bench-complete [--rows 1000000]               field autocomplete: trie build, size, top-10 latency");
+        error->WriteLine("  bench-sort [--rows 10000000] [--memory-mb 256] [--by last] [--format tsv|json]");
+        error->WriteLine("        external sort: runs, merge passes, temp bytes, peak working set, order check");
+        error->WriteLine("  bench-cold [--rows 1000000]                   addresses and notes out of line: memory, hot and address scans");
+        error->WriteLine("  bench-tags [--rows 1000000]                   tag filters: bitmap index vs scan in microseconds, snapshot round trip");
+        error->WriteLine("--compact writes JSON output without indentation.");
+        error->WriteLine("Use - for stdin/stdout; --format, --from, --to select json or tsv for streams.");
+    }
+
+public:
+    // Точка входа: возвращает код завершения процесса
+    static int Run(array<String^>^ args) {
+        CommandArguments^ arguments;
+        try {
+            arguments = CommandArguments::Parse(args);
+        }
+        catch (ArgumentException^ ex) {
+            Console::Error->WriteLine(ex->Message);
+            PrintUsage();
+            return 2;
+        }
+        if (arguments->command == nullptr) {
+            PrintUsage();
+            return 2;
+        }
+
+        BatchCommands^ commands = gcnew BatchCommands(arguments);
+        int exitCode;
+        try {
+            exitCode = commands->Dispatch();
+        }
+        catch (ArgumentException^ ex) {
+            Console::Error->WriteLine(ex->Message);
+            return 2;
+        }
+        catch (Exception^ ex) {
+            Console::Error->WriteLine("Error: " + ex->Message);
+            return 1;
+        }
+
+        if (arguments->HasFlag("--timing")) {
+            Console::Error->WriteLine(commands->timer->ToJson(arguments->command, commands->rows));
+        }
+        return exitCode;
+    }
+};
\ No newline at end of file
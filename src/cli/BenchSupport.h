@@ -0,0 +1,341 @@
+#pragma once
+#include "../controllers/NotebookManager.h"
+#include "../controllers/FieldCompletions.h"
+#include "../utils/EntryStream.h"
+#include "../utils/NameKeys.h"
+#include "../utils/SampleDataGenerator.h"
+#include "../utils/VCardReader.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Diagnostics;
+using namespace System::IO;
+using namespace Newtonsoft::Json;
+
+// Отчет замера NBcli bench-*: один JSON-объект в stdout и проверки
+// результата. Первая не прошедшая проверка дает код завершения 1 и
+// сообщение в stderr
+public ref class BenchReport {
+private:
+    StringWriter^ text;
+    JsonTextWriter^ json;
+    int rows;
+    String^ failure;
+
+public:
+    BenchReport(int rows) : rows(rows) {
+        text = gcnew StringWriter();
+        json = gcnew JsonTextWriter(text);
+        json->WriteStartObject();
+        Add("rows", rows);
+    }
+
+    int GetRows() {
+        return rows;
+    }
+
+    void Add(String^ name, int value) {
+        json->WritePropertyName(name);
+        json->WriteValue(value);
+    }
+
+    void Add(String^ name, long long value) {
+        json->WritePropertyName(name);
+        json->WriteValue(value);
+    }
+
+    void Add(String^ name, double value) {
+        json->WritePropertyName(name);
+        json->WriteValue(value);
+    }
+
+    void Add(String^ name, bool value) {
+        json->WritePropertyName(name);
+        json->WriteValue(value);
+    }
+
+    void Add(String^ name, String^ value) {
+        json->WritePropertyName(name);
+        json->WriteValue(value);
+    }
+
+    // Массив объектов: BeginItem/EndItem для каждого
+    void BeginArray(String^ name) {
+        json->WritePropertyName(name);
+        json->WriteStartArray();
+    }
+
+    void EndArray() {
+        json->WriteEndArray();
+    }
+
+    void BeginItem() {
+        json->WriteStartObject();
+    }
+
+    void EndItem() {
+        json->WriteEndObject();
+    }
+
+    void Check(bool passed, String^ message) {
+        if (!passed && failure == nullptr) failure = message;
+    }
+
+    // Отчет одной строкой в output; 0 или 1 - код завершения
+    int Write(TextWriter^ output) {
+        json->WriteEndObject();
+        json->Flush();
+        output->WriteLine(text->ToString());
+        output->Flush();
+        if (failure == nullptr) return 0;
+        Console::Error->WriteLine(failure);
+        return 1;
+    }
+
+    // amount единиц за milliseconds - в секунду
+    static double PerSecond(double amount, double milliseconds) {
+        return amount / Math::Max(milliseconds, 0.001) * 1000;
+    }
+
+    static double Megabytes(long long bytes) {
+        return bytes / 1048576.0;
+    }
+};
+
+// Данные и эталонные проверки замеров: сгенерированная книга и медленные,
+// но очевидные варианты операций, с которыми сравнивается быстрый путь
+public ref class BenchSupport abstract sealed {
+private:
+    static int CompareCompletions(KeyValuePair<String^, int> x, KeyValuePair<String^, int> y) {
+        if (x.Value != y.Value) return y.Value.CompareTo(x.Value);
+        return String::CompareOrdinal(x.Key, y.Key);
+    }
+
+    static bool SameValues(List<String^>^ x, List<String^>^ y) {
+        if (x->Count != y->Count) return false;
+        for (int i = 0; i < x->Count; i++) {
+            if (x[i] != y[i]) return false;
+        }
+        return true;
+    }
+
+    // Подсказки перебором: значения поля с префиксом (без учета регистра)
+    // по убыванию числа записей, при равенстве - по алфавиту
+    static List<String^>^ CompleteByScan(Dictionary<String^, int>^ counts, String^ prefix, int limit) {
+        List<KeyValuePair<String^, int>>^ matches = gcnew List<KeyValuePair<String^, int>>();
+        for each (KeyValuePair<String^, int> pair in counts) {
+            String^ value = pair.Key;
+            if (value->Length < prefix->Length) continue;
+            bool match = true;
+            for (int i = 0; i < prefix->Length && match; i++) {
+                match = Char::ToLowerInvariant(value[i]) == Char::ToLowerInvariant(prefix[i]);
+            }
+            if (match) matches->Add(pair);
+        }
+        matches->Sort(gcnew Comparison<KeyValuePair<String^, int>>(&BenchSupport::CompareCompletions));
+        List<String^>^ values = gcnew List<String^>(limit);
+        for (int i = 0; i < matches->Count && i < limit; i++) {
+            values->Add(matches[i].Key);
+        }
+        return values;
+    }
+
+public:
+    // Книга из count записей с ID от 1; generator продолжает последовательность
+    static List<NotebookEntry<int>^>^ Generate(SampleDataGenerator^ generator, int count) {
+        List<NotebookEntry<int>^>^ entries = gcnew List<NotebookEntry<int>^>(count);
+        for (int id = 1; id <= count; id++) {
+            entries->Add(generator->Next(id));
+        }
+        return entries;
+    }
+
+    static List<NotebookEntry<int>^>^ Generate(int count) {
+        return Generate(gcnew SampleDataGenerator(42), count);
+    }
+
+    // Лучшее время из трех поисков; результат - номера совпавших записей
+    static List<int>^ TimeFind(List<NotebookEntry<int>^>^ entries, int type, String^ query, double% bestMs) {
+        List<int>^ found = nullptr;
+        bestMs = Double::MaxValue;
+        for (int attempt = 0; attempt < 3; attempt++) {
+            Stopwatch^ clock = Stopwatch::StartNew();
+            found = EntrySchema::Find(type, entries, query->ToLower());
+            bestMs = Math::Min(bestMs, clock->Elapsed.TotalMilliseconds);
+        }
+        return found;
+    }
+
+    static bool SameRows(List<int>^ x, IList<int>^ y) {
+        if (x->Count != y->Count) return false;
+        for (int i = 0; i < x->Count; i++) {
+            if (x[i] != y[i]) return false;
+        }
+        return true;
+    }
+
+    static bool SameEntries(List<NotebookEntry<int>^>^ x, List<NotebookEntry<int>^>^ y) {
+        HashSet<NotebookEntry<int>^>^ set = gcnew HashSet<NotebookEntry<int>^>(x);
+        return x->Count == y->Count && set->SetEquals(y);
+    }
+
+    // Одинаковое содержимое двух файлов
+    static bool SameFiles(String^ first, String^ second) {
+        if ((gcnew FileInfo(first))->Length != (gcnew FileInfo(second))->Length) return false;
+        FileStream^ a = File::OpenRead(first);
+        FileStream^ b = File::OpenRead(second);
+        try {
+            array<Byte>^ left = gcnew array<Byte>(1 << 16);
+            array<Byte>^ right = gcnew array<Byte>(1 << 16);
+            int read;
+            while ((read = a->Read(left, 0, left->Length)) > 0) {
+                int offset = 0;
+                while (offset < read) {
+                    int got = b->Read(right, offset, read - offset);
+                    if (got == 0) return false;
+                    offset += got;
+                }
+                for (int i = 0; i < read; i++) {
+                    if (left[i] != right[i]) return false;
+                }
+            }
+            return true;
+        }
+        finally {
+            a->Close();
+            b->Close();
+        }
+    }
+
+    static String^ TsvLine(NotebookEntry<int>^ entry) {
+        StringWriter^ writer = gcnew StringWriter();
+        EntrySchema::WriteTsv(writer, entry);
+        return writer->ToString();
+    }
+
+    // Разбор карточек с переносами строк, quoted-printable, несколькими
+    // телефонами и структурированным адресом; false - разбор неверен
+    static bool CheckVCardSamples() {
+        String^ sample = String::Concat(
+            "BEGIN:VCARD\r\nVERSION:2.1\r\n",
+            "N;CHARSET=UTF-8;ENCODING=QUOTED-PRINTABLE:=D0=98=D0=B2=D0=B0=D0=BD=D0=BE=D0=B2;=D0=98=D0=B2=D0=B0=D0=BD;;;\r\n",
+            "TEL;CELL:+7 900 000-00-01\r\nTEL;CELL;PREF:+7 900 000-00-02\r\nEMAIL;INTERNET:a@example.com\r\n",
+            "NOTE;ENCODING=QUOTED-PRINTABLE:line one=0D=0A=\r\nline two\r\nEND:VCARD\r\n")
+            + String::Concat(
+            "BEGIN:VCARD\r\nVERSION:3.0\r\nFN:Anna Petrova\r\nUID:urn:uuid:1\r\nTEL;TYPE=home:+7 900 000-00-03\r\n",
+            "ADR;TYPE=home:;;ul. Lenina\\, d. 1;Moskva;;101000;Russia\r\n",
+            "NOTE:long note that is fol\r\n ded here\r\nBDAY:19900415\r\nEND:VCARD\r\n");
+        VCardReader^ reader = gcnew VCardReader(gcnew StringReader(sample));
+        NotebookEntry<int>^ first;
+        NotebookEntry<int>^ second;
+        NotebookEntry<int>^ extra;
+        if (!reader->Read(first) || !reader->Read(second) || reader->Read(extra)) return false;
+        return first->GetLastName() == L"\u0418\u0432\u0430\u043d\u043e\u0432"
+            && first->GetFirstName() == L"\u0418\u0432\u0430\u043d"
+            && first->GetPhoneNumber() == "+7 900 000-00-02"
+            && first->GetEmail() == "a@example.com"
+            && first->GetNotes() == "line one\r\nline two\nTEL: +7 900 000-00-01"
+            && second->GetFirstName() == "Anna" && second->GetLastName() == "Petrova"
+            && second->GetAddress() == "Moskva, ul. Lenina, d. 1, 101000, Russia"
+            && second->GetNotes() == "long note that is folded here"
+            && second->GetBirthDate() == "1990-04-15"
+            && second->GetId() == 0;
+    }
+
+    // Варианты одного имени разными письменностями дают один фонетический ключ
+    static bool CheckNameKeySamples() {
+        array<array<String^>^>^ groups = {
+            gcnew array<String^> { L"\u0418\u0432\u0430\u043d\u043e\u0432", "Ivanov", "Ivanoff", "Iwanow" },
+            gcnew array<String^> { L"\u0414\u043c\u0438\u0442\u0440\u0438\u0439", "Dmitry", "Dmitrii", "Dmitrij" },
+            gcnew array<String^> { L"\u042e\u043b\u0438\u044f", "Julia", "Yulia" },
+            gcnew array<String^> { L"\u0429\u0443\u043a\u0438\u043d", "Schukin", "Shchukin" }
+        };
+        for each (array<String^>^ group in groups) {
+            String^ key = NameKeys::Phonetic(group[0]);
+            for each (String^ name in group) {
+                if (NameKeys::Phonetic(name) != key) return false;
+            }
+        }
+        // Кириллица и латиница без вариантов записи дают один ключ транслитерации
+        return NameKeys::Transliterate(groups[0][0]) == NameKeys::Transliterate("Ivanov")
+            && NameKeys::Phonetic("Ivanov") != NameKeys::Phonetic("Petrov");
+    }
+
+    // Записи файла не по порядку сортировки: сравнение соседних записей
+    // тем же String::Compare, что и сортировка в памяти
+    static long long CountDisorder(String^ path, EntryOrder order, bool descending, long long% count) {
+        EntryStreamReader^ reader = EntryStreamReader::Open(path);
+        long long disorder = 0;
+        count = 0;
+        try {
+            NotebookEntry<int>^ previous = nullptr;
+            NotebookEntry<int>^ entry;
+            while (reader->Read(entry)) {
+                count++;
+                if (previous != nullptr) {
+                    int result = order == EntryOrder::FirstName ? FirstNameField::Compare(previous, entry) :
+                        order == EntryOrder::LastName ? LastNameField::Compare(previous, entry) : 0;
+                    if (result == 0) result = IdField::Compare(previous, entry);
+                    if (descending) result = -result;
+                    if (result > 0) disorder++;
+                }
+                previous = entry;
+            }
+        }
+        finally {
+            reader->Close();
+        }
+        return disorder;
+    }
+
+    // Подсказки фамилий: дерево после удалений и добавлений против перебора
+    static int CountCompletionMismatches(FieldCompletions^ completions, IEnumerable<NotebookEntry<int>^>^ entries,
+                                         array<String^>^ prefixes) {
+        Dictionary<String^, int>^ counts = gcnew Dictionary<String^, int>();
+        for each (NotebookEntry<int>^ entry in entries) {
+            String^ value = entry->GetLastName()->Trim();
+            if (value->Length == 0) continue;
+            int count;
+            counts->TryGetValue(value, count);
+            counts[value] = count + 1;
+        }
+        int mismatches = 0;
+        for each (String^ prefix in prefixes) {
+            List<String^>^ expected = CompleteByScan(counts, prefix, 10);
+            if (!SameValues(completions->Complete(CompletionField::LastName, prefix, 10), expected)) mismatches++;
+        }
+        if (completions->GetTrie(CompletionField::LastName)->GetDistinctCount() != counts->Count) mismatches++;
+        return mismatches;
+    }
+
+    // Все ли результаты кэша совпадают с поиском и сортировкой заново
+    static int CountQueryMismatches(NotebookManager^ manager, array<String^>^ queries) {
+        System::Collections::ObjectModel::ReadOnlyCollection<NotebookEntry<int>^>^ all = manager->GetAllEntries();
+        int mismatches = 0;
+        for each (String^ query in queries) {
+            List<NotebookEntry<int>^>^ cached = manager->SearchByAnyField(query, 0);
+            List<NotebookEntry<int>^>^ fresh = NotebookManager::SearchIn(all, query, 0);
+            if (cached->Count != fresh->Count) {
+                mismatches++;
+                continue;
+            }
+            for (int i = 0; i < cached->Count; i++) {
+                if (!Object::ReferenceEquals(cached[i], fresh[i])) {
+                    mismatches++;
+                    break;
+                }
+            }
+        }
+        // Отсортированное представление: все записи, порядок (имя, ID)
+        List<NotebookEntry<int>^>^ sorted = manager->Query(nullptr, -1, EntryOrder::FirstName, false);
+        if (sorted->Count != all->Count) mismatches++;
+        for (int i = 1; i < sorted->Count; i++) {
+            int order = FirstNameField::Compare(sorted[i - 1], sorted[i]);
+            if (order > 0 || (order == 0 && sorted[i - 1]->GetId() > sorted[i]->GetId())) {
+                mismatches++;
+                break;
+            }
+        }
+        return mismatches;
+    }
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+using namespace System;
+using namespace System::ComponentModel;
+using namespace System::IO;
+using namespace System::Threading;
+
+// Наблюдение за файлом книги: серия событий файловой системы (запись
+// по частям, замена через переименование) сводится в одно событие
+// Changed после паузы DebounceMs. Если задан target, событие приходит
+// в его потоке (например, в потоке формы).
+public ref class BookFileWatcher {
+public:
+    literal int DebounceMs = 300;
+    literal int MaxRetries = 10;
+
+private:
+    FileSystemWatcher^ watcher;
+    System::Threading::Timer^ timer;
+    ISynchronizeInvoke^ target;
+    int retries;
+
+    void OnFileEvent(Object^ sender, FileSystemEventArgs^ e) {
+        retries = 0;
+        timer->Change(DebounceMs, Timeout::Infinite);
+    }
+
+    void OnTimer(Object^ state) {
+        if (target != nullptr && target->InvokeRequired) {
+            target->BeginInvoke(gcnew Action(this, &BookFileWatcher::Raise), nullptr);
+        }
+        else {
+            Raise();
+        }
+    }
+
+    void Raise() {
+        Changed(this, EventArgs::Empty);
+    }
+
+public:
+    event EventHandler^ Changed;
+
+    BookFileWatcher(String^ path, ISynchronizeInvoke^ target) {
+        this->target = target;
+        String^ fullPath = Path::GetFullPath(path);
+        watcher = gcnew FileSystemWatcher(Path::GetDirectoryName(fullPath), Path::GetFileName(fullPath));
+        watcher->NotifyFilter = NotifyFilters::LastWrite | NotifyFilters::Size | NotifyFilters::FileName;
+        watcher->Changed += gcnew FileSystemEventHandler(this, &BookFileWatcher::OnFileEvent);
+        watcher->Created += gcnew FileSystemEventHandler(this, &BookFileWatcher::OnFileEvent);
+        watcher->Renamed += gcnew RenamedEventHandler(this, &BookFileWatcher::OnFileEvent);
+        timer = gcnew System::Threading::Timer(gcnew TimerCallback(this, &BookFileWatcher::OnTimer),
+            nullptr, Timeout::Infinite, Timeout::Infinite);
+    }
+
+    void Start() {
+        watcher->EnableRaisingEvents = true;
+    }
+
+    void Stop() {
+        watcher->EnableRaisingEvents = false;
+        timer->Change(Timeout::Infinite, Timeout::Infinite);
+    }
+
+    // Повтор после неудачного чтения (файл еще занят или дописывается);
+    // не больше MaxRetries раз подряд
+    bool Retry() {
+        if (++retries > MaxRetries) return false;
+        timer->Change(DebounceMs, Timeout::Infinite);
+        return true;
+    }
+
+    ~BookFileWatcher() {
+        Stop();
+        delete watcher;
+        delete timer;
+    }
+};
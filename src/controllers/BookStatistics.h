@@ -0,0 +1,233 @@
+#pragma once
+#include "NotebookManager.h"
+#include "../utils/HyperLogLog.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Globalization;
+using namespace System::Text;
+
+// Счетчик записей по группам (ключи без учета регистра); пустые группы удаляются
+public ref class GroupCounter {
+private:
+    Dictionary<String^, int>^ counts;
+
+    ref class CountComparer : IComparer<KeyValuePair<String^, int>> {
+    public:
+        virtual int Compare(KeyValuePair<String^, int> x, KeyValuePair<String^, int> y) {
+            if (x.Value != y.Value) return y.Value.CompareTo(x.Value);
+            return String::Compare(x.Key, y.Key, StringComparison::OrdinalIgnoreCase);
+        }
+    };
+
+public:
+    GroupCounter() {
+        counts = gcnew Dictionary<String^, int>(StringComparer::OrdinalIgnoreCase);
+    }
+
+    void Add(String^ key) {
+        int count;
+        counts->TryGetValue(key, count);
+        counts[key] = count + 1;
+    }
+
+    void Remove(String^ key) {
+        int count;
+        if (!counts->TryGetValue(key, count)) return;
+        if (count <= 1) counts->Remove(key);
+        else counts[key] = count - 1;
+    }
+
+    int Get(String^ key) {
+        int count;
+        counts->TryGetValue(key, count);
+        return count;
+    }
+
+    // Число различных групп
+    int Count() {
+        return counts->Count;
+    }
+
+    void Clear() {
+        counts->Clear();
+    }
+
+    // Память словаря: ключи и служебные поля записей
+    long long EstimateBytes() {
+        long long bytes = 0;
+        for each (String^ key in counts->Keys) {
+            bytes += MemorySizes::StringBytes(key) + 28;
+        }
+        return bytes;
+    }
+
+    // Самые большие группы (время зависит от числа групп, а не записей)
+    List<KeyValuePair<String^, int>>^ Top(int limit) {
+        List<KeyValuePair<String^, int>>^ top = gcnew List<KeyValuePair<String^, int>>(counts);
+        top->Sort(gcnew CountComparer());
+        if (top->Count > limit) top->RemoveRange(limit, top->Count - limit);
+        return top;
+    }
+};
+
+// Сводная статистика книги, поддерживаемая по событиям NotebookManager::Changed:
+// добавление, удаление и изменение записи меняют только счетчики затронутых
+// групп, полный пересчет - только при событии Reset (загрузка, отмена).
+// Город - первая часть адреса до запятой, десятилетие - по году даты рождения.
+public ref class BookStatistics {
+private:
+    int total;
+    int missingEmail;
+    int missingBirthDate;
+    GroupCounter^ domains;
+    GroupCounter^ cities;
+    GroupCounter^ decades;
+    HyperLogLog^ distinctEmails;
+    HyperLogLog^ distinctPhones;
+
+    static String^ DomainOf(String^ email) {
+        int at = email->LastIndexOf('@');
+        return at >= 0 ? email->Substring(at + 1)->Trim() : "(invalid)";
+    }
+
+    static String^ CityOf(String^ address) {
+        int comma = address->IndexOf(',');
+        String^ city = (comma >= 0 ? address->Substring(0, comma) : address)->Trim();
+        return city->Length > 0 ? city : "(unknown)";
+    }
+
+    static String^ DecadeOf(String^ birthDate) {
+        DateTime date;
+        if (!DateTime::TryParse(birthDate, date)) return "(invalid)";
+        return (date.Year / 10 * 10).ToString(CultureInfo::InvariantCulture) + "s";
+    }
+
+    // Телефон без форматирования: одинаковые номера в разной записи совпадают
+    static String^ PhoneKey(String^ phone) {
+        StringBuilder^ digits = gcnew StringBuilder(phone->Length);
+        for (int i = 0; i < phone->Length; i++) {
+            if (Char::IsDigit(phone[i])) digits->Append(phone[i]);
+        }
+        return digits->ToString();
+    }
+
+    void Count(NotebookEntry<int>^ entry, bool add) {
+        String^ email = entry->GetEmail();
+        String^ address = entry->GetAddress();
+        String^ birthDate = entry->GetBirthDate();
+        String^ phone = entry->GetPhoneNumber();
+        int delta = add ? 1 : -1;
+        total += delta;
+
+        if (String::IsNullOrWhiteSpace(email)) {
+            missingEmail += delta;
+        }
+        else {
+            unsigned long long hash = HyperLogLog::HashString(email->Trim()->ToLowerInvariant());
+            if (add) {
+                domains->Add(DomainOf(email));
+                distinctEmails->Add(hash);
+            }
+            else {
+                domains->Remove(DomainOf(email));
+                distinctEmails->Remove(hash);
+            }
+        }
+
+        if (String::IsNullOrWhiteSpace(birthDate)) {
+            missingBirthDate += delta;
+        }
+        else if (add) decades->Add(DecadeOf(birthDate));
+        else decades->Remove(DecadeOf(birthDate));
+
+        if (!String::IsNullOrWhiteSpace(address)) {
+            if (add) cities->Add(CityOf(address));
+            else cities->Remove(CityOf(address));
+        }
+
+        if (!String::IsNullOrWhiteSpace(phone)) {
+            unsigned long long hash = HyperLogLog::HashString(PhoneKey(phone));
+            if (add) distinctPhones->Add(hash);
+            else distinctPhones->Remove(hash);
+        }
+    }
+
+    void CountAll(IEnumerable<NotebookEntry<int>^>^ source, bool add) {
+        if (source == nullptr) return;
+        for each (NotebookEntry<int>^ entry in source) {
+            Count(entry, add);
+        }
+    }
+
+    void Rebuild(IEnumerable<NotebookEntry<int>^>^ source) {
+        total = 0;
+        missingEmail = 0;
+        missingBirthDate = 0;
+        domains->Clear();
+        cities->Clear();
+        decades->Clear();
+        distinctEmails->Clear();
+        distinctPhones->Clear();
+        CountAll(source, true);
+    }
+
+    void Manager_Changed(Object^ sender, NotebookChangedEventArgs^ e) {
+        for each (NotebookChange^ change in e->changes) {
+            switch (change->kind) {
+            case NotebookChangeKind::Inserted:
+                CountAll(change->entries, true);
+                break;
+            case NotebookChangeKind::Removed:
+                CountAll(change->entries, false);
+                break;
+            case NotebookChangeKind::Updated:
+                CountAll(change->oldEntries, false);
+                CountAll(change->entries, true);
+                break;
+            case NotebookChangeKind::Reset:
+                Rebuild(safe_cast<NotebookManager^>(sender)->GetAllEntries());
+                break;
+            case NotebookChangeKind::Reordered:
+                break;
+            }
+        }
+        Updated(this, EventArgs::Empty);
+    }
+
+public:
+    // Счетчики изменились (после каждой операции менеджера)
+    event EventHandler^ Updated;
+
+    BookStatistics(NotebookManager^ manager) {
+        domains = gcnew GroupCounter();
+        cities = gcnew GroupCounter();
+        decades = gcnew GroupCounter();
+        distinctEmails = gcnew HyperLogLog();
+        distinctPhones = gcnew HyperLogLog();
+        Rebuild(manager->GetAllEntries());
+        manager->Changed += gcnew EventHandler<NotebookChangedEventArgs^>(this, &BookStatistics::Manager_Changed);
+    }
+
+    int GetTotal() { return total; }
+    int GetMissingEmail() { return missingEmail; }
+    int GetMissingBirthDate() { return missingBirthDate; }
+
+    int GetDomainCount(String^ domain) { return domains->Get(domain); }
+    int GetCityCount(String^ city) { return cities->Get(city); }
+    // Десятилетие в виде "1980s"
+    int GetDecadeCount(String^ decade) { return decades->Get(decade); }
+
+    GroupCounter^ GetDomains() { return domains; }
+    GroupCounter^ GetCities() { return cities; }
+    GroupCounter^ GetDecades() { return decades; }
+
+    long long EstimateBytes() {
+        return domains->EstimateBytes() + cities->EstimateBytes() + decades->EstimateBytes()
+            + distinctEmails->EstimateBytes() + distinctPhones->EstimateBytes();
+    }
+
+    // Приблизительное число различных адресов почты и телефонов
+    long long EstimateDistinctEmails() { return distinctEmails->Estimate(); }
+    long long EstimateDistinctPhones() { return distinctPhones->Estimate(); }
+};
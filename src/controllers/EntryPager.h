@@ -0,0 +1,160 @@
+#pragma once
+#include "NotebookManager.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Collections::ObjectModel;
+using namespace System::Text;
+
+// Представление книги: порядок и необязательный фильтр поиска
+// (searchType и текст - как в NotebookManager::SearchByAnyField)
+public ref class EntryQuery {
+public:
+    initonly EntryOrder order;
+    initonly bool descending;
+    initonly String^ search;
+    initonly int searchType;
+
+    EntryQuery(EntryOrder order, bool descending)
+        : order(order), descending(descending), search(nullptr), searchType(-1) {}
+
+    EntryQuery(EntryOrder order, bool descending, String^ search, int searchType)
+        : order(order), descending(descending), search(search), searchType(searchType) {}
+
+    // Строка, однозначно описывающая представление (для кэша и токенов)
+    String^ GetKey() {
+        return String::Format("{0}|{1}|{2}|{3}", (int)order, descending ? 1 : 0, searchType,
+            search == nullptr ? String::Empty : search->ToLower());
+    }
+};
+
+// Страница представления
+public ref class EntryPage {
+public:
+    initonly ReadOnlyCollection<NotebookEntry<int>^>^ rows;
+    // Токен следующей страницы; nullptr - страница последняя
+    initonly String^ nextToken;
+    // Версия книги, по которой построена страница
+    initonly long long version;
+
+    EntryPage(List<NotebookEntry<int>^>^ rows, String^ nextToken, long long version)
+        : rows(rows->AsReadOnly()), nextToken(nextToken), version(version) {}
+};
+
+// Постраничное чтение книги по ключу (keyset pagination): токен хранит
+// ключ сортировки и ID последней выданной строки, а следующая страница
+// начинается с первой строки после этого ключа. Поэтому вставки и удаления
+// между запросами не сдвигают страницы и не дают повторов.
+// Отсортированное представление берется из кэша запросов книги
+// (NotebookManager::Query) и переиспользуется, пока версия и запрос
+// не поменялись; выдача страницы - двоичный поиск и копия pageSize ссылок.
+public ref class EntryPager {
+public:
+    literal int MaxPageSize = 10000;
+
+private:
+    NotebookManager^ manager;
+    array<NotebookEntry<int>^>^ view;
+    String^ viewKey;
+    long long viewVersion;
+
+    static String^ SortKey(NotebookEntry<int>^ entry, EntryOrder order) {
+        switch (order) {
+            case EntryOrder::FirstName: return entry->GetFirstName();
+            case EntryOrder::LastName: return entry->GetLastName();
+            default: return nullptr;
+        }
+    }
+
+    static int CompareKeys(String^ xKey, int xId, String^ yKey, int yId, bool descending) {
+        int result = String::Compare(xKey, yKey);
+        if (result == 0) result = xId.CompareTo(yId);
+        return descending ? -result : result;
+    }
+
+    array<NotebookEntry<int>^>^ GetView(EntryQuery^ query, long long version) {
+        String^ key = query->GetKey();
+        if (view != nullptr && viewVersion == version && viewKey == key) {
+            return view;
+        }
+        // Порядок кэша совпадает с порядком страниц: ключ, затем ID
+        view = manager->Query(query->search, query->searchType, query->order, query->descending)->ToArray();
+        viewKey = key;
+        viewVersion = version;
+        return view;
+    }
+
+    static String^ EncodeToken(EntryQuery^ query, NotebookEntry<int>^ last) {
+        String^ key = SortKey(last, query->order);
+        String^ text = query->GetKey() + "\n" + last->GetId() + "\n" + (key == nullptr ? String::Empty : key);
+        return Convert::ToBase64String(Encoding::UTF8->GetBytes(text));
+    }
+
+    static void DecodeToken(EntryQuery^ query, String^ token, String^% key, int% id) {
+        array<String^>^ parts;
+        try {
+            parts = Encoding::UTF8->GetString(Convert::FromBase64String(token))->Split(gcnew array<wchar_t> { '\n' }, 3);
+        }
+        catch (FormatException^) {
+            parts = nullptr;
+        }
+        if (parts == nullptr || parts->Length != 3 || !Int32::TryParse(parts[1], id)) {
+            throw gcnew ArgumentException("Invalid continuation token");
+        }
+        if (parts[0] != query->GetKey()) {
+            throw gcnew ArgumentException("Continuation token belongs to a different query");
+        }
+        key = query->order == EntryOrder::Id ? nullptr : parts[2];
+    }
+
+    // Позиция первой строки, следующей за ключом (key, id)
+    static int UpperBound(array<NotebookEntry<int>^>^ rows, EntryQuery^ query, String^ key, int id) {
+        int low = 0;
+        int high = rows->Length;
+        while (low < high) {
+            int middle = low + (high - low) / 2;
+            NotebookEntry<int>^ row = rows[middle];
+            if (CompareKeys(SortKey(row, query->order), row->GetId(), key, id, query->descending) <= 0) {
+                low = middle + 1;
+            }
+            else {
+                high = middle;
+            }
+        }
+        return low;
+    }
+
+public:
+    EntryPager(NotebookManager^ manager) {
+        this->manager = manager;
+        viewVersion = -1;
+    }
+
+    // Страница из pageSize строк после строки, на которой закончился token
+    // (nullptr - с начала представления)
+    EntryPage^ GetPage(EntryQuery^ query, String^ token, int pageSize) {
+        if (pageSize <= 0 || pageSize > MaxPageSize) {
+            throw gcnew ArgumentOutOfRangeException("pageSize");
+        }
+        if (query->order == EntryOrder::Book) {
+            throw gcnew ArgumentException("Paging requires a sort order");
+        }
+        long long version = manager->GetVersion();
+        array<NotebookEntry<int>^>^ rows = GetView(query, version);
+
+        int start = 0;
+        if (token != nullptr) {
+            String^ key;
+            int id;
+            DecodeToken(query, token, key, id);
+            start = UpperBound(rows, query, key, id);
+        }
+        int count = Math::Min(pageSize, rows->Length - start);
+        List<NotebookEntry<int>^>^ page = gcnew List<NotebookEntry<int>^>(count);
+        for (int i = 0; i < count; i++) {
+            page->Add(rows[start + i]);
+        }
+        String^ next = start + count < rows->Length ? EncodeToken(query, page[count - 1]) : nullptr;
+        return gcnew EntryPage(page, next, version);
+    }
+};
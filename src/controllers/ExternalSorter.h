@@ -0,0 +1,485 @@
+#pragma once
+#include "QueryCache.h"
+#include "../utils/EntryStream.h"
+#include "../utils/ParallelExporter.h"
+#include "../utils/VCardReader.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Diagnostics;
+using namespace System::Globalization;
+using namespace System::IO;
+using namespace System::Text;
+using namespace System::Threading::Tasks;
+
+// Итоги внешней сортировки
+public ref class SortReport {
+public:
+    long long rows;
+    int runs;
+    // Промежуточные слияния, когда частей больше, чем сливается за раз
+    int mergePasses;
+    long long runBytes;
+    double runMilliseconds;
+    double mergeMilliseconds;
+
+    String^ ToJson() {
+        return String::Format(CultureInfo::InvariantCulture,
+            "{{\"rows\":{0},\"runs\":{1},\"merge_passes\":{2},\"run_bytes\":{3},\"run_ms\":{4:0.0},\"merge_ms\":{5:0.0}}}",
+            rows, runs, mergePasses, runBytes, runMilliseconds, mergeMilliseconds);
+    }
+};
+
+// Внешняя сортировка книг, которые не помещаются в память объектами.
+// Записи читаются потоком; когда набранная часть доходит до бюджета памяти,
+// для нее параллельно считаются двоичные ключи сравнения
+// (CompareInfo::GetSortKey - тот же порядок, что и у String::Compare в
+// SortByFirstName/SortByLastName), часть сортируется и пишется во временный
+// файл подряд. Затем части сливаются кучей по k за проход; при большем
+// числе частей - в несколько проходов. Порядок - как в QueryCache: ключ,
+// ID, при равенстве - порядок во входном файле. Если вся книга уместилась
+// в бюджет, временные файлы не пишутся.
+public ref class ExternalSorter {
+public:
+    literal long long DefaultMemoryBudgetBytes = 256LL * 1024 * 1024;
+    // Частей, сливаемых за один проход
+    literal int MaxFanIn = 64;
+
+private:
+    // Объект части, массив ключа и ссылки в списке и массиве сортировки
+    literal int RecordOverheadBytes = 80;
+
+    ref class Record {
+    public:
+        array<Byte>^ key;
+        long long sequence;
+        NotebookEntry<int>^ entry;
+    };
+
+    // Порядок записей: ключ поля, ID (с обращением при убывании), номер во входе
+    ref class RecordComparer : IComparer<Record^> {
+    private:
+        bool descending;
+    public:
+        RecordComparer(bool descending) : descending(descending) {}
+
+        static int CompareKeys(array<Byte>^ x, array<Byte>^ y) {
+            int length = Math::Min(x->Length, y->Length);
+            for (int i = 0; i < length; i++) {
+                if (x[i] != y[i]) return x[i] < y[i] ? -1 : 1;
+            }
+            return x->Length.CompareTo(y->Length);
+        }
+
+        virtual int Compare(Record^ x, Record^ y) {
+            int result = CompareKeys(x->key, y->key);
+            if (result == 0) result = x->entry->GetId().CompareTo(y->entry->GetId());
+            if (descending) result = -result;
+            return result != 0 ? result : x->sequence.CompareTo(y->sequence);
+        }
+    };
+
+    // Отсортированная часть во временном файле
+    ref class Run {
+    public:
+        String^ path;
+        long long count;
+    };
+
+    // Последовательное чтение части: текущая запись и остаток
+    ref class RunReader {
+    private:
+        BinaryReader^ reader;
+        long long remaining;
+    public:
+        Record^ current;
+
+        RunReader(Run^ run, int bufferBytes) {
+            reader = gcnew BinaryReader(gcnew FileStream(run->path, FileMode::Open, FileAccess::Read, FileShare::Read,
+                bufferBytes, FileOptions::SequentialScan), Encoding::UTF8);
+            remaining = run->count;
+            Next();
+        }
+
+        bool Next() {
+            if (remaining == 0) {
+                current = nullptr;
+                return false;
+            }
+            remaining--;
+            current = ReadRecord(reader);
+            return true;
+        }
+
+        void Close() {
+            reader->Close();
+        }
+    };
+
+    EntryOrder order;
+    bool descending;
+    long long memoryBudget;
+    CompareInfo^ compare;
+    RecordComparer^ comparer;
+    String^ prefix;
+    int runFiles;
+
+    List<NotebookEntry<int>^>^ pending;
+    long long pendingBytes;
+    long long sequence;
+    array<Record^>^ sorting;
+    List<Run^>^ runs;
+    SortReport^ report;
+    Stopwatch^ runClock;
+
+    // Вывод: поток записей книги или формат экспорта кусками по ChunkRows
+    EntryStreamWriter^ writer;
+    IRecordFormatter^ formatter;
+    Stream^ output;
+    List<NotebookEntry<int>^>^ chunk;
+
+    static void WriteRecord(BinaryWriter^ writer, Record^ record) {
+        NotebookEntry<int>^ entry = record->entry;
+        writer->Write(record->key->Length);
+        writer->Write(record->key);
+        writer->Write(record->sequence);
+        writer->Write(entry->GetId());
+        writer->Write(entry->GetFirstName() == nullptr ? "" : entry->GetFirstName());
+        writer->Write(entry->GetLastName() == nullptr ? "" : entry->GetLastName());
+        writer->Write(entry->GetPhoneNumber() == nullptr ? "" : entry->GetPhoneNumber());
+        writer->Write(entry->GetBirthDate() == nullptr ? "" : entry->GetBirthDate());
+        writer->Write(entry->GetEmail() == nullptr ? "" : entry->GetEmail());
+        writer->Write(entry->GetAddress() == nullptr ? "" : entry->GetAddress());
+        writer->Write(entry->GetNotes() == nullptr ? "" : entry->GetNotes());
+        array<String^>^ tags = entry->GetTags();
+        writer->Write(tags == nullptr ? 0 : tags->Length);
+        if (tags != nullptr) {
+            for each (String^ tag in tags) writer->Write(tag);
+        }
+    }
+
+    static Record^ ReadRecord(BinaryReader^ reader) {
+        Record^ record = gcnew Record();
+        record->key = reader->ReadBytes(reader->ReadInt32());
+        record->sequence = reader->ReadInt64();
+        int id = reader->ReadInt32();
+        String^ firstName = reader->ReadString();
+        String^ lastName = reader->ReadString();
+        String^ phoneNumber = reader->ReadString();
+        String^ birthDate = reader->ReadString();
+        String^ email = reader->ReadString();
+        String^ address = reader->ReadString();
+        String^ notes = reader->ReadString();
+        array<String^>^ tags = gcnew array<String^>(reader->ReadInt32());
+        for (int t = 0; t < tags->Length; t++) tags[t] = reader->ReadString();
+        record->entry = gcnew NotebookEntry<int>(id, firstName, lastName, phoneNumber, birthDate, email, address, notes);
+        record->entry->SetTags(tags);
+        return record;
+    }
+
+    String^ KeyText(NotebookEntry<int>^ entry) {
+        switch (order) {
+            case EntryOrder::FirstName: return entry->GetFirstName();
+            case EntryOrder::LastName: return entry->GetLastName();
+            default: return nullptr;
+        }
+    }
+
+    // Ключ записи sorting[i] (вызывается параллельно)
+    void MakeKey(int i) {
+        String^ text = KeyText(sorting[i]->entry);
+        sorting[i]->key = text == nullptr ? gcnew array<Byte>(0) : compare->GetSortKey(text)->KeyData;
+    }
+
+    // Набранные записи - отсортированный массив
+    array<Record^>^ SortPending() {
+        sorting = gcnew array<Record^>(pending->Count);
+        for (int i = 0; i < sorting->Length; i++) {
+            Record^ record = gcnew Record();
+            record->entry = pending[i];
+            record->sequence = sequence - pending->Count + i;
+            sorting[i] = record;
+        }
+        Parallel::For(0, sorting->Length, gcnew Action<int>(this, &ExternalSorter::MakeKey));
+        array<Record^>^ sorted = sorting;
+        sorting = nullptr;
+        pending->Clear();
+        pendingBytes = 0;
+        Array::Sort<Record^>(sorted, comparer);
+        return sorted;
+    }
+
+    int RunBufferBytes(int fanIn) {
+        return (int)Math::Min(1LL << 20, Math::Max(1LL << 16, memoryBudget / 4 / Math::Max(fanIn, 1)));
+    }
+
+    Run^ CreateRun() {
+        if (prefix == nullptr) {
+            prefix = Path::Combine(Path::GetTempPath(), "nbsort-" + Guid::NewGuid().ToString("N"));
+        }
+        Run^ run = gcnew Run();
+        run->path = prefix + "-" + (runFiles++) + ".tmp";
+        return run;
+    }
+
+    static BinaryWriter^ OpenRun(Run^ run) {
+        return gcnew BinaryWriter(gcnew FileStream(run->path, FileMode::Create, FileAccess::Write, FileShare::None,
+            1 << 20, FileOptions::SequentialScan), Encoding::UTF8);
+    }
+
+    void FlushRun() {
+        array<Record^>^ sorted = SortPending();
+        Run^ run = CreateRun();
+        BinaryWriter^ file = OpenRun(run);
+        try {
+            for each (Record^ record in sorted) {
+                WriteRecord(file, record);
+            }
+            run->count = sorted->Length;
+            report->runs++;
+            report->runBytes += file->BaseStream->Length;
+        }
+        finally {
+            file->Close();
+        }
+        runs->Add(run);
+    }
+
+    void Emit(NotebookEntry<int>^ entry) {
+        report->rows++;
+        if (writer != nullptr) {
+            writer->Write(entry);
+            return;
+        }
+        chunk->Add(entry);
+        if (chunk->Count == ParallelExporter::ChunkRows) {
+            formatter->WriteChunk(output, chunk, 0, chunk->Count);
+            chunk->Clear();
+        }
+    }
+
+    // Слияние частей parts: в новую часть target или, если он nullptr, в вывод
+    void MergeRuns(List<Run^>^ parts, Run^ target) {
+        int bufferBytes = RunBufferBytes(parts->Count);
+        List<RunReader^>^ readers = gcnew List<RunReader^>(parts->Count);
+        BinaryWriter^ file = target == nullptr ? nullptr : OpenRun(target);
+        try {
+            for each (Run^ run in parts) {
+                RunReader^ reader = gcnew RunReader(run, bufferBytes);
+                readers->Add(reader);
+            }
+            // Куча по текущим записям частей: в вершине - наименьшая
+            array<RunReader^>^ heap = gcnew array<RunReader^>(readers->Count);
+            int size = 0;
+            for each (RunReader^ reader in readers) {
+                if (reader->current == nullptr) continue;
+                heap[size] = reader;
+                SiftUp(heap, size++);
+            }
+            long long count = 0;
+            while (size > 0) {
+                RunReader^ top = heap[0];
+                if (file != nullptr) WriteRecord(file, top->current);
+                else Emit(top->current->entry);
+                count++;
+                if (!top->Next()) {
+                    heap[0] = heap[--size];
+                    heap[size] = nullptr;
+                }
+                if (size > 0) SiftDown(heap, size);
+            }
+            if (file != nullptr) {
+                target->count = count;
+                report->runBytes += file->BaseStream->Length;
+            }
+        }
+        finally {
+            for each (RunReader^ reader in readers) {
+                reader->Close();
+            }
+            if (file != nullptr) file->Close();
+            for each (Run^ run in parts) {
+                File::Delete(run->path);
+            }
+        }
+    }
+
+    bool Before(RunReader^ x, RunReader^ y) {
+        return comparer->Compare(x->current, y->current) < 0;
+    }
+
+    void SiftUp(array<RunReader^>^ heap, int i) {
+        while (i > 0) {
+            int up = (i - 1) / 2;
+            if (!Before(heap[i], heap[up])) break;
+            RunReader^ swap = heap[i];
+            heap[i] = heap[up];
+            heap[up] = swap;
+            i = up;
+        }
+    }
+
+    void SiftDown(array<RunReader^>^ heap, int size) {
+        int i = 0;
+        while (true) {
+            int left = 2 * i + 1;
+            int right = left + 1;
+            int first = i;
+            if (left < size && Before(heap[left], heap[first])) first = left;
+            if (right < size && Before(heap[right], heap[first])) first = right;
+            if (first == i) break;
+            RunReader^ swap = heap[i];
+            heap[i] = heap[first];
+            heap[first] = swap;
+            i = first;
+        }
+    }
+
+    // Вывод всех записей по порядку: без частей на диске - прямо из памяти
+    void Finish() {
+        report->runMilliseconds = runClock->Elapsed.TotalMilliseconds;
+        Stopwatch^ clock = Stopwatch::StartNew();
+        try {
+            if (runs->Count == 0) {
+                for each (Record^ record in SortPending()) {
+                    Emit(record->entry);
+                }
+            }
+            else {
+                if (pending->Count > 0) FlushRun();
+                report->runMilliseconds = runClock->Elapsed.TotalMilliseconds;
+                clock->Restart();
+                // Слияние по MaxFanIn частей, пока все не сольются за один проход
+                while (runs->Count > MaxFanIn) {
+                    List<Run^>^ parts = runs->GetRange(0, MaxFanIn);
+                    runs->RemoveRange(0, MaxFanIn);
+                    // Новая часть учитывается до слияния: если оно прервется,
+                    // недописанный файл удалит Discard
+                    Run^ merged = CreateRun();
+                    runs->Add(merged);
+                    MergeRuns(parts, merged);
+                    report->mergePasses++;
+                }
+                MergeRuns(runs, nullptr);
+                runs->Clear();
+            }
+        }
+        finally {
+            Discard();
+        }
+        report->mergeMilliseconds = clock->Elapsed.TotalMilliseconds;
+    }
+
+public:
+    // order - Id, FirstName или LastName; memoryBudgetBytes - на записи в памяти
+    ExternalSorter(EntryOrder order, bool descending, long long memoryBudgetBytes) {
+        if (order == EntryOrder::Book) {
+            throw gcnew ArgumentException("External sort needs a sort key");
+        }
+        this->order = order;
+        this->descending = descending;
+        this->memoryBudget = Math::Max(1LL << 20, memoryBudgetBytes);
+        compare = CultureInfo::CurrentCulture->CompareInfo;
+        comparer = gcnew RecordComparer(descending);
+        pending = gcnew List<NotebookEntry<int>^>();
+        runs = gcnew List<Run^>();
+        report = gcnew SortReport();
+        runClock = Stopwatch::StartNew();
+    }
+
+    ~ExternalSorter() {
+        Discard();
+    }
+
+    void Add(NotebookEntry<int>^ entry) {
+        pending->Add(entry);
+        sequence++;
+        // Набранные записи вместе с ключами занимают половину бюджета:
+        // вторая половина - на сортировку и мусор, который еще не собран
+        pendingBytes += EntrySchema::EstimateBytes(entry) + RecordOverheadBytes +
+            2 * MemorySizes::StringBytes(KeyText(entry));
+        if (pendingBytes >= memoryBudget / 2) FlushRun();
+    }
+
+    // Все записи файла: JSON, JSON Lines, TSV или vCard (по расширению)
+    void AddFile(String^ path) {
+        NotebookEntry<int>^ entry;
+        if (path->EndsWith(".vcf", StringComparison::OrdinalIgnoreCase)) {
+            VCardReader^ cards = VCardReader::Open(path);
+            try {
+                while (cards->Read(entry)) Add(entry);
+            }
+            finally {
+                cards->Close();
+            }
+            return;
+        }
+        EntryStreamReader^ reader = EntryStreamReader::Open(path);
+        try {
+            while (reader->Read(entry)) Add(entry);
+        }
+        finally {
+            reader->Close();
+        }
+    }
+
+    // Вывод в формате хранения книги (JSON-массив или TSV), как при сохранении
+    SortReport^ WriteTo(EntryStreamWriter^ target) {
+        writer = target;
+        Finish();
+        writer = nullptr;
+        return report;
+    }
+
+    // Вывод в формате экспорта (CSV, JSON Lines, vCard, TSV)
+    SortReport^ WriteTo(IRecordFormatter^ target, Stream^ stream) {
+        formatter = target;
+        output = stream;
+        chunk = gcnew List<NotebookEntry<int>^>(ParallelExporter::ChunkRows);
+        formatter->WriteHeader(output);
+        Finish();
+        if (chunk->Count > 0) formatter->WriteChunk(output, chunk, 0, chunk->Count);
+        formatter->WriteFooter(output);
+        output->Flush();
+        formatter = nullptr;
+        output = nullptr;
+        chunk = nullptr;
+        return report;
+    }
+
+    // Вывод в файл: формат экспорта по расширению (.csv, .jsonl, .vcf, .tsv),
+    // остальное - как сохранение книги (.json - JSON-массив, иначе TSV)
+    SortReport^ WriteTo(String^ path) {
+        IRecordFormatter^ target = RecordFormatters::ForPath(path);
+        if (target == nullptr) {
+            EntryStreamWriter^ stream = EntryStreamWriter::Create(path);
+            try {
+                return WriteTo(stream);
+            }
+            finally {
+                stream->Close();
+            }
+        }
+        FileStream^ file = gcnew FileStream(path, FileMode::Create, FileAccess::Write, FileShare::None, 1 << 20);
+        try {
+            return WriteTo(target, file);
+        }
+        finally {
+            file->Close();
+        }
+    }
+
+    // Удаление временных файлов (после ошибки или без вывода)
+    void Discard() {
+        for each (Run^ run in runs) {
+            if (File::Exists(run->path)) File::Delete(run->path);
+        }
+        runs->Clear();
+        pending->Clear();
+        pendingBytes = 0;
+    }
+
+    SortReport^ GetReport() {
+        return report;
+    }
+};
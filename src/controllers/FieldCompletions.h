@@ -0,0 +1,132 @@
+#pragma once
+#include "NotebookManager.h"
+#include "../utils/CompletionTrie.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+
+// Поля формы ввода с подсказками
+public enum class CompletionField {
+    FirstName,
+    LastName,
+    Email,
+    Address
+};
+
+// Подсказки для полей ввода: по префиксному дереву на поле, значения -
+// без пробелов по краям, вес - число записей с этим значением. Деревья
+// поддерживаются по событиям NotebookManager::Changed, как BookStatistics:
+// добавление, удаление и изменение записи правят только свои значения,
+// полное построение - при событии Reset (загрузка, отмена).
+public ref class FieldCompletions {
+public:
+    literal int FieldCount = 4;
+
+private:
+    array<CompletionTrie^>^ tries;
+
+    static String^ ValueOf(NotebookEntry<int>^ entry, CompletionField field) {
+        String^ value;
+        switch (field) {
+        case CompletionField::FirstName: value = entry->GetFirstName(); break;
+        case CompletionField::LastName: value = entry->GetLastName(); break;
+        case CompletionField::Email: value = entry->GetEmail(); break;
+        default: value = entry->GetAddress(); break;
+        }
+        return value == nullptr ? String::Empty : value->Trim();
+    }
+
+    void Count(NotebookEntry<int>^ entry, bool add) {
+        for (int i = 0; i < FieldCount; i++) {
+            String^ value = ValueOf(entry, (CompletionField)i);
+            if (value->Length == 0) continue;
+            if (add) tries[i]->Add(value);
+            else tries[i]->Remove(value);
+        }
+    }
+
+    void CountAll(IEnumerable<NotebookEntry<int>^>^ source, bool add) {
+        if (source == nullptr) return;
+        for each (NotebookEntry<int>^ entry in source) {
+            Count(entry, add);
+        }
+    }
+
+    void Manager_Changed(Object^ sender, NotebookChangedEventArgs^ e) {
+        for each (NotebookChange^ change in e->changes) {
+            switch (change->kind) {
+            case NotebookChangeKind::Inserted:
+                CountAll(change->entries, true);
+                break;
+            case NotebookChangeKind::Removed:
+                CountAll(change->entries, false);
+                break;
+            case NotebookChangeKind::Updated:
+                CountAll(change->oldEntries, false);
+                CountAll(change->entries, true);
+                break;
+            case NotebookChangeKind::Reset:
+                Rebuild(safe_cast<NotebookManager^>(sender)->GetAllEntries());
+                break;
+            case NotebookChangeKind::Reordered:
+                break;
+            }
+        }
+    }
+
+public:
+    FieldCompletions(NotebookManager^ manager) {
+        tries = gcnew array<CompletionTrie^>(FieldCount);
+        for (int i = 0; i < FieldCount; i++) {
+            tries[i] = gcnew CompletionTrie();
+        }
+        Rebuild(manager->GetAllEntries());
+        manager->Changed += gcnew EventHandler<NotebookChangedEventArgs^>(this, &FieldCompletions::Manager_Changed);
+    }
+
+    // Без менеджера: деревья наполняются через Rebuild (NBcli bench-complete)
+    FieldCompletions() {
+        tries = gcnew array<CompletionTrie^>(FieldCount);
+        for (int i = 0; i < FieldCount; i++) {
+            tries[i] = gcnew CompletionTrie();
+        }
+    }
+
+    void Rebuild(IEnumerable<NotebookEntry<int>^>^ source) {
+        for (int i = 0; i < FieldCount; i++) {
+            tries[i]->Clear();
+        }
+        CountAll(source, true);
+    }
+
+    void Add(NotebookEntry<int>^ entry) {
+        Count(entry, true);
+    }
+
+    void Remove(NotebookEntry<int>^ entry) {
+        Count(entry, false);
+    }
+
+    // До limit самых частых значений поля, начинающихся с prefix
+    List<String^>^ Complete(CompletionField field, String^ prefix, int limit) {
+        List<String^>^ values = gcnew List<String^>(limit);
+        String^ trimmed = prefix == nullptr ? String::Empty : prefix->TrimStart();
+        if (trimmed->Length == 0) return values;
+        for each (CompletionTrie::Completion^ completion in tries[(int)field]->Complete(trimmed, limit)) {
+            values->Add(completion->value);
+        }
+        return values;
+    }
+
+    CompletionTrie^ GetTrie(CompletionField field) {
+        return tries[(int)field];
+    }
+
+    long long EstimateBytes() {
+        long long bytes = 0;
+        for (int i = 0; i < FieldCount; i++) {
+            bytes += tries[i]->EstimateBytes();
+        }
+        return bytes;
+    }
+};
@@ -0,0 +1,183 @@
+#pragma once
+#include "../models/NotebookEntry.h"
+#include "../models/NotebookChange.h"
+#include "../utils/MemoryAccounting.h"
+#include "../utils/NameKeys.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Threading;
+
+// Хеш-индекс имен и фамилий по ключам NameKeys для поиска "звучит как":
+// ключ транслитерации и фонетический ключ - списки записей. Запрос любой
+// письменностью - два обращения к словарю и обход k найденных записей,
+// без просмотра книги. Индекс правится пакетами изменений менеджера и
+// строится заново при первом поиске после полной замены списка.
+public ref class NameIndex {
+private:
+    // Слот словаря, объект списка и его массив
+    literal int BucketOverheadBytes = 96;
+
+    Dictionary<String^, List<NotebookEntry<int>^>^>^ transliterated;
+    Dictionary<String^, List<NotebookEntry<int>^>^>^ phonetic;
+    bool built;
+    long long usedBytes;
+    Object^ sync;
+
+    void AddKey(Dictionary<String^, List<NotebookEntry<int>^>^>^ index, String^ key, NotebookEntry<int>^ entry) {
+        List<NotebookEntry<int>^>^ bucket;
+        if (!index->TryGetValue(key, bucket)) {
+            bucket = gcnew List<NotebookEntry<int>^>();
+            index[key] = bucket;
+            usedBytes += BucketOverheadBytes + MemorySizes::StringBytes(key);
+        }
+        bucket->Add(entry);
+        usedBytes += MemorySizes::Reference;
+    }
+
+    void RemoveKey(Dictionary<String^, List<NotebookEntry<int>^>^>^ index, String^ key, NotebookEntry<int>^ entry) {
+        List<NotebookEntry<int>^>^ bucket;
+        if (!index->TryGetValue(key, bucket) || !bucket->Remove(entry)) return;
+        usedBytes -= MemorySizes::Reference;
+        if (bucket->Count == 0) {
+            index->Remove(key);
+            usedBytes -= BucketOverheadBytes + MemorySizes::StringBytes(key);
+        }
+    }
+
+    // Имя и фамилия с одинаковым ключом дают одну ссылку в списке
+    void Index(NotebookEntry<int>^ entry, bool add) {
+        String^ first = NameKeys::Transliterate(entry->GetFirstName());
+        String^ last = NameKeys::Transliterate(entry->GetLastName());
+        String^ firstSound = NameKeys::PhoneticOf(first);
+        String^ lastSound = NameKeys::PhoneticOf(last);
+        if (add) {
+            if (first->Length > 0) AddKey(transliterated, first, entry);
+            if (last->Length > 0 && last != first) AddKey(transliterated, last, entry);
+            if (firstSound->Length > 0) AddKey(phonetic, firstSound, entry);
+            if (lastSound->Length > 0 && lastSound != firstSound) AddKey(phonetic, lastSound, entry);
+        }
+        else {
+            if (first->Length > 0) RemoveKey(transliterated, first, entry);
+            if (last->Length > 0 && last != first) RemoveKey(transliterated, last, entry);
+            if (firstSound->Length > 0) RemoveKey(phonetic, firstSound, entry);
+            if (lastSound->Length > 0 && lastSound != firstSound) RemoveKey(phonetic, lastSound, entry);
+        }
+    }
+
+    void IndexAll(IEnumerable<NotebookEntry<int>^>^ source, bool add) {
+        if (source == nullptr) return;
+        for each (NotebookEntry<int>^ entry in source) {
+            Index(entry, add);
+        }
+    }
+
+    void Drop() {
+        transliterated->Clear();
+        phonetic->Clear();
+        usedBytes = 0;
+        built = false;
+    }
+
+    static List<NotebookEntry<int>^>^ Lookup(Dictionary<String^, List<NotebookEntry<int>^>^>^ index, String^ key) {
+        List<NotebookEntry<int>^>^ bucket;
+        return index->TryGetValue(key, bucket) ? bucket : nullptr;
+    }
+
+public:
+    NameIndex() {
+        transliterated = gcnew Dictionary<String^, List<NotebookEntry<int>^>^>();
+        phonetic = gcnew Dictionary<String^, List<NotebookEntry<int>^>^>();
+        sync = gcnew Object();
+    }
+
+    // Пакет изменений менеджера; до первого поиска индекс не ведется
+    void Apply(List<NotebookChange^>^ changes) {
+        Monitor::Enter(sync);
+        try {
+            if (!built) return;
+            for each (NotebookChange^ change in changes) {
+                switch (change->kind) {
+                case NotebookChangeKind::Inserted:
+                    IndexAll(change->entries, true);
+                    break;
+                case NotebookChangeKind::Removed:
+                    IndexAll(change->entries, false);
+                    break;
+                case NotebookChangeKind::Updated:
+                    IndexAll(change->oldEntries, false);
+                    IndexAll(change->entries, true);
+                    break;
+                case NotebookChangeKind::Reset:
+                    Drop();
+                    return;
+                case NotebookChangeKind::Reordered:
+                    break;
+                }
+            }
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    // Записи, у которых имя или фамилия звучит как каждое слово запроса:
+    // сначала совпавшие по ключу транслитерации (то же имя другой
+    // письменностью), затем только по звучанию. entries - текущий список
+    // книги для построения индекса. Пустой запрос - все записи
+    List<NotebookEntry<int>^>^ Find(String^ query, IList<NotebookEntry<int>^>^ entries) {
+        array<String^>^ keys = NameKeys::QueryKeys(query);
+        if (keys->Length == 0) return gcnew List<NotebookEntry<int>^>(entries);
+
+        Monitor::Enter(sync);
+        try {
+            if (!built) {
+                IndexAll(entries, true);
+                built = true;
+            }
+            // Кандидаты - по первому слову, остальные слова проверяются на них
+            String^ word = query->Split((array<wchar_t>^)nullptr, StringSplitOptions::RemoveEmptyEntries)[0];
+            List<NotebookEntry<int>^>^ exact = Lookup(transliterated, NameKeys::Transliterate(word));
+            List<NotebookEntry<int>^>^ similar = Lookup(phonetic, keys[0]);
+
+            List<NotebookEntry<int>^>^ results = gcnew List<NotebookEntry<int>^>();
+            HashSet<NotebookEntry<int>^>^ seen = gcnew HashSet<NotebookEntry<int>^>();
+            for each (List<NotebookEntry<int>^>^ bucket in gcnew array<List<NotebookEntry<int>^>^> { exact, similar }) {
+                if (bucket == nullptr) continue;
+                for each (NotebookEntry<int>^ entry in bucket) {
+                    if ((keys->Length == 1 || NameKeys::Matches(entry, keys)) && seen->Add(entry)) {
+                        results->Add(entry);
+                    }
+                }
+            }
+            return results;
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    bool IsBuilt() {
+        return built;
+    }
+
+    int GetKeyCount() {
+        return transliterated->Count + phonetic->Count;
+    }
+
+    long long GetUsedBytes() {
+        return usedBytes;
+    }
+
+    // Сброс индекса (для MemoryAccounting): он построится при следующем поиске
+    long long Trim(long long targetBytes) {
+        Monitor::Enter(sync);
+        try {
+            Drop();
+            return 0;
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+};
@@ -0,0 +1,205 @@
+#pragma once
+#include "../models/NotebookEntry.h"
+#include "../models/NotebookChange.h"
+#include "../models/PersistentVector.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+
+// История изменений книги для отмены и повтора.
+// Каждое состояние - версия персистентного вектора записей, поэтому шаг
+// истории хранит только измененные узлы (O(log N) на одиночную правку),
+// а не копию всего списка. Глубина истории ограничена бюджетом памяти:
+// при превышении отбрасываются самые старые шаги.
+// Шаг помнит и пакет изменений своей операции: отмена и повтор
+// публикуются обратным или тем же пакетом, без обхода всего списка.
+public ref class NotebookHistory {
+public:
+    // Бюджет истории по умолчанию
+    literal long long DefaultBudgetBytes = 64LL * 1024 * 1024;
+
+private:
+    ref class Step {
+    public:
+        String^ description;
+        PersistentVector<NotebookEntry<int>^>^ state;
+        // Изменения от state к следующей версии; nullptr - только полная замена
+        List<NotebookChange^>^ changes;
+        long long costBytes;
+
+        Step(String^ description, PersistentVector<NotebookEntry<int>^>^ state,
+             List<NotebookChange^>^ changes, long long costBytes)
+            : description(description), state(state), changes(changes), costBytes(costBytes) {}
+    };
+
+    // Объект изменения и его списки ссылок; сами записи учтены в узлах версий
+    literal int ChangeBytes = 96;
+
+    static long long EstimateChangeBytes(List<NotebookChange^>^ changes) {
+        if (changes == nullptr) return 0;
+        long long bytes = 0;
+        for each (NotebookChange^ change in changes) {
+            bytes += ChangeBytes + 8LL * change->count * (change->oldEntries != nullptr ? 2 : 1);
+        }
+        return bytes;
+    }
+
+    PersistentVector<NotebookEntry<int>^>^ current;
+    LinkedList<Step^>^ undoSteps;   // Last - самый свежий шаг
+    LinkedList<Step^>^ redoSteps;   // Last - ближайший шаг для повтора
+    long long budgetBytes;
+    long long usedBytes;
+    long long nodesBefore;
+
+    // Отбрасывание старых шагов при превышении бюджета
+    void Trim() {
+        while (usedBytes > budgetBytes && undoSteps->Count > 0) {
+            usedBytes -= undoSteps->First->Value->costBytes;
+            undoSteps->RemoveFirst();
+        }
+        while (usedBytes > budgetBytes && redoSteps->Count > 0) {
+            usedBytes -= redoSteps->First->Value->costBytes;
+            redoSteps->RemoveFirst();
+        }
+    }
+
+    void ClearSteps(LinkedList<Step^>^ steps) {
+        for each (Step^ step in steps) {
+            usedBytes -= step->costBytes;
+        }
+        steps->Clear();
+    }
+
+public:
+    // Конструктор
+    NotebookHistory(long long budgetBytes) {
+        current = gcnew PersistentVector<NotebookEntry<int>^>();
+        undoSteps = gcnew LinkedList<Step^>();
+        redoSteps = gcnew LinkedList<Step^>();
+        this->budgetBytes = budgetBytes;
+        usedBytes = 0;
+        nodesBefore = 0;
+    }
+
+    // Новая исходная точка (после загрузки файла): история очищается
+    void Reset(List<NotebookEntry<int>^>^ entries) {
+        current = current->FromList(entries);
+        undoSteps->Clear();
+        redoSteps->Clear();
+        usedBytes = 0;
+    }
+
+    // Текущая версия (неизменяемая, ее можно читать из других потоков)
+    PersistentVector<NotebookEntry<int>^>^ Current() {
+        return current;
+    }
+
+    // Текущая версия; счетчик узлов запоминается для оценки стоимости шага
+    PersistentVector<NotebookEntry<int>^>^ Begin() {
+        nodesBefore = current->GetCounter()->created;
+        return current;
+    }
+
+    // Фиксация новой версии после операции, начатой через Begin().
+    // Стоимость шага - созданные узлы плюс узлы, которые остаются живы
+    // только благодаря предыдущей версии (например, после очистки книги).
+    // Без пакета изменений отмена шага - полная замена списка
+    void Commit(String^ description, PersistentVector<NotebookEntry<int>^>^ state) {
+        Commit(description, state, nullptr);
+    }
+
+    // changes - пакет, переводящий текущую версию в state
+    void Commit(String^ description, PersistentVector<NotebookEntry<int>^>^ state, List<NotebookChange^>^ changes) {
+        long long nodes = state->GetCounter()->created - nodesBefore;
+        int dropped = current->Count() - state->Count();
+        if (dropped > 0) {
+            nodes += dropped;
+        }
+        long long cost = nodes * PersistentVector<NotebookEntry<int>^>::NodeBytes + EstimateChangeBytes(changes);
+
+        ClearSteps(redoSteps);
+        undoSteps->AddLast(gcnew Step(description, current, changes, cost));
+        usedBytes += cost;
+        current = state;
+        Trim();
+    }
+
+    bool CanUndo() { return undoSteps->Count > 0; }
+    bool CanRedo() { return redoSteps->Count > 0; }
+
+    String^ GetUndoDescription() {
+        return undoSteps->Count > 0 ? undoSteps->Last->Value->description : nullptr;
+    }
+
+    String^ GetRedoDescription() {
+        return redoSteps->Count > 0 ? redoSteps->Last->Value->description : nullptr;
+    }
+
+    // Отмена: переход к предыдущей версии (O(1), без копирования записей).
+    // changes - пакет от текущей версии к предыдущей (обратный пакету
+    // операции) или nullptr, если шаг записан без пакета
+    PersistentVector<NotebookEntry<int>^>^ Undo(List<NotebookChange^>^% changes) {
+        changes = nullptr;
+        if (undoSteps->Count == 0) return nullptr;
+        Step^ step = undoSteps->Last->Value;
+        undoSteps->RemoveLast();
+        redoSteps->AddLast(gcnew Step(step->description, current, step->changes, step->costBytes));
+        current = step->state;
+        changes = Invert(step->changes);
+        return current;
+    }
+
+    // Повтор отмененного шага; changes - пакет самой операции
+    PersistentVector<NotebookEntry<int>^>^ Redo(List<NotebookChange^>^% changes) {
+        changes = nullptr;
+        if (redoSteps->Count == 0) return nullptr;
+        Step^ step = redoSteps->Last->Value;
+        redoSteps->RemoveLast();
+        undoSteps->AddLast(gcnew Step(step->description, current, step->changes, step->costBytes));
+        current = step->state;
+        changes = step->changes;
+        return current;
+    }
+
+    // Обратный пакет: изменения в обратном порядке, вставка и удаление
+    // меняются местами, у замены - старые и новые значения
+    static List<NotebookChange^>^ Invert(List<NotebookChange^>^ changes) {
+        if (changes == nullptr) return nullptr;
+        List<NotebookChange^>^ inverted = gcnew List<NotebookChange^>(changes->Count);
+        for (int i = changes->Count - 1; i >= 0; i--) {
+            NotebookChange^ change = changes[i];
+            switch (change->kind) {
+            case NotebookChangeKind::Inserted:
+                inverted->Add(gcnew NotebookChange(NotebookChangeKind::Removed, change->index, change->count, change->entries, nullptr));
+                break;
+            case NotebookChangeKind::Removed:
+                inverted->Add(gcnew NotebookChange(NotebookChangeKind::Inserted, change->index, change->count, change->entries, nullptr));
+                break;
+            case NotebookChangeKind::Updated:
+                inverted->Add(gcnew NotebookChange(NotebookChangeKind::Updated, change->index, change->count, change->oldEntries, change->entries));
+                break;
+            default:
+                return nullptr;
+            }
+        }
+        return inverted;
+    }
+
+    // Бюджет памяти истории
+    void SetBudget(long long bytes) {
+        budgetBytes = bytes;
+        Trim();
+    }
+
+    // Оценка памяти, занятой шагами истории
+    long long GetUsedBytes() {
+        return usedBytes;
+    }
+
+    // Сокращение истории до заданного размера (бюджет учета памяти);
+    // возвращает размер после сокращения
+    long long TrimTo(long long bytes) {
+        SetBudget(bytes);
+        return usedBytes;
+    }
+};
\ No newline at end of file
@@ -2,10 +2,25 @@
 #include <vcclr.h>
 #include <vector>
 #include "../models/NotebookEntry.h"
+#include "../models/NotebookChange.h"
+#include "../models/EntrySchema.h"
+#include "../utils/TsvChunkLoader.h"
+#include "../storage/AtomicFile.h"
+#include "../storage/ColdFieldStore.h"
+#include "../storage/CompressedBook.h"
+#include "../storage/StorageJournal.h"
+#include "../utils/EntryJsonWriter.h"
+#include "../utils/JsonSpans.h"
+#include "../utils/RecordHasher.h"
+#include "../utils/VCardReader.h"
+#include "NotebookHistory.h"
+#include "QueryCache.h"
+#include "NameIndex.h"
+#include "TagIndex.h"
 
 using namespace System;
 using namespace System::Collections::Generic;
-using namespace System::Windows::Forms;
+using namespace System::Diagnostics;
 using namespace System::Text;
 using namespace System::IO;
 using namespace Newtonsoft::Json;
@@ -20,59 +35,404 @@ private:
     String^ currentFilePath;
     static Encoding^ fileEncoding = Encoding::UTF8;
     String^ defaultJsonPath = "contacts.json";
+    NotebookHistory^ history;
+    bool autoPersist = true;
+    long long version;
+    // Размер и время записи файла хранения при последнем чтении/сохранении:
+    // по ним внешние изменения отличаются от собственных сохранений
+    long long storageLength = -1;
+    DateTime storageWriteTime;
+    // Длина текста файла хранения в символах и хеш текстов его объектов
+    // (JsonSpans::Combine) - версия файла, к которой относится журнал
+    long long storageTextLength;
+    unsigned long long storageTextHash;
+    // Записи по хешу текста их JSON-объекта в файле хранения
+    Dictionary<unsigned long long, NotebookEntry<int>^>^ spanCache;
+    // Оценка памяти записей и версия, для которой она посчитана
+    long long entryBytes;
+    long long entryBytesVersion = -1;
+    // Журнал операций после последней публикации файла хранения
+    StorageJournal^ journal;
+    // Операции пишутся в журнал, а файл публикуется контрольной точкой
+    // (EnableJournal); иначе файл переписывается после каждой операции
+    bool journalOperations;
+    // Пакет изменений последней операции - для записи в журнал
+    List<NotebookChange^>^ lastChanges;
+    JournalRecovery^ recovery;
+    // Результаты поиска и сортировки по версиям; правится каждым пакетом изменений
+    QueryCache^ queryCache = gcnew QueryCache(QueryCache::DefaultBudgetBytes);
+    // Ключи имен для поиска "звучит как"; строится при первом таком поиске
+    NameIndex^ nameIndex = gcnew NameIndex();
+    // Множества строк по меткам; строится при первом фильтре по меткам
+    TagIndex^ tagIndex = gcnew TagIndex();
+    // Адреса и заметки новых и измененных записей (EnableColdFields);
+    // nullptr - поля остаются строками в записях
+    ColdFieldStore^ coldFields;
 
-    // Вспомогательный класс для предиката удаления
-    ref class RemoveEntryPredicate {
-    private:
-        int targetId;
-    public:
-        RemoveEntryPredicate(int id) : targetId(id) {}
-        bool Match(NotebookEntry<int>^ entry) {
-            return entry->GetId() == targetId;
-        }
-    };
-
-    // Вспомогательный класс для сравнения при сортировке по фамилии
-    ref class LastNameComparer : IComparer<NotebookEntry<int>^> {
-    private:
-        bool ascending;
-    public:
-        LastNameComparer(bool asc) : ascending(asc) {}
-        virtual int Compare(NotebookEntry<int>^ x, NotebookEntry<int>^ y) {
-            if (ascending) {
-                return String::Compare(x->GetLastName(), y->GetLastName());
-            }
-            return String::Compare(y->GetLastName(), x->GetLastName());
-        }
-    };
-
-    // Вспомогательный класс для сравнения при сортировке по имени
-    ref class FirstNameComparer : IComparer<NotebookEntry<int>^> {
-    private:
-        bool ascending;
-    public:
-        FirstNameComparer(bool asc) : ascending(asc) {}
-        virtual int Compare(NotebookEntry<int>^ x, NotebookEntry<int>^ y) {
-            if (ascending) {
-                return String::Compare(x->GetFirstName(), y->GetFirstName());
-            }
-            return String::Compare(y->GetFirstName(), x->GetFirstName());
-        }
-    };
-
-    // Вспомогательный класс для сортировки по ID
-    ref class IdComparer : IComparer<NotebookEntry<int>^> {
-    public:
-        virtual int Compare(NotebookEntry<int>^ x, NotebookEntry<int>^ y) {
-            return x->GetId() - y->GetId();
-        }
-    };
+    // Последовательная загрузка текстового формата (для файлов в UTF-16)
+    List<NotebookEntry<int>^>^ LoadFromTextFileSequential(String^ filePath) {
+        StreamReader^ reader = nullptr;
+        try {
+            // Открываем reader с автоопределением кодировки
+            reader = gcnew StreamReader(filePath, true);
+            return ReadTsv(reader);
+        }
+        finally {
+            if (reader != nullptr) {
+                reader->Close();
+                delete reader;
+            }
+        }
+    }
 
-public:
-    // Конструктор
-    NotebookManager() {
+    // Построчное чтение текстового формата
+    static List<NotebookEntry<int>^>^ ReadTsv(TextReader^ reader) {
+        List<NotebookEntry<int>^>^ loaded = gcnew List<NotebookEntry<int>^>();
+        String^ line;
+        while ((line = reader->ReadLine()) != nullptr) {
+            NotebookEntry<int>^ entry = EntrySchema::FromTsv(line->Split('\t'));
+            if (entry != nullptr) {
+                loaded->Add(entry);
+            }
+        }
+        return loaded;
+    }
+
+    // Публикация пакета изменений одной операции
+    void RaiseChanged(String^ operation, List<NotebookChange^>^ changes) {
+        MoveColdFields(changes);
+        version++;
+        lastChanges = changes;
+        queryCache->Apply(changes, entries, version);
+        nameIndex->Apply(changes);
+        tagIndex->Apply(changes);
+        Changed(this, gcnew NotebookChangedEventArgs(operation, version, changes));
+    }
+
+    // Перенос холодных полей записей, появившихся в списке; значения
+    // полей не меняются, поэтому остальные подписчики пакета это не видят
+    void MoveColdFields(List<NotebookChange^>^ changes) {
+        if (coldFields == nullptr) return;
+        for each (NotebookChange^ change in changes) {
+            switch (change->kind) {
+            case NotebookChangeKind::Inserted:
+            case NotebookChangeKind::Updated:
+                for each (NotebookEntry<int>^ entry in change->entries) {
+                    entry->MoveCold(coldFields);
+                }
+                break;
+            case NotebookChangeKind::Reset:
+                // Записи из истории и StorageLoader уже перенесены и пропускаются
+                for each (NotebookEntry<int>^ entry in entries) {
+                    entry->MoveCold(coldFields);
+                }
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    void RaiseChanged(String^ operation, NotebookChange^ change) {
+        List<NotebookChange^>^ changes = gcnew List<NotebookChange^>(1);
+        changes->Add(change);
+        RaiseChanged(operation, changes);
+    }
+
+    // Список заменен целиком: новая точка истории и событие Reset
+    void OnEntriesReplaced(String^ operation) {
+        history->Reset(entries);
+        RaiseChanged(operation, gcnew NotebookChange(NotebookChangeKind::Reset, 0, entries->Count, nullptr, nullptr));
+    }
+
+    // Событие о перестановке всего списка после сортировки; newPositions[i] -
+    // новый номер записи, стоявшей на месте i (по нему правится кэш запросов)
+    void OnEntriesReordered(String^ operation, array<int>^ newPositions) {
+        queryCache->Reorder(newPositions, version + 1);
+        RaiseChanged(operation, gcnew NotebookChange(NotebookChangeKind::Reordered, 0, entries->Count, nullptr, nullptr));
+    }
+
+    // Сортировка всего списка на месте. Порядок берется из кэша запросов:
+    // повторная сортировка или возврат к порядку, уже посчитанному для этой
+    // версии, - одна перестановка за O(n). Равные ключи упорядочены по ID.
+    // Возвращает false, если список уже в этом порядке (без шага истории)
+    bool SortEntries(EntryOrder order, bool descending, String^ operation) {
+        array<int>^ sorted = queryCache->GetRows(String::Empty, -1, order, descending, entries, version);
+        bool identity = true;
+        for (int i = 0; i < sorted->Length && identity; i++) {
+            identity = sorted[i] == i;
+        }
+        if (identity) return false;
+
+        array<NotebookEntry<int>^>^ source = entries->ToArray();
+        array<int>^ newPositions = gcnew array<int>(sorted->Length);
+        for (int i = 0; i < sorted->Length; i++) {
+            entries[i] = source[sorted[i]];
+            newPositions[sorted[i]] = i;
+        }
+        history->Commit(operation, history->Begin()->FromList(entries));
+        OnEntriesReordered(operation, newPositions);
+        return true;
+    }
+
+    // Путь указывает на файл хранения книги
+    bool IsStoragePath(String^ filePath) {
+        return autoPersist && String::Equals(Path::GetFullPath(filePath), Path::GetFullPath(defaultJsonPath),
+            StringComparison::OrdinalIgnoreCase);
+    }
+
+    // Запоминание текста файла хранения после чтения/сохранения: JSON-объекты
+    // идут в порядке записей, поэтому каждому участку соответствует entries[i]
+    void RememberStorage(String^ filePath, String^ json) {
+        if (!IsStoragePath(filePath)) return;
+        List<TextSpan>^ spans = JsonSpans::ScanArray(json);
+        if (spans == nullptr) {
+            // Разбирается Newtonsoft, но не разметкой (например, с комментариями)
+            spans = gcnew List<TextSpan>();
+            spans->Add(TextSpan(0, json->Length));
+        }
+        List<unsigned long long>^ hashes = gcnew List<unsigned long long>(spans->Count);
+        for each (TextSpan span in spans) {
+            hashes->Add(JsonSpans::Hash(json, span));
+        }
+        RememberStorage(filePath, json->Length, hashes);
+    }
+
+    // То же по хешам объектов, посчитанным при записи файла
+    void RememberStorage(String^ filePath, long long textLength, List<unsigned long long>^ hashes) {
+        if (!IsStoragePath(filePath)) return;
+        spanCache = gcnew Dictionary<unsigned long long, NotebookEntry<int>^>();
+        if (hashes->Count == entries->Count) {
+            for (int i = 0; i < hashes->Count; i++) {
+                spanCache[hashes[i]] = entries[i];
+            }
+        }
+        storageTextLength = textLength;
+        storageTextHash = JsonSpans::Combine(hashes);
+        FileInfo^ info = gcnew FileInfo(filePath);
+        storageLength = info->Length;
+        storageWriteTime = info->LastWriteTimeUtc;
+    }
+
+    // Переход к списку, прочитанному из измененного файла: удаленные,
+    // добавленные и измененные записи одним шагом истории. Если порядок
+    // оставшихся записей поменялся или ID повторяются - событие Reset
+    int ApplyExternalState(List<NotebookEntry<int>^>^ loaded) {
+        String^ operation = "External change";
+        HashSet<int>^ oldIds = gcnew HashSet<int>();
+        HashSet<int>^ newIds = gcnew HashSet<int>();
+        bool reset = false;
+        for each (NotebookEntry<int>^ entry in entries) {
+            if (!oldIds->Add(entry->GetId())) reset = true;
+        }
+        for each (NotebookEntry<int>^ entry in loaded) {
+            if (!newIds->Add(entry->GetId())) reset = true;
+        }
+
+        PersistentVector<NotebookEntry<int>^>^ state = history->Begin();
+        List<NotebookChange^>^ changes = gcnew List<NotebookChange^>();
+        int changed = 0;
+        if (!reset) {
+            // Удаленные записи: диапазоны с конца списка, как в RemoveAtIndices
+            List<int>^ removed = gcnew List<int>();
+            List<NotebookEntry<int>^>^ survivors = gcnew List<NotebookEntry<int>^>(entries->Count);
+            for (int i = 0; i < entries->Count; i++) {
+                if (newIds->Contains(entries[i]->GetId())) survivors->Add(entries[i]);
+                else removed->Add(i);
+            }
+            if (removed->Count > 0) {
+                List<NotebookChange^>^ runs = gcnew List<NotebookChange^>();
+                int runStart = 0;
+                for (int i = 1; i <= removed->Count; i++) {
+                    if (i == removed->Count || removed[i] != removed[i - 1] + 1) {
+                        int count = i - runStart;
+                        runs->Add(gcnew NotebookChange(NotebookChangeKind::Removed, removed[runStart], count,
+                            entries->GetRange(removed[runStart], count), nullptr));
+                        runStart = i;
+                    }
+                }
+                runs->Reverse();
+                changes->AddRange(runs);
+                state = state->RemoveAll(removed);
+                changed += removed->Count;
+            }
+
+            // Добавленные и измененные записи в порядке нового списка
+            int next = 0;
+            int insertStart = -1;
+            for (int i = 0; i <= loaded->Count && !reset; i++) {
+                NotebookEntry<int>^ entry = i < loaded->Count ? loaded[i] : nullptr;
+                bool inserted = entry != nullptr && !oldIds->Contains(entry->GetId());
+                if (insertStart >= 0 && !inserted) {
+                    changes->Add(gcnew NotebookChange(NotebookChangeKind::Inserted, insertStart, i - insertStart,
+                        loaded->GetRange(insertStart, i - insertStart), nullptr));
+                    changed += i - insertStart;
+                    insertStart = -1;
+                }
+                if (entry == nullptr) break;
+                if (inserted) {
+                    if (insertStart < 0) insertStart = i;
+                    state = state->Insert(i, entry);
+                    continue;
+                }
+                NotebookEntry<int>^ previous = survivors[next++];
+                if (previous->GetId() != entry->GetId()) {
+                    reset = true;
+                }
+                else if (previous != entry && RecordHasher::Hash(previous) != RecordHasher::Hash(entry)) {
+                    List<NotebookEntry<int>^>^ newEntries = gcnew List<NotebookEntry<int>^>(1);
+                    newEntries->Add(entry);
+                    List<NotebookEntry<int>^>^ oldEntries = gcnew List<NotebookEntry<int>^>(1);
+                    oldEntries->Add(previous);
+                    changes->Add(gcnew NotebookChange(NotebookChangeKind::Updated, i, 1, newEntries, oldEntries));
+                    state = state->Set(i, entry);
+                    changed++;
+                }
+            }
+        }
+
+        entries = loaded;
+        if (reset) {
+            OnEntriesReplaced(operation);
+            return entries->Count;
+        }
+        if (changes->Count > 0) {
+            history->Commit(operation, state, changes);
+            RaiseChanged(operation, changes);
+        }
+        return changed;
+    }
+
+    // Автоматическое сохранение после изменения (если книга связана с файлом):
+    // блок в журнале, а при его переполнении или перестановке записей -
+    // публикация всего файла
+    void Persist() {
+        if (!autoPersist) return;
+        if (journalOperations && journal != nullptr && journal->IsReady() && StorageJournal::CanRecord(lastChanges)) {
+            try {
+                journal->Append(lastChanges);
+                if (journal->GetLength() < CheckpointBytes) return;
+            }
+            catch (SimulatedCrashException^) {
+                throw;
+            }
+            catch (IOException^) {
+                // Журнал недоступен - сохраняем файл целиком
+            }
+        }
+        Checkpoint();
+    }
+
+    String^ JournalPath() {
+        return defaultJsonPath + ".journal";
+    }
+
+    // Новый журнал для версии файла хранения из RememberStorage
+    void ResetJournal() {
+        if (journal == nullptr) {
+            journal = gcnew StorageJournal(JournalPath());
+        }
+        try {
+            journal->Reset(storageTextLength, storageTextHash);
+        }
+        catch (SimulatedCrashException^) {
+            throw;
+        }
+        catch (IOException^) {
+            // Без журнала каждая операция сохраняет файл целиком
+        }
+        catch (UnauthorizedAccessException^) {
+        }
+    }
+
+    // Книга заменена записями из другого источника: операции журнала
+    // ссылаются на индексы прежнего списка, поэтому файл хранения сразу
+    // публикуется заново. Если это не удалось, журнал отключается до
+    // следующего сохранения, и операция сохранит файл целиком
+    void PublishReplacedEntries() {
+        if (!autoPersist || !journalOperations || journal == nullptr) return;
+        try {
+            Checkpoint();
+        }
+        catch (SimulatedCrashException^) {
+            throw;
+        }
+        catch (Exception^) {
+            journal = nullptr;
+        }
+    }
+
+    // Повтор операций журнала поверх только что прочитанного файла хранения
+    // (после RememberStorage). Журнал от другой версии файла откладывается
+    // в .stale, а не теряется
+    int RecoverJournal() {
+        Stopwatch^ clock = Stopwatch::StartNew();
+        recovery = gcnew JournalRecovery();
+        journal = gcnew StorageJournal(JournalPath());
+        int replayed = 0;
+        try {
+            replayed = journal->Replay(storageTextLength, storageTextHash, entries, recovery);
+            if (recovery->staleJournal) {
+                File::Copy(JournalPath(), JournalPath() + ".stale", true);
+            }
+        }
+        catch (IOException^) {
+            // Журнал не читается: книга остается в опубликованном состоянии
+        }
+        if (!journal->IsReady()) {
+            ResetJournal();
+        }
+        recovery->milliseconds = clock->Elapsed.TotalMilliseconds;
+        return replayed;
+    }
+
+    // Файл хранения не разбирается: копия поврежденного файла сохраняется
+    // рядом, книга берется из предыдущей опубликованной версии (.bak).
+    // Возвращает true, если записи восстановлены
+    bool RecoverDamagedStorage() {
+        Stopwatch^ clock = Stopwatch::StartNew();
+        recovery = gcnew JournalRecovery();
+        try {
+            if (File::Exists(defaultJsonPath)) {
+                recovery->damagedCopyPath = defaultJsonPath + ".damaged";
+                File::Copy(defaultJsonPath, recovery->damagedCopyPath, true);
+            }
+            String^ backupPath = AtomicFile::BackupPath(defaultJsonPath);
+            if (!File::Exists(backupPath)) return false;
+            String^ json = File::ReadAllText(backupPath, gcnew UTF8Encoding(true));
+            List<NotebookEntry<int>^>^ loaded = JsonConvert::DeserializeObject<List<NotebookEntry<int>^>^>(json);
+            if (loaded == nullptr) return false;
+            entries = loaded;
+            recovery->restoredFromBackup = true;
+            return true;
+        }
+        catch (Exception^) {
+            return false;
+        }
+        finally {
+            recovery->milliseconds = clock->Elapsed.TotalMilliseconds;
+        }
+    }
+
+    // Контрольная точка после восстановления или переноса операций журнала
+    // на новую версию файла; при ошибке журнал остается (после сбоя он
+    // повторяется при загрузке или сохраняется в .stale)
+    void CheckpointAfterRecovery() {
+        try {
+            Checkpoint();
+        }
+        catch (SimulatedCrashException^) {
+            throw;
+        }
+        catch (Exception^) {
+        }
+    }
+
+    // Начальная загрузка книги из файла хранения
+    void Initialize() {
         entries = gcnew List<NotebookEntry<int>^>();
         currentFilePath = defaultJsonPath;
+        history = gcnew NotebookHistory(NotebookHistory::DefaultBudgetBytes);
         
         // Создаем пустой JSON файл, если он не существует
         if (!File::Exists(defaultJsonPath)) {
@@ -84,144 +444,732 @@ public:
                 // Игнорируем ошибку, если не удалось создать файл
                 // Будем использовать пустой список в памяти
                 entries = gcnew List<NotebookEntry<int>^>();
+                OnEntriesReplaced("Load");
                 return;
             }
         }
         
-        // Автоматически загружаем контакты из JSON файла при запуске, если он существует
+        // Автоматически загружаем контакты из JSON файла при запуске, если он существует.
+        // LoadFromJsonFile сам публикует Reset, в том числе при ошибке разбора
         if (File::Exists(defaultJsonPath)) {
+            long long versionBefore = version;
             try {
                 LoadFromJsonFile(defaultJsonPath);
+                return;
+            }
+            catch (SimulatedCrashException^) {
+                throw;
             }
             catch (...) {
-                // Если не удалось загрузить - создаем пустой список
+                // Файл поврежден: предыдущая версия или пустой список, но не
+                // молча - поврежденный файл остается рядом (GetRecovery)
+                if (RecoverDamagedStorage()) {
+                    OnEntriesReplaced("Load");
+                    CheckpointAfterRecovery();
+                    return;
+                }
+                if (version != versionBefore) {
+                    // Пустой список уже опубликован при ошибке разбора
+                    return;
+                }
                 entries = gcnew List<NotebookEntry<int>^>();
             }
         }
+        OnEntriesReplaced("Load");
+    }
+
+    // Индексы записей с указанными ID (в порядке возрастания)
+    List<int>^ FindIndices(HashSet<int>^ ids) {
+        List<int>^ indices = gcnew List<int>();
+        for (int i = 0; i < entries->Count; i++) {
+            if (ids->Contains(entries[i]->GetId())) {
+                indices->Add(i);
+            }
+        }
+        return indices;
+    }
+
+    // Удаление записей по набору ID
+    int RemoveEntries(HashSet<int>^ ids, String^ description) {
+        return RemoveAtIndices(FindIndices(ids), description);
+    }
+
+    // Удаление записей по позициям (в порядке возрастания) одним шагом истории
+    int RemoveAtIndices(List<int>^ indices, String^ description) {
+        if (indices->Count == 0) {
+            return 0;
+        }
+        PersistentVector<NotebookEntry<int>^>^ state = history->Begin()->RemoveAll(indices);
+
+        // Непрерывные диапазоны удаленных записей; в пакете - с конца списка,
+        // чтобы индексы оставались верными при последовательном применении
+        List<NotebookChange^>^ changes = gcnew List<NotebookChange^>();
+        int runStart = 0;
+        for (int i = 1; i <= indices->Count; i++) {
+            if (i == indices->Count || indices[i] != indices[i - 1] + 1) {
+                int count = i - runStart;
+                changes->Add(gcnew NotebookChange(NotebookChangeKind::Removed, indices[runStart], count,
+                    entries->GetRange(indices[runStart], count), nullptr));
+                runStart = i;
+            }
+        }
+        changes->Reverse();
+        history->Commit(description, state, changes);
+
+        // Сдвигаем оставшиеся записи за один проход
+        int write = 0;
+        int next = 0;
+        for (int read = 0; read < entries->Count; read++) {
+            if (next < indices->Count && indices[next] == read) {
+                next++;
+                continue;
+            }
+            entries[write++] = entries[read];
+        }
+        entries->RemoveRange(write, entries->Count - write);
+        RaiseChanged(description, changes);
+
+        // Автоматически сохраняем в JSON после удаления
+        Persist();
+        return indices->Count;
+    }
+
+    // Применение версии из истории к рабочему списку. Пакет шага правит
+    // список и публикуется как есть - его видят журнал, кэши и индексы;
+    // шаг без пакета (сортировка) заменяет список целиком
+    void ApplyHistoryState(PersistentVector<NotebookEntry<int>^>^ state, List<NotebookChange^>^ changes, String^ operation) {
+        if (changes == nullptr) {
+            entries = state->ToList();
+            RaiseChanged(operation, gcnew NotebookChange(NotebookChangeKind::Reset, 0, entries->Count, nullptr, nullptr));
+        }
+        else {
+            for each (NotebookChange^ change in changes) {
+                switch (change->kind) {
+                case NotebookChangeKind::Inserted:
+                    entries->InsertRange(change->index, change->entries);
+                    break;
+                case NotebookChangeKind::Removed:
+                    entries->RemoveRange(change->index, change->count);
+                    break;
+                default:
+                    for (int i = 0; i < change->count; i++) {
+                        entries[change->index + i] = change->entries[i];
+                    }
+                    break;
+                }
+            }
+            RaiseChanged(operation, changes);
+        }
+        // Автоматически сохраняем в JSON после отмены/повтора
+        Persist();
+    }
+
+public:
+    // Размер журнала, после которого файл хранения публикуется заново;
+    // ограничивает и время восстановления после сбоя
+    literal long long CheckpointBytes = 4LL * 1024 * 1024;
+
+    // Изменения списка записей: один пакет на каждую операцию
+    event EventHandler<NotebookChangedEventArgs^>^ Changed;
+
+    // Конструктор
+    NotebookManager() {
+        Initialize();
+    }
+
+    // Конструктор для книги, хранящейся в указанном JSON файле
+    NotebookManager(String^ jsonPath) {
+        defaultJsonPath = jsonPath;
+        Initialize();
+    }
+
+    // Конструктор без автоматической загрузки и сохранения: книга живет
+    // только в памяти, пока ее явно не сохранят (для пакетной обработки)
+    NotebookManager(String^ jsonPath, bool autoPersist) {
+        defaultJsonPath = jsonPath;
+        this->autoPersist = autoPersist;
+        if (autoPersist) {
+            Initialize();
+        }
+        else {
+            entries = gcnew List<NotebookEntry<int>^>();
+            currentFilePath = jsonPath;
+            history = gcnew NotebookHistory(NotebookHistory::DefaultBudgetBytes);
+            OnEntriesReplaced("Load");
+        }
+    }
+
+    // Конструктор с отложенной загрузкой: книга пуста, пока записи,
+    // прочитанные в фоне (StorageLoader), не переданы в CompleteLoad
+    NotebookManager(String^ jsonPath, bool autoPersist, bool deferLoad) {
+        defaultJsonPath = jsonPath;
+        this->autoPersist = autoPersist;
+        if (autoPersist && !deferLoad) {
+            Initialize();
+        }
+        else {
+            entries = gcnew List<NotebookEntry<int>^>();
+            currentFilePath = jsonPath;
+            history = gcnew NotebookHistory(NotebookHistory::DefaultBudgetBytes);
+            OnEntriesReplaced("Load");
+        }
+    }
+
+    // Завершение отложенной загрузки: записи и текст файла хранения,
+    // из которого они разобраны (nullptr, если файл прочитать не удалось)
+    void CompleteLoad(List<NotebookEntry<int>^>^ loaded, String^ json) {
+        entries = loaded;
+        currentFilePath = defaultJsonPath;
+        bool recovered = false;
+        if (json != nullptr) {
+            RememberStorage(defaultJsonPath, json);
+            recovered = RecoverJournal() > 0;
+        }
+        else {
+            recovered = RecoverDamagedStorage();
+        }
+        OnEntriesReplaced("Load");
+        if (recovered) {
+            CheckpointAfterRecovery();
+        }
+    }
+
+    // Итоги восстановления при последней загрузке (nullptr - загрузки не было)
+    JournalRecovery^ GetRecovery() {
+        return recovery;
+    }
+
+    // Запись операций в журнал вместо сохранения всего файла после каждой
+    // из них. Файл хранения догоняет журнал в Checkpoint - ее нужно вызывать
+    // в простое и перед выходом, иначе другие программы не увидят изменения
+    void EnableJournal() {
+        journalOperations = true;
+    }
+
+    // Хранение адресов и заметок вне записей: они сжимаются в сегменты
+    // ColdFieldStore и декодируются при показе строки, экспорте и поиске
+    // по адресу. Уже загруженные записи переносятся сразу
+    void EnableColdFields() {
+        if (coldFields != nullptr) return;
+        coldFields = gcnew ColdFieldStore();
+        for each (NotebookEntry<int>^ entry in entries) {
+            entry->MoveCold(coldFields);
+        }
+        entryBytesVersion = -1;
+    }
+
+    // nullptr, если холодные поля не включены
+    ColdFieldStore^ GetColdFields() {
+        return coldFields;
+    }
+
+    long long EstimateColdFieldBytes() {
+        return coldFields == nullptr ? 0 : coldFields->EstimateBytes();
+    }
+
+    String^ DescribeColdFields() {
+        return coldFields == nullptr ? "disabled" : coldFields->Describe();
+    }
+
+    // В журнале есть операции, еще не опубликованные в файле хранения
+    bool HasPendingOperations() {
+        return journal != nullptr && journal->HasOperations();
+    }
+
+    // Публикация файла хранения и сброс журнала
+    void Checkpoint() {
+        if (autoPersist) {
+            SaveToJsonFile(defaultJsonPath);
+        }
     }
 
     // Добавление новой записи
     void AddEntry(NotebookEntry<int>^ entry) {
         if (entry->IsValid()) {
+            List<NotebookEntry<int>^>^ inserted = gcnew List<NotebookEntry<int>^>(1);
+            inserted->Add(entry);
+            List<NotebookChange^>^ changes = gcnew List<NotebookChange^>(1);
+            changes->Add(gcnew NotebookChange(NotebookChangeKind::Inserted, entries->Count, 1, inserted, nullptr));
+            history->Commit("Add", history->Begin()->Add(entry), changes);
             entries->Add(entry);
+            RaiseChanged("Add", changes);
             // Автоматически сохраняем в JSON после добавления
-            SaveToJsonFile(defaultJsonPath);
+            Persist();
         }
         else {
             throw gcnew Exception("Invalid entry: required fields must be filled");
         }
     }
 
+    // Пакетное добавление записей с одним сохранением в конце.
+    // Невалидные записи пропускаются; возвращается число добавленных
+    int AddEntries(IEnumerable<NotebookEntry<int>^>^ newEntries) {
+        PersistentVector<NotebookEntry<int>^>^ state = history->Begin();
+        int start = entries->Count;
+        int added = 0;
+        for each (NotebookEntry<int>^ entry in newEntries) {
+            if (entry->IsValid()) {
+                state = state->Add(entry);
+                entries->Add(entry);
+                added++;
+            }
+        }
+        if (added > 0) {
+            List<NotebookChange^>^ changes = gcnew List<NotebookChange^>(1);
+            changes->Add(gcnew NotebookChange(NotebookChangeKind::Inserted, start, added, entries->GetRange(start, added), nullptr));
+            history->Commit("Add " + added + " entries", state, changes);
+            RaiseChanged("Add " + added + " entries", changes);
+            Persist();
+        }
+        return added;
+    }
+
+    // Добавление карточек из файла vCard одним шагом истории и одним
+    // сохранением. Файл читается потоково; карточки с занятым или
+    // нечисловым UID получают следующие свободные ID.
+    // Возвращает число добавленных записей
+    int ImportVCard(String^ filePath) {
+        VCardReader^ reader = VCardReader::Open(filePath);
+        try {
+            HashSet<int>^ usedIds = gcnew HashSet<int>();
+            for each (NotebookEntry<int>^ entry in entries) {
+                usedIds->Add(entry->GetId());
+            }
+            reader->AssignIds(usedIds, GetMaxId() + 1);
+            // Файл дочитывается до изменения списка: ошибка чтения посередине
+            // не оставляет книгу с частью карточек вне истории
+            return AddEntries(gcnew List<NotebookEntry<int>^>(reader));
+        }
+        catch (IOException^ ex) {
+            throw gcnew Exception("Error importing vCard file: " + ex->Message);
+        }
+        finally {
+            reader->Close();
+        }
+    }
+
+    // Замена записи с тем же ID новыми значениями
+    bool UpdateEntry(NotebookEntry<int>^ updated) {
+        if (!updated->IsValid()) {
+            throw gcnew Exception("Invalid entry: required fields must be filled");
+        }
+        for (int i = 0; i < entries->Count; i++) {
+            if (entries[i]->GetId() != updated->GetId()) continue;
+
+            List<NotebookEntry<int>^>^ oldEntries = gcnew List<NotebookEntry<int>^>(1);
+            oldEntries->Add(entries[i]);
+            List<NotebookEntry<int>^>^ newEntries = gcnew List<NotebookEntry<int>^>(1);
+            newEntries->Add(updated);
+            List<NotebookChange^>^ changes = gcnew List<NotebookChange^>(1);
+            changes->Add(gcnew NotebookChange(NotebookChangeKind::Updated, i, 1, newEntries, oldEntries));
+            history->Commit("Edit", history->Begin()->Set(i, updated), changes);
+            entries[i] = updated;
+            RaiseChanged("Edit", changes);
+            // Автоматически сохраняем в JSON после изменения
+            Persist();
+            return true;
+        }
+        return false;
+    }
+
+    // Добавление (add) или снятие меток у записей с указанными ID одним
+    // шагом истории. Записи не меняются на месте: измененные заменяются
+    // копиями с новыми метками. Возвращает число измененных записей
+    int TagEntries(IEnumerable<int>^ ids, array<String^>^ tags, bool add) {
+        HashSet<int>^ idSet = gcnew HashSet<int>(ids);
+        array<String^>^ normalized = NotebookEntry<int>::NormalizeTags(tags);
+        if (normalized == nullptr) return 0;
+
+        PersistentVector<NotebookEntry<int>^>^ state = history->Begin();
+        List<NotebookChange^>^ changes = gcnew List<NotebookChange^>();
+        for (int i = 0; i < entries->Count; i++) {
+            NotebookEntry<int>^ entry = entries[i];
+            if (!idSet->Contains(entry->GetId())) continue;
+            List<String^>^ merged = entry->GetTags() == nullptr
+                ? gcnew List<String^>() : gcnew List<String^>(entry->GetTags());
+            bool changed = false;
+            for each (String^ tag in normalized) {
+                if (add ? !merged->Contains(tag) : merged->Contains(tag)) {
+                    if (add) merged->Add(tag);
+                    else merged->Remove(tag);
+                    changed = true;
+                }
+            }
+            if (!changed) continue;
+
+            NotebookEntry<int>^ updated = entry->Clone();
+            updated->SetTags(merged->ToArray());
+            List<NotebookEntry<int>^>^ oldEntries = gcnew List<NotebookEntry<int>^>(1);
+            oldEntries->Add(entry);
+            List<NotebookEntry<int>^>^ newEntries = gcnew List<NotebookEntry<int>^>(1);
+            newEntries->Add(updated);
+            changes->Add(gcnew NotebookChange(NotebookChangeKind::Updated, i, 1, newEntries, oldEntries));
+            state = state->Set(i, updated);
+            entries[i] = updated;
+        }
+        if (changes->Count == 0) return 0;
+
+        String^ operation = (add ? "Tag " : "Untag ") + changes->Count + " entries";
+        history->Commit(operation, state, changes);
+        RaiseChanged(operation, changes);
+        Persist();
+        return changes->Count;
+    }
+
+    // Метки книги и число записей с каждой (из индекса меток)
+    SortedDictionary<String^, int>^ GetTags() {
+        return tagIndex->GetTags(entries);
+    }
+
+    // Число записей под выражением меток без списка результатов
+    int CountTagged(String^ query) {
+        return tagIndex->Count(query->ToLower(), entries);
+    }
+
     // Удаление записи по ID
     bool RemoveEntry(int id) {
-        RemoveEntryPredicate^ predicate = gcnew RemoveEntryPredicate(id);
-        bool result = entries->RemoveAll(gcnew Predicate<NotebookEntry<int>^>(predicate, &RemoveEntryPredicate::Match)) > 0;
-        if (result) {
-            // Автоматически сохраняем в JSON после удаления
-            SaveToJsonFile(defaultJsonPath);
+        HashSet<int>^ ids = gcnew HashSet<int>();
+        ids->Add(id);
+        return RemoveEntries(ids, "Delete") > 0;
+    }
+
+    // Удаление нескольких записей по ID одной операцией (одним шагом истории)
+    int RemoveEntries(IEnumerable<int>^ ids) {
+        HashSet<int>^ idSet = gcnew HashSet<int>(ids);
+        return RemoveEntries(idSet, "Delete " + idSet->Count + " entries");
+    }
+
+    // Удаление дубликатов: совпадают имя, фамилия (без учета регистра)
+    // и цифры телефона. Остается первая запись; возвращается число удаленных
+    int RemoveDuplicates() {
+        HashSet<String^>^ seen = gcnew HashSet<String^>();
+        List<int>^ duplicates = gcnew List<int>();
+        for (int i = 0; i < entries->Count; i++) {
+            NotebookEntry<int>^ entry = entries[i];
+            StringBuilder^ key = gcnew StringBuilder();
+            key->Append(entry->GetFirstName()->Trim()->ToLower())->Append('\t');
+            key->Append(entry->GetLastName()->Trim()->ToLower())->Append('\t');
+            String^ phone = entry->GetPhoneNumber();
+            for (int j = 0; j < phone->Length; j++) {
+                if (Char::IsDigit(phone[j])) key->Append(phone[j]);
+            }
+            if (!seen->Add(key->ToString())) {
+                duplicates->Add(i);
+            }
         }
-        return result;
+        return RemoveAtIndices(duplicates, "Remove " + duplicates->Count + " duplicates");
     }
 
-    // Получение всех записей
-    List<NotebookEntry<int>^>^ GetAllEntries() {
-        return entries;
+    // Очистка книги (операцию можно отменить)
+    void Clear() {
+        // Для отмены шаг помнит очистку как удаление всех записей
+        List<NotebookChange^>^ removed = gcnew List<NotebookChange^>(1);
+        removed->Add(gcnew NotebookChange(NotebookChangeKind::Removed, 0, entries->Count, entries, nullptr));
+        history->Commit("Clear", history->Begin()->FromList(gcnew List<NotebookEntry<int>^>()), removed);
+        entries = gcnew List<NotebookEntry<int>^>();
+        RaiseChanged("Clear", gcnew NotebookChange(NotebookChangeKind::Reset, 0, 0, nullptr, nullptr));
+        // Автоматически сохраняем в JSON после очистки
+        Persist();
     }
 
-    // Поиск по имени
-    List<NotebookEntry<int>^>^ SearchByFirstName(String^ firstName) {
-        List<NotebookEntry<int>^>^ results = gcnew List<NotebookEntry<int>^>();
-        for each (NotebookEntry<int>^ entry in entries) {
-            if (entry->GetFirstName()->ToLower()->Contains(firstName->ToLower())) {
-                results->Add(entry);
+    // Отмена последней операции
+    bool Undo() {
+        List<NotebookChange^>^ changes;
+        PersistentVector<NotebookEntry<int>^>^ state = history->Undo(changes);
+        if (state == nullptr) {
+            return false;
+        }
+        ApplyHistoryState(state, changes, "Undo");
+        return true;
+    }
+
+    // Повтор отмененной операции
+    bool Redo() {
+        List<NotebookChange^>^ changes;
+        PersistentVector<NotebookEntry<int>^>^ state = history->Redo(changes);
+        if (state == nullptr) {
+            return false;
+        }
+        ApplyHistoryState(state, changes, "Redo");
+        return true;
+    }
+
+    // История изменений (для отображения состояния отмены/повтора)
+    NotebookHistory^ GetHistory() {
+        return history;
+    }
+
+    // Путь к файлу хранения книги
+    String^ GetStoragePath() {
+        return defaultJsonPath;
+    }
+
+    // Файл хранения изменен не этим экземпляром после последнего чтения/сохранения
+    bool HasExternalChanges() {
+        if (!autoPersist || !File::Exists(defaultJsonPath)) return false;
+        FileInfo^ info = gcnew FileInfo(defaultJsonPath);
+        return info->Length != storageLength || info->LastWriteTimeUtc != storageWriteTime;
+    }
+
+    // Перечитывание файла хранения, измененного другой программой. Заново
+    // разбираются только JSON-объекты, текста которых не было при последнем
+    // чтении/сохранении; в Changed публикуется разница с текущим списком.
+    // Операции журнала, еще не опубликованные в файле, переносятся на новую
+    // версию по ID записей и публикуются вместе с ней.
+    // Возвращает число затронутых записей (0 - изменений нет). IOException
+    // (файл занят) и InvalidDataException (файл дописывается) означают,
+    // что чтение нужно повторить позже
+    int ReloadExternalChanges() {
+        if (!HasExternalChanges()) return 0;
+        FileInfo^ info = gcnew FileInfo(defaultJsonPath);
+        long long length = info->Length;
+        DateTime writeTime = info->LastWriteTimeUtc;
+        String^ json = File::ReadAllText(defaultJsonPath, gcnew UTF8Encoding(true));
+        List<TextSpan>^ spans = String::IsNullOrWhiteSpace(json) ? gcnew List<TextSpan>() : JsonSpans::ScanArray(json);
+        if (spans == nullptr) {
+            throw gcnew InvalidDataException("Storage file is not a complete JSON array: " + defaultJsonPath);
+        }
+
+        Dictionary<unsigned long long, NotebookEntry<int>^>^ cache =
+            gcnew Dictionary<unsigned long long, NotebookEntry<int>^>(spans->Count);
+        List<NotebookEntry<int>^>^ loaded = gcnew List<NotebookEntry<int>^>(spans->Count);
+        List<unsigned long long>^ hashes = gcnew List<unsigned long long>(spans->Count);
+        for each (TextSpan span in spans) {
+            unsigned long long hash = JsonSpans::Hash(json, span);
+            hashes->Add(hash);
+            NotebookEntry<int>^ entry;
+            if ((spanCache == nullptr || !spanCache->TryGetValue(hash, entry)) && !cache->TryGetValue(hash, entry)) {
+                entry = JsonConvert::DeserializeObject<NotebookEntry<int>^>(json->Substring(span.start, span.length));
             }
+            cache[hash] = entry;
+            loaded->Add(entry);
         }
-        return results;
+
+        // Без переноса сброс журнала потерял бы операции этого экземпляра
+        bool pending = HasPendingOperations();
+        if (pending) {
+            journal->Rebase(loaded);
+        }
+        int changed = ApplyExternalState(loaded);
+        spanCache = cache;
+        storageLength = length;
+        storageWriteTime = writeTime;
+        storageTextLength = json->Length;
+        storageTextHash = JsonSpans::Combine(hashes);
+        if (pending) {
+            // Журнал сбрасывается только после публикации; при ошибке он
+            // остается и публикуется следующей контрольной точкой
+            CheckpointAfterRecovery();
+        }
+        else {
+            // Операций нет - журнал только привязывается к новой версии файла
+            ResetJournal();
+        }
+        return changed;
     }
 
-    // Поиск по фамилии
-    List<NotebookEntry<int>^>^ SearchByLastName(String^ lastName) {
-        List<NotebookEntry<int>^>^ results = gcnew List<NotebookEntry<int>^>();
-        for each (NotebookEntry<int>^ entry in entries) {
-            if (entry->GetLastName()->ToLower()->Contains(lastName->ToLower())) {
-                results->Add(entry);
+    // Версия списка записей: растет с каждой опубликованной операцией
+    long long GetVersion() {
+        return version;
+    }
+
+    // Оценка памяти записей (объекты, строки полей и сам список);
+    // пересчитывается только после изменения версии
+    long long EstimateEntryBytes() {
+        if (entryBytesVersion != version) {
+            long long bytes = MemorySizes::ReferenceArrayBytes(entries->Capacity);
+            for each (NotebookEntry<int>^ entry in entries) {
+                bytes += EntrySchema::EstimateBytes(entry);
             }
+            entryBytes = bytes;
+            entryBytesVersion = version;
         }
-        return results;
+        return entryBytes;
     }
 
-    // Поиск по номеру телефона
-    List<NotebookEntry<int>^>^ SearchByPhone(String^ phone) {
+    // Кэш разобранных объектов файла хранения (хеш, ссылка и служебные поля словаря)
+    long long EstimateSpanCacheBytes() {
+        Dictionary<unsigned long long, NotebookEntry<int>^>^ cache = spanCache;
+        return cache == nullptr ? 0 : cache->Count * 28LL;
+    }
+
+    // Сброс кэша: следующее внешнее изменение разбирает файл целиком
+    long long TrimSpanCache(long long targetBytes) {
+        spanCache = nullptr;
+        return 0;
+    }
+
+    // Количество записей
+    int GetCount() {
+        return entries->Count;
+    }
+
+    // Записи, у которых день рождения попадает в ближайшие days дней начиная с from
+    List<NotebookEntry<int>^>^ GetUpcomingBirthdays(DateTime from, int days) {
         List<NotebookEntry<int>^>^ results = gcnew List<NotebookEntry<int>^>();
         for each (NotebookEntry<int>^ entry in entries) {
-            if (entry->GetPhoneNumber()->ToLower()->Contains(phone->ToLower())) {
+            DateTime birthDate;
+            if (String::IsNullOrEmpty(entry->GetBirthDate()) ||
+                !DateTime::TryParse(entry->GetBirthDate(), birthDate)) {
+                continue;
+            }
+            DateTime next = GetNextBirthday(birthDate, from);
+            if ((next - from.Date).TotalDays < days) {
                 results->Add(entry);
             }
         }
         return results;
     }
 
+    // Ближайший день рождения не раньше указанной даты (29 февраля - 28 февраля в невисокосный год)
+    static DateTime GetNextBirthday(DateTime birthDate, DateTime from) {
+        int year = from.Year;
+        int day = Math::Min(birthDate.Day, DateTime::DaysInMonth(year, birthDate.Month));
+        DateTime candidate = DateTime(year, birthDate.Month, day);
+        if (candidate < from.Date) {
+            year++;
+            day = Math::Min(birthDate.Day, DateTime::DaysInMonth(year, birthDate.Month));
+            candidate = DateTime(year, birthDate.Month, day);
+        }
+        return candidate;
+    }
+
+    // Все записи только для чтения: обертка над рабочим списком без копирования.
+    // Изменения - только через методы менеджера, иначе не будет события Changed
+    System::Collections::ObjectModel::ReadOnlyCollection<NotebookEntry<int>^>^ GetAllEntries() {
+        return entries->AsReadOnly();
+    }
+
+    // Неизменяемый снимок текущей версии (O(1)): обход не видит последующих
+    // изменений и подходит для потокового экспорта и сохранения в фоне
+    PersistentVector<NotebookEntry<int>^>^ GetSnapshot() {
+        return history->Current();
+    }
+
+    // Поиск по имени
+    List<NotebookEntry<int>^>^ SearchByFirstName(String^ firstName) {
+        return SearchField<FirstNameField>(entries, firstName->ToLower());
+    }
+
+    // Поиск по фамилии
+    List<NotebookEntry<int>^>^ SearchByLastName(String^ lastName) {
+        return SearchField<LastNameField>(entries, lastName->ToLower());
+    }
+
+    // Поиск по номеру телефона
+    List<NotebookEntry<int>^>^ SearchByPhone(String^ phone) {
+        return SearchField<PhoneField>(entries, phone->ToLower());
+    }
+
     // Поиск по email
     List<NotebookEntry<int>^>^ SearchByEmail(String^ email) {
-        List<NotebookEntry<int>^>^ results = gcnew List<NotebookEntry<int>^>();
-        for each (NotebookEntry<int>^ entry in entries) {
-            if (!String::IsNullOrEmpty(entry->GetEmail()) && 
-                entry->GetEmail()->ToLower()->Contains(email->ToLower())) {
-                results->Add(entry);
-            }
-        }
-        return results;
+        return SearchField<EmailField>(entries, email->ToLower());
     }
 
     // Поиск по адресу
     List<NotebookEntry<int>^>^ SearchByAddress(String^ address) {
-        List<NotebookEntry<int>^>^ results = gcnew List<NotebookEntry<int>^>();
-        for each (NotebookEntry<int>^ entry in entries) {
-            if (!String::IsNullOrEmpty(entry->GetAddress()) && 
-                entry->GetAddress()->ToLower()->Contains(address->ToLower())) {
-                results->Add(entry);
-            }
+        return SearchField<AddressField>(entries, address->ToLower());
+    }
+
+    // Поиск по любому полю: searchType - номер поля в EntrySchema
+    // (0 - имя, 1 - фамилия, 2 - телефон, 3 - email, 4 - адрес,
+    // 5 - имя или фамилия звучит как запрос, любой письменностью,
+    // 6 - выражение меток TagExpression).
+    // Повтор того же запроса к той же версии отвечается из кэша; "звучит
+    // как" - из индекса имен, совпадения по транслитерации идут первыми;
+    // метки - из индекса меток
+    List<NotebookEntry<int>^>^ SearchByAnyField(String^ query, int searchType) {
+        if (searchType == EntrySchema::SoundsLikeSearchType) {
+            return nameIndex->Find(query, entries);
+        }
+        if (searchType == EntrySchema::TagSearchType) {
+            return tagIndex->Find(query->ToLower(), entries);
+        }
+        return Query(query, searchType, EntryOrder::Book, false);
+    }
+
+    // Результат поиска в заданном порядке (query == nullptr - все записи)
+    // через кэш запросов: поиск, сортировка, постраничное чтение и экспорт
+    // переиспользуют результаты друг друга
+    List<NotebookEntry<int>^>^ Query(String^ query, int searchType, EntryOrder order, bool descending) {
+        if (query == nullptr) searchType = -1;
+        array<int>^ rows = queryCache->GetRows(query, searchType, order, descending, entries, version);
+        List<NotebookEntry<int>^>^ results = gcnew List<NotebookEntry<int>^>(rows->Length);
+        for each (int row in rows) {
+            results->Add(entries[row]);
         }
         return results;
     }
 
-    // Поиск по любому полю
-    List<NotebookEntry<int>^>^ SearchByAnyField(String^ query, int searchType) {
-        switch (searchType) {
-            case 0: // By First Name
-                return SearchByFirstName(query);
-            case 1: // By Last Name
-                return SearchByLastName(query);
-            case 2: // By Phone
-                return SearchByPhone(query);
-            case 3: // By Email
-                return SearchByEmail(query);
-            case 4: // By Address
-                return SearchByAddress(query);
-            default:
-                return GetAllEntries();
+    QueryCache^ GetQueryCache() {
+        return queryCache;
+    }
+
+    long long EstimateQueryCacheBytes() {
+        return queryCache->GetUsedBytes();
+    }
+
+    long long TrimQueryCache(long long targetBytes) {
+        return queryCache->TrimTo(targetBytes);
+    }
+
+    String^ DescribeQueryCache() {
+        return queryCache->Describe();
+    }
+
+    long long EstimateNameIndexBytes() {
+        return nameIndex->GetUsedBytes();
+    }
+
+    long long TrimNameIndex(long long targetBytes) {
+        return nameIndex->Trim(targetBytes);
+    }
+
+    long long EstimateTagIndexBytes() {
+        return tagIndex->GetUsedBytes();
+    }
+
+    long long TrimTagIndex(long long targetBytes) {
+        return tagIndex->Trim(targetBytes);
+    }
+
+    // Проверка одной записи с той же семантикой, что и SearchByAnyField
+    // (запрос уже приведен к нижнему регистру)
+    static bool Matches(NotebookEntry<int>^ entry, String^ loweredQuery, int searchType) {
+        return EntrySchema::Matches(searchType, entry, loweredQuery);
+    }
+
+    // Поиск по произвольной последовательности записей (например, по снимку
+    // версии из другого потока) с той же семантикой, что и SearchByAnyField.
+    // Неизвестный номер поля - все записи
+    static List<NotebookEntry<int>^>^ SearchIn(IEnumerable<NotebookEntry<int>^>^ source, String^ query, int searchType) {
+        List<NotebookEntry<int>^>^ results = EntrySchema::Search(searchType, source, query->ToLower());
+        return results != nullptr ? results : gcnew List<NotebookEntry<int>^>(source);
+    }
+
+    // Запись последовательности записей в текстовом формате
+    static void WriteTsv(IEnumerable<NotebookEntry<int>^>^ source, TextWriter^ writer) {
+        for each (NotebookEntry<int>^ entry in source) {
+            EntrySchema::WriteTsv(writer, entry);
         }
     }
 
     // Сортировка по фамилии
     void SortByLastName(bool ascending) {
-        LastNameComparer^ comparer = gcnew LastNameComparer(ascending);
-        entries->Sort(comparer);
+        SortEntries(EntryOrder::LastName, !ascending, "Sort by last name");
     }
     
     // Сортировка по имени
     void SortByFirstName(bool ascending) {
-        FirstNameComparer^ comparer = gcnew FirstNameComparer(ascending);
-        entries->Sort(comparer);
+        SortEntries(EntryOrder::FirstName, !ascending, "Sort by first name");
     }
     
     // Сортировка по ID
     void SortById() {
         if (entries->Count > 0) {
-            IdComparer^ comparer = gcnew IdComparer();
-            entries->Sort(comparer);
+            SortEntries(EntryOrder::Id, false, "Sort by ID");
             // Автоматически сохраняем в JSON после сортировки
-            SaveToJsonFile(defaultJsonPath);
+            Persist();
         }
     }
     
@@ -237,13 +1185,28 @@ public:
     
     // Сохранение в JSON файл
     void SaveToJsonFile(String^ filePath) {
+        SaveToJsonFile(filePath, true);
+    }
+
+    // indented = false - без отступов и переводов строк (файл меньше, а
+    // Newtonsoft читает его так же)
+    void SaveToJsonFile(String^ filePath, bool indented) {
         try {
-            // Преобразуем список записей в JSON
-            String^ json = JsonConvert::SerializeObject(entries, Formatting::Indented);
-            
-            // Записываем JSON в файл
-            File::WriteAllText(filePath, json, gcnew UTF8Encoding(true));
+            // Записи пишутся в файл порциями, без текста всего документа;
+            // хеши объектов для файла хранения считаются по ходу записи
+            EntryJsonDocument^ document = gcnew EntryJsonDocument(entries, indented, IsStoragePath(filePath));
+
+            // Публикуем файл целиком: после сбоя остается старая или новая версия
+            AtomicFile::Publish(filePath, gcnew UTF8Encoding(true),
+                gcnew Action<Stream^>(document, &EntryJsonDocument::Write));
             currentFilePath = filePath;
+            if (IsStoragePath(filePath)) {
+                RememberStorage(filePath, document->GetLength(), document->GetObjectHashes());
+                ResetJournal();
+            }
+        }
+        catch (SimulatedCrashException^) {
+            throw;
         }
         catch (Exception^ ex) {
             throw gcnew Exception("Error saving to JSON file: " + ex->Message);
@@ -260,6 +1223,8 @@ public:
                 // Проверяем, не пустой ли файл
                 if (String::IsNullOrWhiteSpace(json)) {
                     entries = gcnew List<NotebookEntry<int>^>();
+                    OnEntriesReplaced("Load");
+                    PublishReplacedEntries();
                     return;
                 }
                 
@@ -270,10 +1235,22 @@ public:
                         entries = gcnew List<NotebookEntry<int>^>();
                     }
                     currentFilePath = filePath;
+                    RememberStorage(filePath, json);
+                    bool recovered = IsStoragePath(filePath) && RecoverJournal() > 0;
+                    OnEntriesReplaced("Load");
+                    if (recovered) {
+                        CheckpointAfterRecovery();
+                    }
+                    else if (!IsStoragePath(filePath)) {
+                        PublishReplacedEntries();
+                    }
                 }
                 catch (Exception^ jsonEx) {
                     // Если ошибка десериализации, создаем новый список
                     entries = gcnew List<NotebookEntry<int>^>();
+                    OnEntriesReplaced("Load");
+                    // Пустой список не публикуется: журнал только отключается
+                    if (journalOperations) journal = nullptr;
                     throw gcnew Exception("Error parsing JSON: " + jsonEx->Message);
                 }
             }
@@ -293,6 +1270,24 @@ public:
             SaveToJsonFile(filePath);
             return;
         }
+
+        // Сжатый по колонкам снимок
+        if (filePath->EndsWith(".nbz", StringComparison::OrdinalIgnoreCase)) {
+            try {
+                FileStream^ stream = gcnew FileStream(filePath, FileMode::Create, FileAccess::Write, FileShare::None, 1 << 16);
+                try {
+                    CompressedBook::Build(entries)->Save(stream);
+                    currentFilePath = filePath;
+                }
+                finally {
+                    stream->Close();
+                }
+            }
+            catch (Exception^ ex) {
+                throw gcnew Exception("Error saving file: " + ex->Message);
+            }
+            return;
+        }
         
         // Иначе используем старый текстовый формат
         try {
@@ -300,18 +1295,7 @@ public:
             try {
                 // Создаем writer с явным указанием кодировки UTF-8 с BOM
                 writer = gcnew StreamWriter(filePath, false, gcnew UTF8Encoding(true));
-                
-                for each (NotebookEntry<int>^ entry in entries) {
-                    writer->WriteLine("{0}\t{1}\t{2}\t{3}\t{4}\t{5}\t{6}\t{7}",
-                        entry->GetId(),
-                        entry->GetFirstName(),
-                        entry->GetLastName(),
-                        entry->GetPhoneNumber(),
-                        entry->GetBirthDate(),
-                        entry->GetEmail(),
-                        entry->GetAddress(),
-                        entry->GetNotes());
-                }
+                WriteTsv(entries, writer);
                 currentFilePath = filePath;
             }
             finally {
@@ -326,6 +1310,62 @@ public:
         }
     }
 
+    // Сохранение в поток: format - "json" или "tsv"
+    void SaveToStream(Stream^ stream, String^ format) {
+        SaveToStream(stream, format, true);
+    }
+
+    void SaveToStream(Stream^ stream, String^ format, bool indented) {
+        try {
+            WriteEntries(entries, stream, format, indented);
+        }
+        catch (Exception^ ex) {
+            throw gcnew Exception("Error saving to stream: " + ex->Message);
+        }
+    }
+
+    // Потоковая запись последовательности записей: source перебирается
+    // по одной записи, не собираясь в список
+    static void WriteEntries(IEnumerable<NotebookEntry<int>^>^ source, Stream^ stream, String^ format) {
+        WriteEntries(source, stream, format, true);
+    }
+
+    // indented влияет только на JSON
+    static void WriteEntries(IEnumerable<NotebookEntry<int>^>^ source, Stream^ stream, String^ format, bool indented) {
+        if (format->Equals("tsv", StringComparison::OrdinalIgnoreCase)) {
+            StreamWriter^ writer = gcnew StreamWriter(stream, gcnew UTF8Encoding(false), 1 << 16);
+            WriteTsv(source, writer);
+            writer->Flush();
+        }
+        else {
+            EntryJsonWriter::WriteAll(source, stream, indented, false);
+        }
+    }
+
+    // Загрузка из потока: format - "json" или "tsv"
+    void LoadFromStream(Stream^ stream, String^ format) {
+        try {
+            StreamReader^ reader = gcnew StreamReader(stream, Encoding::UTF8, true, 1 << 16);
+            List<NotebookEntry<int>^>^ loaded;
+            if (format->Equals("tsv", StringComparison::OrdinalIgnoreCase)) {
+                loaded = ReadTsv(reader);
+            }
+            else {
+                JsonSerializer^ serializer = gcnew JsonSerializer();
+                loaded = serializer->Deserialize<List<NotebookEntry<int>^>^>(gcnew JsonTextReader(reader));
+                if (loaded == nullptr) {
+                    loaded = gcnew List<NotebookEntry<int>^>();
+                }
+            }
+            entries = loaded;
+            OnEntriesReplaced("Load");
+            PublishReplacedEntries();
+        }
+        catch (Exception^ ex) {
+            throw gcnew Exception("Error loading from stream: " + ex->Message);
+        }
+    }
+
     // Загрузка из файла (для совместимости)
     void LoadFromFile(String^ filePath) {
         // Если файл имеет расширение .json, используем JSON формат
@@ -333,40 +1373,62 @@ public:
             LoadFromJsonFile(filePath);
             return;
         }
-        
-        // Иначе используем старый текстовый формат
-        try {
-            StreamReader^ reader = nullptr;
+
+        // Адресная книга vCard: карточки без имени, фамилии или телефона пропускаются
+        if (filePath->EndsWith(".vcf", StringComparison::OrdinalIgnoreCase)) {
+            VCardReader^ reader = nullptr;
             try {
-                entries->Clear();
-                // Открываем reader с автоопределением кодировки
-                reader = gcnew StreamReader(filePath, true);
-                
-                String^ line;
-                while ((line = reader->ReadLine()) != nullptr) {
-                    array<String^>^ parts = line->Split('\t');
-                    if (parts->Length >= 8) {
-                        NotebookEntry<int>^ entry = gcnew NotebookEntry<int>(
-                            Int32::Parse(parts[0]),
-                            parts[1],
-                            parts[2],
-                            parts[3],
-                            parts[4],
-                            parts[5],
-                            parts[6],
-                            parts[7]
-                        );
-                        entries->Add(entry);
-                    }
+                reader = VCardReader::Open(filePath);
+                reader->AssignIds(gcnew HashSet<int>(), 1);
+                List<NotebookEntry<int>^>^ loaded = gcnew List<NotebookEntry<int>^>();
+                NotebookEntry<int>^ entry;
+                while (reader->Read(entry)) {
+                    if (entry->IsValid()) loaded->Add(entry);
                 }
+                entries = loaded;
                 currentFilePath = filePath;
+                OnEntriesReplaced("Load");
+                PublishReplacedEntries();
+            }
+            catch (Exception^ ex) {
+                throw gcnew Exception("Error loading file: " + ex->Message);
             }
             finally {
-                if (reader != nullptr) {
-                    reader->Close();
-                    delete reader;
+                if (reader != nullptr) reader->Close();
+            }
+            return;
+        }
+
+        if (filePath->EndsWith(".nbz", StringComparison::OrdinalIgnoreCase)) {
+            try {
+                FileStream^ stream = gcnew FileStream(filePath, FileMode::Open, FileAccess::Read, FileShare::Read, 1 << 16);
+                try {
+                    entries = CompressedBook::Load(stream)->ToList();
+                }
+                finally {
+                    stream->Close();
                 }
+                currentFilePath = filePath;
+                OnEntriesReplaced("Load");
+                PublishReplacedEntries();
+            }
+            catch (Exception^ ex) {
+                throw gcnew Exception("Error loading file: " + ex->Message);
             }
+            return;
+        }
+        
+        // Иначе используем старый текстовый формат
+        try {
+            // Файл разбирается параллельно по кускам; UTF-16 читаем по строкам
+            List<NotebookEntry<int>^>^ loaded = TsvChunkLoader::Load(filePath);
+            if (loaded == nullptr) {
+                loaded = LoadFromTextFileSequential(filePath);
+            }
+            entries = loaded;
+            currentFilePath = filePath;
+            OnEntriesReplaced("Load");
+            PublishReplacedEntries();
         }
         catch (Exception^ ex) {
             throw gcnew Exception("Error loading file: " + ex->Message);
@@ -424,47 +1486,42 @@ public:
                 worksheet->Name = "Contacts";
             }
             
-            // Заголовки колонок
-            array<String^>^ headers = {"ID", "First Name", "Last Name", "Phone", "Birth Date", "Email", "Address", "Notes"};
-            
             // Заголовок таблицы
-            for (int i = 0; i < headers->Length; i++) {
-                worksheet->Cells[1, i + 1] = headers[i];
-                
-                // Форматирование заголовка
-                Microsoft::Office::Interop::Excel::Range^ headerCell = 
-                    safe_cast<Microsoft::Office::Interop::Excel::Range^>(worksheet->Cells[1, i + 1]);
-                    
-                headerCell->Font->Bold = true;
-                headerCell->Interior->Color = System::Drawing::ColorTranslator::ToOle(System::Drawing::Color::LightGray);
-                headerCell->Borders->LineStyle = Microsoft::Office::Interop::Excel::XlLineStyle::xlContinuous;
-                headerCell->HorizontalAlignment = Microsoft::Office::Interop::Excel::XlHAlign::xlHAlignCenter;
+            int columns = EntrySchema::FieldCount;
+            for (int i = 0; i < columns; i++) {
+                worksheet->Cells[1, i + 1] = EntrySchema::GetHeader(i);
             }
+            Microsoft::Office::Interop::Excel::Range^ headerRange = worksheet->Range[
+                worksheet->Cells[1, 1],
+                worksheet->Cells[1, columns]];
+            headerRange->Font->Bold = true;
+            headerRange->Interior->Color = System::Drawing::ColorTranslator::ToOle(System::Drawing::Color::LightGray);
+            headerRange->Borders->LineStyle = Microsoft::Office::Interop::Excel::XlLineStyle::xlContinuous;
+            headerRange->HorizontalAlignment = Microsoft::Office::Interop::Excel::XlHAlign::xlHAlignCenter;
             
-            // Данные
-            int row = 2;
-            for each (NotebookEntry<int>^ entry in entries) {
-                worksheet->Cells[row, 1] = entry->GetId();
-                worksheet->Cells[row, 2] = entry->GetFirstName();
-                worksheet->Cells[row, 3] = entry->GetLastName();
-                
-                // Установим формат ячейки с телефоном как текстовый перед вставкой данных
-                Microsoft::Office::Interop::Excel::Range^ phoneCell = safe_cast<Microsoft::Office::Interop::Excel::Range^>(worksheet->Cells[row, 4]);
-                phoneCell->NumberFormat = "@"; // Установка текстового формата
-                phoneCell->Value2 = entry->GetPhoneNumber(); // Используем Value2 вместо простого присваивания
-                
-                worksheet->Cells[row, 5] = entry->GetBirthDate();
-                worksheet->Cells[row, 6] = entry->GetEmail();
-                worksheet->Cells[row, 7] = entry->GetAddress();
-                worksheet->Cells[row, 8] = entry->GetNotes();
-                
-                // Добавляем границы ячеек с данными
+            // Данные записываются одним диапазоном, а не по ячейке: каждое
+            // обращение к ячейке - отдельный межпроцессный вызов COM
+            if (entries->Count > 0) {
+                array<Object^, 2>^ cells = gcnew array<Object^, 2>(entries->Count, columns);
+                for (int row = 0; row < entries->Count; row++) {
+                    EntrySchema::FillCells(cells, row, entries[row]);
+                }
                 Microsoft::Office::Interop::Excel::Range^ dataRange = worksheet->Range[
-                    worksheet->Cells[row, 1], 
-                    worksheet->Cells[row, headers->Length]];
-                dataRange->Borders->LineStyle = Microsoft::Office::Interop::Excel::XlLineStyle::xlContinuous;
+                    worksheet->Cells[2, 1],
+                    worksheet->Cells[entries->Count + 1, columns]];
                 
-                row++;
+                // Текстовые колонки - в текстовом формате до вставки данных,
+                // чтобы телефоны не превращались в числа
+                for (int i = 0; i < columns; i++) {
+                    if (EntrySchema::IsTextColumn(i)) {
+                        Microsoft::Office::Interop::Excel::Range^ column = worksheet->Range[
+                            worksheet->Cells[2, i + 1],
+                            worksheet->Cells[entries->Count + 1, i + 1]];
+                        column->NumberFormat = "@";
+                    }
+                }
+                dataRange->Value2 = cells;
+                dataRange->Borders->LineStyle = Microsoft::Office::Interop::Excel::XlLineStyle::xlContinuous;
             }
             
             // Автоподбор ширины колонок
@@ -0,0 +1,451 @@
+#pragma once
+#include "../utils/EntryStream.h"
+#include "../utils/RecordHasher.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Globalization;
+using namespace System::IO;
+using namespace System::Text;
+
+// Как разрешать записи, которые различаются в двух файлах
+public enum class MergePolicy {
+    PreferIncoming,     // изменения и конфликты берутся из входящего файла
+    PreferMaster,       // основной файл не меняется, новые записи добавляются
+    KeepBoth            // изменения - из входящего, при конфликте остаются обе записи
+};
+
+// Итоги слияния
+public ref class MergeReport {
+public:
+    long long unchanged;
+    long long added;
+    long long removed;
+    long long changed;
+    long long conflicts;
+    long long written;
+    int partitions;
+
+    String^ ToJson() {
+        return String::Format(CultureInfo::InvariantCulture,
+            "{{\"unchanged\":{0},\"added\":{1},\"removed\":{2},\"changed\":{3},\"conflicts\":{4},\"written\":{5},\"partitions\":{6}}}",
+            unchanged, added, removed, changed, conflicts, written, partitions);
+    }
+};
+
+// Слияние основного файла книги с входящим (например, от выездной команды).
+// Записи сопоставляются по ID, содержимое сравнивается по хешу:
+//   только во входящем       - added (добавляется);
+//   только в основном        - removed (остается, если не задано dropRemoved);
+//   хеши совпали             - без изменений;
+//   тот же человек (имя и фамилия совпадают без учета регистра) - changed;
+//   под тем же ID другой человек - conflict.
+// Если оба файла не помещаются в бюджет памяти, они разбиваются по ID на
+// части во временных файлах, и каждая часть сливается отдельно. Записи
+// несут номер в исходном файле, а результаты частей сливаются по нему,
+// поэтому порядок вывода тот же, что и без разбиения: порядок основного
+// файла, затем новые записи в порядке входящего.
+public ref class NotebookMerger {
+private:
+    // Запись в памяти занимает примерно втрое больше, чем в файле
+    literal int MemoryPerFileByte = 3;
+    literal int MaxPartitions = 256;
+
+    // Запись и ее номер: в основном файле - позиция, во входящем - число
+    // записей основного плюс позиция (новые записи идут после основных)
+    ref class Record {
+    public:
+        NotebookEntry<int>^ entry;
+        unsigned long long hash;
+        long long sequence;
+        Record(NotebookEntry<int>^ entry, long long sequence)
+            : entry(entry), hash(RecordHasher::Hash(entry)), sequence(sequence) {}
+    };
+
+    // Последовательное чтение результата одной части при слиянии по номерам
+    ref class PartReader {
+    private:
+        BinaryReader^ reader;
+    public:
+        NotebookEntry<int>^ current;
+        long long sequence;
+
+        PartReader(String^ path) {
+            reader = gcnew BinaryReader(gcnew BufferedStream(File::OpenRead(path), 1 << 16), Encoding::UTF8);
+            Next();
+        }
+
+        bool Next() {
+            if (reader->BaseStream->Position >= reader->BaseStream->Length) {
+                current = nullptr;
+                return false;
+            }
+            current = ReadEntry(reader, sequence);
+            return true;
+        }
+
+        void Close() {
+            reader->Close();
+        }
+    };
+
+    MergePolicy policy;
+    bool dropRemoved;
+    long long memoryBudget;
+    MergeReport^ report;
+    EntryStreamWriter^ output;
+    // Результат текущей части при разбиении; nullptr - запись прямо в output
+    BinaryWriter^ partOutput;
+    TextWriter^ diff;
+    int nextId;
+
+    static List<Record^>^ ReadAll(String^ path, long long firstSequence, int% maxId) {
+        List<Record^>^ records = gcnew List<Record^>();
+        EntryStreamReader^ reader = EntryStreamReader::Open(path);
+        try {
+            NotebookEntry<int>^ entry;
+            while (reader->Read(entry)) {
+                records->Add(gcnew Record(entry, firstSequence + records->Count));
+                maxId = Math::Max(maxId, entry->GetId());
+            }
+        }
+        finally {
+            reader->Close();
+        }
+        return records;
+    }
+
+    static void WriteEntry(BinaryWriter^ writer, long long sequence, NotebookEntry<int>^ entry) {
+        writer->Write(sequence);
+        writer->Write(entry->GetId());
+        writer->Write(entry->GetFirstName() == nullptr ? "" : entry->GetFirstName());
+        writer->Write(entry->GetLastName() == nullptr ? "" : entry->GetLastName());
+        writer->Write(entry->GetPhoneNumber() == nullptr ? "" : entry->GetPhoneNumber());
+        writer->Write(entry->GetBirthDate() == nullptr ? "" : entry->GetBirthDate());
+        writer->Write(entry->GetEmail() == nullptr ? "" : entry->GetEmail());
+        writer->Write(entry->GetAddress() == nullptr ? "" : entry->GetAddress());
+        writer->Write(entry->GetNotes() == nullptr ? "" : entry->GetNotes());
+        array<String^>^ tags = entry->GetTags();
+        writer->Write(tags == nullptr ? 0 : tags->Length);
+        if (tags != nullptr) {
+            for each (String^ tag in tags) writer->Write(tag);
+        }
+    }
+
+    static NotebookEntry<int>^ ReadEntry(BinaryReader^ reader, long long% sequence) {
+        sequence = reader->ReadInt64();
+        int id = reader->ReadInt32();
+        String^ firstName = reader->ReadString();
+        String^ lastName = reader->ReadString();
+        String^ phoneNumber = reader->ReadString();
+        String^ birthDate = reader->ReadString();
+        String^ email = reader->ReadString();
+        String^ address = reader->ReadString();
+        String^ notes = reader->ReadString();
+        array<String^>^ tags = gcnew array<String^>(reader->ReadInt32());
+        for (int t = 0; t < tags->Length; t++) tags[t] = reader->ReadString();
+        NotebookEntry<int>^ entry = gcnew NotebookEntry<int>(id, firstName, lastName, phoneNumber, birthDate, email, address, notes);
+        entry->SetTags(tags);
+        return entry;
+    }
+
+    // Раскладка файла по частям: номер части - остаток от деления ID.
+    // Возвращает число записей файла
+    static long long Spill(String^ path, array<String^>^ partitionPaths, long long firstSequence, int% maxId) {
+        array<BinaryWriter^>^ writers = gcnew array<BinaryWriter^>(partitionPaths->Length);
+        EntryStreamReader^ reader = EntryStreamReader::Open(path);
+        try {
+            for (int p = 0; p < writers->Length; p++) {
+                writers[p] = gcnew BinaryWriter(gcnew BufferedStream(File::Create(partitionPaths[p]), 1 << 16), Encoding::UTF8);
+            }
+            NotebookEntry<int>^ entry;
+            long long count = 0;
+            while (reader->Read(entry)) {
+                maxId = Math::Max(maxId, entry->GetId());
+                BinaryWriter^ writer = writers[(int)((unsigned int)entry->GetId() % (unsigned int)writers->Length)];
+                WriteEntry(writer, firstSequence + count++, entry);
+            }
+            return count;
+        }
+        finally {
+            reader->Close();
+            for each (BinaryWriter^ writer in writers) {
+                if (writer != nullptr) writer->Close();
+            }
+        }
+    }
+
+    static List<Record^>^ ReadPartition(String^ path) {
+        List<Record^>^ records = gcnew List<Record^>();
+        BinaryReader^ reader = gcnew BinaryReader(gcnew BufferedStream(File::OpenRead(path), 1 << 16), Encoding::UTF8);
+        try {
+            while (reader->BaseStream->Position < reader->BaseStream->Length) {
+                long long sequence;
+                NotebookEntry<int>^ entry = ReadEntry(reader, sequence);
+                records->Add(gcnew Record(entry, sequence));
+            }
+        }
+        finally {
+            reader->Close();
+        }
+        return records;
+    }
+
+    static bool SamePerson(NotebookEntry<int>^ a, NotebookEntry<int>^ b) {
+        return String::Equals(a->GetFirstName(), b->GetFirstName(), StringComparison::OrdinalIgnoreCase) &&
+               String::Equals(a->GetLastName(), b->GetLastName(), StringComparison::OrdinalIgnoreCase);
+    }
+
+    static String^ ChangedFields(NotebookEntry<int>^ a, NotebookEntry<int>^ b) {
+        List<String^>^ fields = gcnew List<String^>();
+        if (!String::Equals(a->GetFirstName(), b->GetFirstName())) fields->Add("firstName");
+        if (!String::Equals(a->GetLastName(), b->GetLastName())) fields->Add("lastName");
+        if (!String::Equals(a->GetPhoneNumber(), b->GetPhoneNumber())) fields->Add("phoneNumber");
+        if (!String::Equals(a->GetBirthDate(), b->GetBirthDate())) fields->Add("birthDate");
+        if (!String::Equals(a->GetEmail(), b->GetEmail())) fields->Add("email");
+        if (!String::Equals(a->GetAddress(), b->GetAddress())) fields->Add("address");
+        if (!String::Equals(a->GetNotes(), b->GetNotes())) fields->Add("notes");
+        array<String^>^ tagsA = a->GetTags();
+        array<String^>^ tagsB = b->GetTags();
+        if (!String::Equals(tagsA == nullptr ? nullptr : String::Join(",", tagsA),
+                            tagsB == nullptr ? nullptr : String::Join(",", tagsB))) fields->Add("tags");
+        return String::Join(",", fields);
+    }
+
+    // Строка отчета: status, id, resolution, fields, master, incoming
+    void Report(String^ status, int id, String^ resolution, String^ fields,
+                NotebookEntry<int>^ master, NotebookEntry<int>^ incoming) {
+        if (diff == nullptr) return;
+        diff->WriteLine("{0}\t{1}\t{2}\t{3}\t{4}\t{5}", status, id, resolution, fields,
+            master == nullptr ? "" : master->GetFullName(),
+            incoming == nullptr ? "" : incoming->GetFullName());
+    }
+
+    void Emit(long long sequence, NotebookEntry<int>^ entry) {
+        if (partOutput != nullptr) WriteEntry(partOutput, sequence, entry);
+        else output->Write(entry);
+        report->written++;
+    }
+
+    // Слияние одной части: все записи с этими ID есть только в ней.
+    // Порядок вывода - порядок основного файла, затем новые записи.
+    void MergePartition(List<Record^>^ master, List<Record^>^ incoming) {
+        Dictionary<int, int>^ masterIndex = gcnew Dictionary<int, int>(master->Count);
+        for (int i = 0; i < master->Count; i++) {
+            int id = master[i]->entry->GetId();
+            if (!masterIndex->ContainsKey(id)) masterIndex[id] = i;
+        }
+        array<NotebookEntry<int>^>^ resolved = gcnew array<NotebookEntry<int>^>(master->Count);
+        array<bool>^ matched = gcnew array<bool>(master->Count);
+        for (int i = 0; i < master->Count; i++) {
+            resolved[i] = master[i]->entry;
+        }
+        List<Record^>^ appended = gcnew List<Record^>();
+
+        for each (Record^ record in incoming) {
+            NotebookEntry<int>^ entry = record->entry;
+            int index;
+            if (!masterIndex->TryGetValue(entry->GetId(), index)) {
+                report->added++;
+                appended->Add(record);
+                Report("added", entry->GetId(), "added", "", nullptr, entry);
+                continue;
+            }
+            if (matched[index]) {
+                // Повтор ID во входящем файле: запись добавляется под новым ID
+                report->added++;
+                entry->SetId(nextId++);
+                appended->Add(record);
+                Report("added", entry->GetId(), "renumbered", "", nullptr, entry);
+                continue;
+            }
+            matched[index] = true;
+            Record^ original = master[index];
+            if (original->hash == record->hash) {
+                report->unchanged++;
+                continue;
+            }
+
+            String^ fields = ChangedFields(original->entry, entry);
+            if (SamePerson(original->entry, entry)) {
+                report->changed++;
+                bool takeMaster = policy == MergePolicy::PreferMaster;
+                if (!takeMaster) resolved[index] = entry;
+                Report("changed", entry->GetId(), takeMaster ? "master" : "incoming", fields, original->entry, entry);
+                continue;
+            }
+
+            report->conflicts++;
+            switch (policy) {
+                case MergePolicy::PreferMaster:
+                    Report("conflict", entry->GetId(), "master", fields, original->entry, entry);
+                    break;
+                case MergePolicy::PreferIncoming:
+                    resolved[index] = entry;
+                    Report("conflict", entry->GetId(), "incoming", fields, original->entry, entry);
+                    break;
+                default:
+                    entry->SetId(nextId++);
+                    appended->Add(record);
+                    Report("conflict", original->entry->GetId(), "both:" + entry->GetId(), fields, original->entry, entry);
+                    break;
+            }
+        }
+
+        for (int i = 0; i < master->Count; i++) {
+            if (!matched[i]) {
+                report->removed++;
+                Report("removed", master[i]->entry->GetId(), dropRemoved ? "dropped" : "kept", "", master[i]->entry, nullptr);
+                if (dropRemoved) resolved[i] = nullptr;
+            }
+        }
+
+        for (int i = 0; i < resolved->Length; i++) {
+            if (resolved[i] != nullptr) Emit(master[i]->sequence, resolved[i]);
+        }
+        for each (Record^ record in appended) {
+            Emit(record->sequence, record->entry);
+        }
+    }
+
+    // Результаты частей (каждая - по возрастанию номеров) в output
+    // в порядке номеров записей
+    void MergeParts(array<String^>^ resultParts) {
+        List<PartReader^>^ readers = gcnew List<PartReader^>(resultParts->Length);
+        try {
+            // Куча по текущим записям частей: в вершине - наименьший номер
+            array<PartReader^>^ heap = gcnew array<PartReader^>(resultParts->Length);
+            int size = 0;
+            for each (String^ part in resultParts) {
+                PartReader^ reader = gcnew PartReader(part);
+                readers->Add(reader);
+                if (reader->current == nullptr) continue;
+                heap[size] = reader;
+                SiftUp(heap, size++);
+            }
+            while (size > 0) {
+                PartReader^ top = heap[0];
+                output->Write(top->current);
+                if (!top->Next()) {
+                    heap[0] = heap[--size];
+                    heap[size] = nullptr;
+                }
+                if (size > 0) SiftDown(heap, size);
+            }
+        }
+        finally {
+            for each (PartReader^ reader in readers) {
+                reader->Close();
+            }
+        }
+    }
+
+    static void SiftUp(array<PartReader^>^ heap, int i) {
+        while (i > 0) {
+            int up = (i - 1) / 2;
+            if (heap[i]->sequence >= heap[up]->sequence) break;
+            PartReader^ swap = heap[i];
+            heap[i] = heap[up];
+            heap[up] = swap;
+            i = up;
+        }
+    }
+
+    static void SiftDown(array<PartReader^>^ heap, int size) {
+        int i = 0;
+        while (true) {
+            int left = 2 * i + 1;
+            int right = left + 1;
+            int first = i;
+            if (left < size && heap[left]->sequence < heap[first]->sequence) first = left;
+            if (right < size && heap[right]->sequence < heap[first]->sequence) first = right;
+            if (first == i) break;
+            PartReader^ swap = heap[i];
+            heap[i] = heap[first];
+            heap[first] = swap;
+            i = first;
+        }
+    }
+
+public:
+    literal long long DefaultMemoryBudgetBytes = 256LL * 1024 * 1024;
+
+    NotebookMerger(MergePolicy policy, bool dropRemoved, long long memoryBudgetBytes) {
+        this->policy = policy;
+        this->dropRemoved = dropRemoved;
+        this->memoryBudget = Math::Max(1LL << 20, memoryBudgetBytes);
+    }
+
+    static MergePolicy ParsePolicy(String^ name) {
+        String^ lowered = name->ToLower();
+        if (lowered == "incoming") return MergePolicy::PreferIncoming;
+        if (lowered == "master") return MergePolicy::PreferMaster;
+        if (lowered == "keep-both") return MergePolicy::KeepBoth;
+        throw gcnew ArgumentException("Unknown merge policy: " + name);
+    }
+
+    // Слияние masterPath и incomingPath в outputPath; отчет о различиях
+    // (TSV) пишется в reportPath, если он задан. Формат файлов - по расширению.
+    MergeReport^ Merge(String^ masterPath, String^ incomingPath, String^ outputPath, String^ reportPath) {
+        report = gcnew MergeReport();
+        long long inputBytes = (gcnew FileInfo(masterPath))->Length + (gcnew FileInfo(incomingPath))->Length;
+        report->partitions = (int)Math::Min((long long)MaxPartitions,
+            Math::Max(1LL, (inputBytes * MemoryPerFileByte + memoryBudget - 1) / memoryBudget));
+
+        output = EntryStreamWriter::Create(outputPath);
+        diff = reportPath == nullptr ? nullptr : gcnew StreamWriter(reportPath, false, gcnew UTF8Encoding(false), 1 << 16);
+        array<String^>^ masterParts = nullptr;
+        array<String^>^ incomingParts = nullptr;
+        array<String^>^ resultParts = nullptr;
+        try {
+            if (diff != nullptr) {
+                diff->WriteLine("status\tid\tresolution\tfields\tmaster\tincoming");
+            }
+            int maxId = 0;
+            if (report->partitions == 1) {
+                List<Record^>^ master = ReadAll(masterPath, 0, maxId);
+                List<Record^>^ incoming = ReadAll(incomingPath, master->Count, maxId);
+                nextId = maxId + 1;
+                MergePartition(master, incoming);
+            }
+            else {
+                String^ prefix = Path::Combine(Path::GetTempPath(), "nbmerge-" + Guid::NewGuid().ToString("N"));
+                masterParts = gcnew array<String^>(report->partitions);
+                incomingParts = gcnew array<String^>(report->partitions);
+                resultParts = gcnew array<String^>(report->partitions);
+                for (int p = 0; p < report->partitions; p++) {
+                    masterParts[p] = prefix + "-m" + p + ".tmp";
+                    incomingParts[p] = prefix + "-i" + p + ".tmp";
+                    resultParts[p] = prefix + "-r" + p + ".tmp";
+                }
+                long long masterCount = Spill(masterPath, masterParts, 0, maxId);
+                Spill(incomingPath, incomingParts, masterCount, maxId);
+                nextId = maxId + 1;
+                for (int p = 0; p < report->partitions; p++) {
+                    partOutput = gcnew BinaryWriter(gcnew BufferedStream(File::Create(resultParts[p]), 1 << 16), Encoding::UTF8);
+                    try {
+                        MergePartition(ReadPartition(masterParts[p]), ReadPartition(incomingParts[p]));
+                    }
+                    finally {
+                        partOutput->Close();
+                        partOutput = nullptr;
+                    }
+                    File::Delete(masterParts[p]);
+                    File::Delete(incomingParts[p]);
+                }
+                MergeParts(resultParts);
+            }
+        }
+        finally {
+            output->Close();
+            if (diff != nullptr) diff->Close();
+            for each (array<String^>^ parts in gcnew array<array<String^>^> { masterParts, incomingParts, resultParts }) {
+                if (parts == nullptr) continue;
+                for each (String^ part in parts) {
+                    if (File::Exists(part)) File::Delete(part);
+                }
+            }
+        }
+        return report;
+    }
+};
@@ -0,0 +1,362 @@
+#pragma once
+#include "NotebookManager.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::IO;
+using namespace System::Threading;
+using namespace System::Threading::Tasks;
+
+// Рабочее пространство из нескольких записных книжек (шардов).
+// Каждая книга хранится в своем JSON файле, загружается при первом
+// обращении и сохраняется независимо от остальных (через автосохранение
+// NotebookManager). Число книг в памяти ограничено LRU: самые давно
+// использованные книги выгружаются. Книга, выданная AcquireShard, не
+// выгружается до парного ReleaseShard - иначе следующее обращение
+// создало бы второй менеджер над тем же файлом.
+public ref class NotebookWorkspace {
+private:
+    // Описание одной книги рабочего пространства. Поля lruNode, pins и
+    // manager меняются под syncRoot; загрузка файла - под блокировкой шарда
+    ref class Shard {
+    public:
+        String^ name;
+        String^ filePath;
+        NotebookManager^ manager;           // nullptr, пока книга не загружена
+        LinkedListNode<Shard^>^ lruNode;    // узел в списке LRU, если книга загружена
+        int pins;                           // число выданных и не возвращенных менеджеров
+
+        Shard(String^ name, String^ filePath) : name(name), filePath(filePath), pins(0) {}
+    };
+
+    // Задача поиска по одной книге для параллельного обхода
+    ref class ShardSearch {
+    private:
+        NotebookWorkspace^ workspace;
+        array<Shard^>^ targets;
+        String^ query;
+        int searchType;
+    public:
+        array<List<NotebookEntry<int>^>^>^ results;
+
+        ShardSearch(NotebookWorkspace^ workspace, array<Shard^>^ targets, String^ query, int searchType)
+            : workspace(workspace), targets(targets), query(query), searchType(searchType) {
+            results = gcnew array<List<NotebookEntry<int>^>^>(targets->Length);
+        }
+
+        void Run(int index) {
+            NotebookManager^ manager = workspace->Acquire(targets[index]);
+            try {
+                results[index] = manager->SearchByAnyField(query, searchType);
+            }
+            finally {
+                workspace->Release(targets[index]);
+            }
+        }
+    };
+
+    Dictionary<String^, Shard^>^ shards;
+    List<Shard^>^ shardOrder;               // порядок открытия - порядок слияния результатов
+    LinkedList<Shard^>^ lru;                // в начале - последние использованные
+    Object^ syncRoot;
+    int maxResidentShards;
+    int maxResidentEntries;                 // 0 - без ограничения по числу записей
+
+    // Выдача книги (с ленивой загрузкой): книга закрепляется до Release
+    NotebookManager^ Acquire(Shard^ shard) {
+        Monitor::Enter(syncRoot);
+        try {
+            Shard^ current;
+            if (!shards->TryGetValue(shard->name, current) || current != shard) {
+                throw gcnew Exception("Notebook not found in workspace: " + shard->name);
+            }
+            shard->pins++;
+            if (shard->lruNode != nullptr) {
+                lru->Remove(shard->lruNode);
+            }
+            shard->lruNode = lru->AddFirst(shard);
+        }
+        finally {
+            Monitor::Exit(syncRoot);
+        }
+
+        NotebookManager^ manager;
+        try {
+            // Закрепленную книгу никто не выгрузит, поэтому загрузку под
+            // блокировкой шарда можно вести без syncRoot
+            Monitor::Enter(shard);
+            try {
+                manager = shard->manager;
+                if (manager == nullptr) {
+                    manager = gcnew NotebookManager(shard->filePath);
+                    Monitor::Enter(syncRoot);
+                    try {
+                        shard->manager = manager;
+                    }
+                    finally {
+                        Monitor::Exit(syncRoot);
+                    }
+                }
+            }
+            finally {
+                Monitor::Exit(shard);
+            }
+        }
+        catch (Exception^) {
+            Release(shard);
+            throw;
+        }
+
+        EvictCold();
+        return manager;
+    }
+
+    // Возврат книги, выданной Acquire
+    void Release(Shard^ shard) {
+        Monitor::Enter(syncRoot);
+        try {
+            if (shard->pins > 0) {
+                shard->pins--;
+            }
+        }
+        finally {
+            Monitor::Exit(syncRoot);
+        }
+        EvictCold();
+    }
+
+    // Выгрузка давно использованных книг, пока не уложимся в лимиты;
+    // закрепленные книги пропускаются. Изменения уже сохранены
+    // автосохранением менеджера, поэтому ссылку достаточно отпустить
+    void EvictCold() {
+        Monitor::Enter(syncRoot);
+        try {
+            int residentEntries = 0;
+            if (maxResidentEntries > 0) {
+                for each (Shard^ resident in lru) {
+                    NotebookManager^ manager = resident->manager;
+                    if (manager != nullptr) {
+                        residentEntries += manager->GetCount();
+                    }
+                }
+            }
+            LinkedListNode<Shard^>^ node = lru->Last;
+            while (node != nullptr &&
+                   (lru->Count > maxResidentShards ||
+                    (maxResidentEntries > 0 && residentEntries > maxResidentEntries))) {
+                LinkedListNode<Shard^>^ previous = node->Previous;
+                Shard^ victim = node->Value;
+                if (victim->pins == 0) {
+                    lru->Remove(node);
+                    victim->lruNode = nullptr;
+                    if (victim->manager != nullptr) {
+                        residentEntries -= victim->manager->GetCount();
+                        victim->manager = nullptr;
+                    }
+                }
+                node = previous;
+            }
+        }
+        finally {
+            Monitor::Exit(syncRoot);
+        }
+    }
+
+    Shard^ FindShard(String^ name) {
+        Shard^ shard;
+        Monitor::Enter(syncRoot);
+        try {
+            if (!shards->TryGetValue(name, shard)) {
+                throw gcnew Exception("Notebook not found in workspace: " + name);
+            }
+        }
+        finally {
+            Monitor::Exit(syncRoot);
+        }
+        return shard;
+    }
+
+public:
+    // Конструктор
+    NotebookWorkspace(int maxResidentShards) {
+        shards = gcnew Dictionary<String^, Shard^>(StringComparer::OrdinalIgnoreCase);
+        shardOrder = gcnew List<Shard^>();
+        lru = gcnew LinkedList<Shard^>();
+        syncRoot = gcnew Object();
+        this->maxResidentShards = Math::Max(1, maxResidentShards);
+        this->maxResidentEntries = 0;
+    }
+
+    // Ограничение суммарного числа записей в загруженных книгах
+    void SetMaxResidentEntries(int value) {
+        maxResidentEntries = Math::Max(0, value);
+    }
+
+    // Регистрация книги; файл читается только при первом обращении
+    void OpenShard(String^ name, String^ filePath) {
+        Monitor::Enter(syncRoot);
+        try {
+            if (shards->ContainsKey(name)) {
+                throw gcnew Exception("Notebook already opened in workspace: " + name);
+            }
+            Shard^ shard = gcnew Shard(name, Path::GetFullPath(filePath));
+            shards->Add(name, shard);
+            shardOrder->Add(shard);
+        }
+        finally {
+            Monitor::Exit(syncRoot);
+        }
+    }
+
+    // Регистрация всех JSON книг каталога; имя книги - имя файла без расширения
+    void OpenDirectory(String^ directoryPath) {
+        try {
+            array<String^>^ files = Directory::GetFiles(directoryPath, "*.json");
+            Array::Sort(files, StringComparer::OrdinalIgnoreCase);
+            for each (String^ file in files) {
+                OpenShard(Path::GetFileNameWithoutExtension(file), file);
+            }
+        }
+        catch (Exception^ ex) {
+            throw gcnew Exception("Error opening workspace: " + ex->Message);
+        }
+    }
+
+    // Закрытие книги; выданную и не возвращенную книгу закрыть нельзя
+    bool CloseShard(String^ name) {
+        Shard^ shard;
+        Monitor::Enter(syncRoot);
+        try {
+            if (!shards->TryGetValue(name, shard)) {
+                return false;
+            }
+            if (shard->pins > 0) {
+                throw gcnew InvalidOperationException("Notebook is in use: " + name);
+            }
+            shards->Remove(name);
+            shardOrder->Remove(shard);
+            if (shard->lruNode != nullptr) {
+                lru->Remove(shard->lruNode);
+                shard->lruNode = nullptr;
+            }
+            shard->manager = nullptr;
+        }
+        finally {
+            Monitor::Exit(syncRoot);
+        }
+        return true;
+    }
+
+    // Получение книги по имени (загружается при необходимости). Книга
+    // не выгружается, пока ее не вернут через ReleaseShard
+    NotebookManager^ AcquireShard(String^ name) {
+        return Acquire(FindShard(name));
+    }
+
+    void ReleaseShard(String^ name) {
+        Release(FindShard(name));
+    }
+
+    // Имена книг в порядке открытия
+    List<String^>^ GetShardNames() {
+        List<String^>^ names = gcnew List<String^>();
+        Monitor::Enter(syncRoot);
+        try {
+            for each (Shard^ shard in shardOrder) {
+                names->Add(shard->name);
+            }
+        }
+        finally {
+            Monitor::Exit(syncRoot);
+        }
+        return names;
+    }
+
+    // Загружена ли книга в память
+    bool IsLoaded(String^ name) {
+        Shard^ shard = FindShard(name);
+        Monitor::Enter(syncRoot);
+        try {
+            return shard->manager != nullptr;
+        }
+        finally {
+            Monitor::Exit(syncRoot);
+        }
+    }
+
+    // Число книг в памяти
+    int GetResidentShardCount() {
+        Monitor::Enter(syncRoot);
+        try {
+            return lru->Count;
+        }
+        finally {
+            Monitor::Exit(syncRoot);
+        }
+    }
+
+    // Сохранение всех загруженных книг; на время записи книги закреплены
+    void FlushAll() {
+        List<Shard^>^ targets = gcnew List<Shard^>();
+        Monitor::Enter(syncRoot);
+        try {
+            for each (Shard^ shard in shardOrder) {
+                if (shard->manager != nullptr) {
+                    shard->pins++;
+                    targets->Add(shard);
+                }
+            }
+        }
+        finally {
+            Monitor::Exit(syncRoot);
+        }
+        for each (Shard^ shard in targets) {
+            try {
+                Monitor::Enter(shard);
+                try {
+                    shard->manager->SaveToJsonFile(shard->filePath);
+                }
+                finally {
+                    Monitor::Exit(shard);
+                }
+            }
+            finally {
+                Release(shard);
+            }
+        }
+    }
+
+    // Поиск по всем книгам: параллельный обход и слияние в порядке книг.
+    // Степень параллелизма не превышает лимит LRU, чтобы поиск не выталкивал
+    // только что загруженные книги, по которым он еще идет
+    List<NotebookEntry<int>^>^ SearchAll(String^ query, int searchType) {
+        array<Shard^>^ targets;
+        Monitor::Enter(syncRoot);
+        try {
+            targets = shardOrder->ToArray();
+        }
+        finally {
+            Monitor::Exit(syncRoot);
+        }
+
+        ShardSearch^ search = gcnew ShardSearch(this, targets, query, searchType);
+        ParallelOptions^ options = gcnew ParallelOptions();
+        options->MaxDegreeOfParallelism = Math::Max(1, Math::Min(maxResidentShards, Environment::ProcessorCount));
+        try {
+            Parallel::For(0, targets->Length, options, gcnew Action<int>(search, &ShardSearch::Run));
+        }
+        catch (AggregateException^ ex) {
+            throw gcnew Exception("Error searching workspace: " + ex->Flatten()->InnerExceptions[0]->Message);
+        }
+
+        int total = 0;
+        for each (List<NotebookEntry<int>^>^ partial in search->results) {
+            total += partial->Count;
+        }
+        List<NotebookEntry<int>^>^ merged = gcnew List<NotebookEntry<int>^>(total);
+        for each (List<NotebookEntry<int>^>^ partial in search->results) {
+            merged->AddRange(partial);
+        }
+        return merged;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,338 @@
+#pragma once
+#include "NotebookManager.h"
+#include "../storage/BPlusTree.h"
+#include "../storage/SlottedPage.h"
+#include "../utils/EntryStream.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::IO;
+
+// Записная книжка в страничном файле для книг, не помещающихся в память.
+// Записи лежат в страницах со слотами, индекс по ID - B+-дерево, в памяти
+// держится не больше страниц, чем позволяет буферный пул. Поиск, сортировка
+// и экспорт работают через курсоры, которые читают по одной записи.
+public ref class PagedNotebook {
+private:
+    literal int Magic = 0x4750424E;     // "NBPG"
+    literal int FormatVersion = 1;
+    literal int MagicOffset = PageLayout::HeaderSize;
+    literal int VersionOffset = PageLayout::HeaderSize + 4;
+    literal int RootOffset = PageLayout::HeaderSize + 8;
+    literal int RecordCountOffset = PageLayout::HeaderSize + 12;
+    literal int MaxIdOffset = PageLayout::HeaderSize + 16;
+    literal int InsertPageOffset = PageLayout::HeaderSize + 20;
+
+    PageFile^ file;
+    BufferPool^ pool;
+    BPlusTree^ index;
+    int count;
+    int maxId;
+    int insertPage;                     // страница данных, куда идут новые записи
+    int oversized;                      // записей, пропущенных импортом из-за размера
+    array<Byte>^ scratch;
+
+    static long long MakeAddress(int pageId, int slot) {
+        return ((long long)pageId << 16) | slot;
+    }
+
+    void WriteHeader() {
+        array<Byte>^ header = pool->Pin(0);
+        header[PageLayout::TypeOffset] = PageLayout::TypeHeader;
+        PageBytes::WriteInt32(header, MagicOffset, Magic);
+        PageBytes::WriteInt32(header, VersionOffset, FormatVersion);
+        PageBytes::WriteInt32(header, RootOffset, index->GetRootId());
+        PageBytes::WriteInt32(header, RecordCountOffset, count);
+        PageBytes::WriteInt32(header, MaxIdOffset, maxId);
+        PageBytes::WriteInt32(header, InsertPageOffset, insertPage);
+        pool->Unpin(0, true);
+    }
+
+    // Размещение закодированной записи на странице данных
+    long long Store(int length) {
+        if (insertPage != 0) {
+            array<Byte>^ page = pool->Pin(insertPage);
+            int slot = SlottedPage::Insert(page, scratch, length);
+            pool->Unpin(insertPage, slot >= 0);
+            if (slot >= 0) return MakeAddress(insertPage, slot);
+        }
+        int pageId;
+        array<Byte>^ page = pool->PinNew(pageId);
+        SlottedPage::Init(page);
+        int slot = SlottedPage::Insert(page, scratch, length);
+        pool->Unpin(pageId, true);
+        insertPage = pageId;
+        return MakeAddress(pageId, slot);
+    }
+
+    NotebookEntry<int>^ Load(long long address) {
+        int pageId = (int)(address >> 16);
+        int slot = (int)(address & 0xFFFF);
+        array<Byte>^ page = pool->Pin(pageId);
+        try {
+            int offset;
+            int length;
+            if (!SlottedPage::TryGetRecord(page, slot, offset, length)) {
+                throw gcnew InvalidDataException("Index points to an empty slot");
+            }
+            return RecordCodec::Decode(page, offset);
+        }
+        finally {
+            pool->Unpin(pageId, false);
+        }
+    }
+
+public:
+    // Перебор записей: по возрастанию ID (с фильтром поиска) или в заданном
+    // порядке ID (после сортировки). Записи читаются по одной через пул.
+    ref class Cursor : IEnumerable<NotebookEntry<int>^> {
+    private:
+        ref class Enumerator : IEnumerator<NotebookEntry<int>^> {
+        private:
+            Cursor^ owner;
+            BPlusTree::Cursor^ scan;
+            int position;
+            NotebookEntry<int>^ current;
+        public:
+            Enumerator(Cursor^ owner) : owner(owner) {
+                Reset();
+            }
+            ~Enumerator() {}
+
+            virtual bool MoveNext() {
+                if (owner->order != nullptr) {
+                    if (++position >= owner->order->Length) return false;
+                    int i = owner->descending ? owner->order->Length - 1 - position : position;
+                    current = owner->book->GetEntry(owner->order[i]);
+                    return true;
+                }
+                while (scan->MoveNext()) {
+                    NotebookEntry<int>^ entry = owner->book->Load(scan->GetAddress());
+                    if (owner->query == nullptr || NotebookManager::Matches(entry, owner->query, owner->searchType)) {
+                        current = entry;
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            virtual void Reset() {
+                position = -1;
+                scan = owner->order == nullptr ? owner->book->index->Seek(Int32::MinValue) : nullptr;
+            }
+
+            property NotebookEntry<int>^ Current {
+                virtual NotebookEntry<int>^ get() { return current; }
+            }
+
+            property Object^ CurrentObject {
+                virtual Object^ get() = System::Collections::IEnumerator::Current::get { return current; }
+            }
+        };
+
+        PagedNotebook^ book;
+        String^ query;
+        int searchType;
+        array<int>^ order;
+        bool descending;
+
+    public:
+        Cursor(PagedNotebook^ book, String^ query, int searchType)
+            : book(book), query(query == nullptr ? nullptr : query->ToLower()), searchType(searchType) {}
+
+        Cursor(PagedNotebook^ book, array<int>^ order, bool descending)
+            : book(book), order(order), descending(descending) {}
+
+        virtual IEnumerator<NotebookEntry<int>^>^ GetEnumerator() {
+            return gcnew Enumerator(this);
+        }
+
+        virtual System::Collections::IEnumerator^ GetEnumeratorObject() = System::Collections::IEnumerable::GetEnumerator {
+            return GetEnumerator();
+        }
+    };
+
+    // Открытие или создание книги; cacheBytes ограничивает буферный пул
+    PagedNotebook(String^ path, long long cacheBytes) {
+        file = gcnew PageFile(path);
+        pool = gcnew BufferPool(file, cacheBytes);
+        scratch = gcnew array<Byte>(PageFile::PageSize);
+
+        if (file->GetPageCount() == 0) {
+            int headerId;
+            pool->PinNew(headerId);
+            pool->Unpin(headerId, true);
+            index = BPlusTree::Create(pool);
+            WriteHeader();
+            return;
+        }
+
+        array<Byte>^ header = pool->Pin(0);
+        try {
+            if (PageBytes::ReadInt32(header, MagicOffset) != Magic ||
+                PageBytes::ReadInt32(header, VersionOffset) != FormatVersion) {
+                throw gcnew InvalidDataException("Not a paged notebook file: " + path);
+            }
+            index = gcnew BPlusTree(pool, PageBytes::ReadInt32(header, RootOffset));
+            count = PageBytes::ReadInt32(header, RecordCountOffset);
+            maxId = PageBytes::ReadInt32(header, MaxIdOffset);
+            insertPage = PageBytes::ReadInt32(header, InsertPageOffset);
+        }
+        finally {
+            pool->Unpin(0, false);
+        }
+    }
+
+    ~PagedNotebook() {
+        if (file != nullptr) {
+            Close();
+        }
+    }
+
+    int GetCount() {
+        return count;
+    }
+
+    int GetMaxId() {
+        return maxId;
+    }
+
+    BufferPool^ GetPool() {
+        return pool;
+    }
+
+    NotebookEntry<int>^ GetEntry(int id) {
+        long long address;
+        return index->TryGetValue(id, address) ? Load(address) : nullptr;
+    }
+
+    // Добавление записи с новым ID
+    void AddEntry(NotebookEntry<int>^ entry) {
+        if (!entry->IsValid()) {
+            throw gcnew Exception("Invalid entry: required fields must be filled");
+        }
+        long long existing;
+        if (index->TryGetValue(entry->GetId(), existing)) {
+            throw gcnew ArgumentException("Entry " + entry->GetId() + " already exists");
+        }
+        int length = RecordCodec::Encode(entry, scratch);
+        index->Set(entry->GetId(), Store(length));
+        count++;
+        maxId = Math::Max(maxId, entry->GetId());
+    }
+
+    // Изменение на месте: страница остается той же, если запись на ней
+    // помещается; иначе запись переносится и адрес в индексе обновляется
+    bool UpdateEntry(NotebookEntry<int>^ entry) {
+        long long address;
+        if (!index->TryGetValue(entry->GetId(), address)) return false;
+        int length = RecordCodec::Encode(entry, scratch);
+        int pageId = (int)(address >> 16);
+        int slot = (int)(address & 0xFFFF);
+        array<Byte>^ page = pool->Pin(pageId);
+        bool updated = SlottedPage::Update(page, slot, scratch, length);
+        if (!updated) {
+            SlottedPage::Delete(page, slot);
+        }
+        pool->Unpin(pageId, true);
+        if (!updated) {
+            index->Set(entry->GetId(), Store(length));
+        }
+        return true;
+    }
+
+    bool RemoveEntry(int id) {
+        long long address;
+        if (!index->TryGetValue(id, address)) return false;
+        int pageId = (int)(address >> 16);
+        array<Byte>^ page = pool->Pin(pageId);
+        SlottedPage::Delete(page, (int)(address & 0xFFFF));
+        pool->Unpin(pageId, true);
+        index->Remove(id);
+        count--;
+        return true;
+    }
+
+    // Все записи по возрастанию ID
+    Cursor^ GetAllEntries() {
+        return gcnew Cursor(this, (String^)nullptr, -1);
+    }
+
+    // Поиск с той же семантикой, что и NotebookManager::SearchByAnyField
+    Cursor^ SearchByAnyField(String^ query, int searchType) {
+        return gcnew Cursor(this, query, searchType);
+    }
+
+    // Порядок по ID: по возрастанию - прямой обход индекса, по убыванию -
+    // обход в обратном порядке по списку ID из листьев индекса
+    Cursor^ SortById(bool ascending) {
+        if (ascending) {
+            return GetAllEntries();
+        }
+        array<int>^ ids = gcnew array<int>(count);
+        BPlusTree::Cursor^ scan = index->Seek(Int32::MinValue);
+        for (int n = 0; n < count && scan->MoveNext(); n++) {
+            ids[n] = scan->GetKey();
+        }
+        return gcnew Cursor(this, ids, true);
+    }
+
+    // Порядок по имени или фамилии: в памяти только ключи сортировки и ID,
+    // сами записи читаются курсором при обходе
+    Cursor^ SortByName(bool byLastName, bool ascending) {
+        array<String^>^ keys = gcnew array<String^>(count);
+        array<int>^ ids = gcnew array<int>(count);
+        int n = 0;
+        for each (NotebookEntry<int>^ entry in GetAllEntries()) {
+            keys[n] = byLastName ? entry->GetLastName() : entry->GetFirstName();
+            ids[n] = entry->GetId();
+            n++;
+        }
+        Array::Sort(keys, ids, StringComparer::CurrentCulture);
+        return gcnew Cursor(this, ids, !ascending);
+    }
+
+    // Потоковая загрузка из JSON или TSV без сборки списка в памяти.
+    // Записи с уже занятым ID, без обязательных полей или не помещающиеся
+    // на страницу (например, с очень длинными заметками) пропускаются;
+    // последние считаются в GetOversizedCount.
+    int ImportFrom(TextReader^ reader, String^ format) {
+        EntryStreamReader^ source = gcnew EntryStreamReader(reader, format);
+        NotebookEntry<int>^ entry;
+        int added = 0;
+        while (source->Read(entry)) {
+            if (TryImport(entry)) added++;
+        }
+        return added;
+    }
+
+    bool TryImport(NotebookEntry<int>^ entry) {
+        long long existing;
+        if (entry == nullptr || !entry->IsValid() || index->TryGetValue(entry->GetId(), existing)) {
+            return false;
+        }
+        if (!RecordCodec::Fits(entry)) {
+            oversized++;
+            return false;
+        }
+        AddEntry(entry);
+        return true;
+    }
+
+    // Записей, пропущенных импортом с открытия книги: больше страницы
+    int GetOversizedCount() {
+        return oversized;
+    }
+
+    // Запись измененных страниц и заголовка на диск
+    void Flush() {
+        WriteHeader();
+        pool->FlushAll();
+    }
+
+    void Close() {
+        Flush();
+        file->Close();
+        file = nullptr;
+    }
+};
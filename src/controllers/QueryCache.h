@@ -0,0 +1,378 @@
+#pragma once
+#include "../models/NotebookEntry.h"
+#include "../models/NotebookChange.h"
+#include "../models/EntrySchema.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Threading;
+
+// Порядок строк в представлении; при равных ключах - по ID.
+// Book - порядок списка книги (без сортировки)
+public enum class EntryOrder {
+    Id,
+    FirstName,
+    LastName,
+    Book
+};
+
+// Кэш результатов запросов к книге: поиск, сортировка и выборки для
+// постраничного чтения и экспорта. Результат - номера записей в списке
+// книги (int на строку) в порядке представления; ключ - нормализованный
+// запрос (текст в нижнем регистре, номер поля, порядок) и версия книги.
+// Пакеты изменений менеджера правят результаты на месте: номера сдвигаются
+// вставками и удалениями, а вставленные и измененные записи проверяются
+// заново и встают на место двоичным слиянием. Полная замена списка,
+// перестановка без известной перестановки и слишком длинные пакеты
+// сбрасывают кэш. Вытеснение - по давности использования (LRU) в пределах
+// бюджета памяти.
+public ref class QueryCache {
+public:
+    literal long long DefaultBudgetBytes = 64LL * 1024 * 1024;
+    // Пакеты длиннее (например, удаление тысяч разрозненных записей) не
+    // правятся - дешевле пересчитать результат при следующем запросе
+    literal int MaxPatchedChanges = 16;
+
+private:
+    // Объект результата, узел LRU и элемент словаря
+    literal int ResultOverheadBytes = 96;
+
+    ref class Result {
+    public:
+        String^ key;
+        String^ search;
+        int searchType;
+        EntryOrder order;
+        bool descending;
+        long long version;
+        array<int>^ rows;
+        long long bytes;
+        LinkedListNode<Result^>^ node;
+    };
+
+    // Сравнение номеров записей по порядку представления: ключ, ID,
+    // при полном равенстве - номер в списке (сортировка устойчивая)
+    ref class PositionComparer : IComparer<int> {
+    private:
+        IList<NotebookEntry<int>^>^ entries;
+        EntryOrder order;
+        bool descending;
+    public:
+        PositionComparer(IList<NotebookEntry<int>^>^ entries, EntryOrder order, bool descending)
+            : entries(entries), order(order), descending(descending) {}
+
+        virtual int Compare(int x, int y) {
+            NotebookEntry<int>^ left = entries[x];
+            NotebookEntry<int>^ right = entries[y];
+            int result = 0;
+            switch (order) {
+                case EntryOrder::FirstName: result = FirstNameField::Compare(left, right); break;
+                case EntryOrder::LastName: result = LastNameField::Compare(left, right); break;
+                case EntryOrder::Book: return x.CompareTo(y);
+            }
+            if (result == 0) result = IdField::Compare(left, right);
+            if (descending) result = -result;
+            return result != 0 ? result : x.CompareTo(y);
+        }
+    };
+
+    Dictionary<String^, Result^>^ results;
+    LinkedList<Result^>^ lru;               // в начале - последние использованные
+    Object^ sync;
+    long long budgetBytes;
+    long long usedBytes;
+    long long hits;
+    long long misses;
+    long long patches;
+    long long invalidations;
+    long long evictions;
+
+    static String^ MakeKey(String^ search, int searchType, EntryOrder order, bool descending) {
+        return String::Format("{0}|{1}|{2}|{3}", (int)order, descending ? 1 : 0, searchType, search);
+    }
+
+    static long long ResultBytes(Result^ result) {
+        return ResultOverheadBytes + MemorySizes::StringBytes(result->key) + MemorySizes::StringBytes(result->search) +
+            MemorySizes::ObjectHeader + 8 + 4LL * result->rows->Length;
+    }
+
+    void Remove(Result^ result) {
+        results->Remove(result->key);
+        lru->Remove(result->node);
+        usedBytes -= result->bytes;
+    }
+
+    void Resize(Result^ result) {
+        usedBytes -= result->bytes;
+        result->bytes = ResultBytes(result);
+        usedBytes += result->bytes;
+    }
+
+    void Trim() {
+        while (usedBytes > budgetBytes && lru->Count > 0) {
+            Remove(lru->Last->Value);
+            evictions++;
+        }
+    }
+
+    static array<int>^ Compute(String^ search, int searchType, EntryOrder order, bool descending,
+                               IList<NotebookEntry<int>^>^ entries) {
+        List<int>^ found = EntrySchema::Find(searchType, entries, search);
+        array<int>^ rows;
+        if (found != nullptr) {
+            rows = found->ToArray();
+        }
+        else {
+            rows = gcnew array<int>(entries->Count);
+            for (int i = 0; i < rows->Length; i++) {
+                rows[i] = i;
+            }
+        }
+        if (order != EntryOrder::Book) {
+            Array::Sort<int>(rows, gcnew PositionComparer(entries, order, descending));
+        }
+        return rows;
+    }
+
+    // Изменение диапазона [index, index + removed), на месте которого
+    // оказалось inserted записей: номера внутри диапазона выбрасываются,
+    // номера после него сдвигаются. Порядок оставшихся не меняется
+    static void Move(List<int>^ positions, int index, int removed, int inserted) {
+        int write = 0;
+        for (int read = 0; read < positions->Count; read++) {
+            int position = positions[read];
+            if (position >= index + removed) {
+                position += inserted - removed;
+            }
+            else if (position >= index) {
+                continue;
+            }
+            positions[write++] = position;
+        }
+        positions->RemoveRange(write, positions->Count - write);
+    }
+
+    // Слияние двух упорядоченных последовательностей номеров
+    static array<int>^ Merge(List<int>^ rows, List<int>^ added, IComparer<int>^ comparer) {
+        array<int>^ merged = gcnew array<int>(rows->Count + added->Count);
+        int i = 0;
+        int j = 0;
+        int write = 0;
+        while (i < rows->Count && j < added->Count) {
+            merged[write++] = comparer->Compare(added[j], rows[i]) < 0 ? added[j++] : rows[i++];
+        }
+        while (i < rows->Count) merged[write++] = rows[i++];
+        while (j < added->Count) merged[write++] = added[j++];
+        return merged;
+    }
+
+    // Результат после пакета изменений: entries - список после всего пакета
+    static array<int>^ Patch(Result^ result, List<NotebookChange^>^ changes, IList<NotebookEntry<int>^>^ entries) {
+        List<int>^ rows = gcnew List<int>(result->rows);
+        // Вставленные и измененные записи - проверяются после всего пакета
+        List<int>^ candidates = gcnew List<int>();
+        for each (NotebookChange^ change in changes) {
+            int inserted = change->kind == NotebookChangeKind::Removed ? 0 : change->count;
+            int removed = change->kind == NotebookChangeKind::Inserted ? 0 : change->count;
+            Move(rows, change->index, removed, inserted);
+            Move(candidates, change->index, removed, inserted);
+            for (int i = 0; i < inserted; i++) {
+                candidates->Add(change->index + i);
+            }
+        }
+
+        List<int>^ added = gcnew List<int>();
+        for each (int position in candidates) {
+            if (EntrySchema::Matches(result->searchType, entries[position], result->search)) {
+                added->Add(position);
+            }
+        }
+        IComparer<int>^ comparer = gcnew PositionComparer(entries, result->order, result->descending);
+        added->Sort(comparer);
+        return Merge(rows, added, comparer);
+    }
+
+    // Пакет правится на месте, только если в нем нет перестановок и замены списка
+    static bool CanPatch(List<NotebookChange^>^ changes) {
+        if (changes->Count > MaxPatchedChanges) return false;
+        for each (NotebookChange^ change in changes) {
+            if (change->kind == NotebookChangeKind::Reordered || change->kind == NotebookChangeKind::Reset) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+public:
+    QueryCache(long long budgetBytes) {
+        results = gcnew Dictionary<String^, Result^>();
+        lru = gcnew LinkedList<Result^>();
+        sync = gcnew Object();
+        this->budgetBytes = budgetBytes;
+    }
+
+    // Номера записей результата запроса к списку entries версии version.
+    // Массив общий для всех, кто получил этот результат, - его нельзя менять.
+    // Неизвестный номер поля - все записи (как в SearchByAnyField)
+    array<int>^ GetRows(String^ query, int searchType, EntryOrder order, bool descending,
+                        IList<NotebookEntry<int>^>^ entries, long long version) {
+        String^ search = query == nullptr ? String::Empty : query->ToLower();
+        if (!EntrySchema::HasSearchType(searchType)) {
+            search = String::Empty;
+            searchType = -1;
+        }
+        if (order == EntryOrder::Book) descending = false;
+        String^ key = MakeKey(search, searchType, order, descending);
+
+        Monitor::Enter(sync);
+        try {
+            Result^ cached;
+            if (results->TryGetValue(key, cached)) {
+                if (cached->version == version) {
+                    hits++;
+                    lru->Remove(cached->node);
+                    lru->AddFirst(cached->node);
+                    return cached->rows;
+                }
+                Remove(cached);
+                invalidations++;
+            }
+            misses++;
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+
+        // Поиск и сортировка - без блокировки: другие запросы не ждут
+        array<int>^ rows = Compute(search, searchType, order, descending, entries);
+        Result^ result = gcnew Result();
+        result->key = key;
+        result->search = search;
+        result->searchType = searchType;
+        result->order = order;
+        result->descending = descending;
+        result->version = version;
+        result->rows = rows;
+        result->bytes = ResultBytes(result);
+        if (result->bytes > budgetBytes) return rows;
+
+        Monitor::Enter(sync);
+        try {
+            Result^ existing;
+            if (results->TryGetValue(key, existing)) {
+                Remove(existing);
+            }
+            result->node = lru->AddFirst(result);
+            results[key] = result;
+            usedBytes += result->bytes;
+            Trim();
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+        return rows;
+    }
+
+    // Пакет изменений, после которого список entries получил версию version.
+    // Результаты предыдущей версии правятся, остальные устаревшие удаляются
+    void Apply(List<NotebookChange^>^ changes, IList<NotebookEntry<int>^>^ entries, long long version) {
+        Monitor::Enter(sync);
+        try {
+            bool patch = CanPatch(changes);
+            for each (Result^ result in gcnew List<Result^>(lru)) {
+                if (result->version == version) continue;
+                if (!patch || result->version != version - 1) {
+                    Remove(result);
+                    invalidations++;
+                    continue;
+                }
+                result->rows = Patch(result, changes, entries);
+                result->version = version;
+                Resize(result);
+                patches++;
+            }
+            Trim();
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    // Перестановка записей: запись с номером i стала записью newPositions[i].
+    // Результаты текущей версии переводятся на новые номера и получают
+    // версию version, поэтому Apply с событием перестановки их не трогает
+    void Reorder(array<int>^ newPositions, long long version) {
+        Monitor::Enter(sync);
+        try {
+            for each (Result^ result in lru) {
+                if (result->version != version - 1) continue;
+                array<int>^ rows = gcnew array<int>(result->rows->Length);
+                for (int i = 0; i < rows->Length; i++) {
+                    rows[i] = newPositions[result->rows[i]];
+                }
+                // Порядок книги - номера по возрастанию; порядок сортировки
+                // задают ключи, он от перестановки не меняется
+                if (result->order == EntryOrder::Book) {
+                    Array::Sort(rows);
+                }
+                result->rows = rows;
+                result->version = version;
+                patches++;
+            }
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    void Clear() {
+        Monitor::Enter(sync);
+        try {
+            invalidations += results->Count;
+            results->Clear();
+            lru->Clear();
+            usedBytes = 0;
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    void SetBudget(long long bytes) {
+        Monitor::Enter(sync);
+        try {
+            budgetBytes = bytes;
+            Trim();
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    // Сокращение до заданного размера (для MemoryAccounting); возвращает размер после
+    long long TrimTo(long long bytes) {
+        SetBudget(bytes);
+        return usedBytes;
+    }
+
+    long long GetUsedBytes() {
+        return usedBytes;
+    }
+
+    int GetCount() {
+        return results->Count;
+    }
+
+    long long GetHits() { return hits; }
+    long long GetMisses() { return misses; }
+    long long GetPatches() { return patches; }
+    long long GetInvalidations() { return invalidations; }
+    long long GetEvictions() { return evictions; }
+
+    // Счетчики одной строкой (окно диагностики памяти)
+    String^ Describe() {
+        long long total = hits + misses;
+        return String::Format("{0} results, hits {1} ({2:0}%), misses {3}, patched {4}, invalidated {5}",
+            results->Count, hits, total == 0 ? 0.0 : hits * 100.0 / total, misses, patches, invalidations);
+    }
+};
@@ -0,0 +1,134 @@
+#pragma once
+#include "../models/NotebookEntry.h"
+#include "../storage/ColdFieldStore.h"
+#include "../utils/JsonSpans.h"
+#include "../utils/MemoryAccounting.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::ComponentModel;
+using namespace System::IO;
+using namespace System::Text;
+using namespace Newtonsoft::Json;
+
+// Очередная порция записей, разобранная фоновой загрузкой
+public ref class StorageBatchEventArgs : EventArgs {
+public:
+    initonly List<NotebookEntry<int>^>^ entries;
+    // Сколько записей разобрано всего и сколько их в файле
+    initonly int loaded;
+    initonly int total;
+
+    StorageBatchEventArgs(List<NotebookEntry<int>^>^ entries, int loaded, int total)
+        : entries(entries), loaded(loaded), total(total) {}
+};
+
+// Загрузка файла хранения в фоновом потоке. Файл читается целиком,
+// размечается на JSON-объекты (JsonSpans) и разбирается по одному
+// объекту, а готовые записи отдаются порциями в BatchLoaded - первая
+// порция маленькая, чтобы таблица заполнилась как можно раньше.
+// События приходят в потоке, вызвавшем Start (BackgroundWorker).
+// С хранилищем холодных полей адреса и заметки переносятся в него там же,
+// в фоне, и строки разобранных объектов не доживают до конца загрузки.
+public ref class StorageLoader {
+public:
+    literal int FirstBatchSize = 200;
+    literal int BatchSize = 5000;
+
+private:
+    String^ path;
+    ColdFieldStore^ coldFields;
+    BackgroundWorker^ worker;
+    List<NotebookEntry<int>^>^ entries;
+    String^ text;
+    Exception^ error;
+
+    void DoWork(Object^ sender, DoWorkEventArgs^ e) {
+        // Как и NotebookManager::Initialize, создаем пустую книгу при первом запуске
+        if (!File::Exists(path)) {
+            try {
+                File::WriteAllText(path, "[]", gcnew UTF8Encoding(true));
+            }
+            catch (Exception^) {
+                // Книга останется только в памяти до первого сохранения
+            }
+        }
+        String^ json = File::Exists(path) ? File::ReadAllText(path, gcnew UTF8Encoding(true)) : "[]";
+        if (String::IsNullOrWhiteSpace(json)) json = "[]";
+        List<TextSpan>^ spans = JsonSpans::ScanArray(json);
+        if (spans == nullptr) {
+            throw gcnew InvalidDataException("Error parsing JSON: " + path + " is not a JSON array of contacts");
+        }
+
+        List<NotebookEntry<int>^>^ result = gcnew List<NotebookEntry<int>^>(spans->Count);
+        List<NotebookEntry<int>^>^ batch = gcnew List<NotebookEntry<int>^>(FirstBatchSize);
+        int limit = FirstBatchSize;
+        for each (TextSpan span in spans) {
+            NotebookEntry<int>^ entry = JsonConvert::DeserializeObject<NotebookEntry<int>^>(json->Substring(span.start, span.length));
+            if (coldFields != nullptr) entry->MoveCold(coldFields);
+            result->Add(entry);
+            batch->Add(entry);
+            if (batch->Count >= limit) {
+                worker->ReportProgress(0, gcnew StorageBatchEventArgs(batch, result->Count, spans->Count));
+                batch = gcnew List<NotebookEntry<int>^>(BatchSize);
+                limit = BatchSize;
+            }
+        }
+        if (batch->Count > 0) {
+            worker->ReportProgress(0, gcnew StorageBatchEventArgs(batch, result->Count, spans->Count));
+        }
+        entries = result;
+        text = json;
+    }
+
+    void OnProgress(Object^ sender, ProgressChangedEventArgs^ e) {
+        BatchLoaded(this, safe_cast<StorageBatchEventArgs^>(e->UserState));
+    }
+
+    void OnCompleted(Object^ sender, RunWorkerCompletedEventArgs^ e) {
+        error = e->Error;
+        if (error != nullptr) {
+            entries = gcnew List<NotebookEntry<int>^>();
+            text = nullptr;
+        }
+        LoadCompleted(this, EventArgs::Empty);
+    }
+
+public:
+    event EventHandler<StorageBatchEventArgs^>^ BatchLoaded;
+    // Загрузка завершена (успешно или с ошибкой - см. GetError)
+    event EventHandler^ LoadCompleted;
+
+    // coldFields - хранилище холодных полей книги (NotebookManager::GetColdFields)
+    // или nullptr
+    StorageLoader(String^ path, ColdFieldStore^ coldFields) {
+        this->path = path;
+        this->coldFields = coldFields;
+        worker = gcnew BackgroundWorker();
+        worker->WorkerReportsProgress = true;
+        worker->DoWork += gcnew DoWorkEventHandler(this, &StorageLoader::DoWork);
+        worker->ProgressChanged += gcnew ProgressChangedEventHandler(this, &StorageLoader::OnProgress);
+        worker->RunWorkerCompleted += gcnew RunWorkerCompletedEventHandler(this, &StorageLoader::OnCompleted);
+    }
+
+    void Start() {
+        worker->RunWorkerAsync();
+    }
+
+    bool IsBusy() {
+        return worker->IsBusy;
+    }
+
+    // Текст файла и список разобранных записей, пока они не отданы
+    long long EstimateBytes() {
+        String^ json = text;
+        List<NotebookEntry<int>^>^ loaded = entries;
+        return MemorySizes::StringBytes(json) + (loaded == nullptr ? 0 : MemorySizes::ReferenceArrayBytes(loaded->Capacity));
+    }
+
+    // Результат после LoadCompleted: все записи, текст файла (для
+    // NotebookManager::CompleteLoad) и ошибка загрузки
+    List<NotebookEntry<int>^>^ GetEntries() { return entries; }
+    String^ GetText() { return text; }
+    Exception^ GetError() { return error; }
+};
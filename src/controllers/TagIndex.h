@@ -0,0 +1,229 @@
+#pragma once
+#include "../models/NotebookEntry.h"
+#include "../models/NotebookChange.h"
+#include "../models/EntrySchema.h"
+#include "../utils/MemoryAccounting.h"
+#include "../utils/RoaringBitmap.h"
+#include "../utils/TagQuery.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Threading;
+
+// Индекс меток: для каждой метки - сжатое множество RoaringBitmap номеров
+// строк книги с этой меткой. Выражение меток (TagExpression) считается
+// операциями над множествами, без обхода записей; условия на поля в нем -
+// обычным поиском EntrySchema::Find. Добавление и удаление в конце списка
+// и замена записей правят множества на месте; вставка или удаление в
+// середине сдвигают номера строк - тогда индекс сбрасывается и строится
+// заново при следующем запросе, как NameIndex.
+public ref class TagIndex : ITagBitmapSource {
+private:
+    // Слот словаря и объект множества
+    literal int TagOverheadBytes = 96;
+
+    Dictionary<String^, RoaringBitmap^>^ bitmaps;
+    RoaringBitmap^ empty;
+    RoaringBitmap^ all;
+    IList<NotebookEntry<int>^>^ current;
+    int rows;
+    bool built;
+    Object^ sync;
+
+    void Index(NotebookEntry<int>^ entry, int row, bool add) {
+        array<String^>^ tags = entry->GetTags();
+        if (tags == nullptr) return;
+        for each (String^ tag in tags) {
+            RoaringBitmap^ bitmap;
+            if (!bitmaps->TryGetValue(tag, bitmap)) {
+                if (!add) continue;
+                bitmap = gcnew RoaringBitmap();
+                bitmaps[tag] = bitmap;
+            }
+            if (add) {
+                bitmap->Add(row);
+            }
+            else {
+                bitmap->Remove(row);
+                if (bitmap->IsEmpty()) bitmaps->Remove(tag);
+            }
+        }
+    }
+
+    void Build(IList<NotebookEntry<int>^>^ entries) {
+        bitmaps->Clear();
+        for (int i = 0; i < entries->Count; i++) {
+            Index(entries[i], i, true);
+        }
+        rows = entries->Count;
+        all = nullptr;
+        built = true;
+    }
+
+    void Drop() {
+        bitmaps->Clear();
+        all = nullptr;
+        built = false;
+    }
+
+    // Изменение одного диапазона; false - номера строк сдвинулись
+    bool ApplyChange(NotebookChange^ change) {
+        switch (change->kind) {
+        case NotebookChangeKind::Inserted:
+            if (change->index != rows) return false;
+            for (int i = 0; i < change->count; i++) {
+                Index(change->entries[i], rows + i, true);
+            }
+            rows += change->count;
+            return true;
+        case NotebookChangeKind::Removed:
+            if (change->index + change->count != rows) return false;
+            for (int i = 0; i < change->count; i++) {
+                Index(change->entries[i], change->index + i, false);
+            }
+            rows -= change->count;
+            return true;
+        case NotebookChangeKind::Updated:
+            for (int i = 0; i < change->count; i++) {
+                Index(change->oldEntries[i], change->index + i, false);
+                Index(change->entries[i], change->index + i, true);
+            }
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    void EnsureBuilt(IList<NotebookEntry<int>^>^ entries) {
+        current = entries;
+        if (!built || rows != entries->Count) Build(entries);
+    }
+
+public:
+    TagIndex() {
+        bitmaps = gcnew Dictionary<String^, RoaringBitmap^>();
+        empty = gcnew RoaringBitmap();
+        sync = gcnew Object();
+    }
+
+    // Пакет изменений менеджера; до первого запроса индекс не ведется
+    void Apply(List<NotebookChange^>^ changes) {
+        Monitor::Enter(sync);
+        try {
+            if (!built) return;
+            for each (NotebookChange^ change in changes) {
+                if (!ApplyChange(change)) {
+                    Drop();
+                    return;
+                }
+                if (change->kind != NotebookChangeKind::Updated) all = nullptr;
+            }
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    // ITagBitmapSource: вызываются из Evaluate под блокировкой индекса
+    virtual RoaringBitmap^ Tag(String^ tag) {
+        RoaringBitmap^ bitmap;
+        return bitmaps->TryGetValue(tag, bitmap) ? bitmap : empty;
+    }
+
+    virtual RoaringBitmap^ Search(int searchType, String^ loweredQuery) {
+        List<int>^ found = EntrySchema::Find(searchType, current, loweredQuery);
+        return found == nullptr ? All() : RoaringBitmap::FromSorted(found);
+    }
+
+    virtual RoaringBitmap^ All() {
+        if (all == nullptr) all = RoaringBitmap::Range(rows);
+        return all;
+    }
+
+    // Номера строк entries (текущий список книги), подходящих под
+    // выражение меток, по возрастанию. Пустой запрос - все строки;
+    // FormatException - ошибка в выражении
+    array<int>^ FindRows(String^ loweredQuery, IList<NotebookEntry<int>^>^ entries) {
+        TagExpression^ expression = TagExpression::Parse(loweredQuery);
+        Monitor::Enter(sync);
+        try {
+            EnsureBuilt(entries);
+            RoaringBitmap^ result = expression == nullptr ? All() : expression->Evaluate(this);
+            return result->ToArray();
+        }
+        finally {
+            current = nullptr;
+            Monitor::Exit(sync);
+        }
+    }
+
+    // Число записей, подходящих под выражение, без списка номеров
+    int Count(String^ loweredQuery, IList<NotebookEntry<int>^>^ entries) {
+        TagExpression^ expression = TagExpression::Parse(loweredQuery);
+        Monitor::Enter(sync);
+        try {
+            EnsureBuilt(entries);
+            return (expression == nullptr ? All() : expression->Evaluate(this))->GetCardinality();
+        }
+        finally {
+            current = nullptr;
+            Monitor::Exit(sync);
+        }
+    }
+
+    List<NotebookEntry<int>^>^ Find(String^ loweredQuery, IList<NotebookEntry<int>^>^ entries) {
+        array<int>^ found = FindRows(loweredQuery, entries);
+        List<NotebookEntry<int>^>^ results = gcnew List<NotebookEntry<int>^>(found->Length);
+        for each (int row in found) {
+            results->Add(entries[row]);
+        }
+        return results;
+    }
+
+    // Метки книги и число записей с каждой, по алфавиту
+    SortedDictionary<String^, int>^ GetTags(IList<NotebookEntry<int>^>^ entries) {
+        Monitor::Enter(sync);
+        try {
+            EnsureBuilt(entries);
+            SortedDictionary<String^, int>^ counts = gcnew SortedDictionary<String^, int>(StringComparer::Ordinal);
+            for each (KeyValuePair<String^, RoaringBitmap^> pair in bitmaps) {
+                counts[pair.Key] = pair.Value->GetCardinality();
+            }
+            return counts;
+        }
+        finally {
+            current = nullptr;
+            Monitor::Exit(sync);
+        }
+    }
+
+    bool IsBuilt() {
+        return built;
+    }
+
+    long long GetUsedBytes() {
+        Monitor::Enter(sync);
+        try {
+            long long bytes = 0;
+            for each (KeyValuePair<String^, RoaringBitmap^> pair in bitmaps) {
+                bytes += TagOverheadBytes + pair.Value->EstimateBytes();
+            }
+            return bytes + (all == nullptr ? 0 : all->EstimateBytes());
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    // Сброс индекса (для MemoryAccounting): он построится при следующем запросе
+    long long Trim(long long targetBytes) {
+        Monitor::Enter(sync);
+        try {
+            Drop();
+            return 0;
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+};
@@ -0,0 +1,498 @@
+#pragma once
+#include "NotebookEntry.h"
+#include "../utils/MemoryAccounting.h"
+#include "../utils/NameKeys.h"
+#include "../utils/TagQuery.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::IO;
+
+// Описание полей NotebookEntry на этапе компиляции.
+// Каждое поле - структура со статическими методами доступа; список полей
+// EntryFields задает их порядок в TSV, таблице и Excel. Поиск, сравнение,
+// чтение/запись TSV и строки таблицы генерируются шаблонами по этому списку:
+// для каждого поля получается отдельный цикл без выбора поля внутри него.
+// Новое поле добавляется здесь: структура поля и строка в EntryFields.
+
+// Общая часть текстовых полей; Field - структура поля (CRTP)
+template<typename Field>
+struct TextField {
+    static const bool IsText = true;
+    // Холодное поле хранится в ColdFieldStore (NotebookEntry::MoveCold);
+    // ColdPart - его номер в записи сегмента
+    static const bool IsCold = false;
+    static const int ColdPart = -1;
+
+    static Object^ Box(NotebookEntry<int>^ entry) {
+        return Field::Get(entry);
+    }
+
+    static String^ Format(NotebookEntry<int>^ entry) {
+        return Field::Get(entry);
+    }
+
+    static void Parse(NotebookEntry<int>^ entry, String^ value) {
+        Field::Set(entry, value);
+    }
+
+    static int Compare(NotebookEntry<int>^ x, NotebookEntry<int>^ y) {
+        return String::Compare(Field::Get(x), Field::Get(y));
+    }
+
+    // Свойство JSON-объекта (Writer - EntryJsonWriter)
+    template<typename Writer>
+    static void WriteJson(Writer^ writer, NotebookEntry<int>^ entry) {
+        writer->WriteProperty(Field::JsonName(), Field::Get(entry));
+    }
+
+    // Память, занятая значением поля (без ссылки на него в записи)
+    // Перенесенное холодное поле учитывается в памяти хранилища
+    static long long Bytes(NotebookEntry<int>^ entry) {
+        if (Field::IsCold && entry->IsCold()) return 0;
+        return MemorySizes::StringBytes(Field::Get(entry));
+    }
+
+    // Подстрока без учета регистра (запрос уже в нижнем регистре).
+    // Пустое обязательное поле совпадает только с пустым запросом;
+    // холодные поля необязательные и проверяются без создания строки
+    static bool Matches(NotebookEntry<int>^ entry, String^ loweredQuery) {
+        if (Field::IsCold) {
+            return entry->ColdContains(Field::ColdPart, loweredQuery);
+        }
+        String^ value = Field::Get(entry);
+        if (!String::IsNullOrEmpty(value)) {
+            return value->ToLower()->Contains(loweredQuery);
+        }
+        return Field::Required && loweredQuery->Length == 0;
+    }
+};
+
+struct IdField {
+    // Номер поля в SearchByAnyField; -1 - поле не участвует в поиске
+    static const int SearchType = -1;
+    static const bool Required = true;
+    static const bool IsText = false;
+    static const bool IsCold = false;
+    static String^ Header() { return "ID"; }
+    static String^ ColumnName() { return "Id"; }
+    static String^ JsonName() { return "id"; }
+
+    static Object^ Box(NotebookEntry<int>^ entry) { return entry->GetId(); }
+    static String^ Format(NotebookEntry<int>^ entry) { return entry->GetId().ToString(); }
+    static void Parse(NotebookEntry<int>^ entry, String^ value) { entry->SetId(Int32::Parse(value)); }
+    static int Compare(NotebookEntry<int>^ x, NotebookEntry<int>^ y) { return x->GetId().CompareTo(y->GetId()); }
+    static long long Bytes(NotebookEntry<int>^ entry) { return 0; }
+    static bool Matches(NotebookEntry<int>^ entry, String^ loweredQuery) { return true; }
+    template<typename Writer>
+    static void WriteJson(Writer^ writer, NotebookEntry<int>^ entry) {
+        writer->WriteProperty(JsonName(), entry->GetId());
+    }
+};
+
+struct FirstNameField : TextField<FirstNameField> {
+    static const int SearchType = 0;
+    static const bool Required = true;
+    static String^ Header() { return "First Name"; }
+    static String^ ColumnName() { return "FirstName"; }
+    static String^ JsonName() { return "firstName"; }
+    static String^ Get(NotebookEntry<int>^ entry) { return entry->GetFirstName(); }
+    static void Set(NotebookEntry<int>^ entry, String^ value) { entry->SetFirstName(value); }
+};
+
+struct LastNameField : TextField<LastNameField> {
+    static const int SearchType = 1;
+    static const bool Required = true;
+    static String^ Header() { return "Last Name"; }
+    static String^ ColumnName() { return "LastName"; }
+    static String^ JsonName() { return "lastName"; }
+    static String^ Get(NotebookEntry<int>^ entry) { return entry->GetLastName(); }
+    static void Set(NotebookEntry<int>^ entry, String^ value) { entry->SetLastName(value); }
+};
+
+struct PhoneField : TextField<PhoneField> {
+    static const int SearchType = 2;
+    static const bool Required = true;
+    static String^ Header() { return "Phone"; }
+    static String^ ColumnName() { return "Phone"; }
+    static String^ JsonName() { return "phoneNumber"; }
+    static String^ Get(NotebookEntry<int>^ entry) { return entry->GetPhoneNumber(); }
+    static void Set(NotebookEntry<int>^ entry, String^ value) { entry->SetPhoneNumber(value); }
+};
+
+struct BirthDateField : TextField<BirthDateField> {
+    static const int SearchType = -1;
+    static const bool Required = false;
+    static String^ Header() { return "Birth Date"; }
+    static String^ ColumnName() { return "BirthDate"; }
+    static String^ JsonName() { return "birthDate"; }
+    static String^ Get(NotebookEntry<int>^ entry) { return entry->GetBirthDate(); }
+    static void Set(NotebookEntry<int>^ entry, String^ value) { entry->SetBirthDate(value); }
+};
+
+struct EmailField : TextField<EmailField> {
+    static const int SearchType = 3;
+    static const bool Required = false;
+    static String^ Header() { return "Email"; }
+    static String^ ColumnName() { return "Email"; }
+    static String^ JsonName() { return "email"; }
+    static String^ Get(NotebookEntry<int>^ entry) { return entry->GetEmail(); }
+    static void Set(NotebookEntry<int>^ entry, String^ value) { entry->SetEmail(value); }
+};
+
+struct AddressField : TextField<AddressField> {
+    static const int SearchType = 4;
+    static const bool Required = false;
+    static String^ Header() { return "Address"; }
+    static String^ ColumnName() { return "Address"; }
+    static const bool IsCold = true;
+    static const int ColdPart = NotebookEntry<int>::AddressPart;
+    static String^ JsonName() { return "address"; }
+    static String^ Get(NotebookEntry<int>^ entry) { return entry->GetAddress(); }
+    static void Set(NotebookEntry<int>^ entry, String^ value) { entry->SetAddress(value); }
+};
+
+struct NotesField : TextField<NotesField> {
+    static const int SearchType = -1;
+    static const bool Required = false;
+    static String^ Header() { return "Notes"; }
+    static String^ ColumnName() { return "Notes"; }
+    static const bool IsCold = true;
+    static const int ColdPart = NotebookEntry<int>::NotesPart;
+    static String^ JsonName() { return "notes"; }
+    static String^ Get(NotebookEntry<int>^ entry) { return entry->GetNotes(); }
+    static void Set(NotebookEntry<int>^ entry, String^ value) { entry->SetNotes(value); }
+};
+
+// Поиск по одному полю: отдельный цикл для каждого Field
+template<typename Field>
+List<NotebookEntry<int>^>^ SearchField(IEnumerable<NotebookEntry<int>^>^ source, String^ loweredQuery) {
+    List<NotebookEntry<int>^>^ results = gcnew List<NotebookEntry<int>^>();
+    for each (NotebookEntry<int>^ entry in source) {
+        if (Field::Matches(entry, loweredQuery)) {
+            results->Add(entry);
+        }
+    }
+    return results;
+}
+
+// То же по списку, но результат - номера совпавших записей в нем
+template<typename Field>
+List<int>^ FindField(IList<NotebookEntry<int>^>^ source, String^ loweredQuery) {
+    List<int>^ positions = gcnew List<int>();
+    for (int i = 0; i < source->Count; i++) {
+        if (Field::Matches(source[i], loweredQuery)) {
+            positions->Add(i);
+        }
+    }
+    return positions;
+}
+
+// Сравнение записей по одному полю (для List::Sort и Array::Sort)
+template<typename Field>
+ref class FieldComparer : IComparer<NotebookEntry<int>^> {
+private:
+    bool ascending;
+public:
+    FieldComparer(bool ascending) : ascending(ascending) {}
+    virtual int Compare(NotebookEntry<int>^ x, NotebookEntry<int>^ y) {
+        return ascending ? Field::Compare(x, y) : Field::Compare(y, x);
+    }
+};
+
+// Список полей и операции над всеми полями записи, развернутые рекурсией
+// по списку на этапе компиляции
+template<typename... Fields>
+struct FieldList;
+
+template<>
+struct FieldList<> {
+    static const int Count = 0;
+
+    static void WriteTsv(TextWriter^ writer, NotebookEntry<int>^ entry) {}
+    static void ReadTsv(array<String^>^ parts, int index, NotebookEntry<int>^ entry) {}
+    static void FillRow(array<Object^>^ row, int index, NotebookEntry<int>^ entry, bool withCold) {}
+    static void FillCells(array<Object^, 2>^ cells, int row, int index, NotebookEntry<int>^ entry) {}
+    static Object^ Box(int column, int index, NotebookEntry<int>^ entry) {
+        return nullptr;
+    }
+    static void FillHeaders(array<String^>^ headers, array<String^>^ names, array<bool>^ text, array<bool>^ cold, int index) {}
+    static long long Bytes(NotebookEntry<int>^ entry) {
+        return 0;
+    }
+    template<typename Writer>
+    static void WriteJson(Writer^ writer, NotebookEntry<int>^ entry) {}
+    template<typename Writer>
+    static void WriteText(Writer^ writer, NotebookEntry<int>^ entry) {}
+    static List<NotebookEntry<int>^>^ Search(int searchType, IEnumerable<NotebookEntry<int>^>^ source, String^ loweredQuery) {
+        return nullptr;
+    }
+    static List<int>^ Find(int searchType, IList<NotebookEntry<int>^>^ source, String^ loweredQuery) {
+        return nullptr;
+    }
+    static bool Matches(int searchType, NotebookEntry<int>^ entry, String^ loweredQuery) {
+        return true;
+    }
+    static bool HasSearchType(int searchType) {
+        return false;
+    }
+};
+
+template<typename Head, typename... Tail>
+struct FieldList<Head, Tail...> {
+    typedef FieldList<Tail...> Rest;
+    static const int Count = 1 + Rest::Count;
+
+    // Строка TSV: поля через табуляцию в порядке списка
+    static void WriteTsv(TextWriter^ writer, NotebookEntry<int>^ entry) {
+        writer->Write(Head::Format(entry));
+        if (Rest::Count > 0) writer->Write(L'\t');
+        Rest::WriteTsv(writer, entry);
+    }
+
+    static void ReadTsv(array<String^>^ parts, int index, NotebookEntry<int>^ entry) {
+        Head::Parse(entry, parts[index]);
+        Rest::ReadTsv(parts, index + 1, entry);
+    }
+
+    // Значения строки таблицы; без withCold холодные поля остаются nullptr
+    static void FillRow(array<Object^>^ row, int index, NotebookEntry<int>^ entry, bool withCold) {
+        row[index] = withCold || !Head::IsCold ? Head::Box(entry) : nullptr;
+        Rest::FillRow(row, index + 1, entry, withCold);
+    }
+
+    // Значения строки двумерного массива (диапазон Excel)
+    static void FillCells(array<Object^, 2>^ cells, int row, int index, NotebookEntry<int>^ entry) {
+        cells[row, index] = Head::Box(entry);
+        Rest::FillCells(cells, row, index + 1, entry);
+    }
+
+    // Значение колонки column
+    static Object^ Box(int column, int index, NotebookEntry<int>^ entry) {
+        return column == index ? Head::Box(entry) : Rest::Box(column, index + 1, entry);
+    }
+
+    static void FillHeaders(array<String^>^ headers, array<String^>^ names, array<bool>^ text, array<bool>^ cold, int index) {
+        headers[index] = Head::Header();
+        names[index] = Head::ColumnName();
+        text[index] = Head::IsText;
+        cold[index] = Head::IsCold;
+        Rest::FillHeaders(headers, names, text, cold, index + 1);
+    }
+
+    static long long Bytes(NotebookEntry<int>^ entry) {
+        return Head::Bytes(entry) + Rest::Bytes(entry);
+    }
+
+    // Свойства JSON-объекта в порядке списка (он совпадает с порядком
+    // [JsonProperty] в NotebookEntry)
+    template<typename Writer>
+    static void WriteJson(Writer^ writer, NotebookEntry<int>^ entry) {
+        Head::WriteJson(writer, entry);
+        Rest::WriteJson(writer, entry);
+    }
+
+    // Текстовые значения полей по порядку (Writer - формат экспорта с
+    // методом WriteField, например CSV)
+    template<typename Writer>
+    static void WriteText(Writer^ writer, NotebookEntry<int>^ entry) {
+        writer->WriteField(Head::Format(entry));
+        Rest::WriteText(writer, entry);
+    }
+
+    // Выбор поля по номеру поиска - один раз на запрос, затем цикл SearchField<Head>
+    static List<NotebookEntry<int>^>^ Search(int searchType, IEnumerable<NotebookEntry<int>^>^ source, String^ loweredQuery) {
+        if (Head::SearchType >= 0 && Head::SearchType == searchType) {
+            return SearchField<Head>(source, loweredQuery);
+        }
+        return Rest::Search(searchType, source, loweredQuery);
+    }
+
+    static List<int>^ Find(int searchType, IList<NotebookEntry<int>^>^ source, String^ loweredQuery) {
+        if (Head::SearchType >= 0 && Head::SearchType == searchType) {
+            return FindField<Head>(source, loweredQuery);
+        }
+        return Rest::Find(searchType, source, loweredQuery);
+    }
+
+    static bool Matches(int searchType, NotebookEntry<int>^ entry, String^ loweredQuery) {
+        if (Head::SearchType >= 0 && Head::SearchType == searchType) {
+            return Head::Matches(entry, loweredQuery);
+        }
+        return Rest::Matches(searchType, entry, loweredQuery);
+    }
+
+    static bool HasSearchType(int searchType) {
+        return (Head::SearchType >= 0 && Head::SearchType == searchType) || Rest::HasSearchType(searchType);
+    }
+};
+
+typedef FieldList<IdField, FirstNameField, LastNameField, PhoneField,
+                  BirthDateField, EmailField, AddressField, NotesField> EntryFields;
+
+// Операции над записью целиком по списку EntryFields
+public ref class EntrySchema abstract sealed {
+private:
+    static array<String^>^ headers;
+    static array<String^>^ columnNames;
+    static array<bool>^ textColumns;
+    static array<bool>^ coldColumns;
+
+    static EntrySchema() {
+        headers = gcnew array<String^>(EntryFields::Count);
+        columnNames = gcnew array<String^>(EntryFields::Count);
+        textColumns = gcnew array<bool>(EntryFields::Count);
+        coldColumns = gcnew array<bool>(EntryFields::Count);
+        EntryFields::FillHeaders(headers, columnNames, textColumns, coldColumns, 0);
+    }
+
+    // Выражение меток для одной записи (без индекса меток)
+    static bool MatchesTags(TagExpression^ expression, NotebookEntry<int>^ entry) {
+        if (expression == nullptr) return true;
+        switch (expression->kind) {
+        case TagNodeKind::Tag:
+            return entry->HasTag(expression->text);
+        case TagNodeKind::Field:
+            return Matches(expression->searchType, entry, expression->text);
+        case TagNodeKind::Not:
+            return !MatchesTags(expression->left, entry);
+        case TagNodeKind::And:
+            return MatchesTags(expression->left, entry) && MatchesTags(expression->right, entry);
+        default:
+            return MatchesTags(expression->left, entry) || MatchesTags(expression->right, entry);
+        }
+    }
+
+public:
+    literal int FieldCount = EntryFields::Count;
+
+    // Заголовки колонок для таблицы и Excel
+    static String^ GetHeader(int index) { return headers[index]; }
+    static String^ GetColumnName(int index) { return columnNames[index]; }
+    // Текстовая колонка (в Excel - текстовый формат, чтобы телефоны не стали числами)
+    static bool IsTextColumn(int index) { return textColumns[index]; }
+    // Холодная колонка (адрес, заметки): значение декодируется по запросу
+    static bool IsColdColumn(int index) { return coldColumns[index]; }
+
+    // Память записи: объект (заголовок, ID, ссылки на поля, сегмент и
+    // смещение холодных полей, метки), строки полей и массив меток
+    // (сами метки интернированы и общие)
+    static long long EstimateBytes(NotebookEntry<int>^ entry) {
+        array<String^>^ tags = entry->GetTags();
+        return MemorySizes::ObjectHeader + (long long)MemorySizes::Reference * (FieldCount + 3) + EntryFields::Bytes(entry)
+            + (tags == nullptr ? 0 : MemorySizes::ReferenceArrayBytes(tags->Length));
+    }
+
+    // Строка TSV: поля схемы, а у записи с метками - еще одна колонка,
+    // метки через запятую (лишние колонки при чтении всегда пропускались)
+    static void WriteTsv(TextWriter^ writer, NotebookEntry<int>^ entry) {
+        EntryFields::WriteTsv(writer, entry);
+        array<String^>^ tags = entry->GetTags();
+        if (tags != nullptr) {
+            writer->Write(L'\t');
+            writer->Write(String::Join(",", tags));
+        }
+        writer->WriteLine();
+    }
+
+    // Метки из колонки TSV после полей схемы
+    static array<String^>^ ParseTsvTags(String^ value) {
+        return String::IsNullOrEmpty(value) ? nullptr : value->Split(',');
+    }
+
+    // Запись из полей строки TSV; nullptr, если полей меньше, чем в схеме
+    static NotebookEntry<int>^ FromTsv(array<String^>^ parts) {
+        if (parts->Length < FieldCount) return nullptr;
+        NotebookEntry<int>^ entry = gcnew NotebookEntry<int>();
+        EntryFields::ReadTsv(parts, 0, entry);
+        if (parts->Length > FieldCount) {
+            entry->SetTags(ParseTsvTags(parts[FieldCount]));
+        }
+        return entry;
+    }
+
+    static array<Object^>^ ToRow(NotebookEntry<int>^ entry) {
+        array<Object^>^ row = gcnew array<Object^>(FieldCount);
+        EntryFields::FillRow(row, 0, entry, true);
+        return row;
+    }
+
+    // Строка без холодных колонок: их значения берутся из записи, когда
+    // строка видна (BoxField)
+    static array<Object^>^ ToHotRow(NotebookEntry<int>^ entry) {
+        array<Object^>^ row = gcnew array<Object^>(FieldCount);
+        EntryFields::FillRow(row, 0, entry, false);
+        return row;
+    }
+
+    static Object^ BoxField(int index, NotebookEntry<int>^ entry) {
+        return EntryFields::Box(index, 0, entry);
+    }
+
+    static void FillCells(array<Object^, 2>^ cells, int row, NotebookEntry<int>^ entry) {
+        EntryFields::FillCells(cells, row, 0, entry);
+    }
+
+    // Режим поиска "звучит как" по имени и фамилии (NameKeys) - следующий
+    // номер после полей
+    literal int SoundsLikeSearchType = 5;
+    // Фильтр по меткам: запрос - выражение TagExpression
+    literal int TagSearchType = 6;
+
+    // Поиск по полю с номером searchType; nullptr - такого поля нет
+    static List<NotebookEntry<int>^>^ Search(int searchType, IEnumerable<NotebookEntry<int>^>^ source, String^ loweredQuery) {
+        if (searchType == SoundsLikeSearchType) {
+            array<String^>^ keys = NameKeys::QueryKeys(loweredQuery);
+            List<NotebookEntry<int>^>^ results = gcnew List<NotebookEntry<int>^>();
+            for each (NotebookEntry<int>^ entry in source) {
+                if (NameKeys::Matches(entry, keys)) results->Add(entry);
+            }
+            return results;
+        }
+        if (searchType == TagSearchType) {
+            TagExpression^ expression = TagExpression::Parse(loweredQuery);
+            List<NotebookEntry<int>^>^ results = gcnew List<NotebookEntry<int>^>();
+            for each (NotebookEntry<int>^ entry in source) {
+                if (MatchesTags(expression, entry)) results->Add(entry);
+            }
+            return results;
+        }
+        return EntryFields::Search(searchType, source, loweredQuery);
+    }
+
+    // Номера совпавших записей списка по возрастанию; nullptr - такого поля нет
+    static List<int>^ Find(int searchType, IList<NotebookEntry<int>^>^ source, String^ loweredQuery) {
+        if (searchType == SoundsLikeSearchType) {
+            array<String^>^ keys = NameKeys::QueryKeys(loweredQuery);
+            List<int>^ positions = gcnew List<int>();
+            for (int i = 0; i < source->Count; i++) {
+                if (NameKeys::Matches(source[i], keys)) positions->Add(i);
+            }
+            return positions;
+        }
+        if (searchType == TagSearchType) {
+            TagExpression^ expression = TagExpression::Parse(loweredQuery);
+            List<int>^ positions = gcnew List<int>();
+            for (int i = 0; i < source->Count; i++) {
+                if (MatchesTags(expression, source[i])) positions->Add(i);
+            }
+            return positions;
+        }
+        return EntryFields::Find(searchType, source, loweredQuery);
+    }
+
+    static bool Matches(int searchType, NotebookEntry<int>^ entry, String^ loweredQuery) {
+        if (searchType == SoundsLikeSearchType) {
+            return NameKeys::Matches(entry, NameKeys::QueryKeys(loweredQuery));
+        }
+        if (searchType == TagSearchType) {
+            return MatchesTags(TagExpression::ParseCached(loweredQuery), entry);
+        }
+        return EntryFields::Matches(searchType, entry, loweredQuery);
+    }
+
+    // Есть поле поиска с таким номером (иначе поиск возвращает все записи)
+    static bool HasSearchType(int searchType) {
+        return searchType == SoundsLikeSearchType || searchType == TagSearchType || EntryFields::HasSearchType(searchType);
+    }
+};
@@ -0,0 +1,49 @@
+#pragma once
+#include "NotebookEntry.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+
+// Вид изменения списка записей
+public enum class NotebookChangeKind {
+    Inserted,   // записи вставлены начиная с index
+    Removed,    // записи удалены начиная с index
+    Updated,    // записи в диапазоне заменены новыми значениями
+    Reordered,  // записи в диапазоне переставлены (состав не изменился)
+    Reset       // список заменен целиком (загрузка, отмена и т.п.)
+};
+
+// Одно изменение - непрерывный диапазон списка.
+// Изменения пакета применяются по порядку; index каждого изменения
+// указан относительно списка после применения предыдущих.
+public ref class NotebookChange {
+public:
+    initonly NotebookChangeKind kind;
+    initonly int index;
+    initonly int count;
+    initonly List<NotebookEntry<int>^>^ entries;      // вставленные, удаленные или новые значения
+    initonly List<NotebookEntry<int>^>^ oldEntries;   // прежние значения для Updated
+
+    NotebookChange(NotebookChangeKind kind, int index, int count,
+                   List<NotebookEntry<int>^>^ entries, List<NotebookEntry<int>^>^ oldEntries)
+        : kind(kind), index(index), count(count), entries(entries), oldEntries(oldEntries) {}
+};
+
+// Пакет изменений одной операции менеджера
+public ref class NotebookChangedEventArgs : EventArgs {
+public:
+    initonly String^ operation;
+    initonly long long version;
+    initonly List<NotebookChange^>^ changes;
+
+    NotebookChangedEventArgs(String^ operation, long long version, List<NotebookChange^>^ changes)
+        : operation(operation), version(version), changes(changes) {}
+
+    // Пакет содержит полную замену списка
+    bool IsReset() {
+        for each (NotebookChange^ change in changes) {
+            if (change->kind == NotebookChangeKind::Reset) return true;
+        }
+        return false;
+    }
+};
\ No newline at end of file
@@ -1,8 +1,10 @@
 #pragma once
 #include <string>
 #include <msclr\marshal_cppstd.h>
+#include "../storage/ColdFieldStore.h"
 
 using namespace System;
+using namespace System::Collections::Generic;
 using namespace Newtonsoft::Json;
 
 // Шаблонный класс для хранения записи в записной книжке
@@ -27,13 +29,53 @@ private:
     [JsonProperty("email")]
     String^ email;
     
-    [JsonProperty("address")]
+    // Адрес и заметки - в строках или, после MoveCold, в сегменте
+    // хранилища холодных полей (тогда строки равны nullptr)
     String^ address;
-    
-    [JsonProperty("notes")]
     String^ notes;
+    ColdSegment^ cold;
+    int coldOffset;
+
+    // Метки записи: нижний регистр, без повторов, строки интернированы
+    // (у тысяч записей одна метка - одна строка); nullptr - меток нет
+    array<String^>^ tags;
+
+    // Для JSON поля читаются и пишутся через геттеры и сеттеры; свойства
+    // сериализуются после полей, поэтому порядок в файле не меняется
+    [JsonProperty("address")]
+    property String^ AddressValue {
+        String^ get() { return GetAddress(); }
+        void set(String^ value) { SetAddress(value); }
+    }
+
+    [JsonProperty("notes")]
+    property String^ NotesValue {
+        String^ get() { return GetNotes(); }
+        void set(String^ value) { SetNotes(value); }
+    }
+
+    // Метки - последним свойством и только у записей с метками: файлы
+    // без меток не меняются
+    [JsonProperty("tags", NullValueHandling = Newtonsoft::Json::NullValueHandling::Ignore)]
+    property array<String^>^ TagsValue {
+        array<String^>^ get() { return tags; }
+        void set(array<String^>^ value) { SetTags(value); }
+    }
+
+    // Возврат холодных полей в строки перед изменением одного из них
+    void Thaw() {
+        ColdSegment^ segment = cold;
+        if (segment == nullptr) return;
+        address = segment->Read(coldOffset, AddressPart);
+        notes = segment->Read(coldOffset, NotesPart);
+        cold = nullptr;
+    }
 
 public:
+    // Номера холодных полей в записи сегмента
+    literal int AddressPart = 0;
+    literal int NotesPart = 1;
+
     // Конструктор по умолчанию
     NotebookEntry() {
         id = T();
@@ -66,8 +108,18 @@ public:
     String^ GetPhoneNumber() { return phoneNumber; }
     String^ GetBirthDate() { return birthDate; }
     String^ GetEmail() { return email; }
-    String^ GetAddress() { return address; }
-    String^ GetNotes() { return notes; }
+    // Строка читается раньше сегмента: MoveCold сначала публикует
+    // сегмент и только потом обнуляет строку
+    String^ GetAddress() {
+        String^ value = address;
+        ColdSegment^ segment = cold;
+        return segment != nullptr ? segment->Read(coldOffset, AddressPart) : value;
+    }
+    String^ GetNotes() {
+        String^ value = notes;
+        ColdSegment^ segment = cold;
+        return segment != nullptr ? segment->Read(coldOffset, NotesPart) : value;
+    }
 
     // Сеттеры
     void SetId(T value) { id = value; }
@@ -76,8 +128,60 @@ public:
     void SetPhoneNumber(String^ value) { phoneNumber = value; }
     void SetBirthDate(String^ value) { birthDate = value; }
     void SetEmail(String^ value) { email = value; }
-    void SetAddress(String^ value) { address = value; }
-    void SetNotes(String^ value) { notes = value; }
+    void SetAddress(String^ value) { Thaw(); address = value; }
+    void SetNotes(String^ value) { Thaw(); notes = value; }
+
+    // Метки: пустой массив - nullptr, значения приводятся к нижнему
+    // регистру без пробелов по краям, пустые и повторы отбрасываются
+    array<String^>^ GetTags() { return tags; }
+    void SetTags(array<String^>^ value) { tags = NormalizeTags(value); }
+
+    bool HasTag(String^ tag) {
+        array<String^>^ current = tags;
+        return current != nullptr && Array::IndexOf(current, tag) >= 0;
+    }
+
+    static array<String^>^ NormalizeTags(array<String^>^ value) {
+        if (value == nullptr) return nullptr;
+        List<String^>^ normalized = gcnew List<String^>(value->Length);
+        for each (String^ tag in value) {
+            if (tag == nullptr) continue;
+            String^ lowered = tag->Trim()->ToLowerInvariant();
+            if (lowered->Length > 0 && !normalized->Contains(lowered)) normalized->Add(String::Intern(lowered));
+        }
+        return normalized->Count == 0 ? nullptr : normalized->ToArray();
+    }
+
+    // Копия записи для правки (записи книги не меняются на месте):
+    // холодные поля остаются в том же сегменте
+    NotebookEntry^ Clone() {
+        return safe_cast<NotebookEntry^>(MemberwiseClone());
+    }
+
+    // Перенос адреса и заметок в хранилище холодных полей. false - они
+    // уже перенесены или оба пусты (пустые строки общие и места не занимают)
+    bool MoveCold(ColdFieldStore^ store) {
+        if (cold != nullptr || (String::IsNullOrEmpty(address) && String::IsNullOrEmpty(notes))) return false;
+        ColdSegment^ segment;
+        coldOffset = store->Write(gcnew array<String^> { address, notes }, segment);
+        cold = segment;
+        address = nullptr;
+        notes = nullptr;
+        return true;
+    }
+
+    bool IsCold() { return cold != nullptr; }
+
+    // Подстрока в холодном поле без создания строки (запрос в нижнем
+    // регистре); part - AddressPart или NotesPart
+    bool ColdContains(int part, String^ loweredQuery) {
+        ColdSegment^ segment = cold;
+        if (segment == nullptr) {
+            String^ value = part == AddressPart ? address : notes;
+            return !String::IsNullOrEmpty(value) && value->ToLower()->Contains(loweredQuery);
+        }
+        return segment->Contains(coldOffset, part, loweredQuery);
+    }
 
     // Метод для получения полного имени
     String^ GetFullName() {
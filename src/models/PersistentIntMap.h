@@ -0,0 +1,147 @@
+#pragma once
+
+using namespace System;
+
+// Персистентный (неизменяемый) словарь с ключом int - префиксное дерево
+// с разветвлением 32 и битовыми масками (HAMT). Ключ сам служит хешем,
+// поэтому коллизий нет, а глубина не превышает 7 уровней. Изменение
+// копирует только путь от корня; старые версии остаются доступны для чтения
+// из других потоков без блокировок.
+template<typename T>
+public ref class PersistentIntMap {
+private:
+    literal int BitsPerLevel = 5;
+    literal int LastShift = 30;
+
+    ref class Node {
+    public:
+        initonly unsigned int bitmap;
+        initonly array<Object^>^ items;     // Node^ на внутренних уровнях, значения - на последнем
+
+        Node(unsigned int bitmap, array<Object^>^ items) : bitmap(bitmap), items(items) {}
+    };
+
+    Node^ root;
+    int count;
+
+    PersistentIntMap(Node^ root, int count) : root(root), count(count) {}
+
+    static int PopCount(unsigned int value) {
+        value = value - ((value >> 1) & 0x55555555u);
+        value = (value & 0x33333333u) + ((value >> 2) & 0x33333333u);
+        return (int)((((value + (value >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24);
+    }
+
+    static unsigned int BitFor(unsigned int key, int shift) {
+        return 1u << ((key >> shift) & 31);
+    }
+
+    static int IndexOf(unsigned int bitmap, unsigned int bit) {
+        return PopCount(bitmap & (bit - 1));
+    }
+
+    static Node^ Assoc(Node^ node, unsigned int key, int shift, Object^ value, bool% added) {
+        unsigned int bit = BitFor(key, shift);
+        unsigned int bitmap = node == nullptr ? 0 : node->bitmap;
+        int index = IndexOf(bitmap, bit);
+        bool present = (bitmap & bit) != 0;
+
+        Object^ child;
+        if (shift == LastShift) {
+            child = value;
+            added = !present;
+        }
+        else {
+            Node^ inner = present ? safe_cast<Node^>(node->items[index]) : nullptr;
+            child = Assoc(inner, key, shift + BitsPerLevel, value, added);
+        }
+
+        array<Object^>^ items;
+        if (present) {
+            items = safe_cast<array<Object^>^>(node->items->Clone());
+            items[index] = child;
+        }
+        else {
+            int length = node == nullptr ? 0 : node->items->Length;
+            items = gcnew array<Object^>(length + 1);
+            if (index > 0) Array::Copy(node->items, 0, items, 0, index);
+            items[index] = child;
+            if (index < length) Array::Copy(node->items, index, items, index + 1, length - index);
+        }
+        return gcnew Node(bitmap | bit, items);
+    }
+
+    static Node^ Dissoc(Node^ node, unsigned int key, int shift, bool% removed) {
+        if (node == nullptr) return nullptr;
+        unsigned int bit = BitFor(key, shift);
+        if ((node->bitmap & bit) == 0) return node;
+        int index = IndexOf(node->bitmap, bit);
+
+        Object^ child = nullptr;
+        if (shift == LastShift) {
+            removed = true;
+        }
+        else {
+            Node^ inner = safe_cast<Node^>(node->items[index]);
+            Node^ updated = Dissoc(inner, key, shift + BitsPerLevel, removed);
+            if (updated == inner) return node;
+            child = updated;
+        }
+
+        if (child != nullptr) {
+            array<Object^>^ items = safe_cast<array<Object^>^>(node->items->Clone());
+            items[index] = child;
+            return gcnew Node(node->bitmap, items);
+        }
+        if (node->bitmap == bit) {
+            return nullptr;
+        }
+        array<Object^>^ items = gcnew array<Object^>(node->items->Length - 1);
+        if (index > 0) Array::Copy(node->items, 0, items, 0, index);
+        if (index < items->Length) Array::Copy(node->items, index + 1, items, index, items->Length - index);
+        return gcnew Node(node->bitmap & ~bit, items);
+    }
+
+public:
+    // Пустой словарь
+    PersistentIntMap() : root(nullptr), count(0) {}
+
+    int Count() {
+        return count;
+    }
+
+    // Поиск значения по ключу (не более 7 шагов)
+    bool TryGetValue(int key, T% value) {
+        unsigned int k = (unsigned int)key;
+        Node^ node = root;
+        for (int shift = 0; node != nullptr; shift += BitsPerLevel) {
+            unsigned int bit = BitFor(k, shift);
+            if ((node->bitmap & bit) == 0) {
+                break;
+            }
+            Object^ item = node->items[IndexOf(node->bitmap, bit)];
+            if (shift == LastShift) {
+                value = safe_cast<T>(item);
+                return true;
+            }
+            node = safe_cast<Node^>(item);
+        }
+        value = T();
+        return false;
+    }
+
+    // Новая версия с добавленным или замененным значением
+    PersistentIntMap<T>^ Set(int key, T value) {
+        bool added = false;
+        Node^ updated = Assoc(root, (unsigned int)key, 0, value, added);
+        return gcnew PersistentIntMap<T>(updated, added ? count + 1 : count);
+    }
+
+    // Новая версия без ключа
+    PersistentIntMap<T>^ Remove(int key) {
+        bool removed = false;
+        Node^ updated = Dissoc(root, (unsigned int)key, 0, removed);
+        if (!removed) return this;
+        return gcnew PersistentIntMap<T>(updated, count - 1);
+    }
+};
\ No newline at end of file
@@ -0,0 +1,270 @@
+#pragma once
+
+using namespace System;
+using namespace System::Collections::Generic;
+
+// Счетчик созданных узлов - по нему оценивается стоимость версии
+public ref class PersistentNodeCounter {
+public:
+    long long created;
+    PersistentNodeCounter() : created(0) {}
+};
+
+// Персистентный (неизменяемый) вектор со структурным разделением.
+// Внутри - рандомизированное дерево поиска по позиции: каждая операция
+// вставки или удаления копирует только путь от корня, т.е. O(log N) узлов,
+// а все остальные узлы разделяются между старой и новой версиями.
+template<typename T>
+public ref class PersistentVector : IEnumerable<T> {
+public:
+    // Примерный размер узла в управляемой куче (заголовок + 3 ссылки + размер)
+    literal int NodeBytes = 48;
+
+private:
+    ref class Node {
+    public:
+        initonly T value;
+        initonly Node^ left;
+        initonly Node^ right;
+        initonly int size;
+
+        Node(T value, Node^ left, Node^ right)
+            : value(value), left(left), right(right),
+              size(1 + SizeOf(left) + SizeOf(right)) {}
+    };
+
+    // Обход версии по порядку без материализации списка
+    ref class Enumerator : IEnumerator<T> {
+    private:
+        Node^ root;
+        Node^ next;
+        Stack<Node^>^ stack;
+        T current;
+    public:
+        Enumerator(Node^ root) : root(root) {
+            stack = gcnew Stack<Node^>();
+            next = root;
+        }
+        ~Enumerator() {}
+
+        virtual bool MoveNext() {
+            while (next != nullptr) {
+                stack->Push(next);
+                next = next->left;
+            }
+            if (stack->Count == 0) {
+                return false;
+            }
+            Node^ node = stack->Pop();
+            current = node->value;
+            next = node->right;
+            return true;
+        }
+
+        virtual void Reset() {
+            stack->Clear();
+            next = root;
+        }
+
+        property T Current {
+            virtual T get() { return current; }
+        }
+
+        property Object^ CurrentObject {
+            virtual Object^ get() = System::Collections::IEnumerator::Current::get { return current; }
+        }
+    };
+
+    Node^ root;
+    PersistentNodeCounter^ counter;
+    Random^ random;
+
+    PersistentVector(Node^ root, PersistentNodeCounter^ counter, Random^ random)
+        : root(root), counter(counter), random(random) {}
+
+    static int SizeOf(Node^ node) {
+        return node == nullptr ? 0 : node->size;
+    }
+
+    Node^ MakeNode(T value, Node^ left, Node^ right) {
+        counter->created++;
+        return gcnew Node(value, left, right);
+    }
+
+    // Разделение на первые count элементов и остаток
+    void Split(Node^ node, int count, Node^% left, Node^% right) {
+        if (node == nullptr) {
+            left = nullptr;
+            right = nullptr;
+            return;
+        }
+        int leftSize = SizeOf(node->left);
+        if (count <= leftSize) {
+            Node^ innerLeft;
+            Node^ innerRight;
+            Split(node->left, count, innerLeft, innerRight);
+            left = innerLeft;
+            right = MakeNode(node->value, innerRight, node->right);
+        }
+        else {
+            Node^ innerLeft;
+            Node^ innerRight;
+            Split(node->right, count - leftSize - 1, innerLeft, innerRight);
+            left = MakeNode(node->value, node->left, innerLeft);
+            right = innerRight;
+        }
+    }
+
+    // Слияние: корень выбирается случайно с весом по размеру поддеревьев,
+    // что сохраняет ожидаемую высоту O(log N) без хранения приоритетов
+    Node^ Merge(Node^ left, Node^ right) {
+        if (left == nullptr) return right;
+        if (right == nullptr) return left;
+        if (random->Next(left->size + right->size) < left->size) {
+            return MakeNode(left->value, left->left, Merge(left->right, right));
+        }
+        return MakeNode(right->value, Merge(left, right->left), right->right);
+    }
+
+    // Замена значения с копированием пути от корня
+    Node^ Replace(Node^ node, int index, T value) {
+        int leftSize = SizeOf(node->left);
+        if (index < leftSize) {
+            return MakeNode(node->value, Replace(node->left, index, value), node->right);
+        }
+        if (index == leftSize) {
+            return MakeNode(value, node->left, node->right);
+        }
+        return MakeNode(node->value, node->left, Replace(node->right, index - leftSize - 1, value));
+    }
+
+    Node^ Build(List<T>^ items, int from, int to) {
+        if (from >= to) return nullptr;
+        int middle = from + (to - from) / 2;
+        Node^ left = Build(items, from, middle);
+        Node^ right = Build(items, middle + 1, to);
+        return MakeNode(items[middle], left, right);
+    }
+
+public:
+    // Пустой вектор
+    PersistentVector() {
+        root = nullptr;
+        counter = gcnew PersistentNodeCounter();
+        random = gcnew Random(12345);
+    }
+
+    // Новая версия, построенная из списка (O(N))
+    PersistentVector<T>^ FromList(List<T>^ items) {
+        return gcnew PersistentVector<T>(Build(items, 0, items->Count), counter, random);
+    }
+
+    int Count() {
+        return SizeOf(root);
+    }
+
+    // Общий для всех версий счетчик созданных узлов
+    PersistentNodeCounter^ GetCounter() {
+        return counter;
+    }
+
+    // Элемент по индексу (O(log N))
+    T Get(int index) {
+        if (index < 0 || index >= Count()) {
+            throw gcnew ArgumentOutOfRangeException("index");
+        }
+        Node^ node = root;
+        while (true) {
+            int leftSize = SizeOf(node->left);
+            if (index < leftSize) {
+                node = node->left;
+            }
+            else if (index == leftSize) {
+                return node->value;
+            }
+            else {
+                index -= leftSize + 1;
+                node = node->right;
+            }
+        }
+    }
+
+    // Новая версия со вставленным элементом
+    PersistentVector<T>^ Insert(int index, T value) {
+        if (index < 0 || index > Count()) {
+            throw gcnew ArgumentOutOfRangeException("index");
+        }
+        Node^ left;
+        Node^ right;
+        Split(root, index, left, right);
+        Node^ single = MakeNode(value, nullptr, nullptr);
+        return gcnew PersistentVector<T>(Merge(Merge(left, single), right), counter, random);
+    }
+
+    // Новая версия с замененным элементом
+    PersistentVector<T>^ Set(int index, T value) {
+        if (index < 0 || index >= Count()) {
+            throw gcnew ArgumentOutOfRangeException("index");
+        }
+        return gcnew PersistentVector<T>(Replace(root, index, value), counter, random);
+    }
+
+    // Новая версия с добавленным в конец элементом
+    PersistentVector<T>^ Add(T value) {
+        return Insert(Count(), value);
+    }
+
+    // Новая версия без элемента по индексу
+    PersistentVector<T>^ RemoveAt(int index) {
+        if (index < 0 || index >= Count()) {
+            throw gcnew ArgumentOutOfRangeException("index");
+        }
+        Node^ left;
+        Node^ rest;
+        Split(root, index, left, rest);
+        Node^ removed;
+        Node^ right;
+        Split(rest, 1, removed, right);
+        return gcnew PersistentVector<T>(Merge(left, right), counter, random);
+    }
+
+    // Новая версия без элементов по индексам (индексы в порядке возрастания)
+    PersistentVector<T>^ RemoveAll(List<int>^ sortedIndices) {
+        Node^ current = root;
+        for (int i = sortedIndices->Count - 1; i >= 0; i--) {
+            Node^ left;
+            Node^ rest;
+            Split(current, sortedIndices[i], left, rest);
+            Node^ removed;
+            Node^ right;
+            Split(rest, 1, removed, right);
+            current = Merge(left, right);
+        }
+        return gcnew PersistentVector<T>(current, counter, random);
+    }
+
+    virtual IEnumerator<T>^ GetEnumerator() {
+        return gcnew Enumerator(root);
+    }
+
+    virtual System::Collections::IEnumerator^ GetEnumeratorObject() = System::Collections::IEnumerable::GetEnumerator {
+        return GetEnumerator();
+    }
+
+    // Материализация версии в список (O(N), копируются только ссылки)
+    List<T>^ ToList() {
+        List<T>^ result = gcnew List<T>(Count());
+        Stack<Node^>^ stack = gcnew Stack<Node^>();
+        Node^ node = root;
+        while (node != nullptr || stack->Count > 0) {
+            while (node != nullptr) {
+                stack->Push(node);
+                node = node->left;
+            }
+            node = stack->Pop();
+            result->Add(node->value);
+            node = node->right;
+        }
+        return result;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,172 @@
+#pragma once
+#include "NotebookServer.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Diagnostics;
+using namespace System::Globalization;
+using namespace System::IO;
+using namespace System::IO::Pipes;
+using namespace System::Text;
+using namespace System::Threading;
+
+// Итоги нагрузочного прогона
+public ref class LoadReport {
+public:
+    long long requests;
+    long long errors;
+    double seconds;
+    double qps;
+    double p50Ms;
+    double p99Ms;
+    double maxMs;
+
+    String^ ToJson() {
+        return String::Format(CultureInfo::InvariantCulture,
+            "{{\"requests\":{0},\"errors\":{1},\"seconds\":{2:0.###},\"qps\":{3:0.#},\"p50_ms\":{4:0.###},\"p99_ms\":{5:0.###},\"max_ms\":{6:0.###}}}",
+            requests, errors, seconds, qps, p50Ms, p99Ms, maxMs);
+    }
+};
+
+// Генератор нагрузки для сервера книги: несколько клиентов, каждый
+// отправляет запросы пачками по depth штук (конвейер) и замеряет
+// задержку каждого запроса от отправки пачки до получения ответа
+public ref class LoadGenerator {
+private:
+    String^ pipeName;
+    int clients;
+    int requestsPerClient;
+    int depth;
+    double searchRatio;
+    array<array<double>^>^ latencies;
+    array<long long>^ errors;
+    array<Exception^>^ failures;
+
+    // Один клиент: чтение диапазона ID, затем GET/SEARCH вперемешку
+    void RunClient(int index) {
+        NamedPipeClientStream^ pipe = gcnew NamedPipeClientStream(".", pipeName, PipeDirection::InOut);
+        try {
+            pipe->Connect(5000);
+            StreamReader^ reader = gcnew StreamReader(pipe, Encoding::UTF8, false, 1 << 16);
+            StreamWriter^ writer = gcnew StreamWriter(pipe, gcnew UTF8Encoding(false), 1 << 16);
+
+            writer->Write("COUNT\n");
+            writer->Flush();
+            array<String^>^ countParts = reader->ReadLine()->Split(' ');
+            int maxId = Math::Max(1, Int32::Parse(countParts[2]));
+
+            Random^ random = gcnew Random(index * 7919 + 17);
+            array<double>^ samples = gcnew array<double>(requestsPerClient);
+            array<long long>^ started = gcnew array<long long>(depth);
+            array<bool>^ isSearch = gcnew array<bool>(depth);
+            double ticksToMs = 1000.0 / Stopwatch::Frequency;
+
+            int sent = 0;
+            while (sent < requestsPerClient) {
+                int batch = Math::Min(depth, requestsPerClient - sent);
+                for (int i = 0; i < batch; i++) {
+                    isSearch[i] = random->NextDouble() < searchRatio;
+                    if (isSearch[i]) {
+                        writer->Write("SEARCH 1 {0}\n", (wchar_t)('a' + random->Next(26)));
+                    }
+                    else {
+                        writer->Write("GET {0}\n", 1 + random->Next(maxId));
+                    }
+                    started[i] = Stopwatch::GetTimestamp();
+                }
+                writer->Flush();
+
+                for (int i = 0; i < batch; i++) {
+                    String^ response = reader->ReadLine();
+                    if (response == nullptr) {
+                        throw gcnew IOException("Server closed the connection");
+                    }
+                    if (response->StartsWith("ERR")) {
+                        errors[index]++;
+                    }
+                    else if (isSearch[i] && response->StartsWith("OK ")) {
+                        int rows = Int32::Parse(response->Substring(3));
+                        for (int r = 0; r < rows; r++) {
+                            reader->ReadLine();
+                        }
+                    }
+                    samples[sent + i] = (Stopwatch::GetTimestamp() - started[i]) * ticksToMs;
+                }
+                sent += batch;
+            }
+            latencies[index] = samples;
+        }
+        finally {
+            pipe->Close();
+        }
+    }
+
+    // Каждый клиент - отдельный поток: блокирующий ввод-вывод не должен
+    // ждать разгона пула потоков
+    void ClientThread(Object^ state) {
+        int index = safe_cast<int>(state);
+        try {
+            RunClient(index);
+        }
+        catch (Exception^ ex) {
+            failures[index] = ex;
+        }
+    }
+
+    static double Percentile(array<double>^ sorted, double fraction) {
+        if (sorted->Length == 0) return 0;
+        int index = (int)Math::Ceiling(fraction * sorted->Length) - 1;
+        return sorted[Math::Max(0, Math::Min(sorted->Length - 1, index))];
+    }
+
+public:
+    LoadGenerator(String^ pipeName, int clients, int requestsPerClient, int depth, double searchRatio) {
+        this->pipeName = pipeName;
+        this->clients = Math::Max(1, clients);
+        this->requestsPerClient = Math::Max(1, requestsPerClient);
+        this->depth = Math::Max(1, depth);
+        this->searchRatio = searchRatio;
+    }
+
+    LoadReport^ Run() {
+        latencies = gcnew array<array<double>^>(clients);
+        errors = gcnew array<long long>(clients);
+
+        failures = gcnew array<Exception^>(clients);
+
+        array<Thread^>^ threads = gcnew array<Thread^>(clients);
+        Stopwatch^ clock = Stopwatch::StartNew();
+        for (int i = 0; i < clients; i++) {
+            threads[i] = gcnew Thread(gcnew ParameterizedThreadStart(this, &LoadGenerator::ClientThread));
+            threads[i]->IsBackground = true;
+            threads[i]->Start(i);
+        }
+        for (int i = 0; i < clients; i++) {
+            threads[i]->Join();
+        }
+        clock->Stop();
+
+        for (int i = 0; i < clients; i++) {
+            if (failures[i] != nullptr) {
+                throw gcnew Exception("Load generator failed: " + failures[i]->Message);
+            }
+        }
+
+        List<double>^ all = gcnew List<double>(clients * requestsPerClient);
+        LoadReport^ report = gcnew LoadReport();
+        for (int i = 0; i < clients; i++) {
+            all->AddRange(latencies[i]);
+            report->errors += errors[i];
+        }
+        array<double>^ sorted = all->ToArray();
+        Array::Sort(sorted);
+
+        report->requests = sorted->Length;
+        report->seconds = clock->Elapsed.TotalSeconds;
+        report->qps = report->seconds > 0 ? sorted->Length / report->seconds : 0;
+        report->p50Ms = Percentile(sorted, 0.50);
+        report->p99Ms = Percentile(sorted, 0.99);
+        report->maxMs = sorted->Length > 0 ? sorted[sorted->Length - 1] : 0;
+        return report;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,465 @@
+#pragma once
+#include "../controllers/NotebookManager.h"
+#include "../models/PersistentIntMap.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::IO;
+using namespace System::IO::Pipes;
+using namespace System::Text;
+using namespace System::Threading;
+
+// Строковый протокол сервера: один запрос - одна строка, поля записи
+// разделены табуляцией, а \t, \n, \r и \ внутри полей экранируются
+public ref class WireFormat {
+public:
+    static String^ Escape(String^ value) {
+        if (String::IsNullOrEmpty(value)) return String::Empty;
+        if (value->IndexOfAny(gcnew array<wchar_t> { '\\', '\t', '\n', '\r' }) < 0) return value;
+        StringBuilder^ result = gcnew StringBuilder(value->Length + 8);
+        for (int i = 0; i < value->Length; i++) {
+            switch (value[i]) {
+                case '\\': result->Append("\\\\"); break;
+                case '\t': result->Append("\\t"); break;
+                case '\n': result->Append("\\n"); break;
+                case '\r': result->Append("\\r"); break;
+                default: result->Append(value[i]); break;
+            }
+        }
+        return result->ToString();
+    }
+
+    static String^ Unescape(String^ value) {
+        if (value->IndexOf('\\') < 0) return value;
+        StringBuilder^ result = gcnew StringBuilder(value->Length);
+        for (int i = 0; i < value->Length; i++) {
+            if (value[i] == '\\' && i + 1 < value->Length) {
+                wchar_t next = value[++i];
+                result->Append(next == 't' ? '\t' : next == 'n' ? '\n' : next == 'r' ? '\r' : next);
+            }
+            else {
+                result->Append(value[i]);
+            }
+        }
+        return result->ToString();
+    }
+
+    // Запись одной строкой: id и семь полей через табуляцию
+    static void AppendEntry(StringBuilder^ output, NotebookEntry<int>^ entry) {
+        output->Append(entry->GetId())->Append('\t')
+            ->Append(Escape(entry->GetFirstName()))->Append('\t')
+            ->Append(Escape(entry->GetLastName()))->Append('\t')
+            ->Append(Escape(entry->GetPhoneNumber()))->Append('\t')
+            ->Append(Escape(entry->GetBirthDate()))->Append('\t')
+            ->Append(Escape(entry->GetEmail()))->Append('\t')
+            ->Append(Escape(entry->GetAddress()))->Append('\t')
+            ->Append(Escape(entry->GetNotes()));
+    }
+};
+
+// Неизменяемый снимок книги: читатели работают с ним без блокировок,
+// пока писатель под блокировкой готовит следующий
+public ref class ReadSnapshot {
+public:
+    initonly PersistentVector<NotebookEntry<int>^>^ rows;
+    initonly PersistentIntMap<NotebookEntry<int>^>^ byId;
+    initonly int maxId;
+    initonly long long version;
+
+    ReadSnapshot(PersistentVector<NotebookEntry<int>^>^ rows, PersistentIntMap<NotebookEntry<int>^>^ byId,
+                 int maxId, long long version)
+        : rows(rows), byId(byId), maxId(maxId), version(version) {}
+};
+
+// Сервер запросов к книге через именованный канал.
+// Команды: PING, COUNT, GET <id>, SEARCH <type> <query>, ADD <7 полей>, DEL <id>.
+// Ответ: OK [...], NOTFOUND или ERR <сообщение>; SEARCH возвращает "OK <n>"
+// и n строк записей. Запросы одного соединения можно отправлять пачкой -
+// ответы приходят в том же порядке одной записью в канал.
+// Если у книги включен журнал (NotebookManager::EnableJournal), файл
+// книги публикуется после паузы в изменениях и при остановке сервера.
+public ref class NotebookServer {
+public:
+    literal String^ DefaultPipeName = "NBnotebook";
+    // Пауза в изменениях, после которой файл книги догоняет журнал
+    literal int CheckpointDelayMs = 2000;
+    // Пауза перед повторным открытием канала, если открыть его не удалось
+    literal int ListenRetryMs = 1000;
+
+private:
+    // Одно клиентское соединение: асинхронное чтение, разбор строк, ответ
+    ref class Connection {
+    private:
+        NotebookServer^ server;
+        NamedPipeServerStream^ pipe;
+        array<Byte>^ readBuffer;
+        array<Byte>^ pending;       // байты незавершенной строки
+        int pendingCount;
+
+    public:
+        Connection(NotebookServer^ server, NamedPipeServerStream^ pipe) : server(server), pipe(pipe) {
+            readBuffer = gcnew array<Byte>(1 << 16);
+            pending = gcnew array<Byte>(1 << 12);
+            pendingCount = 0;
+        }
+
+        void Start() {
+            BeginRead();
+        }
+
+        void Close() {
+            server->Forget(this);
+            try {
+                pipe->Close();
+            }
+            catch (...) {
+            }
+        }
+
+    private:
+        void BeginRead() {
+            try {
+                pipe->BeginRead(readBuffer, 0, readBuffer->Length, gcnew AsyncCallback(this, &Connection::OnRead), nullptr);
+            }
+            catch (Exception^) {
+                Close();
+            }
+        }
+
+        void OnRead(IAsyncResult^ result) {
+            array<Byte>^ response = nullptr;
+            try {
+                int read = pipe->EndRead(result);
+                if (read == 0) {
+                    Close();
+                    return;
+                }
+                Append(readBuffer, read);
+                response = ProcessLines();
+            }
+            catch (Exception^) {
+                Close();
+                return;
+            }
+
+            if (response == nullptr) {
+                BeginRead();
+                return;
+            }
+            try {
+                pipe->BeginWrite(response, 0, response->Length, gcnew AsyncCallback(this, &Connection::OnWrite), nullptr);
+            }
+            catch (Exception^) {
+                Close();
+            }
+        }
+
+        void OnWrite(IAsyncResult^ result) {
+            try {
+                pipe->EndWrite(result);
+            }
+            catch (Exception^) {
+                Close();
+                return;
+            }
+            BeginRead();
+        }
+
+        void Append(array<Byte>^ data, int count) {
+            if (pendingCount + count > pending->Length) {
+                array<Byte>^ grown = gcnew array<Byte>(Math::Max(pending->Length * 2, pendingCount + count));
+                Buffer::BlockCopy(pending, 0, grown, 0, pendingCount);
+                pending = grown;
+            }
+            Buffer::BlockCopy(data, 0, pending, pendingCount, count);
+            pendingCount += count;
+        }
+
+        // Обработка всех полных строк; ответы собираются в одну запись
+        array<Byte>^ ProcessLines() {
+            StringBuilder^ output = nullptr;
+            int lineStart = 0;
+            for (int i = 0; i < pendingCount; i++) {
+                if (pending[i] != '\n') continue;
+                int length = i - lineStart;
+                if (length > 0 && pending[i - 1] == '\r') length--;
+                String^ line = Encoding::UTF8->GetString(pending, lineStart, length);
+                if (output == nullptr) output = gcnew StringBuilder();
+                server->Handle(line, output);
+                lineStart = i + 1;
+            }
+            if (lineStart > 0) {
+                Buffer::BlockCopy(pending, lineStart, pending, 0, pendingCount - lineStart);
+                pendingCount -= lineStart;
+            }
+            return output == nullptr ? nullptr : Encoding::UTF8->GetBytes(output->ToString());
+        }
+    };
+
+    NotebookManager^ manager;
+    String^ pipeName;
+    Object^ writeLock;
+    ReadSnapshot^ snapshot;
+    HashSet<Connection^>^ connections;
+    NamedPipeServerStream^ listener;
+    volatile bool running;
+    System::Threading::Timer^ checkpointTimer;
+    System::Threading::Timer^ listenTimer;
+
+    // Контрольная точка после паузы; при ошибке операции остаются в
+    // журнале, и публикация повторяется после следующей паузы
+    void CheckpointTimer_Tick(Object^ state) {
+        Monitor::Enter(writeLock);
+        try {
+            if (manager->HasPendingOperations()) {
+                manager->Checkpoint();
+            }
+        }
+        catch (Exception^) {
+            checkpointTimer->Change(CheckpointDelayMs, Timeout::Infinite);
+        }
+        finally {
+            Monitor::Exit(writeLock);
+        }
+    }
+
+    // Публикация нового снимка после изменения (под writeLock)
+    void Publish(PersistentIntMap<NotebookEntry<int>^>^ byId, int maxId) {
+        ReadSnapshot^ next = gcnew ReadSnapshot(manager->GetHistory()->Current(), byId, maxId, snapshot->version + 1);
+        Interlocked::Exchange<ReadSnapshot^>(snapshot, next);
+    }
+
+    void OpenListener() {
+        NamedPipeServerStream^ pipe = gcnew NamedPipeServerStream(pipeName, PipeDirection::InOut,
+            NamedPipeServerStream::MaxAllowedServerInstances, PipeTransmissionMode::Byte,
+            PipeOptions::Asynchronous, 1 << 16, 1 << 16);
+        try {
+            listener = pipe;
+            pipe->BeginWaitForConnection(gcnew AsyncCallback(this, &NotebookServer::OnConnected), pipe);
+        }
+        catch (Exception^) {
+            pipe->Close();
+            throw;
+        }
+    }
+
+    // Ожидание следующего клиента. Вызывается из обработчиков ввода-вывода,
+    // поэтому исключения не выпускаются: об ошибке сообщает ListenFailed,
+    // а канал открывается заново после паузы
+    void Listen() {
+        if (!running) return;
+        try {
+            OpenListener();
+        }
+        catch (Exception^ ex) {
+            if (!running) return;
+            listenTimer->Change(ListenRetryMs, Timeout::Infinite);
+            ListenFailed(this, gcnew ErrorEventArgs(ex));
+        }
+    }
+
+    void ListenTimer_Tick(Object^ state) {
+        Listen();
+    }
+
+    void OnConnected(IAsyncResult^ result) {
+        NamedPipeServerStream^ pipe = safe_cast<NamedPipeServerStream^>(result->AsyncState);
+        try {
+            pipe->EndWaitForConnection(result);
+        }
+        catch (Exception^) {
+            // Клиент ушел до завершения приема (или канал закрыт в Stop):
+            // прием продолжается, пока сервер работает
+            pipe->Close();
+            Listen();
+            return;
+        }
+        if (!running) {
+            pipe->Close();
+            return;
+        }
+
+        // Сразу ждем следующего клиента, затем обслуживаем текущего
+        Listen();
+        Connection^ connection = gcnew Connection(this, pipe);
+        Monitor::Enter(connections);
+        try {
+            connections->Add(connection);
+        }
+        finally {
+            Monitor::Exit(connections);
+        }
+        connection->Start();
+    }
+
+    void Forget(Connection^ connection) {
+        Monitor::Enter(connections);
+        try {
+            connections->Remove(connection);
+        }
+        finally {
+            Monitor::Exit(connections);
+        }
+    }
+
+    // Разбор и выполнение одного запроса
+    void Handle(String^ line, StringBuilder^ output) {
+        try {
+            int space = line->IndexOf(' ');
+            String^ verb = (space < 0 ? line : line->Substring(0, space))->ToUpperInvariant();
+            String^ rest = space < 0 ? String::Empty : line->Substring(space + 1);
+
+            if (verb == "PING") {
+                output->Append("OK\n");
+            }
+            else if (verb == "COUNT") {
+                ReadSnapshot^ current = snapshot;
+                output->Append("OK ")->Append(current->rows->Count())->Append(' ')->Append(current->maxId)->Append('\n');
+            }
+            else if (verb == "GET") {
+                NotebookEntry<int>^ entry;
+                if (snapshot->byId->TryGetValue(Int32::Parse(rest), entry)) {
+                    output->Append("OK ");
+                    WireFormat::AppendEntry(output, entry);
+                    output->Append('\n');
+                }
+                else {
+                    output->Append("NOTFOUND\n");
+                }
+            }
+            else if (verb == "SEARCH") {
+                int separator = rest->IndexOf(' ');
+                int searchType = Int32::Parse(separator < 0 ? rest : rest->Substring(0, separator));
+                String^ query = separator < 0 ? String::Empty : WireFormat::Unescape(rest->Substring(separator + 1));
+                List<NotebookEntry<int>^>^ results = NotebookManager::SearchIn(snapshot->rows, query, searchType);
+                output->Append("OK ")->Append(results->Count)->Append('\n');
+                for each (NotebookEntry<int>^ entry in results) {
+                    WireFormat::AppendEntry(output, entry);
+                    output->Append('\n');
+                }
+            }
+            else if (verb == "ADD") {
+                array<String^>^ fields = rest->Split('\t');
+                if (fields->Length < 7) {
+                    throw gcnew FormatException("ADD expects 7 tab-separated fields");
+                }
+                Monitor::Enter(writeLock);
+                try {
+                    int id = snapshot->maxId + 1;
+                    NotebookEntry<int>^ entry = gcnew NotebookEntry<int>(id,
+                        WireFormat::Unescape(fields[0]), WireFormat::Unescape(fields[1]),
+                        WireFormat::Unescape(fields[2]), WireFormat::Unescape(fields[3]),
+                        WireFormat::Unescape(fields[4]), WireFormat::Unescape(fields[5]),
+                        WireFormat::Unescape(fields[6]));
+                    manager->AddEntry(entry);
+                    Publish(snapshot->byId->Set(id, entry), id);
+                    checkpointTimer->Change(CheckpointDelayMs, Timeout::Infinite);
+                    output->Append("OK ")->Append(id)->Append('\n');
+                }
+                finally {
+                    Monitor::Exit(writeLock);
+                }
+            }
+            else if (verb == "DEL") {
+                int id = Int32::Parse(rest);
+                Monitor::Enter(writeLock);
+                try {
+                    // Неизвестный ID отвечается по снимку, без обхода книги
+                    NotebookEntry<int>^ existing;
+                    if (snapshot->byId->TryGetValue(id, existing) && manager->RemoveEntry(id)) {
+                        Publish(snapshot->byId->Remove(id), snapshot->maxId);
+                        checkpointTimer->Change(CheckpointDelayMs, Timeout::Infinite);
+                        output->Append("OK\n");
+                    }
+                    else {
+                        output->Append("NOTFOUND\n");
+                    }
+                }
+                finally {
+                    Monitor::Exit(writeLock);
+                }
+            }
+            else {
+                output->Append("ERR unknown command\n");
+            }
+        }
+        catch (Exception^ ex) {
+            output->Append("ERR ")->Append(WireFormat::Escape(ex->Message))->Append('\n');
+        }
+    }
+
+public:
+    // Канал для следующего клиента не открылся (повтор - через ListenRetryMs)
+    event ErrorEventHandler^ ListenFailed;
+
+    // Конструктор: книга остается в памяти на все время работы сервера
+    NotebookServer(NotebookManager^ manager, String^ pipeName) {
+        this->manager = manager;
+        this->pipeName = pipeName;
+        writeLock = gcnew Object();
+        connections = gcnew HashSet<Connection^>();
+        checkpointTimer = gcnew System::Threading::Timer(gcnew TimerCallback(this, &NotebookServer::CheckpointTimer_Tick),
+            nullptr, Timeout::Infinite, Timeout::Infinite);
+        listenTimer = gcnew System::Threading::Timer(gcnew TimerCallback(this, &NotebookServer::ListenTimer_Tick),
+            nullptr, Timeout::Infinite, Timeout::Infinite);
+
+        PersistentIntMap<NotebookEntry<int>^>^ byId = gcnew PersistentIntMap<NotebookEntry<int>^>();
+        PersistentVector<NotebookEntry<int>^>^ rows = manager->GetSnapshot();
+        for each (NotebookEntry<int>^ entry in rows) {
+            byId = byId->Set(entry->GetId(), entry);
+        }
+        snapshot = gcnew ReadSnapshot(rows, byId, manager->GetMaxId(), 0);
+    }
+
+    // Запуск приема соединений (не блокирует)
+    void Start() {
+        running = true;
+        // Ошибка первого канала (занятое имя, нет прав) передается вызывающему
+        try {
+            OpenListener();
+        }
+        catch (Exception^) {
+            running = false;
+            throw;
+        }
+    }
+
+    // Остановка: закрываются ожидающий канал и все соединения, файл
+    // книги догоняет журнал. Ошибка публикации передается вызывающему -
+    // операции при этом остаются в журнале
+    void Stop() {
+        running = false;
+        listenTimer->Change(Timeout::Infinite, Timeout::Infinite);
+        if (listener != nullptr) {
+            listener->Close();
+        }
+        array<Connection^>^ open;
+        Monitor::Enter(connections);
+        try {
+            open = gcnew array<Connection^>(connections->Count);
+            connections->CopyTo(open);
+        }
+        finally {
+            Monitor::Exit(connections);
+        }
+        for each (Connection^ connection in open) {
+            connection->Close();
+        }
+
+        checkpointTimer->Change(Timeout::Infinite, Timeout::Infinite);
+        Monitor::Enter(writeLock);
+        try {
+            if (manager->HasPendingOperations()) {
+                manager->Checkpoint();
+            }
+        }
+        finally {
+            Monitor::Exit(writeLock);
+        }
+    }
+
+    // Версия текущего снимка (растет с каждым изменением)
+    long long GetVersion() {
+        return snapshot->version;
+    }
+};
\ No newline at end of file
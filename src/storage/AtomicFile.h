@@ -0,0 +1,133 @@
+#pragma once
+
+using namespace System;
+using namespace System::IO;
+using namespace System::Text;
+
+// Имитация сбоя при записи: исключение, после которого на диске остается
+// только часть данных (см. StorageFaults)
+public ref class SimulatedCrashException : IOException {
+public:
+    SimulatedCrashException() : IOException("Simulated crash during write") {}
+};
+
+// Внедрение сбоев для проверки восстановления: после ArmAfter(n) запись
+// обрывается на n-м байте (считая все записи AtomicFile и StorageJournal),
+// уже записанное сбрасывается на диск, как при отключении питания.
+// Поле статическое, поэтому сбой действует на все книги процесса
+public ref class StorageFaults abstract sealed {
+private:
+    static long long remainingBytes = -1;
+    static long long writtenBytes;
+
+public:
+    static void ArmAfter(long long bytes) {
+        remainingBytes = bytes;
+    }
+
+    static void Disarm() {
+        remainingBytes = -1;
+    }
+
+    static bool IsArmed() {
+        return remainingBytes >= 0;
+    }
+
+    // Всего байт, записанных через Write (для выбора точки сбоя)
+    static long long GetWrittenBytes() {
+        return writtenBytes;
+    }
+
+    // Запись с учетом взведенного сбоя
+    static void Write(FileStream^ stream, array<Byte>^ data, int offset, int count) {
+        if (remainingBytes >= 0 && count > remainingBytes) {
+            stream->Write(data, offset, (int)remainingBytes);
+            stream->Flush(true);
+            writtenBytes += remainingBytes;
+            remainingBytes = -1;
+            throw gcnew SimulatedCrashException();
+        }
+        stream->Write(data, offset, count);
+        writtenBytes += count;
+        if (remainingBytes >= 0) remainingBytes -= count;
+    }
+};
+
+// Поток записи через StorageFaults - чтобы сбой можно было внедрить в
+// запись, которую ведет EntryJsonWriter
+public ref class FaultInjectingStream : Stream {
+private:
+    FileStream^ inner;
+
+public:
+    FaultInjectingStream(FileStream^ inner) : inner(inner) {}
+
+    property bool CanRead { virtual bool get() override { return false; } }
+    property bool CanSeek { virtual bool get() override { return false; } }
+    property bool CanWrite { virtual bool get() override { return true; } }
+    property long long Length { virtual long long get() override { return inner->Length; } }
+    property long long Position {
+        virtual long long get() override { return inner->Position; }
+        virtual void set(long long value) override { throw gcnew NotSupportedException(); }
+    }
+
+    virtual void Write(array<Byte>^ buffer, int offset, int count) override {
+        StorageFaults::Write(inner, buffer, offset, count);
+    }
+
+    virtual void Flush() override {
+        inner->Flush();
+    }
+
+    virtual int Read(array<Byte>^ buffer, int offset, int count) override {
+        throw gcnew NotSupportedException();
+    }
+
+    virtual long long Seek(long long offset, SeekOrigin origin) override {
+        throw gcnew NotSupportedException();
+    }
+
+    virtual void SetLength(long long value) override {
+        throw gcnew NotSupportedException();
+    }
+};
+
+// Атомарная публикация файла: содержимое пишется во временный файл рядом,
+// сбрасывается на диск и подменяет прежний файл одной операцией
+// файловой системы. Прежняя версия остается в <path>.bak, поэтому после
+// сбоя на диске всегда лежит либо старая, либо новая версия целиком
+public ref class AtomicFile abstract sealed {
+public:
+    static String^ TempPath(String^ path) {
+        return path + ".tmp";
+    }
+
+    static String^ BackupPath(String^ path) {
+        return path + ".bak";
+    }
+
+    // Содержимое пишет write; encoding задает только метку кодировки (BOM)
+    // в начале файла
+    static void Publish(String^ path, Encoding^ encoding, Action<Stream^>^ write) {
+        String^ tempPath = TempPath(path);
+        array<Byte>^ preamble = encoding->GetPreamble();
+        // Без WriteThrough: на диск все сбрасывает Flush(true) перед подменой
+        FileStream^ stream = gcnew FileStream(tempPath, FileMode::Create, FileAccess::Write, FileShare::None,
+            1 << 16, FileOptions::None);
+        try {
+            StorageFaults::Write(stream, preamble, 0, preamble->Length);
+            write(gcnew FaultInjectingStream(stream));
+            stream->Flush(true);
+        }
+        finally {
+            stream->Close();
+        }
+
+        if (File::Exists(path)) {
+            File::Replace(tempPath, path, BackupPath(path), true);
+        }
+        else {
+            File::Move(tempPath, path);
+        }
+    }
+};
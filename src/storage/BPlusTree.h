@@ -0,0 +1,322 @@
+#pragma once
+#include "BufferPool.h"
+
+using namespace System;
+
+// B+-дерево в страницах буферного пула: ключ - ID записи, значение -
+// адрес записи (страница << 16 | слот). Листья связаны в цепочку для
+// обхода по возрастанию ID. При удалении листья не сливаются: пустые
+// листья остаются в цепочке и пропускаются курсором.
+public ref class BPlusTree {
+private:
+    literal int LeafEntrySize = 12;     // ключ + адрес
+    literal int InnerEntrySize = 8;     // ключ + правый потомок
+    literal int LeafCapacity = (PageFile::PageSize - PageLayout::HeaderSize) / LeafEntrySize;
+    literal int InnerCapacity = (PageFile::PageSize - PageLayout::HeaderSize - 4) / InnerEntrySize;
+
+    BufferPool^ pool;
+    int rootId;
+
+    static int Count(array<Byte>^ page) {
+        return PageBytes::ReadUInt16(page, PageLayout::CountOffset);
+    }
+
+    static void SetCount(array<Byte>^ page, int count) {
+        PageBytes::WriteUInt16(page, PageLayout::CountOffset, count);
+    }
+
+    static int LeafKeyAt(int index) {
+        return PageLayout::HeaderSize + index * LeafEntrySize;
+    }
+
+    // Внутренний узел: потомок 0, затем пары (ключ i, потомок i + 1)
+    static int InnerChildAt(int index) {
+        return index == 0 ? PageLayout::HeaderSize : PageLayout::HeaderSize + 4 + (index - 1) * InnerEntrySize + 4;
+    }
+
+    static int InnerKeyAt(int index) {
+        return PageLayout::HeaderSize + 4 + index * InnerEntrySize;
+    }
+
+    // Первая позиция в листе с ключом >= key
+    static int LeafLowerBound(array<Byte>^ page, int key) {
+        int low = 0;
+        int high = Count(page);
+        while (low < high) {
+            int middle = (low + high) / 2;
+            if (PageBytes::ReadInt32(page, LeafKeyAt(middle)) < key) low = middle + 1;
+            else high = middle;
+        }
+        return low;
+    }
+
+    // Номер потомка, в поддереве которого лежит key
+    static int InnerChildIndex(array<Byte>^ page, int key) {
+        int low = 0;
+        int high = Count(page);
+        while (low < high) {
+            int middle = (low + high) / 2;
+            if (PageBytes::ReadInt32(page, InnerKeyAt(middle)) <= key) low = middle + 1;
+            else high = middle;
+        }
+        return low;
+    }
+
+    static void InitNode(array<Byte>^ page, Byte type) {
+        Array::Clear(page, 0, page->Length);
+        page[PageLayout::TypeOffset] = type;
+    }
+
+    // Вставка в поддерево; true, если узел разделился (separator и newPage -
+    // первый ключ и номер новой правой половины)
+    bool InsertInto(int pageId, int key, long long address, int% separator, int% newPage) {
+        array<Byte>^ page = pool->Pin(pageId);
+        bool modified = false;
+        try {
+            if (page[PageLayout::TypeOffset] == PageLayout::TypeLeaf) {
+                int count = Count(page);
+                int position = LeafLowerBound(page, key);
+                modified = true;
+                if (position < count && PageBytes::ReadInt32(page, LeafKeyAt(position)) == key) {
+                    PageBytes::WriteInt64(page, LeafKeyAt(position) + 4, address);
+                    return false;
+                }
+                if (count == LeafCapacity) {
+                    return SplitLeaf(page, key, address, position, separator, newPage);
+                }
+                Buffer::BlockCopy(page, LeafKeyAt(position), page, LeafKeyAt(position + 1), (count - position) * LeafEntrySize);
+                PageBytes::WriteInt32(page, LeafKeyAt(position), key);
+                PageBytes::WriteInt64(page, LeafKeyAt(position) + 4, address);
+                SetCount(page, count + 1);
+                return false;
+            }
+
+            int childIndex = InnerChildIndex(page, key);
+            int childSeparator;
+            int childPage;
+            if (!InsertInto(PageBytes::ReadInt32(page, InnerChildAt(childIndex)), key, address, childSeparator, childPage)) {
+                return false;
+            }
+            modified = true;
+            int count = Count(page);
+            if (count == InnerCapacity) {
+                return SplitInner(page, childIndex, childSeparator, childPage, separator, newPage);
+            }
+            Buffer::BlockCopy(page, InnerKeyAt(childIndex), page, InnerKeyAt(childIndex + 1), (count - childIndex) * InnerEntrySize);
+            PageBytes::WriteInt32(page, InnerKeyAt(childIndex), childSeparator);
+            PageBytes::WriteInt32(page, InnerChildAt(childIndex + 1), childPage);
+            SetCount(page, count + 1);
+            return false;
+        }
+        finally {
+            pool->Unpin(pageId, modified);
+        }
+    }
+
+    bool SplitLeaf(array<Byte>^ page, int key, long long address, int position, int% separator, int% newPage) {
+        int count = Count(page);
+        array<int>^ keys = gcnew array<int>(count + 1);
+        array<long long>^ addresses = gcnew array<long long>(count + 1);
+        for (int i = 0, j = 0; i <= count; i++) {
+            if (i == position) {
+                keys[i] = key;
+                addresses[i] = address;
+                continue;
+            }
+            keys[i] = PageBytes::ReadInt32(page, LeafKeyAt(j));
+            addresses[i] = PageBytes::ReadInt64(page, LeafKeyAt(j) + 4);
+            j++;
+        }
+
+        int rightId;
+        array<Byte>^ right = pool->PinNew(rightId);
+        try {
+            InitNode(right, PageLayout::TypeLeaf);
+            int half = (count + 1) / 2;
+            for (int i = 0; i <= count; i++) {
+                array<Byte>^ target = i < half ? page : right;
+                int index = i < half ? i : i - half;
+                PageBytes::WriteInt32(target, LeafKeyAt(index), keys[i]);
+                PageBytes::WriteInt64(target, LeafKeyAt(index) + 4, addresses[i]);
+            }
+            SetCount(page, half);
+            SetCount(right, count + 1 - half);
+            PageBytes::WriteInt32(right, PageLayout::NextOffset, PageBytes::ReadInt32(page, PageLayout::NextOffset));
+            PageBytes::WriteInt32(page, PageLayout::NextOffset, rightId);
+        }
+        finally {
+            pool->Unpin(rightId, true);
+        }
+        separator = keys[(count + 1) / 2];
+        newPage = rightId;
+        return true;
+    }
+
+    bool SplitInner(array<Byte>^ page, int childIndex, int childSeparator, int childPage, int% separator, int% newPage) {
+        int count = Count(page);
+        array<int>^ keys = gcnew array<int>(count + 1);
+        array<int>^ children = gcnew array<int>(count + 2);
+        children[0] = PageBytes::ReadInt32(page, InnerChildAt(0));
+        for (int i = 0, j = 0; i <= count; i++) {
+            if (i == childIndex) {
+                keys[i] = childSeparator;
+                children[i + 1] = childPage;
+                continue;
+            }
+            keys[i] = PageBytes::ReadInt32(page, InnerKeyAt(j));
+            children[i + 1] = PageBytes::ReadInt32(page, InnerChildAt(j + 1));
+            j++;
+        }
+
+        // Средний ключ поднимается в родителя и не остается ни в одной половине
+        int middle = (count + 1) / 2;
+        int rightId;
+        array<Byte>^ right = pool->PinNew(rightId);
+        try {
+            InitNode(right, PageLayout::TypeInner);
+            SetCount(page, middle);
+            for (int i = 0; i < middle; i++) {
+                PageBytes::WriteInt32(page, InnerKeyAt(i), keys[i]);
+                PageBytes::WriteInt32(page, InnerChildAt(i + 1), children[i + 1]);
+            }
+            PageBytes::WriteInt32(right, InnerChildAt(0), children[middle + 1]);
+            for (int i = middle + 1; i <= count; i++) {
+                PageBytes::WriteInt32(right, InnerKeyAt(i - middle - 1), keys[i]);
+                PageBytes::WriteInt32(right, InnerChildAt(i - middle), children[i + 1]);
+            }
+            SetCount(right, count - middle);
+        }
+        finally {
+            pool->Unpin(rightId, true);
+        }
+        separator = keys[middle];
+        newPage = rightId;
+        return true;
+    }
+
+    // Лист, в котором должен находиться key
+    int FindLeaf(int key) {
+        int pageId = rootId;
+        while (true) {
+            array<Byte>^ page = pool->Pin(pageId);
+            int next = -1;
+            if (page[PageLayout::TypeOffset] == PageLayout::TypeInner) {
+                next = PageBytes::ReadInt32(page, InnerChildAt(InnerChildIndex(page, key)));
+            }
+            pool->Unpin(pageId, false);
+            if (next < 0) return pageId;
+            pageId = next;
+        }
+    }
+
+public:
+    // Курсор по листьям: ключи текущего листа копируются, и лист сразу
+    // открепляется, поэтому обход не держит страницы в пуле
+    ref class Cursor {
+    private:
+        BufferPool^ pool;
+        array<int>^ keys;
+        array<long long>^ addresses;
+        int count;
+        int position;
+        int nextLeaf;
+
+        void LoadLeaf(int pageId, int fromKey) {
+            array<Byte>^ page = pool->Pin(pageId);
+            count = Count(page);
+            for (int i = 0; i < count; i++) {
+                keys[i] = PageBytes::ReadInt32(page, LeafKeyAt(i));
+                addresses[i] = PageBytes::ReadInt64(page, LeafKeyAt(i) + 4);
+            }
+            position = LeafLowerBound(page, fromKey) - 1;
+            nextLeaf = PageBytes::ReadInt32(page, PageLayout::NextOffset);
+            pool->Unpin(pageId, false);
+        }
+
+    public:
+        Cursor(BufferPool^ pool, int leafId, int fromKey) : pool(pool) {
+            keys = gcnew array<int>(LeafCapacity);
+            addresses = gcnew array<long long>(LeafCapacity);
+            LoadLeaf(leafId, fromKey);
+        }
+
+        bool MoveNext() {
+            while (++position >= count) {
+                if (nextLeaf == 0) return false;
+                LoadLeaf(nextLeaf, Int32::MinValue);
+            }
+            return true;
+        }
+
+        int GetKey() {
+            return keys[position];
+        }
+
+        long long GetAddress() {
+            return addresses[position];
+        }
+    };
+
+    // Новое пустое дерево
+    static BPlusTree^ Create(BufferPool^ pool) {
+        int rootId;
+        array<Byte>^ root = pool->PinNew(rootId);
+        InitNode(root, PageLayout::TypeLeaf);
+        pool->Unpin(rootId, true);
+        return gcnew BPlusTree(pool, rootId);
+    }
+
+    // Дерево с известным корнем (из заголовка файла)
+    BPlusTree(BufferPool^ pool, int rootId) : pool(pool), rootId(rootId) {}
+
+    // Корень меняется при разделении; владелец сохраняет его в заголовке
+    int GetRootId() {
+        return rootId;
+    }
+
+    bool TryGetValue(int key, long long% address) {
+        int leafId = FindLeaf(key);
+        array<Byte>^ page = pool->Pin(leafId);
+        int position = LeafLowerBound(page, key);
+        bool found = position < Count(page) && PageBytes::ReadInt32(page, LeafKeyAt(position)) == key;
+        address = found ? PageBytes::ReadInt64(page, LeafKeyAt(position) + 4) : 0;
+        pool->Unpin(leafId, false);
+        return found;
+    }
+
+    // Добавление или замена адреса по ключу
+    void Set(int key, long long address) {
+        int separator;
+        int newPage;
+        if (!InsertInto(rootId, key, address, separator, newPage)) return;
+
+        int newRootId;
+        array<Byte>^ root = pool->PinNew(newRootId);
+        InitNode(root, PageLayout::TypeInner);
+        PageBytes::WriteInt32(root, InnerChildAt(0), rootId);
+        PageBytes::WriteInt32(root, InnerKeyAt(0), separator);
+        PageBytes::WriteInt32(root, InnerChildAt(1), newPage);
+        SetCount(root, 1);
+        pool->Unpin(newRootId, true);
+        rootId = newRootId;
+    }
+
+    bool Remove(int key) {
+        int leafId = FindLeaf(key);
+        array<Byte>^ page = pool->Pin(leafId);
+        int count = Count(page);
+        int position = LeafLowerBound(page, key);
+        bool found = position < count && PageBytes::ReadInt32(page, LeafKeyAt(position)) == key;
+        if (found) {
+            Buffer::BlockCopy(page, LeafKeyAt(position + 1), page, LeafKeyAt(position), (count - position - 1) * LeafEntrySize);
+            SetCount(page, count - 1);
+        }
+        pool->Unpin(leafId, found);
+        return found;
+    }
+
+    // Обход по возрастанию ключа, начиная с fromKey
+    Cursor^ Seek(int fromKey) {
+        return gcnew Cursor(pool, FindLeaf(fromKey), fromKey);
+    }
+};
@@ -0,0 +1,135 @@
+#pragma once
+#include "PageFile.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+
+// Кэш страниц с ограничением по памяти. Вытеснение - алгоритм "часы"
+// (приближение LRU): стрелка обходит кадры и пропускает закрепленные и
+// недавно использованные. На диск записываются только измененные страницы.
+public ref class BufferPool {
+public:
+    literal long long DefaultCapacityBytes = 64LL * 1024 * 1024;
+    literal int MinFrames = 16;
+
+private:
+    PageFile^ file;
+    array<array<Byte>^>^ frames;
+    array<int>^ pageIds;
+    array<int>^ pins;
+    array<bool>^ dirty;
+    array<bool>^ referenced;
+    Dictionary<int, int>^ frameOf;
+    int used;
+    int hand;
+    long long hits;
+    long long misses;
+    long long writes;
+
+    // Свободный кадр: сначала незанятые, затем вытеснение по кругу
+    int TakeFrame() {
+        if (used < frames->Length) {
+            frames[used] = gcnew array<Byte>(PageFile::PageSize);
+            return used++;
+        }
+        for (int step = 0; step < frames->Length * 2; step++) {
+            int frame = hand;
+            hand = (hand + 1) % frames->Length;
+            if (pins[frame] > 0) continue;
+            if (referenced[frame]) {
+                referenced[frame] = false;
+                continue;
+            }
+            if (dirty[frame]) {
+                file->Write(pageIds[frame], frames[frame]);
+                dirty[frame] = false;
+                writes++;
+            }
+            frameOf->Remove(pageIds[frame]);
+            return frame;
+        }
+        throw gcnew InvalidOperationException("Buffer pool exhausted: all pages are pinned");
+    }
+
+    array<Byte>^ Attach(int frame, int pageId) {
+        pageIds[frame] = pageId;
+        pins[frame] = 1;
+        referenced[frame] = true;
+        frameOf[pageId] = frame;
+        return frames[frame];
+    }
+
+public:
+    BufferPool(PageFile^ file, long long capacityBytes) {
+        this->file = file;
+        int count = (int)Math::Max((long long)MinFrames, capacityBytes / PageFile::PageSize);
+        frames = gcnew array<array<Byte>^>(count);
+        pageIds = gcnew array<int>(count);
+        pins = gcnew array<int>(count);
+        dirty = gcnew array<bool>(count);
+        referenced = gcnew array<bool>(count);
+        frameOf = gcnew Dictionary<int, int>(count);
+    }
+
+    // Закрепление страницы в памяти; каждому Pin должен соответствовать Unpin
+    array<Byte>^ Pin(int pageId) {
+        int frame;
+        if (frameOf->TryGetValue(pageId, frame)) {
+            hits++;
+            pins[frame]++;
+            referenced[frame] = true;
+            return frames[frame];
+        }
+        misses++;
+        frame = TakeFrame();
+        file->Read(pageId, frames[frame]);
+        return Attach(frame, pageId);
+    }
+
+    // Новая обнуленная страница в конце файла (уже закреплена и помечена измененной)
+    array<Byte>^ PinNew(int% pageId) {
+        int frame = TakeFrame();
+        pageId = file->Allocate();
+        Array::Clear(frames[frame], 0, PageFile::PageSize);
+        dirty[frame] = true;
+        return Attach(frame, pageId);
+    }
+
+    void Unpin(int pageId, bool modified) {
+        int frame = frameOf[pageId];
+        pins[frame]--;
+        if (modified) dirty[frame] = true;
+    }
+
+    // Запись всех измененных страниц
+    void FlushAll() {
+        for (int frame = 0; frame < used; frame++) {
+            if (dirty[frame]) {
+                file->Write(pageIds[frame], frames[frame]);
+                dirty[frame] = false;
+                writes++;
+            }
+        }
+        file->Flush();
+    }
+
+    int GetCapacityPages() {
+        return frames->Length;
+    }
+
+    long long GetResidentBytes() {
+        return (long long)used * PageFile::PageSize;
+    }
+
+    long long GetHits() {
+        return hits;
+    }
+
+    long long GetMisses() {
+        return misses;
+    }
+
+    long long GetWrites() {
+        return writes;
+    }
+};
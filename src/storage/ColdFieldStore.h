@@ -0,0 +1,248 @@
+#pragma once
+#include "ColumnCompression.h"
+#include "../utils/MemoryAccounting.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Text;
+using namespace System::Threading;
+
+// Сегмент холодных полей записей (адрес и заметки): записи лежат подряд
+// в массиве байтов фиксированного размера, каждая - несколько значений
+// вида VarInt(длина + 1) и байты значения (0 - значение null). Байты
+// значений сжаты таблицей символов хранилища; до ее обучения - UTF-8
+// без сжатия (table == nullptr). Сегмент только дописывается: записи,
+// прочитанные другими потоками, не меняются и не переезжают.
+public ref class ColdSegment {
+public:
+    // Меньше порога кучи больших объектов
+    literal int DefaultCapacity = 1 << 16;
+
+private:
+    array<Byte>^ data;
+    int used;
+    SymbolTable^ table;
+
+    // Буферы декодирования и последний запрос поиска - свои у каждого потока
+    [ThreadStatic] static array<Byte>^ buffer;
+    [ThreadStatic] static String^ lastQuery;
+    [ThreadStatic] static array<Byte>^ lastNeedle;
+
+    static array<Byte>^ Buffer(int length) {
+        if (buffer == nullptr || buffer->Length < length) {
+            buffer = gcnew array<Byte>(Math::Max(256, length));
+        }
+        return buffer;
+    }
+
+    // Начало значения part записи offset и его длина в байтах; -1 - null
+    int Locate(int offset, int part, int% length) {
+        int position = offset;
+        for (int i = 0; ; i++) {
+            int header = VarInt::Read(data, position);
+            if (i == part) {
+                length = header - 1;
+                return header == 0 ? -1 : position;
+            }
+            if (header > 0) position += header - 1;
+        }
+    }
+
+    // Исходные байты UTF-8 значения в буфер потока; возвращает их число
+    int DecodeInto(int start, int length) {
+        if (table == nullptr) {
+            Array::Copy(data, start, Buffer(length), 0, length);
+            return length;
+        }
+        return table->Decode(data, start, length, Buffer(length * SymbolTable::MaxSymbolLength));
+    }
+
+public:
+    ColdSegment(SymbolTable^ table, int capacity) {
+        this->table = table;
+        data = gcnew array<Byte>(capacity);
+    }
+
+    int GetFree() {
+        return data->Length - used;
+    }
+
+    bool IsCompressed() {
+        return table != nullptr;
+    }
+
+    // Запись целиком (уже закодированная); вызывается под блокировкой хранилища
+    int Append(List<Byte>^ record) {
+        int offset = used;
+        record->CopyTo(data, offset);
+        used += record->Count;
+        return offset;
+    }
+
+    String^ Read(int offset, int part) {
+        int length;
+        int start = Locate(offset, part, length);
+        if (start < 0) return nullptr;
+        if (length == 0) return String::Empty;
+        int decoded = DecodeInto(start, length);
+        return Encoding::UTF8->GetString(buffer, 0, decoded);
+    }
+
+    // Подстрока без учета регистра (запрос в нижнем регистре); пустое
+    // значение не совпадает. ASCII-запрос проверяется в байтах без
+    // создания строки, остальные - как TextField::Matches
+    bool Contains(int offset, int part, String^ loweredQuery) {
+        int length;
+        int start = Locate(offset, part, length);
+        if (start < 0 || length == 0) return false;
+        if (!AsciiMatcher::IsAscii(loweredQuery)) {
+            return Read(offset, part)->ToLower()->Contains(loweredQuery);
+        }
+        if (!Object::ReferenceEquals(lastQuery, loweredQuery)) {
+            lastNeedle = Encoding::ASCII->GetBytes(loweredQuery);
+            lastQuery = loweredQuery;
+        }
+        int decoded = DecodeInto(start, length);
+        return AsciiMatcher::Contains(buffer, decoded, lastNeedle);
+    }
+
+    long long EstimateBytes() {
+        return MemorySizes::ObjectHeader + 24 + data->LongLength;
+    }
+};
+
+// Хранилище холодных полей: значения, которые нужны редко (при показе
+// строки, экспорте и полнотекстовом поиске), переносятся из строк записи
+// в сегменты ColdSegment. Первые TrainingBytes байтов значений пишутся
+// без сжатия и служат выборкой для таблицы символов; после ее обучения
+// новые сегменты сжимаются. Сегмент живет, пока на него ссылается хоть
+// одна запись: значения замененных и удаленных записей остаются в
+// сегменте до его сборки вместе с последней записью.
+public ref class ColdFieldStore {
+public:
+    literal int TrainingBytes = 1 << 18;
+
+private:
+    // Выборка для обучения - не больше этого числа значений
+    literal int SampleLimit = 1 << 14;
+
+    Object^ sync;
+    SymbolTable^ table;
+    List<array<Byte>^>^ sample;
+    long long sampleBytes;
+    ColdSegment^ current;
+    List<WeakReference^>^ segments;
+    List<Byte>^ record;
+    array<Byte>^ raw;
+    array<Byte>^ encoded;
+    long long records;
+    long long rawBytes;
+    long long storedBytes;
+
+    void AppendValue(String^ value) {
+        if (value == nullptr) {
+            VarInt::Write(record, 0);
+            return;
+        }
+        int byteCount = Encoding::UTF8->GetByteCount(value);
+        if (raw->Length < byteCount) {
+            raw = gcnew array<Byte>(byteCount * 2);
+            encoded = gcnew array<Byte>(byteCount * 4);
+        }
+        Encoding::UTF8->GetBytes(value, 0, value->Length, raw, 0);
+        rawBytes += byteCount;
+
+        if (table == nullptr) {
+            if (byteCount > 0 && sample->Count < SampleLimit) {
+                array<Byte>^ copy = gcnew array<Byte>(byteCount);
+                Array::Copy(raw, copy, byteCount);
+                sample->Add(copy);
+            }
+            sampleBytes += byteCount;
+            VarInt::Write(record, byteCount + 1);
+            for (int i = 0; i < byteCount; i++) record->Add(raw[i]);
+            return;
+        }
+        int length = table->Encode(raw, byteCount, encoded);
+        VarInt::Write(record, length + 1);
+        for (int i = 0; i < length; i++) record->Add(encoded[i]);
+    }
+
+    // Сегмент с местом под запись текущей кодировки
+    ColdSegment^ Reserve(int length) {
+        bool compressed = table != nullptr;
+        if (current == nullptr || current->GetFree() < length || current->IsCompressed() != compressed) {
+            current = gcnew ColdSegment(table, Math::Max((int)ColdSegment::DefaultCapacity, length));
+            segments->Add(gcnew WeakReference(current));
+        }
+        return current;
+    }
+
+public:
+    ColdFieldStore() {
+        sync = gcnew Object();
+        sample = gcnew List<array<Byte>^>();
+        segments = gcnew List<WeakReference^>();
+        record = gcnew List<Byte>(256);
+        raw = gcnew array<Byte>(256);
+        encoded = gcnew array<Byte>(512);
+    }
+
+    // Запись значений values в сегмент; возвращает смещение записи в нем
+    int Write(array<String^>^ values, ColdSegment^% segment) {
+        Monitor::Enter(sync);
+        try {
+            if (table == nullptr && sampleBytes >= TrainingBytes) {
+                table = SymbolTable::Train(sample);
+                sample = nullptr;
+            }
+            record->Clear();
+            for each (String^ value in values) {
+                AppendValue(value);
+            }
+            segment = Reserve(record->Count);
+            records++;
+            storedBytes += record->Count;
+            return segment->Append(record);
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    // Память живых сегментов и таблицы символов
+    long long EstimateBytes() {
+        Monitor::Enter(sync);
+        try {
+            long long bytes = table == nullptr ? 0 : table->EstimateBytes();
+            for (int i = segments->Count - 1; i >= 0; i--) {
+                ColdSegment^ segment = safe_cast<ColdSegment^>(segments[i]->Target);
+                if (segment == nullptr) {
+                    segments->RemoveAt(i);
+                    continue;
+                }
+                bytes += segment->EstimateBytes() + MemorySizes::ObjectHeader + MemorySizes::Reference;
+            }
+            return bytes;
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    long long GetRecordCount() { return records; }
+    long long GetRawBytes() { return rawBytes; }
+    long long GetStoredBytes() { return storedBytes; }
+
+    String^ Describe() {
+        Monitor::Enter(sync);
+        try {
+            return String::Format("{0} records, {1} segments, {2} KB of UTF-8 stored in {3} KB{4}",
+                records, segments->Count, rawBytes / 1024, storedBytes / 1024,
+                table == nullptr ? ", not compressed yet" : String::Empty);
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+};
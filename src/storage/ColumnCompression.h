@@ -0,0 +1,537 @@
+#pragma once
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::IO;
+using namespace System::Text;
+
+// Переменная длина чисел (7 бит на байт) для компактных словарей
+public ref class VarInt abstract sealed {
+public:
+    static void Write(List<Byte>^ output, int value) {
+        unsigned int v = (unsigned int)value;
+        while (v >= 0x80) {
+            output->Add((Byte)(v | 0x80));
+            v >>= 7;
+        }
+        output->Add((Byte)v);
+    }
+
+    static int Read(array<Byte>^ input, int% position) {
+        unsigned int result = 0;
+        int shift = 0;
+        Byte b;
+        do {
+            b = input[position++];
+            result |= (unsigned int)(b & 0x7F) << shift;
+            shift += 7;
+        } while ((b & 0x80) != 0);
+        return (int)result;
+    }
+};
+
+// Поиск подстроки в байтах UTF-8 без учета регистра латиницы.
+// Используется, когда запрос состоит только из ASCII: тогда совпадение
+// в байтах равносильно совпадению строк после ToLower.
+public ref class AsciiMatcher abstract sealed {
+public:
+    static bool IsAscii(String^ value) {
+        for (int i = 0; i < value->Length; i++) {
+            if (value[i] > 0x7F) return false;
+        }
+        return true;
+    }
+
+    // needle - запрос в нижнем регистре, закодированный в ASCII
+    static bool Contains(array<Byte>^ haystack, int length, array<Byte>^ needle) {
+        int last = length - needle->Length;
+        for (int i = 0; i <= last; i++) {
+            int j = 0;
+            while (j < needle->Length) {
+                Byte b = haystack[i + j];
+                if (b >= 'A' && b <= 'Z') b = (Byte)(b + 32);
+                if (b != needle[j]) break;
+                j++;
+            }
+            if (j == needle->Length) return true;
+        }
+        return false;
+    }
+};
+
+// Словарь для колонок с небольшим числом различных значений: в строке
+// хранится только код значения
+public ref class StringDictionary {
+private:
+    List<String^>^ values;
+    Dictionary<String^, int>^ codes;
+
+public:
+    StringDictionary() {
+        values = gcnew List<String^>();
+        codes = gcnew Dictionary<String^, int>(StringComparer::Ordinal);
+    }
+
+    int Encode(String^ value) {
+        if (value == nullptr) value = "";
+        int code;
+        if (!codes->TryGetValue(value, code)) {
+            code = values->Count;
+            values->Add(value);
+            codes[value] = code;
+        }
+        return code;
+    }
+
+    String^ Get(int code) {
+        return values[code];
+    }
+
+    int Count() {
+        return values->Count;
+    }
+
+    // Предикат вычисляется один раз на значение, а не на строку
+    array<bool>^ Match(Func<String^, bool>^ predicate) {
+        array<bool>^ result = gcnew array<bool>(values->Count);
+        for (int i = 0; i < values->Count; i++) {
+            result[i] = predicate(values[i]);
+        }
+        return result;
+    }
+
+    long long EstimateBytes() {
+        long long total = 0;
+        for each (String^ value in values) {
+            // Строка в куче + ссылка в списке + запись в словаре кодов
+            total += 20 + 2 * value->Length + 8 + 24;
+        }
+        return total;
+    }
+
+    void Write(BinaryWriter^ writer) {
+        writer->Write(values->Count);
+        for each (String^ value in values) {
+            writer->Write(value);
+        }
+    }
+
+    static StringDictionary^ Read(BinaryReader^ reader) {
+        StringDictionary^ dictionary = gcnew StringDictionary();
+        int count = reader->ReadInt32();
+        for (int i = 0; i < count; i++) {
+            dictionary->Encode(reader->ReadString());
+        }
+        return dictionary;
+    }
+};
+
+// Упорядоченный словарь с фронтальным кодированием: значения лежат в
+// блоках по BlockSize, каждое хранит длину общего с предыдущим префикса
+// и свой суффикс. Коды следуют порядку сортировки, поэтому сортировка
+// строк по колонке сводится к сортировке кодов.
+public ref class FrontCodedDictionary {
+public:
+    literal int BlockSize = 16;
+
+private:
+    array<Byte>^ data;
+    array<int>^ blockOffsets;
+    int count;
+    array<Byte>^ buffer;
+
+    FrontCodedDictionary() {}
+
+    // Декодирование блока до значения index включительно в buffer
+    int DecodeInto(int index) {
+        int position = blockOffsets[index / BlockSize];
+        int length = 0;
+        for (int i = index - index % BlockSize; i <= index; i++) {
+            int prefix = i % BlockSize == 0 ? 0 : VarInt::Read(data, position);
+            int suffix = VarInt::Read(data, position);
+            EnsureBuffer(prefix + suffix);
+            Buffer::BlockCopy(data, position, buffer, prefix, suffix);
+            position += suffix;
+            length = prefix + suffix;
+        }
+        return length;
+    }
+
+    void EnsureBuffer(int length) {
+        if (buffer->Length < length) {
+            array<Byte>^ larger = gcnew array<Byte>(Math::Max(length, buffer->Length * 2));
+            Buffer::BlockCopy(buffer, 0, larger, 0, buffer->Length);
+            buffer = larger;
+        }
+    }
+
+public:
+    // sortedValues - различные значения в порядке сортировки
+    static FrontCodedDictionary^ Build(array<String^>^ sortedValues) {
+        FrontCodedDictionary^ dictionary = gcnew FrontCodedDictionary();
+        dictionary->count = sortedValues->Length;
+        dictionary->blockOffsets = gcnew array<int>((sortedValues->Length + BlockSize - 1) / BlockSize);
+        dictionary->buffer = gcnew array<Byte>(64);
+
+        List<Byte>^ output = gcnew List<Byte>();
+        array<Byte>^ previous = gcnew array<Byte>(0);
+        for (int i = 0; i < sortedValues->Length; i++) {
+            array<Byte>^ current = Encoding::UTF8->GetBytes(sortedValues[i]);
+            int prefix = 0;
+            if (i % BlockSize == 0) {
+                dictionary->blockOffsets[i / BlockSize] = output->Count;
+            }
+            else {
+                int limit = Math::Min(previous->Length, current->Length);
+                while (prefix < limit && previous[prefix] == current[prefix]) prefix++;
+                VarInt::Write(output, prefix);
+            }
+            VarInt::Write(output, current->Length - prefix);
+            for (int j = prefix; j < current->Length; j++) {
+                output->Add(current[j]);
+            }
+            previous = current;
+        }
+        dictionary->data = output->ToArray();
+        return dictionary;
+    }
+
+    int Count() {
+        return count;
+    }
+
+    String^ Get(int code) {
+        int length = DecodeInto(code);
+        return Encoding::UTF8->GetString(buffer, 0, length);
+    }
+
+    // Все значения по порядку за один проход (для вычисления предиката поиска)
+    array<bool>^ Match(Func<String^, bool>^ predicate) {
+        array<bool>^ result = gcnew array<bool>(count);
+        int position = 0;
+        int length = 0;
+        for (int i = 0; i < count; i++) {
+            int prefix = i % BlockSize == 0 ? 0 : VarInt::Read(data, position);
+            int suffix = VarInt::Read(data, position);
+            EnsureBuffer(prefix + suffix);
+            Buffer::BlockCopy(data, position, buffer, prefix, suffix);
+            position += suffix;
+            length = prefix + suffix;
+            result[i] = predicate(Encoding::UTF8->GetString(buffer, 0, length));
+        }
+        return result;
+    }
+
+    long long EstimateBytes() {
+        return 16 + data->LongLength + 4LL * blockOffsets->Length;
+    }
+
+    void Write(BinaryWriter^ writer) {
+        writer->Write(count);
+        writer->Write(data->Length);
+        writer->Write(data);
+        writer->Write(blockOffsets->Length);
+        for each (int offset in blockOffsets) {
+            writer->Write(offset);
+        }
+    }
+
+    static FrontCodedDictionary^ Read(BinaryReader^ reader) {
+        FrontCodedDictionary^ dictionary = gcnew FrontCodedDictionary();
+        dictionary->count = reader->ReadInt32();
+        dictionary->data = reader->ReadBytes(reader->ReadInt32());
+        dictionary->blockOffsets = gcnew array<int>(reader->ReadInt32());
+        for (int i = 0; i < dictionary->blockOffsets->Length; i++) {
+            dictionary->blockOffsets[i] = reader->ReadInt32();
+        }
+        dictionary->buffer = gcnew array<Byte>(64);
+        return dictionary;
+    }
+};
+
+// Таблица символов в духе FSST: до 255 частых последовательностей длиной
+// 1-8 байт кодируются одним байтом, остальные байты - парой (Escape, байт).
+// Таблица обучается на выборке за несколько раундов: на каждом раунде
+// выборка кодируется текущей таблицей, и в следующую попадают символы и
+// пары соседних символов с наибольшим выигрышем (частота * длина).
+public ref class SymbolTable {
+public:
+    literal int MaxSymbols = 255;
+    literal int MaxSymbolLength = 8;
+    literal Byte Escape = 255;
+
+private:
+    literal int TrainingRounds = 5;
+
+    array<array<Byte>^>^ symbols;
+    array<array<int>^>^ byFirstByte;    // коды символов по первому байту, длинные - раньше
+
+    SymbolTable(array<array<Byte>^>^ symbols) : symbols(symbols) {
+        array<List<int>^>^ lists = gcnew array<List<int>^>(256);
+        for (int code = 0; code < symbols->Length; code++) {
+            int first = symbols[code][0];
+            if (lists[first] == nullptr) lists[first] = gcnew List<int>();
+            lists[first]->Add(code);
+        }
+        byFirstByte = gcnew array<array<int>^>(256);
+        for (int b = 0; b < 256; b++) {
+            if (lists[b] == nullptr) continue;
+            array<int>^ codes = lists[b]->ToArray();
+            array<int>^ lengths = gcnew array<int>(codes->Length);
+            for (int i = 0; i < codes->Length; i++) lengths[i] = -symbols[codes[i]]->Length;
+            Array::Sort(lengths, codes);
+            byFirstByte[b] = codes;
+        }
+    }
+
+    // Самый длинный символ таблицы, совпадающий с input в позиции position
+    int Match(array<Byte>^ input, int position, int length) {
+        array<int>^ codes = byFirstByte[input[position]];
+        if (codes == nullptr) return -1;
+        for each (int code in codes) {
+            array<Byte>^ symbol = symbols[code];
+            if (position + symbol->Length > length) continue;
+            int i = 1;
+            while (i < symbol->Length && input[position + i] == symbol[i]) i++;
+            if (i == symbol->Length) return code;
+        }
+        return -1;
+    }
+
+    // Ключ последовательности до 8 байт; нулевые байты в обучении не участвуют
+    static unsigned long long Pack(array<Byte>^ bytes, int offset, int length) {
+        unsigned long long key = 0;
+        for (int i = 0; i < length; i++) {
+            key |= (unsigned long long)bytes[offset + i] << (8 * i);
+        }
+        return key;
+    }
+
+    static array<Byte>^ Unpack(unsigned long long key) {
+        int length = 0;
+        while (length < 8 && ((key >> (8 * length)) & 0xFF) != 0) length++;
+        array<Byte>^ bytes = gcnew array<Byte>(length);
+        for (int i = 0; i < length; i++) bytes[i] = (Byte)(key >> (8 * i));
+        return bytes;
+    }
+
+    static void Count(Dictionary<unsigned long long, long long>^ counts, unsigned long long key) {
+        long long value;
+        counts->TryGetValue(key, value);
+        counts[key] = value + 1;
+    }
+
+public:
+    static SymbolTable^ Train(List<array<Byte>^>^ sample) {
+        SymbolTable^ table = gcnew SymbolTable(gcnew array<array<Byte>^>(0));
+        for (int round = 0; round < TrainingRounds; round++) {
+            Dictionary<unsigned long long, long long>^ counts = gcnew Dictionary<unsigned long long, long long>();
+            for each (array<Byte>^ text in sample) {
+                int previousStart = -1;
+                int previousLength = 0;
+                int position = 0;
+                while (position < text->Length) {
+                    int code = table->Match(text, position, text->Length);
+                    int length = code >= 0 ? table->symbols[code]->Length : 1;
+                    bool usable = Array::IndexOf(text, (Byte)0, position, length) < 0;
+                    if (usable) {
+                        Count(counts, Pack(text, position, length));
+                        if (previousStart >= 0 && previousLength + length <= MaxSymbolLength) {
+                            Count(counts, Pack(text, previousStart, previousLength + length));
+                        }
+                    }
+                    previousStart = usable ? position : -1;
+                    previousLength = length;
+                    position += length;
+                }
+            }
+
+            List<KeyValuePair<unsigned long long, long long>>^ ranked =
+                gcnew List<KeyValuePair<unsigned long long, long long>>(counts->Count);
+            for each (KeyValuePair<unsigned long long, long long> item in counts) {
+                long long gain = item.Value * Unpack(item.Key)->Length;
+                ranked->Add(KeyValuePair<unsigned long long, long long>(item.Key, gain));
+            }
+            array<long long>^ gains = gcnew array<long long>(ranked->Count);
+            array<unsigned long long>^ keys = gcnew array<unsigned long long>(ranked->Count);
+            for (int i = 0; i < ranked->Count; i++) {
+                gains[i] = -ranked[i].Value;
+                keys[i] = ranked[i].Key;
+            }
+            Array::Sort(gains, keys);
+
+            array<array<Byte>^>^ chosen = gcnew array<array<Byte>^>(Math::Min(MaxSymbols, keys->Length));
+            for (int i = 0; i < chosen->Length; i++) {
+                chosen[i] = Unpack(keys[i]);
+            }
+            table = gcnew SymbolTable(chosen);
+        }
+        return table;
+    }
+
+    // Кодирование; output должен вмещать 2 * length байт
+    int Encode(array<Byte>^ input, int length, array<Byte>^ output) {
+        int written = 0;
+        int position = 0;
+        while (position < length) {
+            int code = Match(input, position, length);
+            if (code >= 0) {
+                output[written++] = (Byte)code;
+                position += symbols[code]->Length;
+            }
+            else {
+                output[written++] = Escape;
+                output[written++] = input[position++];
+            }
+        }
+        return written;
+    }
+
+    // Декодирование; output должен вмещать MaxSymbolLength * length байт
+    int Decode(array<Byte>^ codes, int offset, int length, array<Byte>^ output) {
+        int written = 0;
+        int end = offset + length;
+        for (int i = offset; i < end; i++) {
+            Byte code = codes[i];
+            if (code == Escape) {
+                output[written++] = codes[++i];
+            }
+            else {
+                array<Byte>^ symbol = symbols[code];
+                for (int j = 0; j < symbol->Length; j++) {
+                    output[written++] = symbol[j];
+                }
+            }
+        }
+        return written;
+    }
+
+    long long EstimateBytes() {
+        long long total = 0;
+        for each (array<Byte>^ symbol in symbols) {
+            total += 24 + symbol->Length;
+        }
+        return total;
+    }
+
+    void Write(BinaryWriter^ writer) {
+        writer->Write(symbols->Length);
+        for each (array<Byte>^ symbol in symbols) {
+            writer->Write((Byte)symbol->Length);
+            writer->Write(symbol);
+        }
+    }
+
+    static SymbolTable^ Read(BinaryReader^ reader) {
+        array<array<Byte>^>^ symbols = gcnew array<array<Byte>^>(reader->ReadInt32());
+        for (int i = 0; i < symbols->Length; i++) {
+            symbols[i] = reader->ReadBytes(reader->ReadByte());
+        }
+        return gcnew SymbolTable(symbols);
+    }
+};
+
+// Колонка строк, сжатых таблицей символов: все значения подряд в одном
+// массиве байтов, начало значения i - offsets[i]
+public ref class SymbolColumn {
+private:
+    literal int SampleLimit = 1 << 16;
+
+    SymbolTable^ table;
+    array<Byte>^ data;
+    array<int>^ offsets;
+    array<Byte>^ buffer;
+
+    SymbolColumn() {}
+
+    array<Byte>^ EnsureBuffer(int codesLength) {
+        int needed = codesLength * SymbolTable::MaxSymbolLength;
+        if (buffer->Length < needed) buffer = gcnew array<Byte>(needed);
+        return buffer;
+    }
+
+public:
+    static SymbolColumn^ Build(array<String^>^ values) {
+        // Обучение на равномерной выборке значений
+        List<array<Byte>^>^ sample = gcnew List<array<Byte>^>();
+        int step = Math::Max(1, values->Length / SampleLimit);
+        for (int i = 0; i < values->Length; i += step) {
+            if (!String::IsNullOrEmpty(values[i])) {
+                sample->Add(Encoding::UTF8->GetBytes(values[i]));
+            }
+        }
+
+        SymbolColumn^ column = gcnew SymbolColumn();
+        column->table = SymbolTable::Train(sample);
+        column->offsets = gcnew array<int>(values->Length + 1);
+        column->buffer = gcnew array<Byte>(256);
+
+        MemoryStream^ output = gcnew MemoryStream();
+        array<Byte>^ raw = gcnew array<Byte>(256);
+        array<Byte>^ encoded = gcnew array<Byte>(512);
+        for (int i = 0; i < values->Length; i++) {
+            column->offsets[i] = (int)output->Length;
+            String^ value = values[i] == nullptr ? "" : values[i];
+            int byteCount = Encoding::UTF8->GetByteCount(value);
+            if (raw->Length < byteCount) {
+                raw = gcnew array<Byte>(byteCount * 2);
+                encoded = gcnew array<Byte>(byteCount * 4);
+            }
+            Encoding::UTF8->GetBytes(value, 0, value->Length, raw, 0);
+            output->Write(encoded, 0, column->table->Encode(raw, byteCount, encoded));
+        }
+        column->offsets[values->Length] = (int)output->Length;
+        column->data = output->ToArray();
+        return column;
+    }
+
+    int Count() {
+        return offsets->Length - 1;
+    }
+
+    bool IsEmpty(int row) {
+        return offsets[row] == offsets[row + 1];
+    }
+
+    String^ Get(int row) {
+        int length = offsets[row + 1] - offsets[row];
+        if (length == 0) return "";
+        array<Byte>^ output = EnsureBuffer(length);
+        int decoded = table->Decode(data, offsets[row], length, output);
+        return Encoding::UTF8->GetString(output, 0, decoded);
+    }
+
+    // Проверка подстроки без создания строки (needle - ASCII в нижнем регистре)
+    bool ContainsAscii(int row, array<Byte>^ needle) {
+        int length = offsets[row + 1] - offsets[row];
+        array<Byte>^ output = EnsureBuffer(length);
+        int decoded = table->Decode(data, offsets[row], length, output);
+        return AsciiMatcher::Contains(output, decoded, needle);
+    }
+
+    long long EstimateBytes() {
+        return table->EstimateBytes() + data->LongLength + 4LL * offsets->Length;
+    }
+
+    void Write(BinaryWriter^ writer) {
+        table->Write(writer);
+        writer->Write(offsets->Length);
+        for each (int offset in offsets) {
+            writer->Write(offset);
+        }
+        writer->Write(data->Length);
+        writer->Write(data);
+    }
+
+    static SymbolColumn^ Read(BinaryReader^ reader) {
+        SymbolColumn^ column = gcnew SymbolColumn();
+        column->table = SymbolTable::Read(reader);
+        column->offsets = gcnew array<int>(reader->ReadInt32());
+        for (int i = 0; i < column->offsets->Length; i++) {
+            column->offsets[i] = reader->ReadInt32();
+        }
+        column->data = reader->ReadBytes(reader->ReadInt32());
+        column->buffer = gcnew array<Byte>(256);
+        return column;
+    }
+};
@@ -0,0 +1,448 @@
+#pragma once
+#include "ColumnCompression.h"
+#include "../models/NotebookEntry.h"
+#include "../utils/NameKeys.h"
+#include "../utils/RoaringBitmap.h"
+#include "../utils/TagQuery.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Globalization;
+using namespace System::IO;
+using namespace System::Text;
+
+// Сжатое по колонкам представление книги (в памяти и в снимке .nbz):
+//   имя, фамилия  - упорядоченный словарь с фронтальным кодированием;
+//   дата рождения - словарь;
+//   email         - локальная часть таблицей символов, домен - словарем;
+//   телефон, адрес, заметки - таблица символов (FSST);
+//   метки         - сжатое множество строк RoaringBitmap на каждую метку.
+// Поиск по словарным колонкам проверяет каждое различное значение один раз,
+// по остальным - работает с байтами без создания строк, если запрос ASCII.
+// Экземпляр не потокобезопасен: колонки декодируют во внутренние буферы.
+public ref class CompressedBook {
+private:
+    literal int Magic = 0x325A424E;     // "NBZ2"
+    // Снимки без меток читаются по-прежнему
+    literal int MagicWithoutTags = 0x315A424E;     // "NBZ1"
+
+    // Условие поиска для одного значения - та же семантика, что и в
+    // NotebookManager::Matches
+    ref class ValuePredicate {
+    private:
+        String^ lowered;
+        bool emptyMatches;
+    public:
+        ValuePredicate(String^ lowered, bool emptyMatches) : lowered(lowered), emptyMatches(emptyMatches) {}
+
+        bool Test(String^ value) {
+            if (!String::IsNullOrEmpty(value)) {
+                return value->ToLower()->Contains(lowered);
+            }
+            return emptyMatches && lowered->Length == 0;
+        }
+    };
+
+    // Значение звучит как слово запроса (семантика NameKeys::Matches)
+    ref class SoundsLikePredicate {
+    private:
+        String^ key;
+    public:
+        SoundsLikePredicate(String^ key) : key(key) {}
+
+        bool Test(String^ value) {
+            return key->Length > 0 && NameKeys::Phonetic(value) == key;
+        }
+    };
+
+    array<int>^ ids;
+    FrontCodedDictionary^ firstNames;
+    array<int>^ firstNameCodes;
+    FrontCodedDictionary^ lastNames;
+    array<int>^ lastNameCodes;
+    SymbolColumn^ phones;
+    StringDictionary^ birthDates;
+    array<int>^ birthDateCodes;
+    SymbolColumn^ emailLocals;
+    StringDictionary^ emailDomains;
+    array<int>^ emailDomainCodes;
+    SymbolColumn^ addresses;
+    SymbolColumn^ notes;
+    array<String^>^ tagNames;
+    array<RoaringBitmap^>^ tagRows;
+
+    // Множества строк для выражения меток (поиск 6)
+    ref class TagSource : ITagBitmapSource {
+    private:
+        CompressedBook^ book;
+        RoaringBitmap^ all;
+    public:
+        TagSource(CompressedBook^ book) : book(book) {}
+
+        virtual RoaringBitmap^ Tag(String^ tag) {
+            int index = Array::IndexOf(book->tagNames, tag);
+            return index >= 0 ? book->tagRows[index] : gcnew RoaringBitmap();
+        }
+
+        virtual RoaringBitmap^ Search(int searchType, String^ loweredQuery) {
+            return RoaringBitmap::FromSorted(book->Search(loweredQuery, searchType));
+        }
+
+        virtual RoaringBitmap^ All() {
+            if (all == nullptr) all = RoaringBitmap::Range(book->ids->Length);
+            return all;
+        }
+    };
+
+    CompressedBook() {}
+
+    // Упорядоченный словарь колонки и коды строк
+    static FrontCodedDictionary^ BuildSorted(array<String^>^ values, array<int>^% codes) {
+        HashSet<String^>^ distinct = gcnew HashSet<String^>(values, StringComparer::Ordinal);
+        array<String^>^ sorted = gcnew array<String^>(distinct->Count);
+        distinct->CopyTo(sorted);
+        Array::Sort(sorted, StringComparer::CurrentCulture);
+
+        Dictionary<String^, int>^ codeOf = gcnew Dictionary<String^, int>(sorted->Length, StringComparer::Ordinal);
+        for (int i = 0; i < sorted->Length; i++) {
+            codeOf[sorted[i]] = i;
+        }
+        codes = gcnew array<int>(values->Length);
+        for (int i = 0; i < values->Length; i++) {
+            codes[i] = codeOf[values[i]];
+        }
+        return FrontCodedDictionary::Build(sorted);
+    }
+
+    static array<int>^ ReadCodes(BinaryReader^ reader) {
+        array<int>^ codes = gcnew array<int>(reader->ReadInt32());
+        for (int i = 0; i < codes->Length; i++) {
+            codes[i] = reader->ReadInt32();
+        }
+        return codes;
+    }
+
+    static void WriteCodes(BinaryWriter^ writer, array<int>^ codes) {
+        writer->Write(codes->Length);
+        for each (int code in codes) {
+            writer->Write(code);
+        }
+    }
+
+    String^ GetEmail(int row) {
+        String^ domain = emailDomains->Get(emailDomainCodes[row]);
+        return emailLocals->IsEmpty(row) ? domain : emailLocals->Get(row) + domain;
+    }
+
+    // Запись строки row с метками tags (nullptr - без меток)
+    NotebookEntry<int>^ GetEntry(int row, List<String^>^ tags) {
+        NotebookEntry<int>^ entry = gcnew NotebookEntry<int>(
+            ids[row],
+            firstNames->Get(firstNameCodes[row]),
+            lastNames->Get(lastNameCodes[row]),
+            phones->Get(row),
+            birthDates->Get(birthDateCodes[row]),
+            GetEmail(row),
+            addresses->Get(row),
+            notes->Get(row));
+        if (tags != nullptr) entry->SetTags(tags->ToArray());
+        return entry;
+    }
+
+    static bool TextMatches(SymbolColumn^ column, int row, String^ lowered, array<Byte>^ asciiNeedle, bool emptyMatches) {
+        if (column->IsEmpty(row)) {
+            return emptyMatches && lowered->Length == 0;
+        }
+        if (asciiNeedle != nullptr) {
+            return column->ContainsAscii(row, asciiNeedle);
+        }
+        return column->Get(row)->ToLower()->Contains(lowered);
+    }
+
+public:
+    static CompressedBook^ Build(List<NotebookEntry<int>^>^ entries) {
+        int count = entries->Count;
+        CompressedBook^ book = gcnew CompressedBook();
+        book->ids = gcnew array<int>(count);
+        array<String^>^ firsts = gcnew array<String^>(count);
+        array<String^>^ lasts = gcnew array<String^>(count);
+        array<String^>^ phoneValues = gcnew array<String^>(count);
+        array<String^>^ locals = gcnew array<String^>(count);
+        array<String^>^ addressValues = gcnew array<String^>(count);
+        array<String^>^ noteValues = gcnew array<String^>(count);
+        book->birthDates = gcnew StringDictionary();
+        book->birthDateCodes = gcnew array<int>(count);
+        book->emailDomains = gcnew StringDictionary();
+        book->emailDomainCodes = gcnew array<int>(count);
+        // Метки в порядке первого появления; строки идут по возрастанию
+        Dictionary<String^, RoaringBitmap^>^ tagged = gcnew Dictionary<String^, RoaringBitmap^>(StringComparer::Ordinal);
+        List<String^>^ tagOrder = gcnew List<String^>();
+
+        for (int i = 0; i < count; i++) {
+            NotebookEntry<int>^ entry = entries[i];
+            book->ids[i] = entry->GetId();
+            firsts[i] = entry->GetFirstName() == nullptr ? "" : entry->GetFirstName();
+            lasts[i] = entry->GetLastName() == nullptr ? "" : entry->GetLastName();
+            phoneValues[i] = entry->GetPhoneNumber();
+            addressValues[i] = entry->GetAddress();
+            noteValues[i] = entry->GetNotes();
+            book->birthDateCodes[i] = book->birthDates->Encode(entry->GetBirthDate());
+
+            // Домен вместе с '@' уходит в словарь, остаток - в таблицу символов
+            String^ email = entry->GetEmail() == nullptr ? "" : entry->GetEmail();
+            int at = email->LastIndexOf('@');
+            locals[i] = at < 0 ? email : email->Substring(0, at);
+            book->emailDomainCodes[i] = book->emailDomains->Encode(at < 0 ? "" : email->Substring(at));
+
+            if (entry->GetTags() == nullptr) continue;
+            for each (String^ tag in entry->GetTags()) {
+                RoaringBitmap^ rows;
+                if (!tagged->TryGetValue(tag, rows)) {
+                    rows = gcnew RoaringBitmap();
+                    tagged[tag] = rows;
+                    tagOrder->Add(tag);
+                }
+                rows->Add(i);
+            }
+        }
+        book->tagNames = tagOrder->ToArray();
+        book->tagRows = gcnew array<RoaringBitmap^>(book->tagNames->Length);
+        for (int t = 0; t < book->tagNames->Length; t++) {
+            book->tagRows[t] = tagged[book->tagNames[t]];
+        }
+
+        book->firstNames = BuildSorted(firsts, book->firstNameCodes);
+        book->lastNames = BuildSorted(lasts, book->lastNameCodes);
+        book->phones = SymbolColumn::Build(phoneValues);
+        book->emailLocals = SymbolColumn::Build(locals);
+        book->addresses = SymbolColumn::Build(addressValues);
+        book->notes = SymbolColumn::Build(noteValues);
+        return book;
+    }
+
+    int Count() {
+        return ids->Length;
+    }
+
+    NotebookEntry<int>^ GetEntry(int row) {
+        List<String^>^ tags = nullptr;
+        for (int t = 0; t < tagNames->Length; t++) {
+            if (!tagRows[t]->Contains(row)) continue;
+            if (tags == nullptr) tags = gcnew List<String^>();
+            tags->Add(tagNames[t]);
+        }
+        return GetEntry(row, tags);
+    }
+
+    List<NotebookEntry<int>^>^ ToList() {
+        // Метки раздаются по строкам множеств, а не проверкой каждой строки
+        array<List<String^>^>^ tagsOf = gcnew array<List<String^>^>(ids->Length);
+        for (int t = 0; t < tagNames->Length; t++) {
+            for each (int row in tagRows[t]->ToArray()) {
+                if (tagsOf[row] == nullptr) tagsOf[row] = gcnew List<String^>(2);
+                tagsOf[row]->Add(tagNames[t]);
+            }
+        }
+        List<NotebookEntry<int>^>^ result = gcnew List<NotebookEntry<int>^>(ids->Length);
+        for (int row = 0; row < ids->Length; row++) {
+            result->Add(GetEntry(row, tagsOf[row]));
+        }
+        return result;
+    }
+
+    // Метки снимка и множества их строк (номер метки - номер множества)
+    array<String^>^ GetTagNames() {
+        return tagNames;
+    }
+
+    RoaringBitmap^ GetTagRows(int index) {
+        return tagRows[index];
+    }
+
+    // Номера строк, подходящих под запрос (семантика SearchByAnyField)
+    List<int>^ Search(String^ query, int searchType) {
+        String^ lowered = query->ToLower();
+        array<Byte>^ asciiNeedle = AsciiMatcher::IsAscii(lowered) ? Encoding::ASCII->GetBytes(lowered) : nullptr;
+        List<int>^ rows = gcnew List<int>();
+        int count = ids->Length;
+
+        switch (searchType) {
+            case 0:
+            case 1: {
+                // Предикат проверяется на словаре, строки сравниваются по коду
+                ValuePredicate^ predicate = gcnew ValuePredicate(lowered, true);
+                Func<String^, bool>^ test = gcnew Func<String^, bool>(predicate, &ValuePredicate::Test);
+                array<bool>^ hits = searchType == 0 ? firstNames->Match(test) : lastNames->Match(test);
+                array<int>^ codes = searchType == 0 ? firstNameCodes : lastNameCodes;
+                for (int row = 0; row < count; row++) {
+                    if (hits[codes[row]]) rows->Add(row);
+                }
+                break;
+            }
+            case 2:
+                for (int row = 0; row < count; row++) {
+                    if (TextMatches(phones, row, lowered, asciiNeedle, true)) rows->Add(row);
+                }
+                break;
+            case 3: {
+                // Подстрока, пересекающая границу локальной части и домена,
+                // обязательно содержит '@' - только тогда нужна полная строка
+                ValuePredicate^ predicate = gcnew ValuePredicate(lowered, false);
+                array<bool>^ domainHits = emailDomains->Match(gcnew Func<String^, bool>(predicate, &ValuePredicate::Test));
+                bool crossesAt = lowered->IndexOf('@') >= 0;
+                for (int row = 0; row < count; row++) {
+                    bool match;
+                    if (crossesAt) {
+                        match = predicate->Test(GetEmail(row));
+                    }
+                    else {
+                        match = domainHits[emailDomainCodes[row]] || TextMatches(emailLocals, row, lowered, asciiNeedle, false);
+                    }
+                    if (match) rows->Add(row);
+                }
+                break;
+            }
+            case 4:
+                for (int row = 0; row < count; row++) {
+                    if (TextMatches(addresses, row, lowered, asciiNeedle, false)) rows->Add(row);
+                }
+                break;
+            case 5: {
+                // Ключи запроса считаются один раз, имена - по одному разу на
+                // различное значение словаря
+                array<String^>^ keys = NameKeys::QueryKeys(query);
+                array<array<bool>^>^ firstHits = gcnew array<array<bool>^>(keys->Length);
+                array<array<bool>^>^ lastHits = gcnew array<array<bool>^>(keys->Length);
+                for (int k = 0; k < keys->Length; k++) {
+                    Func<String^, bool>^ test = gcnew Func<String^, bool>(gcnew SoundsLikePredicate(keys[k]), &SoundsLikePredicate::Test);
+                    firstHits[k] = firstNames->Match(test);
+                    lastHits[k] = lastNames->Match(test);
+                }
+                for (int row = 0; row < count; row++) {
+                    bool match = true;
+                    for (int k = 0; k < keys->Length && match; k++) {
+                        match = firstHits[k][firstNameCodes[row]] || lastHits[k][lastNameCodes[row]];
+                    }
+                    if (match) rows->Add(row);
+                }
+                break;
+            }
+            case 6: {
+                // Выражение меток - операциями над множествами строк
+                TagSource^ source = gcnew TagSource(this);
+                TagExpression^ expression = TagExpression::Parse(lowered);
+                rows->AddRange((expression == nullptr ? source->All() : expression->Evaluate(source))->ToArray());
+                break;
+            }
+            default:
+                for (int row = 0; row < count; row++) {
+                    rows->Add(row);
+                }
+                break;
+        }
+        return rows;
+    }
+
+    List<NotebookEntry<int>^>^ SearchEntries(String^ query, int searchType) {
+        List<int>^ rows = Search(query, searchType);
+        List<NotebookEntry<int>^>^ result = gcnew List<NotebookEntry<int>^>(rows->Count);
+        for each (int row in rows) {
+            result->Add(GetEntry(row));
+        }
+        return result;
+    }
+
+    // Порядок строк по имени или фамилии: сортировка подсчетом по кодам
+    array<int>^ OrderByName(bool byLastName, bool ascending) {
+        array<int>^ codes = byLastName ? lastNameCodes : firstNameCodes;
+        int distinct = byLastName ? lastNames->Count() : firstNames->Count();
+        array<int>^ starts = gcnew array<int>(distinct + 1);
+        for each (int code in codes) {
+            starts[code + 1]++;
+        }
+        for (int i = 0; i < distinct; i++) {
+            starts[i + 1] += starts[i];
+        }
+        array<int>^ order = gcnew array<int>(codes->Length);
+        for (int row = 0; row < codes->Length; row++) {
+            order[starts[codes[row]]++] = row;
+        }
+        if (!ascending) {
+            Array::Reverse(order);
+        }
+        return order;
+    }
+
+    // Оценка занимаемой памяти (массивы колонок и словари)
+    long long EstimateBytes() {
+        long long rows = ids->LongLength;
+        return 4 * rows * 5
+            + firstNames->EstimateBytes() + lastNames->EstimateBytes()
+            + birthDates->EstimateBytes() + emailDomains->EstimateBytes()
+            + phones->EstimateBytes() + emailLocals->EstimateBytes()
+            + addresses->EstimateBytes() + notes->EstimateBytes()
+            + TagBytes();
+    }
+
+    long long TagBytes() {
+        long long bytes = MemorySizes::ReferenceArrayBytes(tagNames->Length) * 2;
+        for (int t = 0; t < tagNames->Length; t++) {
+            bytes += MemorySizes::StringBytes(tagNames[t]) + tagRows[t]->EstimateBytes();
+        }
+        return bytes;
+    }
+
+    void Save(Stream^ stream) {
+        BinaryWriter^ writer = gcnew BinaryWriter(stream, Encoding::UTF8);
+        writer->Write(Magic);
+        WriteCodes(writer, ids);
+        firstNames->Write(writer);
+        WriteCodes(writer, firstNameCodes);
+        lastNames->Write(writer);
+        WriteCodes(writer, lastNameCodes);
+        phones->Write(writer);
+        birthDates->Write(writer);
+        WriteCodes(writer, birthDateCodes);
+        emailLocals->Write(writer);
+        emailDomains->Write(writer);
+        WriteCodes(writer, emailDomainCodes);
+        addresses->Write(writer);
+        notes->Write(writer);
+        writer->Write(tagNames->Length);
+        for (int t = 0; t < tagNames->Length; t++) {
+            writer->Write(tagNames[t]);
+            tagRows[t]->Write(writer);
+        }
+        writer->Flush();
+    }
+
+    static CompressedBook^ Load(Stream^ stream) {
+        BinaryReader^ reader = gcnew BinaryReader(stream, Encoding::UTF8);
+        int magic = reader->ReadInt32();
+        if (magic != Magic && magic != MagicWithoutTags) {
+            throw gcnew InvalidDataException("Not a compressed notebook snapshot");
+        }
+        CompressedBook^ book = gcnew CompressedBook();
+        book->ids = ReadCodes(reader);
+        book->firstNames = FrontCodedDictionary::Read(reader);
+        book->firstNameCodes = ReadCodes(reader);
+        book->lastNames = FrontCodedDictionary::Read(reader);
+        book->lastNameCodes = ReadCodes(reader);
+        book->phones = SymbolColumn::Read(reader);
+        book->birthDates = StringDictionary::Read(reader);
+        book->birthDateCodes = ReadCodes(reader);
+        book->emailLocals = SymbolColumn::Read(reader);
+        book->emailDomains = StringDictionary::Read(reader);
+        book->emailDomainCodes = ReadCodes(reader);
+        book->addresses = SymbolColumn::Read(reader);
+        book->notes = SymbolColumn::Read(reader);
+        int tagCount = magic == Magic ? reader->ReadInt32() : 0;
+        book->tagNames = gcnew array<String^>(tagCount);
+        book->tagRows = gcnew array<RoaringBitmap^>(tagCount);
+        for (int t = 0; t < tagCount; t++) {
+            book->tagNames[t] = String::Intern(reader->ReadString());
+            book->tagRows[t] = RoaringBitmap::Read(reader);
+        }
+        return book;
+    }
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+using namespace System;
+
+// Контрольная сумма CRC-32 (IEEE 802.3, как в zip и png) для блоков,
+// записываемых на диск
+public ref class Crc32 abstract sealed {
+private:
+    static array<unsigned int>^ table = BuildTable();
+
+    static array<unsigned int>^ BuildTable() {
+        array<unsigned int>^ result = gcnew array<unsigned int>(256);
+        for (unsigned int i = 0; i < 256; i++) {
+            unsigned int value = i;
+            for (int bit = 0; bit < 8; bit++) {
+                value = (value & 1) != 0 ? (value >> 1) ^ 0xEDB88320u : value >> 1;
+            }
+            result[i] = value;
+        }
+        return result;
+    }
+
+public:
+    // Продолжение суммы: crc - результат предыдущего вызова (0 в начале)
+    static unsigned int Update(unsigned int crc, array<Byte>^ data, int offset, int count) {
+        unsigned int value = ~crc;
+        for (int i = offset; i < offset + count; i++) {
+            value = table[(value ^ data[i]) & 0xFF] ^ (value >> 8);
+        }
+        return ~value;
+    }
+
+    static unsigned int Compute(array<Byte>^ data, int offset, int count) {
+        return Update(0, data, offset, count);
+    }
+};
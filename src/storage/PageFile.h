@@ -0,0 +1,107 @@
+#pragma once
+
+using namespace System;
+using namespace System::IO;
+
+// Чтение и запись чисел в странице (little-endian)
+public ref class PageBytes abstract sealed {
+public:
+    static int ReadUInt16(array<Byte>^ page, int offset) {
+        return page[offset] | (page[offset + 1] << 8);
+    }
+
+    static void WriteUInt16(array<Byte>^ page, int offset, int value) {
+        page[offset] = (Byte)value;
+        page[offset + 1] = (Byte)(value >> 8);
+    }
+
+    static int ReadInt32(array<Byte>^ page, int offset) {
+        return page[offset] | (page[offset + 1] << 8) | (page[offset + 2] << 16) | (page[offset + 3] << 24);
+    }
+
+    static void WriteInt32(array<Byte>^ page, int offset, int value) {
+        page[offset] = (Byte)value;
+        page[offset + 1] = (Byte)(value >> 8);
+        page[offset + 2] = (Byte)(value >> 16);
+        page[offset + 3] = (Byte)(value >> 24);
+    }
+
+    static long long ReadInt64(array<Byte>^ page, int offset) {
+        return (unsigned int)ReadInt32(page, offset) | ((long long)ReadInt32(page, offset + 4) << 32);
+    }
+
+    static void WriteInt64(array<Byte>^ page, int offset, long long value) {
+        WriteInt32(page, offset, (int)value);
+        WriteInt32(page, offset + 4, (int)(value >> 32));
+    }
+};
+
+// Общий заголовок страницы: тип, число слотов/ключей, начало области
+// записей (для страниц данных) и ссылка на следующую страницу (для листьев)
+public ref class PageLayout abstract sealed {
+public:
+    literal int HeaderSize = 16;
+    literal int TypeOffset = 0;
+    literal int CountOffset = 2;
+    literal int HeapOffset = 4;
+    literal int NextOffset = 8;
+
+    literal Byte TypeHeader = 0;
+    literal Byte TypeData = 1;
+    literal Byte TypeLeaf = 2;
+    literal Byte TypeInner = 3;
+};
+
+// Файл из страниц фиксированного размера с произвольным доступом.
+// Страница 0 - заголовок книги, остальные - данные и узлы индекса.
+public ref class PageFile {
+public:
+    literal int PageSize = 8192;
+
+private:
+    FileStream^ stream;
+    int pageCount;
+
+public:
+    PageFile(String^ path) {
+        stream = gcnew FileStream(path, FileMode::OpenOrCreate, FileAccess::ReadWrite,
+            FileShare::None, PageSize, FileOptions::RandomAccess);
+        pageCount = (int)((stream->Length + PageSize - 1) / PageSize);
+    }
+
+    int GetPageCount() {
+        return pageCount;
+    }
+
+    // Номер новой страницы; на диск она попадет при первой записи
+    int Allocate() {
+        return pageCount++;
+    }
+
+    void Read(int pageId, array<Byte>^ buffer) {
+        stream->Position = (long long)pageId * PageSize;
+        int read = 0;
+        while (read < PageSize) {
+            int n = stream->Read(buffer, read, PageSize - read);
+            if (n == 0) {
+                // Хвост файла, еще не записанный на диск
+                Array::Clear(buffer, read, PageSize - read);
+                break;
+            }
+            read += n;
+        }
+    }
+
+    void Write(int pageId, array<Byte>^ buffer) {
+        stream->Position = (long long)pageId * PageSize;
+        stream->Write(buffer, 0, PageSize);
+    }
+
+    void Flush() {
+        stream->Flush(true);
+    }
+
+    void Close() {
+        stream->Close();
+    }
+};
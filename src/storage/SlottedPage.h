@@ -0,0 +1,199 @@
+#pragma once
+#include "PageFile.h"
+#include "../models/NotebookEntry.h"
+
+using namespace System;
+using namespace System::Text;
+
+// Страница данных со слотами: каталог слотов (смещение, длина) растет
+// от заголовка, сами записи - от конца страницы. Номер слота не меняется
+// при уплотнении, поэтому адрес записи (страница, слот) остается верным.
+// Слот с нулевой длиной свободен.
+public ref class SlottedPage abstract sealed {
+private:
+    literal int SlotSize = 4;
+
+    static int SlotAt(int slot) {
+        return PageLayout::HeaderSize + slot * SlotSize;
+    }
+
+    static int GetHeap(array<Byte>^ page) {
+        return PageBytes::ReadUInt16(page, PageLayout::HeapOffset);
+    }
+
+    static void SetSlot(array<Byte>^ page, int slot, int offset, int length) {
+        PageBytes::WriteUInt16(page, SlotAt(slot), offset);
+        PageBytes::WriteUInt16(page, SlotAt(slot) + 2, length);
+    }
+
+    static int LiveBytes(array<Byte>^ page) {
+        int total = 0;
+        int count = GetCount(page);
+        for (int i = 0; i < count; i++) {
+            total += PageBytes::ReadUInt16(page, SlotAt(i) + 2);
+        }
+        return total;
+    }
+
+    static int ContiguousBytes(array<Byte>^ page) {
+        return GetHeap(page) - SlotAt(GetCount(page));
+    }
+
+    // Сдвиг живых записей к концу страницы, чтобы свободное место стало сплошным
+    static void Compact(array<Byte>^ page) {
+        array<Byte>^ copy = safe_cast<array<Byte>^>(page->Clone());
+        int heap = PageFile::PageSize;
+        int count = GetCount(page);
+        for (int i = 0; i < count; i++) {
+            int length = PageBytes::ReadUInt16(copy, SlotAt(i) + 2);
+            if (length == 0) continue;
+            heap -= length;
+            Buffer::BlockCopy(copy, PageBytes::ReadUInt16(copy, SlotAt(i)), page, heap, length);
+            PageBytes::WriteUInt16(page, SlotAt(i), heap);
+        }
+        PageBytes::WriteUInt16(page, PageLayout::HeapOffset, heap);
+    }
+
+    static void Place(array<Byte>^ page, int slot, array<Byte>^ record, int length) {
+        int heap = GetHeap(page) - length;
+        Buffer::BlockCopy(record, 0, page, heap, length);
+        PageBytes::WriteUInt16(page, PageLayout::HeapOffset, heap);
+        SetSlot(page, slot, heap, length);
+    }
+
+public:
+    // Самая длинная запись, которая помещается на пустую страницу
+    literal int MaxRecordBytes = PageFile::PageSize - PageLayout::HeaderSize - SlotSize;
+
+    static void Init(array<Byte>^ page) {
+        Array::Clear(page, 0, page->Length);
+        page[PageLayout::TypeOffset] = PageLayout::TypeData;
+        PageBytes::WriteUInt16(page, PageLayout::HeapOffset, PageFile::PageSize);
+    }
+
+    static int GetCount(array<Byte>^ page) {
+        return PageBytes::ReadUInt16(page, PageLayout::CountOffset);
+    }
+
+    // Свободное место с учетом дыр от удаленных записей
+    static int FreeBytes(array<Byte>^ page) {
+        return PageFile::PageSize - SlotAt(GetCount(page)) - LiveBytes(page);
+    }
+
+    static bool TryGetRecord(array<Byte>^ page, int slot, int% offset, int% length) {
+        if (slot >= GetCount(page)) return false;
+        offset = PageBytes::ReadUInt16(page, SlotAt(slot));
+        length = PageBytes::ReadUInt16(page, SlotAt(slot) + 2);
+        return length > 0;
+    }
+
+    // Вставка записи; -1, если места на странице нет
+    static int Insert(array<Byte>^ page, array<Byte>^ record, int length) {
+        int count = GetCount(page);
+        int slot = -1;
+        for (int i = 0; i < count; i++) {
+            if (PageBytes::ReadUInt16(page, SlotAt(i) + 2) == 0) {
+                slot = i;
+                break;
+            }
+        }
+        int needed = length + (slot < 0 ? SlotSize : 0);
+        if (FreeBytes(page) < needed) return -1;
+        if (ContiguousBytes(page) < needed) Compact(page);
+        if (slot < 0) {
+            slot = count;
+            PageBytes::WriteUInt16(page, PageLayout::CountOffset, count + 1);
+        }
+        Place(page, slot, record, length);
+        return slot;
+    }
+
+    // Замена записи на месте; false, если новая версия не помещается на странице
+    static bool Update(array<Byte>^ page, int slot, array<Byte>^ record, int length) {
+        int offset = PageBytes::ReadUInt16(page, SlotAt(slot));
+        int oldLength = PageBytes::ReadUInt16(page, SlotAt(slot) + 2);
+        if (length <= oldLength) {
+            Buffer::BlockCopy(record, 0, page, offset, length);
+            SetSlot(page, slot, offset, length);
+            return true;
+        }
+        if (FreeBytes(page) + oldLength < length) return false;
+        SetSlot(page, slot, 0, 0);
+        if (ContiguousBytes(page) < length) Compact(page);
+        Place(page, slot, record, length);
+        return true;
+    }
+
+    static void Delete(array<Byte>^ page, int slot) {
+        SetSlot(page, slot, 0, 0);
+        // Пустые слоты в конце каталога возвращаются в свободное место
+        int count = GetCount(page);
+        while (count > 0 && PageBytes::ReadUInt16(page, SlotAt(count - 1) + 2) == 0) {
+            count--;
+        }
+        PageBytes::WriteUInt16(page, PageLayout::CountOffset, count);
+    }
+};
+
+// Двоичное представление записи: ID и семь строк UTF-8 с длиной в 2 байта
+public ref class RecordCodec abstract sealed {
+private:
+    static int WriteField(array<Byte>^ buffer, int position, String^ value, int id) {
+        if (value == nullptr) value = "";
+        int length = Encoding::UTF8->GetByteCount(value);
+        if (position + 2 + length > SlottedPage::MaxRecordBytes) {
+            throw gcnew ArgumentException("Entry " + id + " is too large for a storage page");
+        }
+        PageBytes::WriteUInt16(buffer, position, length);
+        Encoding::UTF8->GetBytes(value, 0, value->Length, buffer, position + 2);
+        return position + 2 + length;
+    }
+
+    static String^ ReadField(array<Byte>^ page, int% position) {
+        int length = PageBytes::ReadUInt16(page, position);
+        String^ value = Encoding::UTF8->GetString(page, position + 2, length);
+        position += 2 + length;
+        return value;
+    }
+
+    static int FieldBytes(String^ value) {
+        return 2 + (value == nullptr ? 0 : Encoding::UTF8->GetByteCount(value));
+    }
+
+public:
+    // Запись помещается на одну страницу (иначе Encode бросает ArgumentException)
+    static bool Fits(NotebookEntry<int>^ entry) {
+        int length = 4 + FieldBytes(entry->GetFirstName()) + FieldBytes(entry->GetLastName())
+            + FieldBytes(entry->GetPhoneNumber()) + FieldBytes(entry->GetBirthDate())
+            + FieldBytes(entry->GetEmail()) + FieldBytes(entry->GetAddress()) + FieldBytes(entry->GetNotes());
+        return length <= SlottedPage::MaxRecordBytes;
+    }
+
+    // Кодирование в буфер размером не меньше страницы; возвращает длину
+    static int Encode(NotebookEntry<int>^ entry, array<Byte>^ buffer) {
+        int id = entry->GetId();
+        PageBytes::WriteInt32(buffer, 0, id);
+        int position = 4;
+        position = WriteField(buffer, position, entry->GetFirstName(), id);
+        position = WriteField(buffer, position, entry->GetLastName(), id);
+        position = WriteField(buffer, position, entry->GetPhoneNumber(), id);
+        position = WriteField(buffer, position, entry->GetBirthDate(), id);
+        position = WriteField(buffer, position, entry->GetEmail(), id);
+        position = WriteField(buffer, position, entry->GetAddress(), id);
+        position = WriteField(buffer, position, entry->GetNotes(), id);
+        return position;
+    }
+
+    static NotebookEntry<int>^ Decode(array<Byte>^ page, int offset) {
+        int id = PageBytes::ReadInt32(page, offset);
+        int position = offset + 4;
+        String^ firstName = ReadField(page, position);
+        String^ lastName = ReadField(page, position);
+        String^ phoneNumber = ReadField(page, position);
+        String^ birthDate = ReadField(page, position);
+        String^ email = ReadField(page, position);
+        String^ address = ReadField(page, position);
+        String^ notes = ReadField(page, position);
+        return gcnew NotebookEntry<int>(id, firstName, lastName, phoneNumber, birthDate, email, address, notes);
+    }
+};
@@ -0,0 +1,421 @@
+#pragma once
+#include "../models/NotebookEntry.h"
+#include "../models/NotebookChange.h"
+#include "AtomicFile.h"
+#include "Crc32.h"
+#include "PageFile.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::IO;
+using namespace System::Text;
+using namespace Newtonsoft::Json;
+
+// Одно изменение списка в журнале: вставка, удаление или замена диапазона
+public ref class JournalRecord {
+public:
+    [JsonProperty("op")]
+    String^ op;
+    [JsonProperty("index")]
+    int index;
+    [JsonProperty("count")]
+    int count;
+    [JsonProperty("entries")]
+    List<NotebookEntry<int>^>^ entries;
+    // ID записей, которые стояли на этих местах до операции (удаление и
+    // замена); по ним блок проверяется перед повтором
+    [JsonProperty("ids", NullValueHandling = NullValueHandling::Ignore)]
+    List<int>^ ids;
+};
+
+// Итоги восстановления книги при загрузке
+public ref class JournalRecovery {
+public:
+    // Операций повторено из журнала
+    int replayedOperations;
+    // Отброшенный оборванный хвост журнала, байт
+    long long discardedBytes;
+    // Журнал относился к другой версии файла (сохранен как .stale)
+    bool staleJournal;
+    // Файл хранения не читался, книга взята из предыдущей версии (.bak)
+    bool restoredFromBackup;
+    // Копия поврежденного файла хранения (nullptr - повреждения не было)
+    String^ damagedCopyPath;
+    double milliseconds;
+};
+
+// Журнал операций рядом с файлом хранения. Заголовок связывает журнал с
+// опубликованной версией файла (длина текста и JsonSpans::Combine хешей ее
+// объектов), за ним идут блоки [длина][CRC-32][JSON операции] - по одному
+// на операцию.
+// Блок дописывается и сбрасывается на диск до возврата из операции, поэтому
+// после сбоя теряется не больше одной операции: оборванный или испорченный
+// хвост не проходит проверку суммы и отбрасывается. Размер журнала
+// ограничен контрольной точкой (NotebookManager::CheckpointBytes), так что
+// время восстановления не зависит от размера книги.
+public ref class StorageJournal {
+public:
+    literal int HeaderSize = 24;
+    literal int FrameHeaderSize = 8;
+    literal int Magic = 0x314A424E;     // "NBJ1"
+
+private:
+    String^ path;
+    // Длина проверенной части журнала; -1 - заголовок не записан
+    long long length = -1;
+
+    static String^ KindName(NotebookChangeKind kind) {
+        switch (kind) {
+        case NotebookChangeKind::Inserted: return "insert";
+        case NotebookChangeKind::Removed: return "remove";
+        case NotebookChangeKind::Updated: return "update";
+        default: return nullptr;
+        }
+    }
+
+    // Записи на месте [index, index + count) - те, что были там при записи
+    // операции (журнал без ID не проверяется)
+    static bool SameIds(JournalRecord^ record, int count, List<NotebookEntry<int>^>^ entries) {
+        if (record->ids == nullptr) return true;
+        if (record->ids->Count != count) return false;
+        for (int k = 0; k < count; k++) {
+            if (entries[record->index + k]->GetId() != record->ids[k]) return false;
+        }
+        return true;
+    }
+
+    // Применение одного изменения с проверкой индексов и ID. Возвращает
+    // обратное изменение или nullptr, если изменение не подходит к списку
+    static JournalRecord^ ApplyRecord(JournalRecord^ record, List<NotebookEntry<int>^>^ entries) {
+        if (record == nullptr || record->index < 0) return nullptr;
+        JournalRecord^ inverse = gcnew JournalRecord();
+        inverse->index = record->index;
+        if (record->op == "insert") {
+            if (record->entries == nullptr || record->index > entries->Count) return nullptr;
+            entries->InsertRange(record->index, record->entries);
+            inverse->op = "remove";
+            inverse->count = record->entries->Count;
+        }
+        else if (record->op == "remove") {
+            if (record->count < 0 || record->index + record->count > entries->Count
+                || !SameIds(record, record->count, entries)) return nullptr;
+            inverse->op = "insert";
+            inverse->entries = entries->GetRange(record->index, record->count);
+            entries->RemoveRange(record->index, record->count);
+        }
+        else if (record->op == "update") {
+            if (record->entries == nullptr || record->index + record->entries->Count > entries->Count
+                || !SameIds(record, record->entries->Count, entries)) return nullptr;
+            inverse->op = "update";
+            inverse->entries = entries->GetRange(record->index, record->entries->Count);
+            for (int k = 0; k < record->entries->Count; k++) {
+                entries[record->index + k] = record->entries[k];
+            }
+        }
+        else {
+            return nullptr;
+        }
+        return inverse;
+    }
+
+    // Применение блока целиком или никак: если очередное изменение не
+    // подходит, уже примененные изменения блока откатываются
+    static bool TryApply(List<JournalRecord^>^ records, List<NotebookEntry<int>^>^ entries) {
+        List<JournalRecord^>^ undo = gcnew List<JournalRecord^>(records->Count);
+        for each (JournalRecord^ record in records) {
+            JournalRecord^ inverse = ApplyRecord(record, entries);
+            if (inverse == nullptr) {
+                for (int k = undo->Count - 1; k >= 0; k--) {
+                    ApplyRecord(undo[k], entries);
+                }
+                return false;
+            }
+            undo->Add(inverse);
+        }
+        return true;
+    }
+
+    // Блок журнала по смещению position; nullptr - блок оборван, не прошел
+    // проверку суммы или не разбирается
+    static List<JournalRecord^>^ ReadFrame(array<Byte>^ data, int position, int% size) {
+        if (data->Length - position < FrameHeaderSize) return nullptr;
+        size = PageBytes::ReadInt32(data, position);
+        if (size < 0 || size > data->Length - position - FrameHeaderSize) return nullptr;
+        unsigned int crc = (unsigned int)PageBytes::ReadInt32(data, position + 4);
+        if (Crc32::Compute(data, position + FrameHeaderSize, size) != crc) return nullptr;
+        try {
+            return JsonConvert::DeserializeObject<List<JournalRecord^>^>(
+                (gcnew UTF8Encoding(false))->GetString(data, position + FrameHeaderSize, size));
+        }
+        catch (JsonException^) {
+            return nullptr;
+        }
+    }
+
+    // Rebase: новое значение записи с этим ID
+    static void Put(NotebookEntry<int>^ entry, int index, HashSet<int>^ external,
+                    Dictionary<int, NotebookEntry<int>^>^ replaced,
+                    List<KeyValuePair<int, NotebookEntry<int>^>>^ added, Dictionary<int, int>^ addedById) {
+        int id = entry->GetId();
+        int slot;
+        if (addedById->TryGetValue(id, slot)) {
+            added[slot] = KeyValuePair<int, NotebookEntry<int>^>(added[slot].Key, entry);
+        }
+        else if (external->Contains(id)) {
+            replaced[id] = entry;
+        }
+        else {
+            addedById[id] = added->Count;
+            added->Add(KeyValuePair<int, NotebookEntry<int>^>(index, entry));
+        }
+    }
+
+    // Rebase: запись с этим ID удалена
+    static void Drop(int id, HashSet<int>^ external, Dictionary<int, NotebookEntry<int>^>^ replaced,
+                     List<KeyValuePair<int, NotebookEntry<int>^>>^ added, Dictionary<int, int>^ addedById) {
+        int slot;
+        if (addedById->TryGetValue(id, slot)) {
+            added[slot] = KeyValuePair<int, NotebookEntry<int>^>(added[slot].Key, nullptr);
+            addedById->Remove(id);
+        }
+        else if (external->Contains(id)) {
+            replaced[id] = nullptr;
+        }
+    }
+
+    void Truncate(long long size) {
+        FileStream^ stream = gcnew FileStream(path, FileMode::Open, FileAccess::Write, FileShare::Read);
+        try {
+            stream->SetLength(size);
+            stream->Flush(true);
+        }
+        finally {
+            stream->Close();
+        }
+    }
+
+public:
+    StorageJournal(String^ path) {
+        this->path = path;
+    }
+
+    String^ GetPath() {
+        return path;
+    }
+
+    long long GetLength() {
+        return length;
+    }
+
+    // Заголовок записан этим экземпляром - можно дописывать операции
+    bool IsReady() {
+        return length >= HeaderSize;
+    }
+
+    bool HasOperations() {
+        return length > HeaderSize;
+    }
+
+    // Операции, которые можно записать в журнал (перестановки и полная
+    // замена списка требуют контрольной точки)
+    static bool CanRecord(List<NotebookChange^>^ changes) {
+        if (changes == nullptr) return false;
+        for each (NotebookChange^ change in changes) {
+            if (KindName(change->kind) == nullptr) return false;
+        }
+        return true;
+    }
+
+    // Новый пустой журнал для опубликованной версии файла хранения
+    void Reset(long long baseLength, unsigned long long baseHash) {
+        array<Byte>^ header = gcnew array<Byte>(HeaderSize);
+        PageBytes::WriteInt32(header, 0, Magic);
+        PageBytes::WriteInt64(header, 4, baseLength);
+        PageBytes::WriteInt64(header, 12, (long long)baseHash);
+        PageBytes::WriteInt32(header, 20, (int)Crc32::Compute(header, 0, 20));
+        length = -1;
+        FileStream^ stream = gcnew FileStream(path, FileMode::Create, FileAccess::Write, FileShare::Read,
+            4096, FileOptions::WriteThrough);
+        try {
+            StorageFaults::Write(stream, header, 0, HeaderSize);
+            stream->Flush(true);
+        }
+        finally {
+            stream->Close();
+        }
+        length = HeaderSize;
+    }
+
+    // Запись одной операции (пакета изменений) отдельным блоком
+    void Append(List<NotebookChange^>^ changes) {
+        if (!IsReady()) {
+            throw gcnew InvalidOperationException("Journal has no header: " + path);
+        }
+        List<JournalRecord^>^ records = gcnew List<JournalRecord^>(changes->Count);
+        for each (NotebookChange^ change in changes) {
+            JournalRecord^ record = gcnew JournalRecord();
+            record->op = KindName(change->kind);
+            record->index = change->index;
+            record->count = change->count;
+            if (change->kind != NotebookChangeKind::Removed) {
+                record->entries = change->entries;
+            }
+            List<NotebookEntry<int>^>^ replaced = change->kind == NotebookChangeKind::Removed ? change->entries
+                : change->kind == NotebookChangeKind::Updated ? change->oldEntries : nullptr;
+            if (replaced != nullptr) {
+                record->ids = gcnew List<int>(replaced->Count);
+                for each (NotebookEntry<int>^ entry in replaced) {
+                    record->ids->Add(entry->GetId());
+                }
+            }
+            records->Add(record);
+        }
+        array<Byte>^ payload = (gcnew UTF8Encoding(false))->GetBytes(JsonConvert::SerializeObject(records));
+        array<Byte>^ frame = gcnew array<Byte>(FrameHeaderSize + payload->Length);
+        PageBytes::WriteInt32(frame, 0, payload->Length);
+        PageBytes::WriteInt32(frame, 4, (int)Crc32::Compute(payload, 0, payload->Length));
+        Array::Copy(payload, 0, frame, FrameHeaderSize, payload->Length);
+
+        // Позиция - конец проверенной части: все, что дальше, - мусор после сбоя
+        FileStream^ stream = gcnew FileStream(path, FileMode::Open, FileAccess::Write, FileShare::Read,
+            4096, FileOptions::WriteThrough);
+        try {
+            stream->Position = length;
+            StorageFaults::Write(stream, frame, 0, frame->Length);
+            stream->SetLength(length + frame->Length);
+            stream->Flush(true);
+        }
+        finally {
+            stream->Close();
+        }
+        length += frame->Length;
+    }
+
+    // Повтор операций журнала поверх списка, прочитанного из версии файла
+    // с указанными длиной и хешем.
+    // Блоки читаются до первого, не прошедшего проверку или не подходящего
+    // к списку (индексы или ID записей не совпали); хвост после него
+    // отрезается. Журнал от другой версии файла не применяется.
+    // Возвращает число повторенных операций
+    int Replay(long long baseLength, unsigned long long baseHash, List<NotebookEntry<int>^>^ entries, JournalRecovery^ report) {
+        length = -1;
+        if (!File::Exists(path)) return 0;
+        array<Byte>^ data = File::ReadAllBytes(path);
+        if (data->Length < HeaderSize
+            || PageBytes::ReadInt32(data, 0) != Magic
+            || (unsigned int)PageBytes::ReadInt32(data, 20) != Crc32::Compute(data, 0, 20)) {
+            // Заголовок не дописан: сбой пришелся на сброс журнала после публикации
+            return 0;
+        }
+        if (PageBytes::ReadInt64(data, 4) != baseLength
+            || (unsigned long long)PageBytes::ReadInt64(data, 12) != baseHash) {
+            report->staleJournal = data->Length > HeaderSize;
+            return 0;
+        }
+
+        int position = HeaderSize;
+        int replayed = 0;
+        while (true) {
+            int size = 0;
+            List<JournalRecord^>^ records = ReadFrame(data, position, size);
+            if (records == nullptr || !TryApply(records, entries)) break;
+            position += FrameHeaderSize + size;
+            replayed++;
+        }
+
+        report->replayedOperations = replayed;
+        report->discardedBytes = data->Length - position;
+        if (position < data->Length) {
+            Truncate(position);
+        }
+        length = position;
+        return replayed;
+    }
+
+    // Перенос операций журнала на список из новой версии файла хранения,
+    // измененного другой программой. Индексы к такому списку не подходят,
+    // поэтому записи ищутся по ID: вставка и замена ставят запись на место
+    // записи с тем же ID (или около прежнего индекса, если ее нет),
+    // удаление убирает записи с этими ID. Возвращает число операций
+    int Rebase(List<NotebookEntry<int>^>^ entries) {
+        if (!HasOperations()) return 0;
+        array<Byte>^ data = File::ReadAllBytes(path);
+        if (data->Length > length) {
+            Array::Resize(data, (int)length);
+        }
+
+        HashSet<int>^ external = gcnew HashSet<int>();
+        for each (NotebookEntry<int>^ entry in entries) {
+            external->Add(entry->GetId());
+        }
+        // Новые значения записей списка по ID (nullptr - запись удалена)
+        Dictionary<int, NotebookEntry<int>^>^ replaced = gcnew Dictionary<int, NotebookEntry<int>^>();
+        // Записи, которых нет в списке: прежний индекс и запись (nullptr - удалена)
+        List<KeyValuePair<int, NotebookEntry<int>^>>^ added = gcnew List<KeyValuePair<int, NotebookEntry<int>^>>();
+        Dictionary<int, int>^ addedById = gcnew Dictionary<int, int>();
+
+        int position = HeaderSize;
+        int rebased = 0;
+        while (true) {
+            int size = 0;
+            List<JournalRecord^>^ records = ReadFrame(data, position, size);
+            if (records == nullptr) break;
+            for each (JournalRecord^ record in records) {
+                if (record == nullptr) continue;
+                if (record->op == "remove" && record->ids != nullptr) {
+                    for each (int id in record->ids) {
+                        Drop(id, external, replaced, added, addedById);
+                    }
+                }
+                else if ((record->op == "insert" || record->op == "update") && record->entries != nullptr) {
+                    for (int k = 0; k < record->entries->Count; k++) {
+                        NotebookEntry<int>^ entry = record->entries[k];
+                        if (record->ids != nullptr && k < record->ids->Count && record->ids[k] != entry->GetId()) {
+                            Drop(record->ids[k], external, replaced, added, addedById);
+                        }
+                        Put(entry, record->index + k, external, replaced, added, addedById);
+                    }
+                }
+            }
+            position += FrameHeaderSize + size;
+            rebased++;
+        }
+
+        List<NotebookEntry<int>^>^ kept = gcnew List<NotebookEntry<int>^>(entries->Count);
+        for each (NotebookEntry<int>^ entry in entries) {
+            NotebookEntry<int>^ value;
+            if (!replaced->TryGetValue(entry->GetId(), value)) {
+                kept->Add(entry);
+                continue;
+            }
+            // Повтор ID в списке: заменяется только первая запись
+            replaced->Remove(entry->GetId());
+            if (value != nullptr) kept->Add(value);
+        }
+
+        // Новые записи по прежним индексам; при равных - в порядке операций
+        List<long long>^ keys = gcnew List<long long>(added->Count);
+        List<NotebookEntry<int>^>^ values = gcnew List<NotebookEntry<int>^>(added->Count);
+        for (int i = 0; i < added->Count; i++) {
+            if (added[i].Value == nullptr) continue;
+            keys->Add(((long long)added[i].Key << 32) | i);
+            values->Add(added[i].Value);
+        }
+        array<long long>^ order = keys->ToArray();
+        array<NotebookEntry<int>^>^ inserted = values->ToArray();
+        Array::Sort(order, inserted);
+
+        entries->Clear();
+        int next = 0;
+        for each (NotebookEntry<int>^ entry in kept) {
+            while (next < inserted->Length && (int)(order[next] >> 32) <= entries->Count) {
+                entries->Add(inserted[next++]);
+            }
+            entries->Add(entry);
+        }
+        while (next < inserted->Length) {
+            entries->Add(inserted[next++]);
+        }
+        return rebased;
+    }
+};
@@ -0,0 +1,406 @@
+#pragma once
+#include "MemoryAccounting.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+
+// Префиксный индекс различных значений поля с частотами - сжатое
+// префиксное дерево (radix trie): у узла метка - участок общего буфера
+// символов, у цепочки без ветвлений - один узел. Узлы лежат в параллельных
+// массивах int (метка, число записей со значением, максимум в поддереве,
+// первый потомок, следующий брат, родитель) - 28 байт на узел без
+// объектов и ссылок, поэтому миллионы значений занимают десятки мегабайт.
+// Максимум по поддереву позволяет выдавать k самых частых продолжений
+// обходом по убыванию (best-first), не просматривая все значения с
+// этим префиксом. Добавление и удаление значения - O(длины значения).
+public ref class CompletionTrie {
+public:
+    // Продолжение префикса: значение и число записей с ним
+    ref class Completion {
+    public:
+        initonly String^ value;
+        initonly int count;
+        Completion(String^ value, int count) : value(value), count(count) {}
+    };
+
+private:
+    literal int NoNode = -1;
+
+    array<wchar_t>^ chars;
+    int charCount;
+    // Символы меток удаленных узлов; при большом остатке буфер перестраивается
+    int deadChars;
+
+    array<int>^ labelStart;
+    array<int>^ labelLength;
+    array<int>^ count;
+    array<int>^ best;
+    array<int>^ firstChild;
+    array<int>^ nextSibling;
+    array<int>^ parent;
+    int nodeCount;
+    // Освобожденные узлы (связаны через nextSibling)
+    int freeNode;
+    int freeCount;
+
+    int distinct;
+    long long total;
+
+    // Кандидат обхода: узел (его поддерево) или готовое значение
+    ref class Candidate {
+    public:
+        int priority;
+        int node;
+        String^ text;
+        bool isValue;
+        Candidate(int priority, int node, String^ text, bool isValue)
+            : priority(priority), node(node), text(text), isValue(isValue) {}
+    };
+
+    // Двоичная куча по убыванию priority, при равенстве - по алфавиту
+    ref class CandidateHeap {
+    private:
+        List<Candidate^>^ items;
+
+        static bool Before(Candidate^ x, Candidate^ y) {
+            if (x->priority != y->priority) return x->priority > y->priority;
+            return String::CompareOrdinal(x->text, y->text) < 0;
+        }
+
+    public:
+        CandidateHeap() : items(gcnew List<Candidate^>()) {}
+
+        property int Count { int get() { return items->Count; } }
+
+        void Push(Candidate^ item) {
+            items->Add(item);
+            int i = items->Count - 1;
+            while (i > 0) {
+                int up = (i - 1) / 2;
+                if (!Before(items[i], items[up])) break;
+                Candidate^ swap = items[i];
+                items[i] = items[up];
+                items[up] = swap;
+                i = up;
+            }
+        }
+
+        Candidate^ Pop() {
+            Candidate^ top = items[0];
+            Candidate^ last = items[items->Count - 1];
+            items->RemoveAt(items->Count - 1);
+            if (items->Count > 0) {
+                items[0] = last;
+                int i = 0;
+                while (true) {
+                    int left = 2 * i + 1;
+                    int right = left + 1;
+                    int first = i;
+                    if (left < items->Count && Before(items[left], items[first])) first = left;
+                    if (right < items->Count && Before(items[right], items[first])) first = right;
+                    if (first == i) break;
+                    Candidate^ swap = items[i];
+                    items[i] = items[first];
+                    items[first] = swap;
+                    i = first;
+                }
+            }
+            return top;
+        }
+    };
+
+    void EnsureNodes(int needed) {
+        if (needed <= labelStart->Length) return;
+        int size = Math::Max(needed, labelStart->Length * 2);
+        Array::Resize(labelStart, size);
+        Array::Resize(labelLength, size);
+        Array::Resize(count, size);
+        Array::Resize(best, size);
+        Array::Resize(firstChild, size);
+        Array::Resize(nextSibling, size);
+        Array::Resize(parent, size);
+    }
+
+    int AppendChars(String^ value, int start) {
+        int length = value->Length - start;
+        if (charCount + length > chars->Length) {
+            Array::Resize(chars, Math::Max(charCount + length, chars->Length * 2));
+        }
+        value->CopyTo(start, chars, charCount, length);
+        charCount += length;
+        return charCount - length;
+    }
+
+    int NewNode(int start, int length, int parentNode) {
+        int node;
+        if (freeNode != NoNode) {
+            node = freeNode;
+            freeNode = nextSibling[node];
+            freeCount--;
+        }
+        else {
+            EnsureNodes(nodeCount + 1);
+            node = nodeCount++;
+        }
+        labelStart[node] = start;
+        labelLength[node] = length;
+        count[node] = 0;
+        best[node] = 0;
+        firstChild[node] = NoNode;
+        nextSibling[node] = NoNode;
+        parent[node] = parentNode;
+        return node;
+    }
+
+    void AddChild(int node, int child) {
+        nextSibling[child] = firstChild[node];
+        firstChild[node] = child;
+        parent[child] = node;
+    }
+
+    void ReplaceChild(int node, int oldChild, int newChild) {
+        if (firstChild[node] == oldChild) {
+            firstChild[node] = newChild;
+        }
+        else {
+            int sibling = firstChild[node];
+            while (nextSibling[sibling] != oldChild) sibling = nextSibling[sibling];
+            nextSibling[sibling] = newChild;
+        }
+        nextSibling[newChild] = nextSibling[oldChild];
+        parent[newChild] = node;
+    }
+
+    int FindChild(int node, wchar_t c) {
+        for (int child = firstChild[node]; child != NoNode; child = nextSibling[child]) {
+            if (chars[labelStart[child]] == c) return child;
+        }
+        return NoNode;
+    }
+
+    int CommonPrefix(int node, String^ value, int start) {
+        int length = Math::Min(labelLength[node], value->Length - start);
+        int i = 0;
+        while (i < length && chars[labelStart[node] + i] == value[start + i]) i++;
+        return i;
+    }
+
+    // Узел, в котором заканчивается значение; NoNode - такого значения нет
+    int FindExact(String^ value) {
+        int node = 0;
+        int i = 0;
+        while (i < value->Length) {
+            int child = FindChild(node, value[i]);
+            if (child == NoNode) return NoNode;
+            int matched = CommonPrefix(child, value, i);
+            if (matched != labelLength[child]) return NoNode;
+            node = child;
+            i += matched;
+        }
+        return node;
+    }
+
+    int ChildrenBest(int node) {
+        int result = 0;
+        for (int child = firstChild[node]; child != NoNode; child = nextSibling[child]) {
+            result = Math::Max(result, best[child]);
+        }
+        return result;
+    }
+
+    // Лист без записей удаляется; узел выше, оставшийся без записей с одним
+    // потомком, остается до перестройки (поиск его проходит, как и прежде)
+    void Prune(int node) {
+        while (node != 0 && count[node] == 0 && firstChild[node] == NoNode) {
+            int up = parent[node];
+            int sibling = firstChild[up];
+            if (sibling == node) {
+                firstChild[up] = nextSibling[node];
+            }
+            else {
+                while (nextSibling[sibling] != node) sibling = nextSibling[sibling];
+                nextSibling[sibling] = nextSibling[node];
+            }
+            deadChars += labelLength[node];
+            nextSibling[node] = freeNode;
+            parent[node] = NoNode;
+            freeNode = node;
+            freeCount++;
+            node = up;
+        }
+    }
+
+    String^ Label(int node) {
+        return gcnew String(chars, labelStart[node], labelLength[node]);
+    }
+
+    // Узлы, с которых начинаются продолжения префикса (без учета регистра);
+    // text - значение до конца метки узла
+    void CollectStarts(int node, String^ text, String^ prefix, int position, CandidateHeap^ heap) {
+        for (int child = firstChild[node]; child != NoNode; child = nextSibling[child]) {
+            if (best[child] == 0) continue;
+            int length = Math::Min(labelLength[child], prefix->Length - position);
+            bool matches = true;
+            for (int i = 0; i < length && matches; i++) {
+                matches = Char::ToLowerInvariant(chars[labelStart[child] + i]) == Char::ToLowerInvariant(prefix[position + i]);
+            }
+            if (!matches) continue;
+            String^ childText = text + Label(child);
+            if (position + labelLength[child] >= prefix->Length) {
+                heap->Push(gcnew Candidate(best[child], child, childText, false));
+            }
+            else {
+                CollectStarts(child, childText, prefix, position + labelLength[child], heap);
+            }
+        }
+    }
+
+    void CollectValues(int node, String^ text, List<Completion^>^ values) {
+        if (count[node] > 0) values->Add(gcnew Completion(text, count[node]));
+        for (int child = firstChild[node]; child != NoNode; child = nextSibling[child]) {
+            CollectValues(child, text + Label(child), values);
+        }
+    }
+
+    // Перестройка без мертвых символов и узлов
+    void Compact() {
+        List<Completion^>^ values = gcnew List<Completion^>(distinct);
+        CollectValues(0, String::Empty, values);
+        Clear();
+        for each (Completion^ value in values) {
+            Add(value->value, value->count);
+        }
+    }
+
+public:
+    CompletionTrie() {
+        chars = gcnew array<wchar_t>(256);
+        labelStart = gcnew array<int>(64);
+        labelLength = gcnew array<int>(64);
+        count = gcnew array<int>(64);
+        best = gcnew array<int>(64);
+        firstChild = gcnew array<int>(64);
+        nextSibling = gcnew array<int>(64);
+        parent = gcnew array<int>(64);
+        Clear();
+    }
+
+    void Clear() {
+        charCount = 0;
+        deadChars = 0;
+        nodeCount = 0;
+        freeNode = NoNode;
+        freeCount = 0;
+        distinct = 0;
+        total = 0;
+        NewNode(0, 0, NoNode);
+    }
+
+    // Значение встретилось еще в times записях
+    void Add(String^ value, int times) {
+        if (String::IsNullOrEmpty(value) || times <= 0) return;
+        int node = 0;
+        int i = 0;
+        while (i < value->Length) {
+            int child = FindChild(node, value[i]);
+            if (child == NoNode) {
+                int leaf = NewNode(AppendChars(value, i), value->Length - i, node);
+                AddChild(node, leaf);
+                node = leaf;
+                break;
+            }
+            int matched = CommonPrefix(child, value, i);
+            if (matched < labelLength[child]) {
+                // Разделение метки: общая часть - новый узел над child
+                int middle = NewNode(labelStart[child], matched, node);
+                ReplaceChild(node, child, middle);
+                labelStart[child] += matched;
+                labelLength[child] -= matched;
+                nextSibling[child] = NoNode;
+                AddChild(middle, child);
+                best[middle] = best[child];
+                child = middle;
+            }
+            node = child;
+            i += matched;
+        }
+        if (count[node] == 0) distinct++;
+        count[node] += times;
+        total += times;
+        for (int up = node; up != NoNode && best[up] < count[node]; up = parent[up]) {
+            best[up] = count[node];
+        }
+    }
+
+    void Add(String^ value) {
+        Add(value, 1);
+    }
+
+    // Одной записью со значением меньше; false - значения нет
+    bool Remove(String^ value) {
+        if (String::IsNullOrEmpty(value)) return false;
+        int node = FindExact(value);
+        if (node == NoNode || count[node] == 0) return false;
+        count[node]--;
+        total--;
+        if (count[node] == 0) distinct--;
+        for (int up = node; up != NoNode; up = parent[up]) {
+            int updated = Math::Max(count[up], ChildrenBest(up));
+            if (updated == best[up]) break;
+            best[up] = updated;
+        }
+        Prune(node);
+        if (deadChars > 65536 && deadChars > charCount / 2) {
+            Compact();
+        }
+        return true;
+    }
+
+    // Число записей со значением
+    int GetCount(String^ value) {
+        if (String::IsNullOrEmpty(value)) return 0;
+        int node = FindExact(value);
+        return node == NoNode ? 0 : count[node];
+    }
+
+    // До limit самых частых значений, начинающихся с prefix (без учета
+    // регистра); при равной частоте - по алфавиту
+    List<Completion^>^ Complete(String^ prefix, int limit) {
+        List<Completion^>^ results = gcnew List<Completion^>(limit);
+        if (limit <= 0) return results;
+        CandidateHeap^ heap = gcnew CandidateHeap();
+        if (String::IsNullOrEmpty(prefix)) {
+            if (best[0] > 0) heap->Push(gcnew Candidate(best[0], 0, String::Empty, false));
+        }
+        else {
+            CollectStarts(0, String::Empty, prefix, 0, heap);
+        }
+        while (heap->Count > 0 && results->Count < limit) {
+            Candidate^ item = heap->Pop();
+            if (item->isValue) {
+                results->Add(gcnew Completion(item->text, item->priority));
+                continue;
+            }
+            if (count[item->node] > 0) {
+                heap->Push(gcnew Candidate(count[item->node], item->node, item->text, true));
+            }
+            for (int child = firstChild[item->node]; child != NoNode; child = nextSibling[child]) {
+                if (best[child] > 0) {
+                    heap->Push(gcnew Candidate(best[child], child, item->text + Label(child), false));
+                }
+            }
+        }
+        return results;
+    }
+
+    // Число различных значений и записей с ними
+    int GetDistinctCount() { return distinct; }
+    long long GetTotalCount() { return total; }
+    int GetNodeCount() { return nodeCount - freeCount; }
+
+    // Память: массивы узлов и буфер символов
+    long long EstimateBytes() {
+        return 7 * (MemorySizes::ObjectHeader + 8 + 4LL * labelStart->Length) +
+            MemorySizes::ObjectHeader + 8 + 2LL * chars->Length;
+    }
+};
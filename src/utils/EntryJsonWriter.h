@@ -0,0 +1,310 @@
+#pragma once
+#include <intrin.h>
+#include <vcclr.h>
+#include "../models/EntrySchema.h"
+#include "JsonSpans.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::IO;
+using namespace System::Text;
+
+#pragma managed(push, off)
+// Число символов в начале строки, которые попадают в JSON без экранирования.
+// Экранируются управляющие символы, кавычка, обратная косая черта и
+// U+0085, U+2028, U+2029 - как в Newtonsoft.Json. Проверка по 8 символов
+// за шаг (SSE2); хвост короче 8 символов проверяется по одному
+inline int JsonPlainPrefix(const wchar_t* chars, int length) {
+    const __m128i controlLimit = _mm_set1_epi16(0x1F);
+    const __m128i quote = _mm_set1_epi16('"');
+    const __m128i backslash = _mm_set1_epi16('\\');
+    const __m128i nextLine = _mm_set1_epi16(0x85);
+    const __m128i lineSeparator = _mm_set1_epi16(0x2028);
+    const __m128i lowBit = _mm_set1_epi16(1);
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 8 <= length; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chars + i));
+        // v <= 0x1F без знака: насыщающее вычитание дает ноль
+        __m128i special = _mm_cmpeq_epi16(_mm_subs_epu16(v, controlLimit), zero);
+        special = _mm_or_si128(special, _mm_cmpeq_epi16(v, quote));
+        special = _mm_or_si128(special, _mm_cmpeq_epi16(v, backslash));
+        special = _mm_or_si128(special, _mm_cmpeq_epi16(v, nextLine));
+        // U+2028 и U+2029 различаются только младшим битом
+        special = _mm_or_si128(special, _mm_cmpeq_epi16(_mm_andnot_si128(lowBit, v), lineSeparator));
+        int mask = _mm_movemask_epi8(special);
+        if (mask != 0) {
+            unsigned long bit;
+            _BitScanForward(&bit, (unsigned long)mask);
+            return i + (int)(bit / 2);
+        }
+    }
+    for (; i < length; i++) {
+        wchar_t c = chars[i];
+        if (c < 0x20 || c == '"' || c == '\\' || c == 0x85 || c == 0x2028 || c == 0x2029) return i;
+    }
+    return length;
+}
+#pragma managed(pop)
+
+// Запись записей книги JSON-массивом прямо в поток UTF-8, без рефлексии
+// JsonSerializer и без текста всего документа в памяти. Текст копится в
+// буфере символов (один на поток, переиспользуется) и кодируется порциями
+// между записями. Отступы и экранирование совпадают с
+// JsonConvert::SerializeObject(entries, Formatting::Indented), поэтому файл
+// побайтно тот же; compact-режим пишет без пробелов и переводов строк.
+// Для файла хранения собираются хеши текста объектов (как JsonSpans::Hash)
+public ref class EntryJsonWriter {
+public:
+    literal int BufferChars = 32768;
+
+private:
+    // Порция кодируется, когда в буфере больше половины
+    literal int FlushChars = BufferChars / 2;
+
+    [ThreadStatic] static array<wchar_t>^ sharedChars;
+    [ThreadStatic] static array<Byte>^ sharedBytes;
+    static UTF8Encoding^ utf8 = gcnew UTF8Encoding(false);
+
+    Stream^ stream;
+    bool indented;
+    array<wchar_t>^ chars;
+    array<Byte>^ bytes;
+    int used;
+    int count;
+    bool firstProperty;
+    long long length;
+    List<unsigned long long>^ objectHashes;
+
+    void Ensure(int extra) {
+        if (used + extra > chars->Length) {
+            // Объект не делится между порциями: буфер растет под длинное значение
+            Array::Resize(chars, Math::Max(chars->Length * 2, used + extra));
+        }
+    }
+
+    void Append(wchar_t c) {
+        Ensure(1);
+        chars[used++] = c;
+    }
+
+    void Append(String^ text) {
+        Ensure(text->Length);
+        text->CopyTo(0, chars, used, text->Length);
+        used += text->Length;
+    }
+
+    void AppendInt(int value) {
+        Ensure(11);
+        if (value < 0) {
+            chars[used++] = '-';
+        }
+        // Цифры в обратном порядке; отрицательные без переполнения на Int32::MinValue
+        int start = used;
+        do {
+            int digit = value % 10;
+            chars[used++] = (wchar_t)('0' + (digit < 0 ? -digit : digit));
+            value /= 10;
+        } while (value != 0);
+        Array::Reverse(chars, start, used - start);
+    }
+
+    void AppendEscaped(wchar_t c) {
+        Ensure(6);
+        chars[used++] = '\\';
+        switch (c) {
+        case '"': chars[used++] = '"'; return;
+        case '\\': chars[used++] = '\\'; return;
+        case '\n': chars[used++] = 'n'; return;
+        case '\r': chars[used++] = 'r'; return;
+        case '\t': chars[used++] = 't'; return;
+        case '\b': chars[used++] = 'b'; return;
+        case '\f': chars[used++] = 'f'; return;
+        }
+        chars[used++] = 'u';
+        for (int shift = 12; shift >= 0; shift -= 4) {
+            int digit = (c >> shift) & 0xF;
+            chars[used++] = (wchar_t)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+        }
+    }
+
+    void AppendString(String^ value) {
+        Append('"');
+        int position = 0;
+        int total = value->Length;
+        pin_ptr<const wchar_t> pinned = PtrToStringChars(value);
+        const wchar_t* source = pinned;
+        while (position < total) {
+            int plain = JsonPlainPrefix(source + position, total - position);
+            if (plain > 0) {
+                Ensure(plain);
+                value->CopyTo(position, chars, used, plain);
+                used += plain;
+                position += plain;
+            }
+            if (position < total) {
+                AppendEscaped(value[position++]);
+            }
+        }
+        Append('"');
+    }
+
+    void BeginProperty(String^ name) {
+        if (!firstProperty) Append(',');
+        firstProperty = false;
+        if (indented) Append("\r\n    ");
+        Append('"');
+        Append(name);
+        Append(indented ? "\": " : "\":");
+    }
+
+    void WriteObject(NotebookEntry<int>^ entry) {
+        int objectStart = used;
+        Append('{');
+        firstProperty = true;
+        EntryFields::WriteJson(this, entry);
+        // Метки, как у JsonSerializer, - только у записей с метками
+        array<String^>^ tags = entry->GetTags();
+        if (tags != nullptr) {
+            WriteProperty("tags", tags);
+        }
+        Append(indented ? "\r\n  }" : "}");
+        if (objectHashes != nullptr) {
+            objectHashes->Add(JsonSpans::Hash(chars, objectStart, used - objectStart));
+        }
+        count++;
+    }
+
+    void FlushBuffer() {
+        if (used == 0) return;
+        int needed = utf8->GetMaxByteCount(used);
+        if (bytes->Length < needed) {
+            bytes = gcnew array<Byte>(needed);
+        }
+        int encoded = utf8->GetBytes(chars, 0, used, bytes, 0);
+        stream->Write(bytes, 0, encoded);
+        length += used;
+        used = 0;
+    }
+
+public:
+    EntryJsonWriter(Stream^ stream, bool indented, bool collectHashes) {
+        this->stream = stream;
+        this->indented = indented;
+        chars = sharedChars != nullptr ? sharedChars : gcnew array<wchar_t>(BufferChars);
+        bytes = sharedBytes != nullptr ? sharedBytes : gcnew array<Byte>(utf8->GetMaxByteCount(BufferChars));
+        sharedChars = nullptr;
+        sharedBytes = nullptr;
+        objectHashes = collectHashes ? gcnew List<unsigned long long>() : nullptr;
+    }
+
+    void WriteStartArray() {
+        Append('[');
+    }
+
+    void Write(NotebookEntry<int>^ entry) {
+        if (used >= FlushChars) {
+            FlushBuffer();
+        }
+        if (count > 0) Append(',');
+        if (indented) Append("\r\n  ");
+        WriteObject(entry);
+    }
+
+    // Запись отдельной строкой JSON Lines (без массива и запятых)
+    void WriteLine(NotebookEntry<int>^ entry) {
+        if (used >= FlushChars) {
+            FlushBuffer();
+        }
+        WriteObject(entry);
+        Append('\n');
+    }
+
+    void WriteProperty(String^ name, String^ value) {
+        BeginProperty(name);
+        if (value == nullptr) {
+            Append("null");
+        }
+        else {
+            AppendString(value);
+        }
+    }
+
+    void WriteProperty(String^ name, int value) {
+        BeginProperty(name);
+        AppendInt(value);
+    }
+
+    void WriteProperty(String^ name, array<String^>^ values) {
+        BeginProperty(name);
+        Append('[');
+        for (int i = 0; i < values->Length; i++) {
+            if (i > 0) Append(',');
+            if (indented) Append("\r\n      ");
+            AppendString(values[i]);
+        }
+        if (indented && values->Length > 0) Append("\r\n    ");
+        Append(']');
+    }
+
+    void WriteEndArray() {
+        if (indented && count > 0) Append("\r\n");
+        Append(']');
+        Finish();
+    }
+
+    // Запись остатка буфера; буферы возвращаются для следующей записи в
+    // этом потоке
+    void Finish() {
+        FlushBuffer();
+        stream->Flush();
+        if (chars->Length == BufferChars) sharedChars = chars;
+        sharedBytes = bytes;
+    }
+
+    // Длина записанного текста в символах
+    long long GetLength() {
+        return length + used;
+    }
+
+    List<unsigned long long>^ GetObjectHashes() {
+        return objectHashes;
+    }
+
+    // Весь массив source одним вызовом
+    static EntryJsonWriter^ WriteAll(IEnumerable<NotebookEntry<int>^>^ source, Stream^ stream, bool indented, bool collectHashes) {
+        EntryJsonWriter^ writer = gcnew EntryJsonWriter(stream, indented, collectHashes);
+        writer->WriteStartArray();
+        for each (NotebookEntry<int>^ entry in source) {
+            writer->Write(entry);
+        }
+        writer->WriteEndArray();
+        return writer;
+    }
+};
+
+// Документ для AtomicFile::Publish: записи пишутся в поток публикации,
+// а длина текста и хеши объектов остаются для учета файла хранения
+public ref class EntryJsonDocument {
+private:
+    IEnumerable<NotebookEntry<int>^>^ source;
+    bool indented;
+    bool collectHashes;
+    EntryJsonWriter^ writer;
+
+public:
+    EntryJsonDocument(IEnumerable<NotebookEntry<int>^>^ source, bool indented, bool collectHashes)
+        : source(source), indented(indented), collectHashes(collectHashes) {}
+
+    void Write(Stream^ stream) {
+        writer = EntryJsonWriter::WriteAll(source, stream, indented, collectHashes);
+    }
+
+    long long GetLength() {
+        return writer->GetLength();
+    }
+
+    List<unsigned long long>^ GetObjectHashes() {
+        return writer->GetObjectHashes();
+    }
+};
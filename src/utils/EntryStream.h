@@ -0,0 +1,138 @@
+#pragma once
+#include "../models/NotebookEntry.h"
+#include "../models/EntrySchema.h"
+#include "EntryJsonWriter.h"
+
+using namespace System;
+using namespace System::IO;
+using namespace System::Text;
+using namespace Newtonsoft::Json;
+
+// Последовательное чтение записей из JSON-массива, JSON Lines или TSV
+// по одной, без загрузки файла в память
+public ref class EntryStreamReader {
+private:
+    TextReader^ reader;
+    JsonTextReader^ json;
+    JsonSerializer^ serializer;
+
+public:
+    EntryStreamReader(TextReader^ reader, String^ format) {
+        this->reader = reader;
+        if (!format->Equals("tsv", StringComparison::OrdinalIgnoreCase)) {
+            json = gcnew JsonTextReader(reader);
+            // JSON Lines - объекты подряд, без общего массива
+            json->SupportMultipleContent = format->Equals("ndjson", StringComparison::OrdinalIgnoreCase);
+            serializer = gcnew JsonSerializer();
+        }
+    }
+
+    // Формат по расширению: .json - JSON, .jsonl и .ndjson - JSON Lines,
+    // остальное - TSV
+    static EntryStreamReader^ Open(String^ path) {
+        String^ format = path->EndsWith(".json", StringComparison::OrdinalIgnoreCase) ? "json" :
+            path->EndsWith(".jsonl", StringComparison::OrdinalIgnoreCase) ||
+            path->EndsWith(".ndjson", StringComparison::OrdinalIgnoreCase) ? "ndjson" : "tsv";
+        return gcnew EntryStreamReader(gcnew StreamReader(path, Encoding::UTF8, true, 1 << 16), format);
+    }
+
+    // Следующая запись; false в конце потока. Строки TSV с недостающими
+    // полями пропускаются, как в NotebookManager::ReadTsv
+    bool Read(NotebookEntry<int>^% entry) {
+        if (json != nullptr) {
+            while (json->Read()) {
+                if (json->TokenType == JsonToken::StartObject) {
+                    entry = serializer->Deserialize<NotebookEntry<int>^>(json);
+                    return true;
+                }
+            }
+            return false;
+        }
+        String^ line;
+        while ((line = reader->ReadLine()) != nullptr) {
+            NotebookEntry<int>^ parsed = EntrySchema::FromTsv(line->Split('\t'));
+            if (parsed != nullptr) {
+                entry = parsed;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Close() {
+        reader->Close();
+    }
+};
+
+// Последовательная запись записей в JSON-массив (в том же виде, что и
+// SaveToJsonFile), JSON Lines или TSV
+public ref class EntryStreamWriter {
+private:
+    TextWriter^ writer;
+    Stream^ stream;
+    EntryJsonWriter^ json;
+    // JSON Lines: объект на строку, без массива
+    bool lines;
+
+public:
+    // TSV в текстовый поток
+    EntryStreamWriter(TextWriter^ writer) {
+        this->writer = writer;
+    }
+
+    // JSON-массив в поток байтов (UTF-8)
+    EntryStreamWriter(Stream^ stream, bool indented) {
+        this->stream = stream;
+        json = gcnew EntryJsonWriter(stream, indented, false);
+        json->WriteStartArray();
+    }
+
+    // JSON Lines в поток байтов (UTF-8, как у экспорта JsonLinesFormatter)
+    EntryStreamWriter(Stream^ stream) {
+        this->stream = stream;
+        json = gcnew EntryJsonWriter(stream, false, false);
+        lines = true;
+    }
+
+    // Формат по расширению, как в EntryStreamReader::Open
+    static EntryStreamWriter^ Create(String^ path) {
+        UTF8Encoding^ encoding = gcnew UTF8Encoding(true);
+        if (path->EndsWith(".jsonl", StringComparison::OrdinalIgnoreCase) ||
+            path->EndsWith(".ndjson", StringComparison::OrdinalIgnoreCase)) {
+            return gcnew EntryStreamWriter(gcnew FileStream(path, FileMode::Create, FileAccess::Write, FileShare::None, 1 << 16));
+        }
+        if (!path->EndsWith(".json", StringComparison::OrdinalIgnoreCase)) {
+            return gcnew EntryStreamWriter(gcnew StreamWriter(path, false, encoding, 1 << 16));
+        }
+        FileStream^ file = gcnew FileStream(path, FileMode::Create, FileAccess::Write, FileShare::None, 1 << 16);
+        array<Byte>^ preamble = encoding->GetPreamble();
+        file->Write(preamble, 0, preamble->Length);
+        return gcnew EntryStreamWriter(file, true);
+    }
+
+    void Write(NotebookEntry<int>^ entry) {
+        if (lines) {
+            json->WriteLine(entry);
+            return;
+        }
+        if (json != nullptr) {
+            json->Write(entry);
+            return;
+        }
+        EntrySchema::WriteTsv(writer, entry);
+    }
+
+    void Close() {
+        if (lines) {
+            json->Finish();
+            stream->Close();
+            return;
+        }
+        if (json != nullptr) {
+            json->WriteEndArray();
+            stream->Close();
+            return;
+        }
+        writer->Close();
+    }
+};
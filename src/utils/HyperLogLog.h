@@ -0,0 +1,104 @@
+#pragma once
+
+using namespace System;
+
+// Оценка числа различных значений (HyperLogLog) с поддержкой удаления:
+// для каждого регистра хранится число значений каждого ранга, поэтому
+// после удаления регистр опускается до следующего занятого ранга.
+// Память и время оценки не зависят от числа значений (2^Precision регистров).
+public ref class HyperLogLog {
+public:
+    literal int Precision = 10;
+    literal int RegisterCount = 1 << Precision;
+    literal int MaxRank = 64 - Precision + 1;
+
+private:
+    array<Byte>^ registers;
+    array<int>^ rankCounts;
+    long long cachedEstimate;
+    bool dirty;
+
+    static int RankOf(unsigned long long hash) {
+        // Ранг - позиция первой единицы в битах после индекса регистра
+        unsigned long long rest = hash << Precision;
+        int rank = 1;
+        while (rank < MaxRank && (rest & 0x8000000000000000ULL) == 0) {
+            rest <<= 1;
+            rank++;
+        }
+        return rank;
+    }
+
+public:
+    HyperLogLog() {
+        registers = gcnew array<Byte>(RegisterCount);
+        rankCounts = gcnew array<int>(RegisterCount * MaxRank);
+    }
+
+    // 64-битный хеш строки: FNV-1a с перемешиванием (splitmix64), чтобы
+    // старшие биты индекса регистра были равномерными
+    static unsigned long long HashString(String^ value) {
+        unsigned long long hash = 14695981039346656037ULL;
+        for (int i = 0; i < value->Length; i++) {
+            hash = (hash ^ value[i]) * 1099511628211ULL;
+        }
+        hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+        return hash ^ (hash >> 31);
+    }
+
+    void Add(unsigned long long hash) {
+        int index = (int)(hash >> (64 - Precision));
+        int rank = RankOf(hash);
+        rankCounts[index * MaxRank + rank - 1]++;
+        if (rank > registers[index]) {
+            registers[index] = (Byte)rank;
+            dirty = true;
+        }
+    }
+
+    void Remove(unsigned long long hash) {
+        int index = (int)(hash >> (64 - Precision));
+        int rank = RankOf(hash);
+        int slot = index * MaxRank + rank - 1;
+        if (rankCounts[slot] == 0) return;
+        if (--rankCounts[slot] == 0 && rank == registers[index]) {
+            while (rank > 0 && rankCounts[index * MaxRank + rank - 1] == 0) rank--;
+            registers[index] = (Byte)rank;
+            dirty = true;
+        }
+    }
+
+    // Память регистров и счетчиков рангов
+    long long EstimateBytes() {
+        return 2 * 24 + registers->Length + 4LL * rankCounts->Length;
+    }
+
+    void Clear() {
+        Array::Clear(registers, 0, registers->Length);
+        Array::Clear(rankCounts, 0, rankCounts->Length);
+        cachedEstimate = 0;
+        dirty = false;
+    }
+
+    // Оценка числа различных значений; пересчитывается только после
+    // изменения регистров
+    long long Estimate() {
+        if (!dirty) return cachedEstimate;
+        double sum = 0;
+        int zeros = 0;
+        for (int i = 0; i < RegisterCount; i++) {
+            sum += Math::Pow(2.0, -registers[i]);
+            if (registers[i] == 0) zeros++;
+        }
+        double m = RegisterCount;
+        double estimate = 0.7213 / (1.0 + 1.079 / m) * m * m / sum;
+        if (estimate <= 2.5 * m && zeros > 0) {
+            // Малые значения: линейный подсчет по пустым регистрам
+            estimate = m * Math::Log(m / zeros);
+        }
+        cachedEstimate = (long long)Math::Round(estimate);
+        dirty = false;
+        return cachedEstimate;
+    }
+};
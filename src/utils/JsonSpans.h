@@ -0,0 +1,92 @@
+#pragma once
+
+using namespace System;
+using namespace System::Collections::Generic;
+
+// Участок текста: начало и длина
+public value struct TextSpan {
+    int start;
+    int length;
+    TextSpan(int start, int length) : start(start), length(length) {}
+};
+
+// Разметка JSON-массива объектов без разбора: границы каждого объекта
+// верхнего уровня и хеш его текста. Одинаковый текст объекта означает
+// одинаковую запись, поэтому такие объекты можно не разбирать повторно.
+public ref class JsonSpans abstract sealed {
+private:
+    literal unsigned long long OffsetBasis = 14695981039346656037ULL;
+    literal unsigned long long Prime = 1099511628211ULL;
+
+public:
+    // Границы объектов; nullptr, если текст - не полный массив объектов
+    // (например, файл дописывается другой программой)
+    static List<TextSpan>^ ScanArray(String^ text) {
+        List<TextSpan>^ spans = gcnew List<TextSpan>();
+        int depth = 0;
+        int start = -1;
+        bool inString = false;
+        bool seenArray = false;
+        for (int i = 0; i < text->Length; i++) {
+            wchar_t c = text[i];
+            if (inString) {
+                if (c == '\\') i++;
+                else if (c == '"') inString = false;
+                continue;
+            }
+            switch (c) {
+                case '"':
+                    inString = true;
+                    break;
+                case '[':
+                case '{':
+                    if (depth == 0) {
+                        if (c != '[' || seenArray) return nullptr;
+                        seenArray = true;
+                    }
+                    if (depth == 1) {
+                        if (c != '{') return nullptr;
+                        start = i;
+                    }
+                    depth++;
+                    break;
+                case ']':
+                case '}':
+                    depth--;
+                    if (depth < 0) return nullptr;
+                    if (depth == 1) spans->Add(TextSpan(start, i - start + 1));
+                    break;
+            }
+        }
+        return seenArray && depth == 0 && !inString ? spans : nullptr;
+    }
+
+    // FNV-1a по символам участка с учетом длины
+    static unsigned long long Hash(String^ text, TextSpan span) {
+        unsigned long long hash = (OffsetBasis ^ (unsigned long long)span.length) * Prime;
+        int end = span.start + span.length;
+        for (int i = span.start; i < end; i++) {
+            hash = (hash ^ text[i]) * Prime;
+        }
+        return hash;
+    }
+
+    // То же для участка буфера символов (текст, который еще пишется)
+    static unsigned long long Hash(array<wchar_t>^ chars, int start, int length) {
+        unsigned long long hash = (OffsetBasis ^ (unsigned long long)length) * Prime;
+        int end = start + length;
+        for (int i = start; i < end; i++) {
+            hash = (hash ^ chars[i]) * Prime;
+        }
+        return hash;
+    }
+
+    // Хеш всего массива по хешам объектов в порядке следования
+    static unsigned long long Combine(IEnumerable<unsigned long long>^ hashes) {
+        unsigned long long hash = OffsetBasis;
+        for each (unsigned long long item in hashes) {
+            hash = (hash ^ item) * Prime;
+        }
+        return hash;
+    }
+};
@@ -0,0 +1,252 @@
+#pragma once
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Diagnostics;
+using namespace System::IO;
+using namespace System::Text;
+using namespace System::Threading;
+using namespace Newtonsoft::Json;
+
+// Оценки размеров объектов в управляемой куче (x64)
+public ref class MemorySizes abstract sealed {
+public:
+    literal int ObjectHeader = 16;
+    literal int Reference = 8;
+
+    // Строка: заголовок, длина, символы UTF-16 и завершающий ноль, с выравниванием до 8
+    static long long StringBytes(String^ value) {
+        if (value == nullptr) return 0;
+        return (ObjectHeader + 4 + 2LL * (value->Length + 1) + 7) & ~7LL;
+    }
+
+    // Массив ссылок
+    static long long ReferenceArrayBytes(int length) {
+        return ObjectHeader + 8 + (long long)Reference * length;
+    }
+};
+
+// Потребитель памяти: оценка размера и (необязательно) освобождение до
+// заданного размера. Функция освобождения возвращает размер после нее
+public ref class MemoryConsumer {
+public:
+    initonly String^ name;
+    initonly Func<long long>^ estimate;
+    initonly Func<long long, long long>^ trim;
+    // Строка со счетчиками подсистемы (попадания кэша и т.п.); может быть nullptr
+    initonly Func<String^>^ details;
+    // Бюджет в байтах; 0 - без ограничения
+    long long budgetBytes;
+    // Сколько раз потребитель сокращался из-за превышения бюджета
+    int evictions;
+
+    MemoryConsumer(String^ name, Func<long long>^ estimate, Func<long long, long long>^ trim, long long budgetBytes,
+                   Func<String^>^ details)
+        : name(name), estimate(estimate), trim(trim), details(details), budgetBytes(budgetBytes), evictions(0) {}
+};
+
+// Учет памяти по подсистемам: хранилище записей, индексы, кэши, история
+// отмены, строки таблицы, буферы ввода-вывода. Каждая подсистема
+// регистрирует оценку своего размера; EnforceBudgets сокращает тех, кто
+// вышел за бюджет и умеет освобождать память (кэши, история).
+// Бюджеты можно хранить в JSON-файле: {"имя подсистемы": мегабайты}.
+public ref class MemoryAccounting {
+private:
+    List<MemoryConsumer^>^ consumers;
+    Object^ sync;
+
+    MemoryConsumer^ Find(String^ name) {
+        for each (MemoryConsumer^ consumer in consumers) {
+            if (consumer->name->Equals(name, StringComparison::OrdinalIgnoreCase)) return consumer;
+        }
+        return nullptr;
+    }
+
+    static long long SafeEstimate(MemoryConsumer^ consumer) {
+        try {
+            return consumer->estimate();
+        }
+        catch (InvalidOperationException^) {
+            // Коллекция меняется в другом потоке - оценка будет в следующий раз
+            return 0;
+        }
+    }
+
+public:
+    MemoryAccounting() {
+        consumers = gcnew List<MemoryConsumer^>();
+        sync = gcnew Object();
+    }
+
+    // Регистрация подсистемы; повторная регистрация с тем же именем заменяет
+    // оценку, но сохраняет настроенный бюджет
+    void Register(String^ name, Func<long long>^ estimate, Func<long long, long long>^ trim, long long budgetBytes,
+                  Func<String^>^ details) {
+        Monitor::Enter(sync);
+        try {
+            MemoryConsumer^ existing = Find(name);
+            if (existing != nullptr) {
+                budgetBytes = existing->budgetBytes;
+                consumers->Remove(existing);
+            }
+            consumers->Add(gcnew MemoryConsumer(name, estimate, trim, budgetBytes, details));
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    void Register(String^ name, Func<long long>^ estimate, Func<long long, long long>^ trim, long long budgetBytes) {
+        Register(name, estimate, trim, budgetBytes, nullptr);
+    }
+
+    void Register(String^ name, Func<long long>^ estimate) {
+        Register(name, estimate, nullptr, 0);
+    }
+
+    void Unregister(String^ name) {
+        Monitor::Enter(sync);
+        try {
+            MemoryConsumer^ existing = Find(name);
+            if (existing != nullptr) consumers->Remove(existing);
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    void SetBudget(String^ name, long long budgetBytes) {
+        Monitor::Enter(sync);
+        try {
+            MemoryConsumer^ consumer = Find(name);
+            if (consumer == nullptr) {
+                throw gcnew ArgumentException("Unknown memory consumer: " + name);
+            }
+            consumer->budgetBytes = budgetBytes;
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    // Копия списка подсистем для отображения
+    List<MemoryConsumer^>^ GetConsumers() {
+        Monitor::Enter(sync);
+        try {
+            return gcnew List<MemoryConsumer^>(consumers);
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    long long Estimate(MemoryConsumer^ consumer) {
+        return SafeEstimate(consumer);
+    }
+
+    // Счетчики подсистемы; пустая строка, если их нет
+    String^ Describe(MemoryConsumer^ consumer) {
+        if (consumer->details == nullptr) return String::Empty;
+        try {
+            return consumer->details();
+        }
+        catch (InvalidOperationException^) {
+            return String::Empty;
+        }
+    }
+
+    // Сокращение подсистем, превысивших бюджет; возвращает число сокращенных
+    int EnforceBudgets() {
+        int trimmed = 0;
+        for each (MemoryConsumer^ consumer in GetConsumers()) {
+            if (consumer->budgetBytes <= 0 || consumer->trim == nullptr) continue;
+            if (SafeEstimate(consumer) > consumer->budgetBytes) {
+                consumer->trim(consumer->budgetBytes);
+                consumer->evictions++;
+                trimmed++;
+            }
+        }
+        return trimmed;
+    }
+
+    // Отчет: подсистемы с размерами и бюджетами и показатели процесса
+    String^ ToJson() {
+        StringWriter^ text = gcnew StringWriter();
+        JsonTextWriter^ json = gcnew JsonTextWriter(text);
+        json->Formatting = Formatting::Indented;
+        json->WriteStartObject();
+        json->WritePropertyName("timestamp");
+        json->WriteValue(DateTime::Now.ToString("s"));
+
+        long long tracked = 0;
+        json->WritePropertyName("subsystems");
+        json->WriteStartArray();
+        for each (MemoryConsumer^ consumer in GetConsumers()) {
+            long long bytes = SafeEstimate(consumer);
+            tracked += bytes;
+            json->WriteStartObject();
+            json->WritePropertyName("name");
+            json->WriteValue(consumer->name);
+            json->WritePropertyName("bytes");
+            json->WriteValue(bytes);
+            json->WritePropertyName("budget_bytes");
+            json->WriteValue(consumer->budgetBytes);
+            json->WritePropertyName("evictable");
+            json->WriteValue(consumer->trim != nullptr);
+            json->WritePropertyName("evictions");
+            json->WriteValue(consumer->evictions);
+            if (consumer->details != nullptr) {
+                json->WritePropertyName("details");
+                json->WriteValue(Describe(consumer));
+            }
+            json->WriteEndObject();
+        }
+        json->WriteEndArray();
+
+        Process^ process = Process::GetCurrentProcess();
+        json->WritePropertyName("tracked_bytes");
+        json->WriteValue(tracked);
+        json->WritePropertyName("managed_heap_bytes");
+        json->WriteValue(GC::GetTotalMemory(false));
+        json->WritePropertyName("working_set_bytes");
+        json->WriteValue(process->WorkingSet64);
+        json->WritePropertyName("private_bytes");
+        json->WriteValue(process->PrivateMemorySize64);
+        json->WritePropertyName("gen2_collections");
+        json->WriteValue(GC::CollectionCount(2));
+        json->WriteEndObject();
+        json->Flush();
+        return text->ToString();
+    }
+
+    // Бюджеты из файла {"имя": мегабайты}; неизвестные имена пропускаются
+    void LoadBudgets(String^ path) {
+        if (!File::Exists(path)) return;
+        Dictionary<String^, double>^ budgets =
+            JsonConvert::DeserializeObject<Dictionary<String^, double>^>(File::ReadAllText(path));
+        if (budgets == nullptr) return;
+        Monitor::Enter(sync);
+        try {
+            for each (KeyValuePair<String^, double> pair in budgets) {
+                MemoryConsumer^ consumer = Find(pair.Key);
+                if (consumer != nullptr) {
+                    consumer->budgetBytes = (long long)(pair.Value * 1024 * 1024);
+                }
+            }
+        }
+        finally {
+            Monitor::Exit(sync);
+        }
+    }
+
+    void SaveBudgets(String^ path) {
+        Dictionary<String^, double>^ budgets = gcnew Dictionary<String^, double>();
+        for each (MemoryConsumer^ consumer in GetConsumers()) {
+            // Нулевой бюджет сохраняется явно, иначе вернется бюджет по умолчанию
+            if (consumer->budgetBytes > 0 || consumer->trim != nullptr) {
+                budgets[consumer->name] = Math::Round(consumer->budgetBytes / (1024.0 * 1024.0), 2);
+            }
+        }
+        File::WriteAllText(path, JsonConvert::SerializeObject(budgets, Formatting::Indented));
+    }
+};
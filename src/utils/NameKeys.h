@@ -0,0 +1,181 @@
+#pragma once
+#include "../models/NotebookEntry.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Text;
+
+// Ключи имен для поиска "звучит как": одно и то же имя, записанное
+// кириллицей и латиницей по разным системам транслитерации, дает один ключ.
+//
+// Ключ транслитерации - латиница в нижнем регистре: кириллица переводится
+// по упрощенной системе (ж - zh, х - kh, щ - shch, ю - yu), а латинские
+// варианты приводятся к ней же (j - y, w - v, x - ks, -off - -ov, -ij/-ii/-y - -iy).
+// "Иванов", "Ivanov" и "Ivanoff" дают "ivanov".
+//
+// Фонетический ключ строится по ключу транслитерации, как Metaphone с
+// поправками на русское произношение: гласные после первой буквы
+// отбрасываются (аканье, -ий/-ый, окончания женских фамилий), звонкие и
+// глухие согласные не различаются (оглушение: Иванов - Иваноф), шипящие
+// сводятся к одной букве, повторы схлопываются. "Ivanov", "Iwanow" и
+// "Ivanova" дают "AFNF".
+// Исходники собираются без /utf-8, поэтому кириллица - через коды символов
+public ref class NameKeys abstract sealed {
+private:
+    // Транслитерация букв от U+0430 (а) до U+044F (я)
+    static array<String^>^ cyrillic = gcnew array<String^> {
+        "a", "b", "v", "g", "d", "e", "zh", "z", "i", "y", "k", "l", "m", "n", "o", "p",
+        "r", "s", "t", "u", "f", "kh", "ts", "ch", "sh", "shch", "", "y", "", "e", "yu", "ya"
+    };
+
+    static bool IsVowel(wchar_t c) {
+        return c == L'a' || c == L'e' || c == L'i' || c == L'o' || c == L'u' || c == L'y';
+    }
+
+    static bool At(String^ text, int index, String^ part) {
+        return String::CompareOrdinal(text, index, part, 0, part->Length) == 0;
+    }
+
+    // Кириллица - латиницей, прочие буквы - в нижнем регистре, остальное отбрасывается
+    static String^ ToLatin(String^ text) {
+        StringBuilder^ result = gcnew StringBuilder(text->Length + 4);
+        for each (wchar_t c in text) {
+            wchar_t lower = Char::ToLowerInvariant(c);
+            if (lower >= 0x0430 && lower <= 0x044F) {
+                result->Append(cyrillic[lower - 0x0430]);
+            }
+            else if (lower == 0x0451) {
+                result->Append(L'e');
+            }
+            else if (lower >= L'a' && lower <= L'z') {
+                result->Append(lower);
+            }
+        }
+        return result->ToString();
+    }
+
+    // Латинские варианты записи - к одной системе
+    static String^ Canonical(String^ latin) {
+        StringBuilder^ result = gcnew StringBuilder(latin->Length + 4);
+        int i = 0;
+        // Начальное "ye"/"je" (Yevgeny) - как "е" в начале слова
+        if (At(latin, 0, "ye") || At(latin, 0, "je")) i = 1;
+        while (i < latin->Length) {
+            wchar_t c = latin[i];
+            wchar_t next = i + 1 < latin->Length ? latin[i + 1] : L'\0';
+            if (At(latin, i, "shch")) { result->Append("shch"); i += 4; continue; }
+            if (At(latin, i, "sch")) { result->Append("shch"); i += 3; continue; }
+            if (At(latin, i, "tch")) { result->Append("ch"); i += 3; continue; }
+            if (At(latin, i, "tz") || At(latin, i, "cz")) { result->Append("ts"); i += 2; continue; }
+            if (At(latin, i, "ph")) { result->Append(L'f'); i += 2; continue; }
+            if (At(latin, i, "ck")) { result->Append(L'k'); i += 2; continue; }
+            if (next == L'h' && (c == L'k' || c == L'c' || c == L's' || c == L'z')) {
+                result->Append(c)->Append(L'h');
+                i += 2;
+                continue;
+            }
+            switch (c) {
+            case L'h': result->Append("kh"); break;
+            case L'x': result->Append("ks"); break;
+            case L'q': result->Append(L'k'); break;
+            case L'w': result->Append(L'v'); break;
+            case L'j': result->Append(L'y'); break;
+            // c: k перед a/o/u и согласными на конце, иначе ts (Cvetkov)
+            case L'c': result->Append(next == L'a' || next == L'o' || next == L'u' || next == L'k' || next == L'\0' ? "k" : "ts"); break;
+            default: result->Append(c); break;
+            }
+            i++;
+        }
+
+        String^ text = result->ToString();
+        // -iya/-iyu (Мария, Юлия) - как -ia/-iu (Maria, Yulia)
+        text = text->Replace("iya", "ia")->Replace("iyu", "iu");
+        // Окончания: -off/-eff - старая запись -ов/-ев, -ij/-ii/-yy/-y после согласной - -ий/-ый
+        if (text->EndsWith("off") || text->EndsWith("eff")) {
+            text = text->Substring(0, text->Length - 2) + "v";
+        }
+        if (text->EndsWith("ii") || text->EndsWith("yy") || text->EndsWith("yi")) {
+            text = text->Substring(0, text->Length - 2) + "iy";
+        }
+        else if (text->Length >= 2 && text->EndsWith("y") && !IsVowel(text[text->Length - 2])) {
+            text = text->Substring(0, text->Length - 1) + "iy";
+        }
+        return text;
+    }
+
+    // Класс согласной в начале transliterated[i]: символ ключа и длина
+    static wchar_t Consonant(String^ text, int i, int% length) {
+        length = 1;
+        if (At(text, i, "shch")) { length = 4; return L'X'; }
+        if (At(text, i, "zh") || At(text, i, "sh")) { length = 2; return L'X'; }
+        if (At(text, i, "kh")) { length = 2; return L'H'; }
+        if (At(text, i, "ch")) { length = 2; return L'J'; }
+        if (At(text, i, "ts")) { length = 2; return L'C'; }
+        switch (text[i]) {
+        case L'b': case L'p': return L'P';
+        case L'v': case L'f': return L'F';
+        case L'g': case L'k': return L'K';
+        case L'd': case L't': return L'T';
+        case L'z': case L's': return L'S';
+        default: return Char::ToUpperInvariant(text[i]);
+        }
+    }
+
+public:
+    // Ключ транслитерации одного слова (имени или фамилии)
+    static String^ Transliterate(String^ name) {
+        if (String::IsNullOrEmpty(name)) return String::Empty;
+        return Canonical(ToLatin(name));
+    }
+
+    // Фонетический ключ одного слова
+    static String^ Phonetic(String^ name) {
+        return PhoneticOf(Transliterate(name));
+    }
+
+    // Фонетический ключ по готовому ключу транслитерации
+    static String^ PhoneticOf(String^ transliterated) {
+        StringBuilder^ key = gcnew StringBuilder(transliterated->Length);
+        int i = 0;
+        // Начальная гласная (и й перед гласной: Yakov, Julia) - одна буква A
+        if (transliterated->Length > 0 && IsVowel(transliterated[0])) {
+            key->Append(L'A');
+            while (i < transliterated->Length && IsVowel(transliterated[i])) i++;
+        }
+        while (i < transliterated->Length) {
+            if (IsVowel(transliterated[i])) {
+                i++;
+                continue;
+            }
+            int length;
+            wchar_t symbol = Consonant(transliterated, i, length);
+            if (key->Length == 0 || key[key->Length - 1] != symbol) {
+                key->Append(symbol);
+            }
+            i += length;
+        }
+        return key->ToString();
+    }
+
+    // Фонетические ключи слов запроса; слово без букв дает пустой ключ
+    static array<String^>^ QueryKeys(String^ query) {
+        array<String^>^ words = query->Split((array<wchar_t>^)nullptr, StringSplitOptions::RemoveEmptyEntries);
+        array<String^>^ keys = gcnew array<String^>(words->Length);
+        for (int i = 0; i < words->Length; i++) {
+            keys[i] = Phonetic(words[i]);
+        }
+        return keys;
+    }
+
+    // Каждое слово запроса звучит как имя или фамилия записи.
+    // Пустой запрос совпадает со всеми записями, как и текстовый поиск
+    static bool Matches(NotebookEntry<int>^ entry, array<String^>^ queryKeys) {
+        if (queryKeys->Length == 0) return true;
+        String^ first = Phonetic(entry->GetFirstName());
+        String^ last = Phonetic(entry->GetLastName());
+        for each (String^ key in queryKeys) {
+            if (key->Length == 0 || (key != first && key != last)) return false;
+        }
+        return true;
+    }
+};
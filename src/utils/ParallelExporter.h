@@ -0,0 +1,173 @@
+#pragma once
+#include "../models/NotebookEntry.h"
+#include "RecordFormatters.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Diagnostics;
+using namespace System::IO;
+using namespace System::Threading;
+using namespace System::Threading::Tasks;
+
+// Итоги экспорта
+public ref class ExportResult {
+public:
+    int rows;
+    int chunks;
+    long long bytes;
+    // Время форматирования, сложенное по всем потокам, и время записи в поток
+    double formatMilliseconds;
+    double writeMilliseconds;
+    double elapsedMilliseconds;
+};
+
+// Параллельный экспорт снимка записей. Записи делятся на куски по
+// ChunkRows; куски очередной волны (по два на ядро) форматируются
+// параллельно, каждый в свой буфер, а запись в файл идет по порядку
+// кусков крупными блоками. Пока пишется одна волна, следующая уже
+// форматируется, поэтому при быстром форматировании экспорт упирается в
+// диск. Буферы двух волн переиспользуются, так что память не зависит от
+// размера книги. Список не должен меняться во время экспорта - передается
+// снимок (NotebookManager::GetSnapshot()->ToList())
+public ref class ParallelExporter {
+public:
+    literal int ChunkRows = 8192;
+
+private:
+    IRecordFormatter^ formatter;
+    IList<NotebookEntry<int>^>^ entries;
+    int waveChunks;
+    ParallelOptions^ options;
+    // Волна, которая форматируется сейчас: первый кусок и буферы
+    int formatFirst;
+    array<MemoryStream^>^ formatBuffers;
+    long long formatTicks;
+
+    void FormatChunk(int slot) {
+        Stopwatch^ clock = Stopwatch::StartNew();
+        int start = (formatFirst + slot) * ChunkRows;
+        int count = Math::Min(ChunkRows, entries->Count - start);
+        MemoryStream^ buffer = formatBuffers[slot];
+        buffer->SetLength(0);
+        formatter->WriteChunk(buffer, entries, start, count);
+        Interlocked::Add(formatTicks, clock->ElapsedTicks);
+    }
+
+    int WaveSize(int first) {
+        int chunkCount = (entries->Count + ChunkRows - 1) / ChunkRows;
+        return Math::Min(waveChunks, chunkCount - first);
+    }
+
+    void FormatWave() {
+        Parallel::For(0, WaveSize(formatFirst), options, gcnew Action<int>(this, &ParallelExporter::FormatChunk));
+    }
+
+    static array<MemoryStream^>^ CreateBuffers(int count) {
+        array<MemoryStream^>^ buffers = gcnew array<MemoryStream^>(count);
+        for (int i = 0; i < count; i++) {
+            buffers[i] = gcnew MemoryStream();
+        }
+        return buffers;
+    }
+
+public:
+    ParallelExporter(IRecordFormatter^ formatter) : formatter(formatter) {
+        waveChunks = Environment::ProcessorCount * 2;
+        options = gcnew ParallelOptions();
+    }
+
+    // threads - сколько кусков форматируется одновременно (1 - по одному)
+    ParallelExporter(IRecordFormatter^ formatter, int threads) : formatter(formatter) {
+        waveChunks = Math::Max(1, threads) * 2;
+        options = gcnew ParallelOptions();
+        options->MaxDegreeOfParallelism = Math::Max(1, threads);
+    }
+
+    IRecordFormatter^ GetFormatter() {
+        return formatter;
+    }
+
+    ExportResult^ Export(IList<NotebookEntry<int>^>^ source, Stream^ output) {
+        Stopwatch^ clock = Stopwatch::StartNew();
+        entries = source;
+        formatTicks = 0;
+        long long writeTicks = 0;
+        long long start = output->CanSeek ? output->Position : 0;
+        long long written = 0;
+        int chunkCount = (entries->Count + ChunkRows - 1) / ChunkRows;
+
+        formatter->WriteHeader(output);
+        // Первая волна форматируется без перекрытия с записью
+        array<MemoryStream^>^ ready = CreateBuffers(waveChunks);
+        Task^ next = nullptr;
+        try {
+            formatBuffers = ready;
+            formatFirst = 0;
+            if (chunkCount > 0) {
+                FormatWave();
+            }
+            formatBuffers = CreateBuffers(waveChunks);
+            for (int first = 0; first < chunkCount; first += waveChunks) {
+                if (first + waveChunks < chunkCount) {
+                    formatFirst = first + waveChunks;
+                    next = Task::Factory->StartNew(gcnew Action(this, &ParallelExporter::FormatWave));
+                }
+                Stopwatch^ writeClock = Stopwatch::StartNew();
+                int size = WaveSize(first);
+                for (int slot = 0; slot < size; slot++) {
+                    MemoryStream^ buffer = ready[slot];
+                    output->Write(buffer->GetBuffer(), 0, (int)buffer->Length);
+                    written += buffer->Length;
+                }
+                writeTicks += writeClock->ElapsedTicks;
+                if (next != nullptr) {
+                    Task^ formatted = next;
+                    next = nullptr;
+                    formatted->Wait();
+                    array<MemoryStream^>^ swap = ready;
+                    ready = formatBuffers;
+                    formatBuffers = swap;
+                }
+            }
+        }
+        catch (AggregateException^ ex) {
+            // Наружу отдаем первую настоящую ошибку форматирования
+            throw ex->Flatten()->InnerExceptions[0];
+        }
+        finally {
+            // Ошибка записи: следующая волна дописывает свои буферы до конца
+            if (next != nullptr) {
+                try {
+                    next->Wait();
+                }
+                catch (AggregateException^) {
+                }
+            }
+            formatBuffers = nullptr;
+            entries = nullptr;
+        }
+        formatter->WriteFooter(output);
+        output->Flush();
+
+        ExportResult^ result = gcnew ExportResult();
+        result->rows = source->Count;
+        result->chunks = chunkCount;
+        result->bytes = output->CanSeek ? output->Position - start : written;
+        result->formatMilliseconds = formatTicks * 1000.0 / Stopwatch::Frequency;
+        result->writeMilliseconds = writeTicks * 1000.0 / Stopwatch::Frequency;
+        result->elapsedMilliseconds = clock->Elapsed.TotalMilliseconds;
+        return result;
+    }
+
+    // Экспорт в файл: большой буфер FileStream, чтобы куски уходили на
+    // диск последовательными блоками
+    ExportResult^ Export(IList<NotebookEntry<int>^>^ source, String^ path) {
+        FileStream^ output = gcnew FileStream(path, FileMode::Create, FileAccess::Write, FileShare::None, 1 << 20);
+        try {
+            return Export(source, output);
+        }
+        finally {
+            output->Close();
+        }
+    }
+};
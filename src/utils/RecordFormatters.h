@@ -0,0 +1,237 @@
+#pragma once
+#include "../models/NotebookEntry.h"
+#include "../models/EntrySchema.h"
+#include "EntryJsonWriter.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::IO;
+using namespace System::Text;
+
+// Формат экспорта записей. Кусок записей форматируется целиком за один
+// вызов и, возможно, параллельно с другими кусками, поэтому реализация не
+// хранит состояния между вызовами. Текст пишется в UTF-8 без BOM
+public interface class IRecordFormatter {
+    // Имя формата в NBcli (--to) и расширение файла без точки
+    property String^ Name { String^ get(); }
+    property String^ Extension { String^ get(); }
+
+    // Начало файла (строка заголовков CSV); пишется один раз
+    void WriteHeader(Stream^ output);
+    // Записи entries[start .. start + count)
+    void WriteChunk(Stream^ output, IList<NotebookEntry<int>^>^ entries, int start, int count);
+    // Конец файла
+    void WriteFooter(Stream^ output);
+};
+
+// Строки CSV одного куска (RFC 4180): значения с запятой, кавычкой или
+// переводом строки берутся в кавычки, кавычки внутри удваиваются
+public ref class CsvRowWriter {
+private:
+    static array<wchar_t>^ special = gcnew array<wchar_t> { L',', L'"', L'\r', L'\n' };
+
+    TextWriter^ writer;
+    bool firstField = true;
+
+public:
+    CsvRowWriter(TextWriter^ writer) : writer(writer) {}
+
+    void WriteField(String^ value) {
+        if (!firstField) writer->Write(L',');
+        firstField = false;
+        if (value == nullptr) return;
+        if (value->IndexOfAny(special) < 0) {
+            writer->Write(value);
+            return;
+        }
+        writer->Write(L'"');
+        writer->Write(value->Replace("\"", "\"\""));
+        writer->Write(L'"');
+    }
+
+    void EndRow() {
+        writer->Write("\r\n");
+        firstField = true;
+    }
+};
+
+// Общая часть текстовых форматов: кусок пишется через StreamWriter
+public ref class TextRecordFormatter abstract : IRecordFormatter {
+protected:
+    static UTF8Encoding^ utf8 = gcnew UTF8Encoding(false);
+
+    static TextWriter^ OpenWriter(Stream^ output) {
+        return gcnew StreamWriter(output, utf8, 1 << 16, true);
+    }
+
+    virtual void WriteRecord(TextWriter^ writer, NotebookEntry<int>^ entry) abstract;
+
+public:
+    virtual property String^ Name { String^ get() abstract; }
+    virtual property String^ Extension { String^ get() abstract; }
+
+    virtual void WriteHeader(Stream^ output) {}
+
+    virtual void WriteChunk(Stream^ output, IList<NotebookEntry<int>^>^ entries, int start, int count) {
+        TextWriter^ writer = OpenWriter(output);
+        for (int i = start; i < start + count; i++) {
+            WriteRecord(writer, entries[i]);
+        }
+        writer->Flush();
+    }
+
+    virtual void WriteFooter(Stream^ output) {}
+};
+
+public ref class CsvFormatter : TextRecordFormatter {
+protected:
+    virtual void WriteRecord(TextWriter^ writer, NotebookEntry<int>^ entry) override {
+        CsvRowWriter^ row = gcnew CsvRowWriter(writer);
+        EntryFields::WriteText(row, entry);
+        row->EndRow();
+    }
+
+public:
+    virtual property String^ Name { String^ get() override { return "csv"; } }
+    virtual property String^ Extension { String^ get() override { return "csv"; } }
+
+    virtual void WriteHeader(Stream^ output) override {
+        TextWriter^ writer = OpenWriter(output);
+        CsvRowWriter^ row = gcnew CsvRowWriter(writer);
+        for (int i = 0; i < EntrySchema::FieldCount; i++) {
+            row->WriteField(EntrySchema::GetHeader(i));
+        }
+        row->EndRow();
+        writer->Flush();
+    }
+};
+
+// TSV в том же виде, что и SaveToFile
+public ref class TsvFormatter : TextRecordFormatter {
+protected:
+    virtual void WriteRecord(TextWriter^ writer, NotebookEntry<int>^ entry) override {
+        EntrySchema::WriteTsv(writer, entry);
+    }
+
+public:
+    virtual property String^ Name { String^ get() override { return "tsv"; } }
+    virtual property String^ Extension { String^ get() override { return "txt"; } }
+};
+
+// vCard 3.0 (RFC 2426): карточка на запись. ID записи идет в UID, чтобы
+// повторный импорт мог сопоставить карточки с записями
+public ref class VCardFormatter : TextRecordFormatter {
+private:
+    // Строки длиннее 75 байт UTF-8 переносятся: продолжение начинается с пробела
+    literal int FoldOctets = 75;
+
+    static String^ Escape(String^ value) {
+        StringBuilder^ result = gcnew StringBuilder(value->Length + 8);
+        for each (wchar_t c in value) {
+            switch (c) {
+            case L'\\': result->Append("\\\\"); break;
+            case L',': result->Append("\\,"); break;
+            case L';': result->Append("\\;"); break;
+            case L'\n': result->Append("\\n"); break;
+            case L'\r': break;
+            default: result->Append(c); break;
+            }
+        }
+        return result->ToString();
+    }
+
+    static void WriteLine(TextWriter^ writer, String^ line) {
+        int octets = 0;
+        for (int i = 0; i < line->Length; i++) {
+            wchar_t c = line[i];
+            bool pair = Char::IsHighSurrogate(c) && i + 1 < line->Length;
+            int size = pair ? 4 : c < 0x80 ? 1 : c < 0x800 ? 2 : 3;
+            if (octets + size > FoldOctets) {
+                writer->Write("\r\n ");
+                octets = 1;
+            }
+            writer->Write(c);
+            if (pair) writer->Write(line[++i]);
+            octets += size;
+        }
+        writer->Write("\r\n");
+    }
+
+    static void WriteProperty(TextWriter^ writer, String^ name, String^ value) {
+        if (String::IsNullOrEmpty(value)) return;
+        WriteLine(writer, name + ":" + Escape(value));
+    }
+
+protected:
+    virtual void WriteRecord(TextWriter^ writer, NotebookEntry<int>^ entry) override {
+        String^ first = entry->GetFirstName() == nullptr ? "" : entry->GetFirstName();
+        String^ last = entry->GetLastName() == nullptr ? "" : entry->GetLastName();
+        writer->Write("BEGIN:VCARD\r\nVERSION:3.0\r\n");
+        WriteLine(writer, "UID:" + entry->GetId().ToString());
+        WriteLine(writer, "N:" + Escape(last) + ";" + Escape(first) + ";;;");
+        WriteLine(writer, "FN:" + Escape((first + " " + last)->Trim()));
+        WriteProperty(writer, "TEL", entry->GetPhoneNumber());
+        WriteProperty(writer, "EMAIL", entry->GetEmail());
+        DateTime birthDate;
+        if (!String::IsNullOrEmpty(entry->GetBirthDate()) && DateTime::TryParse(entry->GetBirthDate(), birthDate)) {
+            WriteLine(writer, "BDAY:" + birthDate.ToString("yyyy-MM-dd"));
+        }
+        if (!String::IsNullOrEmpty(entry->GetAddress())) {
+            // Адрес хранится одной строкой - она идет в поле улицы
+            WriteLine(writer, "ADR:;;" + Escape(entry->GetAddress()) + ";;;;");
+        }
+        WriteProperty(writer, "NOTE", entry->GetNotes());
+        array<String^>^ tags = entry->GetTags();
+        if (tags != nullptr) {
+            // Метки - список через запятую, запятые внутри меток экранируются
+            array<String^>^ escaped = gcnew array<String^>(tags->Length);
+            for (int i = 0; i < tags->Length; i++) {
+                escaped[i] = Escape(tags[i]);
+            }
+            WriteLine(writer, "CATEGORIES:" + String::Join(",", escaped));
+        }
+        writer->Write("END:VCARD\r\n");
+    }
+
+public:
+    virtual property String^ Name { String^ get() override { return "vcard"; } }
+    virtual property String^ Extension { String^ get() override { return "vcf"; } }
+};
+
+// JSON Lines: по компактному JSON-объекту на строку, поля как в файле хранения
+public ref class JsonLinesFormatter : IRecordFormatter {
+public:
+    virtual property String^ Name { String^ get() { return "ndjson"; } }
+    virtual property String^ Extension { String^ get() { return "jsonl"; } }
+
+    virtual void WriteHeader(Stream^ output) {}
+
+    virtual void WriteChunk(Stream^ output, IList<NotebookEntry<int>^>^ entries, int start, int count) {
+        EntryJsonWriter^ writer = gcnew EntryJsonWriter(output, false, false);
+        for (int i = start; i < start + count; i++) {
+            writer->WriteLine(entries[i]);
+        }
+        writer->Finish();
+    }
+
+    virtual void WriteFooter(Stream^ output) {}
+};
+
+// Выбор формата по имени (--to) или расширению файла
+public ref class RecordFormatters abstract sealed {
+public:
+    // nullptr - формат не поддерживается
+    static IRecordFormatter^ ByName(String^ name) {
+        String^ key = name->ToLowerInvariant();
+        if (key == "csv") return gcnew CsvFormatter();
+        if (key == "ndjson" || key == "jsonl") return gcnew JsonLinesFormatter();
+        if (key == "vcard" || key == "vcf") return gcnew VCardFormatter();
+        if (key == "tsv" || key == "txt") return gcnew TsvFormatter();
+        return nullptr;
+    }
+
+    static IRecordFormatter^ ForPath(String^ path) {
+        String^ extension = Path::GetExtension(path);
+        return String::IsNullOrEmpty(extension) ? nullptr : ByName(extension->Substring(1));
+    }
+};
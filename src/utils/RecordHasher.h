@@ -0,0 +1,43 @@
+#pragma once
+#include "../models/NotebookEntry.h"
+
+using namespace System;
+
+// 64-битный хеш содержимого записи (FNV-1a по символам всех полей, кроме ID,
+// и меток).
+// Поля разделяются символом, которого нет в тексте, поэтому перенос
+// символа между соседними полями меняет хеш.
+public ref class RecordHasher abstract sealed {
+private:
+    literal unsigned long long OffsetBasis = 14695981039346656037ULL;
+    literal unsigned long long Prime = 1099511628211ULL;
+
+    static unsigned long long Mix(unsigned long long hash, String^ value) {
+        if (value != nullptr) {
+            for (int i = 0; i < value->Length; i++) {
+                hash = (hash ^ value[i]) * Prime;
+            }
+        }
+        return (hash ^ 0xFFFF) * Prime;
+    }
+
+public:
+    static unsigned long long Hash(NotebookEntry<int>^ entry) {
+        unsigned long long hash = OffsetBasis;
+        hash = Mix(hash, entry->GetFirstName());
+        hash = Mix(hash, entry->GetLastName());
+        hash = Mix(hash, entry->GetPhoneNumber());
+        hash = Mix(hash, entry->GetBirthDate());
+        hash = Mix(hash, entry->GetEmail());
+        hash = Mix(hash, entry->GetAddress());
+        hash = Mix(hash, entry->GetNotes());
+        // Метки - только если они есть: хеши записей без меток не меняются
+        array<String^>^ tags = entry->GetTags();
+        if (tags != nullptr) {
+            for each (String^ tag in tags) {
+                hash = Mix(hash, tag);
+            }
+        }
+        return hash;
+    }
+};
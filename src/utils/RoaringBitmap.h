@@ -0,0 +1,506 @@
+#pragma once
+#include <intrin.h>
+#include <vcclr.h>
+#include "MemoryAccounting.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::IO;
+
+#pragma managed(push, off)
+// Число единичных битов слова (без инструкции POPCNT, ее может не быть)
+inline int RoaringPopCount(unsigned long long x) {
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((x * 0x0101010101010101ULL) >> 56);
+}
+
+// Пословная операция над битовыми картами контейнеров, 128 бит за шаг
+// (SSE2); возвращает число единиц результата. op: 0 - AND, 1 - OR,
+// 2 - AND NOT (a без b). Число слов четное
+inline int RoaringWords(int op, const unsigned long long* a, const unsigned long long* b, unsigned long long* out, int words) {
+    int cardinality = 0;
+    for (int i = 0; i < words; i += 2) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        __m128i r = op == 0 ? _mm_and_si128(x, y) : op == 1 ? _mm_or_si128(x, y) : _mm_andnot_si128(y, x);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), r);
+        cardinality += RoaringPopCount(out[i]) + RoaringPopCount(out[i + 1]);
+    }
+    return cardinality;
+}
+
+// Номера единичных битов (base + номер) по возрастанию; возвращает их число
+inline int RoaringExtract(const unsigned long long* words, int count, int base, int* out) {
+    int written = 0;
+    for (int i = 0; i < count * 2; i++) {
+        // Половины по 32 бита: _BitScanForward есть и в 32-битной сборке
+        unsigned long half = (unsigned long)(words[i / 2] >> (32 * (i % 2)));
+        while (half != 0) {
+            unsigned long bit;
+            _BitScanForward(&bit, half);
+            out[written++] = base + i * 32 + (int)bit;
+            half &= half - 1;
+        }
+    }
+    return written;
+}
+#pragma managed(pop)
+
+// Сжатое множество неотрицательных чисел в духе Roaring: числа делятся
+// по старшим 16 битам на контейнеры, контейнер хранит младшие 16 бит -
+// отсортированным массивом, пока в нем не больше ArrayLimit чисел, иначе
+// битовой картой на 65536 бит. Пересечение, объединение и разность идут
+// по контейнерам с общими ключами; пары битовых карт обрабатываются
+// пословно (RoaringWords). Результат операции - новое множество, не
+// разделяющее контейнеров с аргументами.
+public ref class RoaringBitmap {
+public:
+    literal int ArrayLimit = 4096;
+    literal int BitmapWords = 1024;
+
+private:
+    ref class Container {
+    public:
+        // Ровно одно из двух: массив (cardinality <= ArrayLimit) или карта
+        array<unsigned short>^ values;
+        array<unsigned long long>^ words;
+        int cardinality;
+
+        bool IsBitmap() { return words != nullptr; }
+
+        static Container^ FromArray(array<unsigned short>^ values, int cardinality) {
+            Container^ container = gcnew Container();
+            container->values = values;
+            container->cardinality = cardinality;
+            return container;
+        }
+
+        static Container^ FromWords(array<unsigned long long>^ words, int cardinality) {
+            if (cardinality == 0) return nullptr;
+            Container^ container = gcnew Container();
+            if (cardinality > ArrayLimit) {
+                container->words = words;
+            }
+            else {
+                // Редкая карта становится массивом
+                container->values = gcnew array<unsigned short>(cardinality);
+                int written = 0;
+                for (int i = 0; i < BitmapWords; i++) {
+                    unsigned long long word = words[i];
+                    for (int bit = 0; word != 0; bit++, word >>= 1) {
+                        if ((word & 1) != 0) container->values[written++] = (unsigned short)(i * 64 + bit);
+                    }
+                }
+            }
+            container->cardinality = cardinality;
+            return container;
+        }
+
+        bool Contains(unsigned short low) {
+            if (words != nullptr) return (words[low >> 6] & (1ULL << (low & 63))) != 0;
+            return Array::BinarySearch(values, 0, cardinality, low) >= 0;
+        }
+
+        bool Add(unsigned short low) {
+            if (words != nullptr) {
+                unsigned long long mask = 1ULL << (low & 63);
+                if ((words[low >> 6] & mask) != 0) return false;
+                words[low >> 6] |= mask;
+                cardinality++;
+                return true;
+            }
+            // Частый случай - добавление по возрастанию, в конец массива
+            int position = cardinality > 0 && values[cardinality - 1] < low
+                ? ~cardinality : Array::BinarySearch(values, 0, cardinality, low);
+            if (position >= 0) return false;
+            position = ~position;
+            if (cardinality == ArrayLimit) {
+                ToBitmap();
+                return Add(low);
+            }
+            if (cardinality == values->Length) {
+                Array::Resize(values, Math::Min((int)ArrayLimit, Math::Max(4, cardinality * 2)));
+            }
+            Array::Copy(values, position, values, position + 1, cardinality - position);
+            values[position] = low;
+            cardinality++;
+            return true;
+        }
+
+        bool Remove(unsigned short low) {
+            if (words != nullptr) {
+                unsigned long long mask = 1ULL << (low & 63);
+                if ((words[low >> 6] & mask) == 0) return false;
+                words[low >> 6] &= ~mask;
+                cardinality--;
+                if (cardinality <= ArrayLimit) {
+                    Container^ shrunk = FromWords(words, cardinality);
+                    values = shrunk == nullptr ? gcnew array<unsigned short>(0) : shrunk->values;
+                    words = nullptr;
+                }
+                return true;
+            }
+            int position = Array::BinarySearch(values, 0, cardinality, low);
+            if (position < 0) return false;
+            Array::Copy(values, position + 1, values, position, cardinality - position - 1);
+            cardinality--;
+            return true;
+        }
+
+        void ToBitmap() {
+            words = gcnew array<unsigned long long>(BitmapWords);
+            for (int i = 0; i < cardinality; i++) {
+                words[values[i] >> 6] |= 1ULL << (values[i] & 63);
+            }
+            values = nullptr;
+        }
+
+        array<unsigned long long>^ CopyWords() {
+            if (words != nullptr) return safe_cast<array<unsigned long long>^>(words->Clone());
+            array<unsigned long long>^ copy = gcnew array<unsigned long long>(BitmapWords);
+            for (int i = 0; i < cardinality; i++) {
+                copy[values[i] >> 6] |= 1ULL << (values[i] & 63);
+            }
+            return copy;
+        }
+
+        Container^ Clone() {
+            Container^ copy = gcnew Container();
+            copy->cardinality = cardinality;
+            if (words != nullptr) copy->words = safe_cast<array<unsigned long long>^>(words->Clone());
+            else copy->values = safe_cast<array<unsigned short>^>(values->Clone());
+            return copy;
+        }
+
+        long long EstimateBytes() {
+            return MemorySizes::ObjectHeader + 16
+                + (words != nullptr ? MemorySizes::ObjectHeader + 8 + 8LL * words->Length
+                                    : MemorySizes::ObjectHeader + 8 + 2LL * values->Length);
+        }
+    };
+
+    array<unsigned short>^ keys;
+    array<Container^>^ containers;
+    int size;
+
+    int FindKey(unsigned short key) {
+        // Частый случай - последний контейнер (добавление по возрастанию)
+        if (size > 0 && keys[size - 1] == key) return size - 1;
+        if (size > 0 && keys[size - 1] < key) return ~size;
+        return Array::BinarySearch(keys, 0, size, key);
+    }
+
+    void Append(unsigned short key, Container^ container) {
+        if (container == nullptr) return;
+        if (size == keys->Length) {
+            int capacity = Math::Max(4, size * 2);
+            Array::Resize(keys, capacity);
+            Array::Resize(containers, capacity);
+        }
+        keys[size] = key;
+        containers[size] = container;
+        size++;
+    }
+
+    void InsertAt(int position, unsigned short key, Container^ container) {
+        Append(key, container);
+        for (int i = size - 1; i > position; i--) {
+            keys[i] = keys[i - 1];
+            containers[i] = containers[i - 1];
+        }
+        keys[position] = key;
+        containers[position] = container;
+    }
+
+    static Container^ AndArrays(Container^ x, Container^ y) {
+        array<unsigned short>^ result = gcnew array<unsigned short>(Math::Min(x->cardinality, y->cardinality));
+        int i = 0, j = 0, written = 0;
+        while (i < x->cardinality && j < y->cardinality) {
+            unsigned short a = x->values[i];
+            unsigned short b = y->values[j];
+            if (a < b) i++;
+            else if (a > b) j++;
+            else {
+                result[written++] = a;
+                i++;
+                j++;
+            }
+        }
+        return written == 0 ? nullptr : Container::FromArray(result, written);
+    }
+
+    // Значения массива x, которые есть (keep) или которых нет в y
+    static Container^ FilterArray(Container^ x, Container^ y, bool keep) {
+        array<unsigned short>^ result = gcnew array<unsigned short>(x->cardinality);
+        int written = 0;
+        for (int i = 0; i < x->cardinality; i++) {
+            if (y->Contains(x->values[i]) == keep) result[written++] = x->values[i];
+        }
+        return written == 0 ? nullptr : Container::FromArray(result, written);
+    }
+
+    static Container^ OrArrays(Container^ x, Container^ y) {
+        if (x->cardinality + y->cardinality > ArrayLimit) {
+            array<unsigned long long>^ words = x->CopyWords();
+            int cardinality = x->cardinality;
+            for (int j = 0; j < y->cardinality; j++) {
+                unsigned short low = y->values[j];
+                unsigned long long mask = 1ULL << (low & 63);
+                if ((words[low >> 6] & mask) == 0) {
+                    words[low >> 6] |= mask;
+                    cardinality++;
+                }
+            }
+            return Container::FromWords(words, cardinality);
+        }
+        array<unsigned short>^ result = gcnew array<unsigned short>(x->cardinality + y->cardinality);
+        int i = 0, j = 0, written = 0;
+        while (i < x->cardinality || j < y->cardinality) {
+            if (j == y->cardinality || (i < x->cardinality && x->values[i] < y->values[j])) {
+                result[written++] = x->values[i++];
+            }
+            else if (i == x->cardinality || y->values[j] < x->values[i]) {
+                result[written++] = y->values[j++];
+            }
+            else {
+                result[written++] = x->values[i];
+                i++;
+                j++;
+            }
+        }
+        return Container::FromArray(result, written);
+    }
+
+    static Container^ WordsOp(Container^ x, Container^ y, int op) {
+        array<unsigned long long>^ result = gcnew array<unsigned long long>(BitmapWords);
+        pin_ptr<unsigned long long> a = &x->words[0];
+        pin_ptr<unsigned long long> b = &y->words[0];
+        pin_ptr<unsigned long long> out = &result[0];
+        return Container::FromWords(result, RoaringWords(op, a, b, out, BitmapWords));
+    }
+
+    static Container^ AndContainers(Container^ x, Container^ y) {
+        if (x->IsBitmap() && y->IsBitmap()) return WordsOp(x, y, 0);
+        if (x->IsBitmap()) return FilterArray(y, x, true);
+        if (y->IsBitmap()) return FilterArray(x, y, true);
+        return AndArrays(x, y);
+    }
+
+    static Container^ OrContainers(Container^ x, Container^ y) {
+        if (x->IsBitmap() && y->IsBitmap()) return WordsOp(x, y, 1);
+        if (y->IsBitmap()) return OrArrays(y, x);
+        return OrArrays(x, y);
+    }
+
+    static Container^ AndNotContainers(Container^ x, Container^ y) {
+        if (x->IsBitmap() && y->IsBitmap()) return WordsOp(x, y, 2);
+        if (!x->IsBitmap()) return FilterArray(x, y, false);
+        // Карта без значений массива
+        array<unsigned long long>^ words = x->CopyWords();
+        int cardinality = x->cardinality;
+        for (int j = 0; j < y->cardinality; j++) {
+            unsigned short low = y->values[j];
+            unsigned long long mask = 1ULL << (low & 63);
+            if ((words[low >> 6] & mask) != 0) {
+                words[low >> 6] &= ~mask;
+                cardinality--;
+            }
+        }
+        return Container::FromWords(words, cardinality);
+    }
+
+public:
+    RoaringBitmap() {
+        keys = gcnew array<unsigned short>(4);
+        containers = gcnew array<Container^>(4);
+    }
+
+    // Числа от 0 до count - 1 (полные контейнеры - битовые карты)
+    static RoaringBitmap^ Range(int count) {
+        RoaringBitmap^ result = gcnew RoaringBitmap();
+        for (int start = 0; start < count; start += 1 << 16) {
+            int length = Math::Min(1 << 16, count - start);
+            array<unsigned long long>^ words = gcnew array<unsigned long long>(BitmapWords);
+            for (int i = 0; i < length / 64; i++) words[i] = ~0ULL;
+            if (length % 64 != 0) words[length / 64] = (1ULL << (length % 64)) - 1;
+            result->Append((unsigned short)(start >> 16), Container::FromWords(words, length));
+        }
+        return result;
+    }
+
+    // Множество из номеров по возрастанию (например, результата поиска)
+    static RoaringBitmap^ FromSorted(IEnumerable<int>^ values) {
+        RoaringBitmap^ result = gcnew RoaringBitmap();
+        for each (int value in values) {
+            result->Add(value);
+        }
+        return result;
+    }
+
+    bool Add(int value) {
+        unsigned short key = (unsigned short)((unsigned int)value >> 16);
+        int position = FindKey(key);
+        if (position < 0) {
+            position = ~position;
+            InsertAt(position, key, Container::FromArray(gcnew array<unsigned short>(4), 0));
+        }
+        return containers[position]->Add((unsigned short)value);
+    }
+
+    bool Remove(int value) {
+        int position = FindKey((unsigned short)((unsigned int)value >> 16));
+        if (position < 0 || !containers[position]->Remove((unsigned short)value)) return false;
+        if (containers[position]->cardinality == 0) {
+            Array::Copy(keys, position + 1, keys, position, size - position - 1);
+            Array::Copy(containers, position + 1, containers, position, size - position - 1);
+            size--;
+            containers[size] = nullptr;
+        }
+        return true;
+    }
+
+    bool Contains(int value) {
+        int position = FindKey((unsigned short)((unsigned int)value >> 16));
+        return position >= 0 && containers[position]->Contains((unsigned short)value);
+    }
+
+    int GetCardinality() {
+        int total = 0;
+        for (int i = 0; i < size; i++) {
+            total += containers[i]->cardinality;
+        }
+        return total;
+    }
+
+    bool IsEmpty() {
+        return size == 0;
+    }
+
+    static RoaringBitmap^ And(RoaringBitmap^ x, RoaringBitmap^ y) {
+        RoaringBitmap^ result = gcnew RoaringBitmap();
+        int i = 0, j = 0;
+        while (i < x->size && j < y->size) {
+            if (x->keys[i] < y->keys[j]) i++;
+            else if (x->keys[i] > y->keys[j]) j++;
+            else {
+                result->Append(x->keys[i], AndContainers(x->containers[i], y->containers[j]));
+                i++;
+                j++;
+            }
+        }
+        return result;
+    }
+
+    static RoaringBitmap^ Or(RoaringBitmap^ x, RoaringBitmap^ y) {
+        RoaringBitmap^ result = gcnew RoaringBitmap();
+        int i = 0, j = 0;
+        while (i < x->size || j < y->size) {
+            if (j == y->size || (i < x->size && x->keys[i] < y->keys[j])) {
+                result->Append(x->keys[i], x->containers[i]->Clone());
+                i++;
+            }
+            else if (i == x->size || y->keys[j] < x->keys[i]) {
+                result->Append(y->keys[j], y->containers[j]->Clone());
+                j++;
+            }
+            else {
+                result->Append(x->keys[i], OrContainers(x->containers[i], y->containers[j]));
+                i++;
+                j++;
+            }
+        }
+        return result;
+    }
+
+    // Числа x, которых нет в y
+    static RoaringBitmap^ AndNot(RoaringBitmap^ x, RoaringBitmap^ y) {
+        RoaringBitmap^ result = gcnew RoaringBitmap();
+        int j = 0;
+        for (int i = 0; i < x->size; i++) {
+            while (j < y->size && y->keys[j] < x->keys[i]) j++;
+            if (j < y->size && y->keys[j] == x->keys[i]) {
+                result->Append(x->keys[i], AndNotContainers(x->containers[i], y->containers[j]));
+            }
+            else {
+                result->Append(x->keys[i], x->containers[i]->Clone());
+            }
+        }
+        return result;
+    }
+
+    // Все числа по возрастанию
+    array<int>^ ToArray() {
+        array<int>^ result = gcnew array<int>(GetCardinality());
+        int written = 0;
+        for (int i = 0; i < size; i++) {
+            Container^ container = containers[i];
+            int base = keys[i] << 16;
+            if (container->IsBitmap()) {
+                pin_ptr<unsigned long long> words = &container->words[0];
+                pin_ptr<int> pinned = &result[0];
+                int* out = pinned;
+                written += RoaringExtract(words, BitmapWords, base, out + written);
+            }
+            else {
+                for (int j = 0; j < container->cardinality; j++) {
+                    result[written++] = base + container->values[j];
+                }
+            }
+        }
+        return result;
+    }
+
+    long long EstimateBytes() {
+        long long bytes = MemorySizes::ObjectHeader + 24 + 2LL * keys->Length + MemorySizes::ReferenceArrayBytes(containers->Length);
+        for (int i = 0; i < size; i++) {
+            bytes += containers[i]->EstimateBytes();
+        }
+        return bytes;
+    }
+
+    // Формат: число контейнеров, затем ключ, число значений и значения
+    // (массивом, если их не больше ArrayLimit, иначе словами карты)
+    void Write(BinaryWriter^ writer) {
+        writer->Write(size);
+        for (int i = 0; i < size; i++) {
+            Container^ container = containers[i];
+            writer->Write(keys[i]);
+            writer->Write(container->cardinality);
+            if (container->IsBitmap()) {
+                for each (unsigned long long word in container->words) writer->Write(word);
+            }
+            else {
+                for (int j = 0; j < container->cardinality; j++) writer->Write(container->values[j]);
+            }
+        }
+    }
+
+    static RoaringBitmap^ Read(BinaryReader^ reader) {
+        RoaringBitmap^ result = gcnew RoaringBitmap();
+        int count = reader->ReadInt32();
+        for (int i = 0; i < count; i++) {
+            unsigned short key = reader->ReadUInt16();
+            int cardinality = reader->ReadInt32();
+            if (cardinality <= 0 || cardinality > (1 << 16) || (i > 0 && key <= result->keys[i - 1])) {
+                throw gcnew InvalidDataException("Corrupted bitmap");
+            }
+            Container^ container;
+            if (cardinality > ArrayLimit) {
+                array<unsigned long long>^ words = gcnew array<unsigned long long>(BitmapWords);
+                for (int j = 0; j < BitmapWords; j++) words[j] = reader->ReadUInt64();
+                container = gcnew Container();
+                container->words = words;
+                container->cardinality = cardinality;
+            }
+            else {
+                array<unsigned short>^ values = gcnew array<unsigned short>(cardinality);
+                for (int j = 0; j < cardinality; j++) values[j] = reader->ReadUInt16();
+                container = Container::FromArray(values, cardinality);
+            }
+            result->Append(key, container);
+        }
+        return result;
+    }
+};
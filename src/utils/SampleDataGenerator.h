@@ -0,0 +1,119 @@
+#pragma once
+#include "../models/NotebookEntry.h"
+
+using namespace System;
+using namespace System::IO;
+using namespace System::Text;
+
+// Генератор правдоподобных контактов для замеров: распределения имен,
+// доменов и городов повторяют типичную книгу (частые значения встречаются
+// чаще редких), результат детерминирован для одного seed
+public ref class SampleDataGenerator {
+private:
+    // Только латиница: исходники собираются без /utf-8
+    static array<String^>^ firstNames = gcnew array<String^> {
+        "Alexander", "Alexey", "Anna", "Andrey", "Anastasia", "Dmitry", "Ekaterina", "Elena",
+        "Ivan", "Irina", "Maxim", "Maria", "Mikhail", "Natalia", "Nikita", "Olga",
+        "Pavel", "Sergey", "Svetlana", "Tatiana", "Yulia", "Vladimir", "Victoria", "Artem",
+        "Evgeny", "Kirill", "Ksenia", "Roman", "Daria", "Polina", "Egor", "Ilya",
+        "John", "Mary", "David", "Sarah", "Michael", "Emma", "James", "Olivia"
+    };
+    static array<String^>^ lastNames = gcnew array<String^> {
+        "Ivanov", "Smirnov", "Kuznetsov", "Popov", "Vasiliev", "Petrov", "Sokolov", "Mikhailov",
+        "Novikov", "Fedorov", "Morozov", "Volkov", "Alekseev", "Lebedev", "Semenov", "Egorov",
+        "Pavlov", "Kozlov", "Stepanov", "Nikolaev", "Orlov", "Andreev", "Makarov", "Nikitin",
+        "Zakharov", "Zaitsev", "Soloviev", "Borisov", "Yakovlev", "Grigoriev", "Romanov", "Vorobiev",
+        "Smith", "Johnson", "Williams", "Brown", "Jones", "Miller", "Davis", "Wilson"
+    };
+    static array<String^>^ domains = gcnew array<String^> {
+        "gmail.com", "mail.ru", "yandex.ru", "outlook.com", "bk.ru", "inbox.ru", "list.ru",
+        "rambler.ru", "yahoo.com", "icloud.com", "hotmail.com", "protonmail.com", "example.org"
+    };
+    static array<String^>^ cities = gcnew array<String^> {
+        "Moskva", "Sankt-Peterburg", "Novosibirsk", "Ekaterinburg", "Kazan", "Nizhny Novgorod",
+        "Chelyabinsk", "Samara", "Omsk", "Rostov-na-Donu", "Ufa", "Krasnoyarsk", "Voronezh", "Perm",
+        "Volgograd", "Krasnodar", "Saratov", "Tyumen", "Tolyatti", "Izhevsk"
+    };
+    static array<String^>^ streets = gcnew array<String^> {
+        "Lenina", "Sovetskaya", "Mira", "Molodezhnaya", "Tsentralnaya", "Shkolnaya", "Sadovaya",
+        "Lesnaya", "Naberezhnaya", "Gagarina", "Pushkina", "Novaya", "Polevaya", "Zelenaya",
+        "Oktyabrskaya", "Komsomolskaya", "Pervomayskaya", "Zavodskaya", "Kirova", "Chekhova"
+    };
+    static array<String^>^ notes = gcnew array<String^> {
+        "Colleague", "Classmate", "Neighbour", "Call after 18:00", "Client", "Supplier",
+        "Family friend", "Dentist", "Coach", "Accountant, reporting questions"
+    };
+
+    Random^ random;
+
+    // Индекс с перекосом к началу списка: первые значения встречаются чаще
+    int Skewed(int length) {
+        double x = random->NextDouble();
+        return Math::Min(length - 1, (int)(x * x * length));
+    }
+
+public:
+    SampleDataGenerator(int seed) {
+        random = gcnew Random(seed);
+    }
+
+    NotebookEntry<int>^ Next(int id) {
+        int first = Skewed(firstNames->Length);
+        int last = Skewed(lastNames->Length);
+        String^ lastName = lastNames[last];
+        // Женская форма русских фамилий
+        if (first < 32 && firstNames[first]->EndsWith("a") && lastName->EndsWith("v")) {
+            lastName = lastName + "a";
+        }
+
+        String^ email = "";
+        if (random->Next(10) < 8) {
+            email = String::Format("{0}.{1}{2}@{3}", firstNames[first]->ToLower(), lastNames[last]->ToLower(),
+                random->Next(100), domains[Skewed(domains->Length)]);
+        }
+
+        String^ birthDate = "";
+        if (random->Next(10) < 7) {
+            birthDate = DateTime(1950, 1, 1).AddDays(random->Next(20000)).ToString("yyyy-MM-dd");
+        }
+
+        String^ address = "";
+        if (random->Next(10) < 6) {
+            address = String::Format("{0}, ul. {1}, d. {2}, kv. {3}", cities[Skewed(cities->Length)],
+                streets[random->Next(streets->Length)], 1 + random->Next(150), 1 + random->Next(300));
+        }
+
+        return gcnew NotebookEntry<int>(
+            id,
+            firstNames[first],
+            lastName,
+            String::Format("+7 9{0:00} {1:000}-{2:00}-{3:00}", random->Next(100), random->Next(1000),
+                random->Next(100), random->Next(100)),
+            birthDate,
+            email,
+            address,
+            random->Next(10) < 3 ? notes[random->Next(notes->Length)] : "");
+    }
+
+    // Файл TSV из count записей с ID от 1
+    void WriteTsv(String^ path, int count) {
+        StreamWriter^ writer = gcnew StreamWriter(path, false, gcnew UTF8Encoding(true), 1 << 16);
+        try {
+            for (int id = 1; id <= count; id++) {
+                NotebookEntry<int>^ entry = Next(id);
+                writer->WriteLine("{0}\t{1}\t{2}\t{3}\t{4}\t{5}\t{6}\t{7}",
+                    entry->GetId(),
+                    entry->GetFirstName(),
+                    entry->GetLastName(),
+                    entry->GetPhoneNumber(),
+                    entry->GetBirthDate(),
+                    entry->GetEmail(),
+                    entry->GetAddress(),
+                    entry->GetNotes());
+            }
+        }
+        finally {
+            writer->Close();
+        }
+    }
+};
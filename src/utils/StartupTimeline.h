@@ -0,0 +1,45 @@
+#pragma once
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Diagnostics;
+using namespace System::IO;
+using namespace Newtonsoft::Json;
+
+// Отметки времени запуска приложения, считая от старта процесса
+// (а не от конструктора формы, чтобы учесть загрузку сборок)
+public ref class StartupTimeline {
+private:
+    DateTime processStart;
+    List<KeyValuePair<String^, double>>^ marks;
+
+public:
+    StartupTimeline() {
+        processStart = Process::GetCurrentProcess()->StartTime;
+        marks = gcnew List<KeyValuePair<String^, double>>();
+    }
+
+    // Отметка фиксируется один раз: повторные вызовы игнорируются
+    void Mark(String^ name) {
+        for each (KeyValuePair<String^, double> mark in marks) {
+            if (mark.Key == name) return;
+        }
+        marks->Add(KeyValuePair<String^, double>(name, (DateTime::Now - processStart).TotalMilliseconds));
+    }
+
+    // Одна строка JSON: {"rows":..,"shown_ms":..,"first_rows_ms":..,...}
+    String^ ToJson(int rows) {
+        StringWriter^ text = gcnew StringWriter();
+        JsonTextWriter^ json = gcnew JsonTextWriter(text);
+        json->WriteStartObject();
+        json->WritePropertyName("rows");
+        json->WriteValue(rows);
+        for each (KeyValuePair<String^, double> mark in marks) {
+            json->WritePropertyName(mark.Key + "_ms");
+            json->WriteValue(Math::Round(mark.Value, 1));
+        }
+        json->WriteEndObject();
+        json->Flush();
+        return text->ToString();
+    }
+};
@@ -0,0 +1,211 @@
+#pragma once
+#include "RoaringBitmap.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+
+// Множества строк книги для вычисления выражения меток (TagIndex)
+public interface class ITagBitmapSource {
+    // Строки с меткой tag; пустое множество, если ее нет ни у одной записи
+    RoaringBitmap^ Tag(String^ tag);
+    // Строки, совпавшие с поиском по полю (запрос в нижнем регистре)
+    RoaringBitmap^ Search(int searchType, String^ loweredQuery);
+    // Все строки книги
+    RoaringBitmap^ All();
+};
+
+public enum class TagNodeKind {
+    Tag,    // запись с меткой text
+    Field,  // поиск text по полю searchType
+    Not,
+    And,
+    Or
+};
+
+// Выражение фильтра по меткам: метки и условия на поля, соединенные
+// &/and, |/or, !/-/not и скобками; слова подряд без оператора - and.
+// Условие на поле - имя:текст или имя:"текст с пробелами" (имена - как
+// у поиска NBcli: first, last, phone, email, address, sounds), метка с
+// пробелами - в кавычках. Например: work & !archived,
+// (family | friends) address:moscow
+public ref class TagExpression {
+public:
+    initonly TagNodeKind kind;
+    // Метка или текст поиска (нижний регистр)
+    initonly String^ text;
+    initonly int searchType;
+    initonly TagExpression^ left;
+    initonly TagExpression^ right;
+
+    TagExpression(TagNodeKind kind, String^ text, int searchType, TagExpression^ left, TagExpression^ right)
+        : kind(kind), text(text), searchType(searchType), left(left), right(right) {}
+
+    // Имена полей в условиях; номер имени - номер поиска в EntrySchema
+    static array<String^>^ FieldNames = gcnew array<String^> { "first", "last", "phone", "email", "address", "sounds" };
+
+private:
+    ref class Parser {
+    public:
+        String^ query;
+        int position;
+
+        Parser(String^ query) : query(query), position(0) {}
+
+        FormatException^ Error(String^ message) {
+            return gcnew FormatException(String::Format("Tag filter: {0} at position {1}", message, position + 1));
+        }
+
+        void SkipSpaces() {
+            while (position < query->Length && Char::IsWhiteSpace(query[position])) position++;
+        }
+
+        static bool IsWordChar(wchar_t c) {
+            return !Char::IsWhiteSpace(c) && c != '(' && c != ')' && c != '&' && c != '|' && c != '!' && c != '"';
+        }
+
+        // Ключевое слово (and, or, not) целым словом
+        bool TakeKeyword(String^ keyword) {
+            int end = position + keyword->Length;
+            if (end > query->Length || String::CompareOrdinal(query, position, keyword, 0, keyword->Length) != 0) return false;
+            if (end < query->Length && IsWordChar(query[end])) return false;
+            position = end;
+            return true;
+        }
+
+        String^ ReadQuoted() {
+            position++;
+            int end = query->IndexOf('"', position);
+            if (end < 0) throw Error("unterminated quote");
+            String^ value = query->Substring(position, end - position);
+            position = end + 1;
+            return value;
+        }
+
+        String^ ReadWord() {
+            int start = position;
+            while (position < query->Length && IsWordChar(query[position]) && query[position] != ':') position++;
+            return query->Substring(start, position - start);
+        }
+
+        TagExpression^ ParseOr() {
+            TagExpression^ node = ParseAnd();
+            for (;;) {
+                SkipSpaces();
+                if (position < query->Length && query[position] == '|') position++;
+                else if (!TakeKeyword("or")) return node;
+                node = gcnew TagExpression(TagNodeKind::Or, nullptr, -1, node, ParseAnd());
+            }
+        }
+
+        TagExpression^ ParseAnd() {
+            TagExpression^ node = ParseUnary();
+            for (;;) {
+                SkipSpaces();
+                if (position >= query->Length || query[position] == ')' || query[position] == '|') return node;
+                int saved = position;
+                if (TakeKeyword("or")) {
+                    position = saved;
+                    return node;
+                }
+                if (query[position] == '&') position++;
+                else TakeKeyword("and");
+                node = gcnew TagExpression(TagNodeKind::And, nullptr, -1, node, ParseUnary());
+            }
+        }
+
+        TagExpression^ ParseUnary() {
+            SkipSpaces();
+            if (position >= query->Length) throw Error("term expected");
+            wchar_t c = query[position];
+            if (c == '!' || c == '-') {
+                position++;
+                return gcnew TagExpression(TagNodeKind::Not, nullptr, -1, ParseUnary(), nullptr);
+            }
+            if (TakeKeyword("not")) {
+                return gcnew TagExpression(TagNodeKind::Not, nullptr, -1, ParseUnary(), nullptr);
+            }
+            if (c == '(') {
+                position++;
+                TagExpression^ inner = ParseOr();
+                SkipSpaces();
+                if (position >= query->Length || query[position] != ')') throw Error("')' expected");
+                position++;
+                return inner;
+            }
+            if (c == '"') {
+                return Tag(ReadQuoted());
+            }
+            if (!IsWordChar(c) || c == ':') throw Error(String::Format("unexpected '{0}'", c));
+            String^ word = ReadWord();
+            if (position < query->Length && query[position] == ':') {
+                int searchType = Array::IndexOf(FieldNames, word);
+                if (searchType < 0) throw Error("unknown field '" + word + "'");
+                position++;
+                String^ value;
+                if (position < query->Length && query[position] == '"') {
+                    value = ReadQuoted();
+                }
+                else {
+                    int start = position;
+                    while (position < query->Length && IsWordChar(query[position])) position++;
+                    value = query->Substring(start, position - start);
+                }
+                return gcnew TagExpression(TagNodeKind::Field, value->ToLower(), searchType, nullptr, nullptr);
+            }
+            return Tag(word);
+        }
+
+        static TagExpression^ Tag(String^ tag) {
+            return gcnew TagExpression(TagNodeKind::Tag, String::Intern(tag->Trim()->ToLowerInvariant()), -1, nullptr, nullptr);
+        }
+    };
+
+    // Последний разобранный запрос - свой у каждого потока: поиск по
+    // записям вызывает ParseCached для каждой из них
+    [ThreadStatic] static String^ lastQuery;
+    [ThreadStatic] static TagExpression^ lastExpression;
+
+public:
+    // Разбор запроса; пустой запрос - nullptr (все записи).
+    // FormatException - ошибка синтаксиса
+    static TagExpression^ Parse(String^ query) {
+        if (String::IsNullOrWhiteSpace(query)) return nullptr;
+        Parser^ parser = gcnew Parser(query);
+        TagExpression^ expression = parser->ParseOr();
+        parser->SkipSpaces();
+        if (parser->position < query->Length) throw parser->Error("unexpected ')'");
+        return expression;
+    }
+
+    static TagExpression^ ParseCached(String^ query) {
+        if (!Object::ReferenceEquals(lastQuery, query)) {
+            lastExpression = Parse(query);
+            lastQuery = query;
+        }
+        return lastExpression;
+    }
+
+    // Множество строк выражения. And с отрицанием считается разностью
+    // (AndNot), без дополнения до всех строк. Результат может быть
+    // множеством самого источника - его нельзя менять
+    RoaringBitmap^ Evaluate(ITagBitmapSource^ source) {
+        switch (kind) {
+        case TagNodeKind::Tag:
+            return source->Tag(text);
+        case TagNodeKind::Field:
+            return source->Search(searchType, text);
+        case TagNodeKind::Not:
+            return RoaringBitmap::AndNot(source->All(), left->Evaluate(source));
+        case TagNodeKind::And:
+            if (right->kind == TagNodeKind::Not) {
+                return RoaringBitmap::AndNot(left->Evaluate(source), right->left->Evaluate(source));
+            }
+            if (left->kind == TagNodeKind::Not) {
+                return RoaringBitmap::AndNot(right->Evaluate(source), left->left->Evaluate(source));
+            }
+            return RoaringBitmap::And(left->Evaluate(source), right->Evaluate(source));
+        default:
+            return RoaringBitmap::Or(left->Evaluate(source), right->Evaluate(source));
+        }
+    }
+};
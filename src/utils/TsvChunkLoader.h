@@ -0,0 +1,238 @@
+#pragma once
+#include "../models/NotebookEntry.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::IO;
+using namespace System::IO::MemoryMappedFiles;
+using namespace System::Text;
+using namespace System::Threading::Tasks;
+
+// Параллельный загрузчик старого текстового формата (TSV).
+// Файл отображается в память, делится на куски по границам строк,
+// куски разбираются параллельно в заранее выделенные буферы и затем
+// склеиваются в исходном порядке. Поля строки существуют только как
+// пары (указатель, длина) до момента создания записи - никакого Split
+// и промежуточных массивов строк.
+public ref class TsvChunkLoader {
+public:
+    literal int FieldCount = 8;
+    // Колонка меток после полей (EntrySchema::WriteTsv), может отсутствовать
+    literal int TagsColumn = FieldCount;
+
+    // Загрузка файла. Возвращает nullptr, если файл в кодировке UTF-16 -
+    // такие файлы читаются последовательным путем через StreamReader
+    static List<NotebookEntry<int>^>^ Load(String^ filePath) {
+        FileStream^ stream = gcnew FileStream(filePath, FileMode::Open, FileAccess::Read, FileShare::Read);
+        try {
+            long long length = stream->Length;
+            if (length == 0) {
+                return gcnew List<NotebookEntry<int>^>();
+            }
+
+            MemoryMappedFile^ mappedFile = MemoryMappedFile::CreateFromFile(
+                stream, nullptr, 0, MemoryMappedFileAccess::Read, nullptr, HandleInheritability::None, true);
+            MemoryMappedViewAccessor^ view = nullptr;
+            unsigned char* basePtr = nullptr;
+            try {
+                view = mappedFile->CreateViewAccessor(0, 0, MemoryMappedFileAccess::Read);
+                view->SafeMemoryMappedViewHandle->AcquirePointer(basePtr);
+                unsigned char* data = basePtr + view->PointerOffset;
+
+                // Пропускаем BOM UTF-8; UTF-16 отдаем последовательному пути
+                long long offset = 0;
+                if (length >= 2 && ((data[0] == 0xFF && data[1] == 0xFE) || (data[0] == 0xFE && data[1] == 0xFF))) {
+                    return nullptr;
+                }
+                if (length >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF) {
+                    offset = 3;
+                }
+
+                TsvChunkLoader^ loader = gcnew TsvChunkLoader(data + offset, length - offset);
+                return loader->Run();
+            }
+            finally {
+                if (basePtr != nullptr) {
+                    view->SafeMemoryMappedViewHandle->ReleasePointer();
+                }
+                if (view != nullptr) {
+                    delete view;
+                }
+                delete mappedFile;
+            }
+        }
+        finally {
+            stream->Close();
+        }
+    }
+
+private:
+    // Куски меньше этого размера не дробим - накладные расходы больше выигрыша
+    literal long long MinChunkSize = 1024 * 1024;
+
+    unsigned char* data;
+    long long length;
+    array<long long>^ chunkStarts;
+    array<array<NotebookEntry<int>^>^>^ chunkEntries;
+    array<int>^ chunkCounts;
+
+    TsvChunkLoader(unsigned char* data, long long length) {
+        this->data = data;
+        this->length = length;
+    }
+
+    List<NotebookEntry<int>^>^ Run() {
+        SplitIntoChunks();
+
+        int chunkCount = chunkStarts->Length - 1;
+        chunkEntries = gcnew array<array<NotebookEntry<int>^>^>(chunkCount);
+        chunkCounts = gcnew array<int>(chunkCount);
+
+        try {
+            Parallel::For(0, chunkCount, gcnew Action<int>(this, &TsvChunkLoader::ParseChunk));
+        }
+        catch (AggregateException^ ex) {
+            // Наружу отдаем первую настоящую ошибку разбора
+            throw ex->Flatten()->InnerExceptions[0];
+        }
+
+        // Склеиваем куски в исходном порядке
+        int total = 0;
+        for (int i = 0; i < chunkCount; i++) {
+            total += chunkCounts[i];
+        }
+        List<NotebookEntry<int>^>^ result = gcnew List<NotebookEntry<int>^>(total);
+        for (int i = 0; i < chunkCount; i++) {
+            array<NotebookEntry<int>^>^ buffer = chunkEntries[i];
+            for (int j = 0; j < chunkCounts[i]; j++) {
+                result->Add(buffer[j]);
+            }
+            chunkEntries[i] = nullptr;
+        }
+        return result;
+    }
+
+    // Разбиение файла на куски, выровненные по началу строки
+    void SplitIntoChunks() {
+        long long chunkCount = length / MinChunkSize;
+        long long maxChunks = Environment::ProcessorCount * 4;
+        if (chunkCount > maxChunks) chunkCount = maxChunks;
+        if (chunkCount < 1) chunkCount = 1;
+
+        List<long long>^ starts = gcnew List<long long>();
+        starts->Add(0);
+        for (long long k = 1; k < chunkCount; k++) {
+            long long pos = k * (length / chunkCount);
+            if (pos <= starts[starts->Count - 1]) {
+                continue;
+            }
+            while (pos < length && data[pos - 1] != '\n') {
+                pos++;
+            }
+            if (pos >= length) {
+                break;
+            }
+            starts->Add(pos);
+        }
+        starts->Add(length);
+        chunkStarts = starts->ToArray();
+    }
+
+    // Разбор одного куска в собственный буфер
+    void ParseChunk(int chunkIndex) {
+        unsigned char* p = data + chunkStarts[chunkIndex];
+        unsigned char* end = data + chunkStarts[chunkIndex + 1];
+
+        // Число строк не больше числа переводов строки плюс одна
+        int capacity = 1;
+        for (unsigned char* q = p; q < end; q++) {
+            if (*q == '\n' || *q == '\r') capacity++;
+        }
+        array<NotebookEntry<int>^>^ buffer = gcnew array<NotebookEntry<int>^>(capacity);
+        int count = 0;
+
+        // Поля текущей строки: начало и длина
+        unsigned char* fieldStart[FieldCount + 1];
+        int fieldLength[FieldCount + 1];
+
+        while (p < end) {
+            unsigned char* lineEnd = p;
+            while (lineEnd < end && *lineEnd != '\n' && *lineEnd != '\r') {
+                lineEnd++;
+            }
+
+            // Режем строку по табуляциям; поля после меток игнорируются
+            int fields = 0;
+            unsigned char* fieldBegin = p;
+            for (unsigned char* q = p; q <= lineEnd && fields < FieldCount + 1; q++) {
+                if (q == lineEnd || *q == '\t') {
+                    fieldStart[fields] = fieldBegin;
+                    fieldLength[fields] = (int)(q - fieldBegin);
+                    fields++;
+                    fieldBegin = q + 1;
+                }
+            }
+
+            if (fields >= FieldCount) {
+                NotebookEntry<int>^ entry = gcnew NotebookEntry<int>(
+                    ParseId(fieldStart[0], fieldLength[0]),
+                    Decode(fieldStart[1], fieldLength[1]),
+                    Decode(fieldStart[2], fieldLength[2]),
+                    Decode(fieldStart[3], fieldLength[3]),
+                    Decode(fieldStart[4], fieldLength[4]),
+                    Decode(fieldStart[5], fieldLength[5]),
+                    Decode(fieldStart[6], fieldLength[6]),
+                    Decode(fieldStart[7], fieldLength[7])
+                );
+                if (fields > TagsColumn && fieldLength[TagsColumn] > 0) {
+                    entry->SetTags(Decode(fieldStart[TagsColumn], fieldLength[TagsColumn])->Split(','));
+                }
+                buffer[count++] = entry;
+            }
+
+            // Переход к следующей строке (\n, \r или \r\n)
+            p = lineEnd;
+            if (p < end && *p == '\r') {
+                p++;
+                if (p < end && *p == '\n') p++;
+            }
+            else if (p < end) {
+                p++;
+            }
+        }
+
+        chunkEntries[chunkIndex] = buffer;
+        chunkCounts[chunkIndex] = count;
+    }
+
+    static String^ Decode(unsigned char* start, int length) {
+        if (length == 0) {
+            return String::Empty;
+        }
+        return Encoding::UTF8->GetString(start, length);
+    }
+
+    // Разбор ID без создания строки; все нестандартное отдаем Int32::Parse,
+    // чтобы сохранить прежнее поведение и тексты ошибок
+    static int ParseId(unsigned char* start, int length) {
+        long long value = 0;
+        int i = 0;
+        bool negative = false;
+        if (i < length && (start[i] == '-' || start[i] == '+')) {
+            negative = start[i] == '-';
+            i++;
+        }
+        int digitsStart = i;
+        while (i < length && start[i] >= '0' && start[i] <= '9' && i - digitsStart < 10) {
+            value = value * 10 + (start[i] - '0');
+            i++;
+        }
+        if (i == length && i > digitsStart) {
+            if (negative) value = -value;
+            if (value >= Int32::MinValue && value <= Int32::MaxValue) {
+                return (int)value;
+            }
+        }
+        return Int32::Parse(Decode(start, length));
+    }
+};
\ No newline at end of file
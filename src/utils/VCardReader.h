@@ -0,0 +1,455 @@
+#pragma once
+#include "../models/NotebookEntry.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Globalization;
+using namespace System::IO;
+using namespace System::Text;
+
+// Потоковое чтение vCard 2.1/3.0/4.0 (выгрузки адресных книг телефонов).
+// В памяти только текущая карточка: строки читаются по одной, перенесенные
+// строки склеиваются, значения в quoted-printable декодируются в
+// кодировке из CHARSET. Карточка переводится в NotebookEntry:
+//   N (или FN)  - имя и фамилия
+//   TEL, EMAIL  - предпочтительный (PREF/TYPE=pref) или первый номер и адрес
+//                 почты; остальные дописываются в заметки
+//   BDAY        - дата рождения в виде yyyy-MM-dd
+//   ADR         - части адреса через запятую: город, улица, регион, индекс, страна
+//   NOTE        - заметки
+//   CATEGORIES  - метки (список через запятую, свойств может быть несколько)
+//   UID         - ID записи, если это число
+// Карточки без имени, фамилии или телефона пропускаются при добавлении
+// (NotebookEntry::IsValid). Читатель - одноразовая последовательность
+// записей (for each или конструктор List)
+public ref class VCardReader : IEnumerable<NotebookEntry<int>^> {
+private:
+    // Значение свойства с приоритетом (меньше - предпочтительнее)
+    value struct RankedValue {
+        String^ value;
+        int rank;
+    };
+
+    ref class Enumerator : IEnumerator<NotebookEntry<int>^> {
+    private:
+        VCardReader^ owner;
+        NotebookEntry<int>^ current;
+    public:
+        Enumerator(VCardReader^ owner) : owner(owner) {}
+        ~Enumerator() {}
+
+        virtual bool MoveNext() {
+            return owner->Read(current);
+        }
+
+        virtual void Reset() {
+            throw gcnew NotSupportedException();
+        }
+
+        property NotebookEntry<int>^ Current {
+            virtual NotebookEntry<int>^ get() { return current; }
+        }
+
+        property Object^ CurrentObject {
+            virtual Object^ get() = System::Collections::IEnumerator::Current::get { return current; }
+        }
+    };
+
+    TextReader^ reader;
+    // Следующая физическая строка, прочитанная для проверки переноса
+    String^ pending;
+    StringBuilder^ line = gcnew StringBuilder();
+    int cards;
+    int linesRead;
+
+    // ID: из UID, если он свободен, иначе следующий свободный номер
+    HashSet<int>^ usedIds;
+    int nextId = 1;
+
+    // Поля текущей карточки
+    String^ firstName;
+    String^ lastName;
+    String^ formattedName;
+    String^ birthDate;
+    String^ address;
+    String^ note;
+    int uid;
+    bool hasUid;
+    List<RankedValue>^ phones = gcnew List<RankedValue>();
+    List<RankedValue>^ emails = gcnew List<RankedValue>();
+    List<String^>^ categories = gcnew List<String^>();
+
+    String^ ReadPhysical() {
+        if (pending != nullptr) {
+            String^ result = pending;
+            pending = nullptr;
+            return result;
+        }
+        String^ result = reader->ReadLine();
+        if (result != nullptr) linesRead++;
+        return result;
+    }
+
+    static bool IsQuotedPrintable(StringBuilder^ text) {
+        // Параметры - до первого двоеточия
+        int colon = -1;
+        for (int i = 0; i < text->Length; i++) {
+            if (text[i] == L':') { colon = i; break; }
+        }
+        if (colon < 0) return false;
+        return text->ToString(0, colon)->IndexOf("QUOTED-PRINTABLE", StringComparison::OrdinalIgnoreCase) >= 0;
+    }
+
+    // Логическая строка: продолжения, начинающиеся с пробела или табуляции,
+    // приклеиваются без этого символа; в quoted-printable строка,
+    // заканчивающаяся на '=', продолжается следующей (мягкий перенос 2.1)
+    bool NextLine(String^% result) {
+        String^ first = ReadPhysical();
+        while (first != nullptr && first->Length == 0) {
+            first = ReadPhysical();
+        }
+        if (first == nullptr) return false;
+        line->Clear();
+        line->Append(first);
+        while (true) {
+            if (line->Length > 0 && line[line->Length - 1] == L'=' && IsQuotedPrintable(line)) {
+                String^ continuation = ReadPhysical();
+                if (continuation == nullptr) break;
+                line->Length--;
+                line->Append(continuation);
+                continue;
+            }
+            String^ next = ReadPhysical();
+            if (next == nullptr) break;
+            if (next->Length > 0 && (next[0] == L' ' || next[0] == L'\t')) {
+                line->Append(next, 1, next->Length - 1);
+                continue;
+            }
+            pending = next;
+            break;
+        }
+        result = line->ToString();
+        return true;
+    }
+
+    // Значения параметра (TYPE=home,pref; PREF=1; голый параметр 2.1 - "PREF")
+    static bool HasParameter(array<String^>^ parameters, String^ name, String^ value) {
+        for (int i = 1; i < parameters->Length; i++) {
+            String^ parameter = parameters[i];
+            int equals = parameter->IndexOf(L'=');
+            if (equals < 0) {
+                if (value != nullptr && parameter->Equals(value, StringComparison::OrdinalIgnoreCase)) return true;
+                continue;
+            }
+            if (!String::Equals(parameter->Substring(0, equals)->Trim(), name, StringComparison::OrdinalIgnoreCase)) continue;
+            if (value == nullptr) return true;
+            for each (String^ item in parameter->Substring(equals + 1)->Trim(L'"')->Split(L',')) {
+                if (item->Equals(value, StringComparison::OrdinalIgnoreCase)) return true;
+            }
+        }
+        return false;
+    }
+
+    static String^ ParameterValue(array<String^>^ parameters, String^ name) {
+        for (int i = 1; i < parameters->Length; i++) {
+            int equals = parameters[i]->IndexOf(L'=');
+            if (equals > 0 && String::Equals(parameters[i]->Substring(0, equals)->Trim(), name, StringComparison::OrdinalIgnoreCase)) {
+                return parameters[i]->Substring(equals + 1)->Trim(L'"');
+            }
+        }
+        return nullptr;
+    }
+
+    // Приоритет TEL/EMAIL: PREF=1 (4.0) и TYPE=pref (3.0) впереди, затем по порядку
+    static int Rank(array<String^>^ parameters) {
+        String^ pref = ParameterValue(parameters, "PREF");
+        int rank;
+        if (pref != nullptr && Int32::TryParse(pref, rank)) return rank;
+        return HasParameter(parameters, "TYPE", "pref") ? 1 : 101;
+    }
+
+    static String^ DecodeQuotedPrintable(String^ value, String^ charset) {
+        List<Byte>^ bytes = gcnew List<Byte>(value->Length);
+        for (int i = 0; i < value->Length; i++) {
+            int high, low;
+            if (value[i] == L'=' && i + 2 < value->Length
+                && (high = HexDigit(value[i + 1])) >= 0 && (low = HexDigit(value[i + 2])) >= 0) {
+                bytes->Add((Byte)(high * 16 + low));
+                i += 2;
+            }
+            else {
+                bytes->Add((Byte)value[i]);
+            }
+        }
+        Encoding^ encoding = Encoding::UTF8;
+        if (!String::IsNullOrEmpty(charset)) {
+            try {
+                encoding = Encoding::GetEncoding(charset);
+            }
+            catch (ArgumentException^) {
+            }
+        }
+        return encoding->GetString(bytes->ToArray());
+    }
+
+    static int HexDigit(wchar_t c) {
+        if (c >= L'0' && c <= L'9') return c - L'0';
+        if (c >= L'A' && c <= L'F') return c - L'A' + 10;
+        if (c >= L'a' && c <= L'f') return c - L'a' + 10;
+        return -1;
+    }
+
+    // Части структурированного значения (N, ADR) по неэкранированной ';'
+    static List<String^>^ SplitComponents(String^ value) {
+        return SplitComponents(value, L';');
+    }
+
+    // То же по другому разделителю (',' - списки, например CATEGORIES)
+    static List<String^>^ SplitComponents(String^ value, wchar_t separator) {
+        List<String^>^ parts = gcnew List<String^>();
+        int start = 0;
+        for (int i = 0; i < value->Length; i++) {
+            if (value[i] == L'\\') {
+                i++;
+            }
+            else if (value[i] == separator) {
+                parts->Add(Unescape(value->Substring(start, i - start)));
+                start = i + 1;
+            }
+        }
+        parts->Add(Unescape(value->Substring(start)));
+        return parts;
+    }
+
+    static String^ Unescape(String^ value) {
+        if (value->IndexOf(L'\\') < 0) return value;
+        StringBuilder^ result = gcnew StringBuilder(value->Length);
+        for (int i = 0; i < value->Length; i++) {
+            wchar_t c = value[i];
+            if (c == L'\\' && i + 1 < value->Length) {
+                wchar_t next = value[++i];
+                result->Append(next == L'n' || next == L'N' ? L'\n' : next);
+            }
+            else {
+                result->Append(c);
+            }
+        }
+        return result->ToString();
+    }
+
+    static String^ Component(List<String^>^ parts, int index) {
+        return index < parts->Count ? parts[index]->Trim() : "";
+    }
+
+    // yyyy-MM-dd, yyyyMMdd, с временем или без; дата без года (--MMdd) и
+    // прочие формы остаются как есть
+    static String^ NormalizeDate(String^ value) {
+        String^ date = value;
+        int time = date->IndexOf(L'T');
+        if (time > 0) date = date->Substring(0, time);
+        DateTime parsed;
+        array<String^>^ formats = { "yyyy-MM-dd", "yyyyMMdd" };
+        if (DateTime::TryParseExact(date, formats, CultureInfo::InvariantCulture, DateTimeStyles::None, parsed)) {
+            return parsed.ToString("yyyy-MM-dd");
+        }
+        return value;
+    }
+
+    static String^ Best(List<RankedValue>^ values, String^ label, StringBuilder^ extras) {
+        if (values->Count == 0) return "";
+        int best = 0;
+        for (int i = 1; i < values->Count; i++) {
+            if (values[i].rank < values[best].rank) best = i;
+        }
+        for (int i = 0; i < values->Count; i++) {
+            if (i == best) continue;
+            if (extras->Length > 0) extras->Append(L'\n');
+            extras->Append(label)->Append(": ")->Append(values[i].value);
+        }
+        return values[best].value;
+    }
+
+    void BeginCard() {
+        firstName = nullptr;
+        lastName = nullptr;
+        formattedName = nullptr;
+        birthDate = "";
+        address = "";
+        note = "";
+        categories->Clear();
+        hasUid = false;
+        phones->Clear();
+        emails->Clear();
+    }
+
+    void ApplyProperty(String^ text) {
+        int colon = -1;
+        bool quoted = false;
+        for (int i = 0; i < text->Length; i++) {
+            if (text[i] == L'"') quoted = !quoted;
+            else if (text[i] == L':' && !quoted) { colon = i; break; }
+        }
+        if (colon < 0) return;
+        array<String^>^ parameters = text->Substring(0, colon)->Split(L';');
+        String^ name = parameters[0];
+        int dot = name->LastIndexOf(L'.');
+        if (dot >= 0) name = name->Substring(dot + 1);
+        name = name->ToUpperInvariant();
+        String^ value = text->Substring(colon + 1);
+        if (HasParameter(parameters, "ENCODING", "QUOTED-PRINTABLE")) {
+            value = DecodeQuotedPrintable(value, ParameterValue(parameters, "CHARSET"));
+        }
+
+        if (name == "N") {
+            List<String^>^ parts = SplitComponents(value);
+            lastName = Component(parts, 0);
+            firstName = Component(parts, 1);
+        }
+        else if (name == "FN") {
+            formattedName = Unescape(value)->Trim();
+        }
+        else if (name == "TEL") {
+            String^ number = Unescape(value)->Trim();
+            if (number->StartsWith("tel:", StringComparison::OrdinalIgnoreCase)) number = number->Substring(4);
+            if (number->Length == 0) return;
+            RankedValue item;
+            item.value = number;
+            item.rank = Rank(parameters) * 1000 + phones->Count;
+            phones->Add(item);
+        }
+        else if (name == "EMAIL") {
+            String^ email = Unescape(value)->Trim();
+            if (email->Length == 0) return;
+            RankedValue item;
+            item.value = email;
+            item.rank = Rank(parameters) * 1000 + emails->Count;
+            emails->Add(item);
+        }
+        else if (name == "BDAY") {
+            birthDate = NormalizeDate(Unescape(value)->Trim());
+        }
+        else if (name == "ADR" && address->Length == 0) {
+            List<String^>^ parts = SplitComponents(value);
+            // Город первым: по нему группирует статистика
+            array<int>^ order = { 3, 2, 1, 4, 5, 6, 0 };
+            StringBuilder^ joined = gcnew StringBuilder();
+            for each (int index in order) {
+                String^ part = Component(parts, index);
+                if (part->Length == 0) continue;
+                if (joined->Length > 0) joined->Append(", ");
+                joined->Append(part);
+            }
+            address = joined->ToString();
+        }
+        else if (name == "NOTE") {
+            note = note->Length == 0 ? Unescape(value) : note + "\n" + Unescape(value);
+        }
+        else if (name == "CATEGORIES") {
+            categories->AddRange(SplitComponents(value, L','));
+        }
+        else if (name == "UID") {
+            int parsed;
+            String^ raw = Unescape(value)->Trim();
+            if (Int32::TryParse(raw, NumberStyles::None, CultureInfo::InvariantCulture, parsed) && parsed > 0) {
+                uid = parsed;
+                hasUid = true;
+            }
+        }
+    }
+
+    NotebookEntry<int>^ EndCard() {
+        if (String::IsNullOrEmpty(firstName) && String::IsNullOrEmpty(lastName) && !String::IsNullOrEmpty(formattedName)) {
+            // Только FN: фамилия - последнее слово
+            int space = formattedName->LastIndexOf(L' ');
+            firstName = space > 0 ? formattedName->Substring(0, space) : formattedName;
+            lastName = space > 0 ? formattedName->Substring(space + 1) : "";
+        }
+        StringBuilder^ extras = gcnew StringBuilder();
+        String^ phone = Best(phones, "TEL", extras);
+        String^ email = Best(emails, "EMAIL", extras);
+        String^ notes = note;
+        if (extras->Length > 0) {
+            notes = notes->Length == 0 ? extras->ToString() : notes + "\n" + extras->ToString();
+        }
+
+        int id;
+        if (usedIds == nullptr) {
+            id = hasUid ? uid : 0;
+        }
+        else {
+            if (hasUid && usedIds->Add(uid)) {
+                id = uid;
+            }
+            else {
+                while (usedIds->Contains(nextId)) nextId++;
+                id = nextId;
+                usedIds->Add(id);
+            }
+        }
+        cards++;
+        NotebookEntry<int>^ entry = gcnew NotebookEntry<int>(id, firstName == nullptr ? "" : firstName,
+            lastName == nullptr ? "" : lastName, phone, birthDate, email, address, notes);
+        entry->SetTags(categories->ToArray());
+        return entry;
+    }
+
+public:
+    VCardReader(TextReader^ reader) : reader(reader) {}
+
+    static VCardReader^ Open(String^ path) {
+        return gcnew VCardReader(gcnew StreamReader(path, Encoding::UTF8, true, 1 << 16));
+    }
+
+    // Номера записей: UID, если он не занят, иначе следующий свободный.
+    // Без вызова ID берется из UID как есть (0, если его нет)
+    void AssignIds(HashSet<int>^ used, int firstFreeId) {
+        usedIds = used;
+        nextId = Math::Max(1, firstFreeId);
+    }
+
+    // Следующая карточка; false в конце потока. Вложенные карточки
+    // (AGENT в 2.1) пропускаются
+    bool Read(NotebookEntry<int>^% entry) {
+        String^ text;
+        while (NextLine(text)) {
+            if (!text->Trim()->Equals("BEGIN:VCARD", StringComparison::OrdinalIgnoreCase)) continue;
+            BeginCard();
+            int depth = 1;
+            while (depth > 0 && NextLine(text)) {
+                String^ marker = text->Trim();
+                if (marker->Equals("BEGIN:VCARD", StringComparison::OrdinalIgnoreCase)) {
+                    depth++;
+                }
+                else if (marker->Equals("END:VCARD", StringComparison::OrdinalIgnoreCase)) {
+                    depth--;
+                }
+                else if (depth == 1) {
+                    ApplyProperty(text);
+                }
+            }
+            entry = EndCard();
+            return true;
+        }
+        return false;
+    }
+
+    int GetCardCount() {
+        return cards;
+    }
+
+    int GetLineCount() {
+        return linesRead;
+    }
+
+    void Close() {
+        reader->Close();
+    }
+
+    virtual IEnumerator<NotebookEntry<int>^>^ GetEnumerator() {
+        return gcnew Enumerator(this);
+    }
+
+    virtual System::Collections::IEnumerator^ GetEnumeratorObject() = System::Collections::IEnumerable::GetEnumerator {
+        return GetEnumerator();
+    }
+};
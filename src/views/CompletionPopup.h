@@ -0,0 +1,136 @@
+#pragma once
+
+namespace NBapp {
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Drawing;
+using namespace System::Windows::Forms;
+
+// Выпадающий список подсказок под полем ввода: обновляется при вводе
+// текста, стрелки выбирают подсказку, Enter или щелчок подставляют ее,
+// Escape и уход из поля закрывают список. Подсказки дает source
+// (текст поля - значения по убыванию частоты)
+public ref class CompletionPopup
+{
+public:
+    literal int MaxItems = 8;
+
+    CompletionPopup(Form^ form, TextBox^ textBox, Func<String^, List<String^>^>^ source)
+    {
+        this->form = form;
+        this->textBox = textBox;
+        this->source = source;
+
+        list = gcnew ListBox();
+        list->Visible = false;
+        list->TabStop = false;
+        list->IntegralHeight = false;
+        list->Width = textBox->Width;
+        list->MouseClick += gcnew MouseEventHandler(this, &CompletionPopup::List_MouseClick);
+        list->Leave += gcnew EventHandler(this, &CompletionPopup::TextBox_Leave);
+        form->Controls->Add(list);
+
+        textBox->TextChanged += gcnew EventHandler(this, &CompletionPopup::TextBox_TextChanged);
+        textBox->KeyDown += gcnew KeyEventHandler(this, &CompletionPopup::TextBox_KeyDown);
+        textBox->Leave += gcnew EventHandler(this, &CompletionPopup::TextBox_Leave);
+    }
+
+    void Hide()
+    {
+        list->Visible = false;
+    }
+
+private:
+    Form^ form;
+    TextBox^ textBox;
+    ListBox^ list;
+    Func<String^, List<String^>^>^ source;
+    // Текст меняется подстановкой, а не вводом
+    bool accepting;
+
+    void Show(List<String^>^ values)
+    {
+        list->BeginUpdate();
+        list->Items->Clear();
+        for each (String^ value in values) {
+            list->Items->Add(value);
+        }
+        list->EndUpdate();
+        list->Height = list->ItemHeight * Math::Min(values->Count, (int)MaxItems) + 4;
+        list->Location = form->PointToClient(textBox->Parent->PointToScreen(Point(textBox->Left, textBox->Bottom)));
+        list->Visible = true;
+        list->BringToFront();
+    }
+
+    void Accept(int index)
+    {
+        if (index < 0 || index >= list->Items->Count) return;
+        accepting = true;
+        try {
+            textBox->Text = safe_cast<String^>(list->Items[index]);
+            textBox->SelectionStart = textBox->Text->Length;
+        }
+        finally {
+            accepting = false;
+        }
+        Hide();
+    }
+
+    void TextBox_TextChanged(Object^ sender, EventArgs^ e)
+    {
+        if (accepting || !textBox->Focused) return;
+        List<String^>^ values = source(textBox->Text);
+        // Единственная подсказка, совпадающая с текстом, ничего не добавляет
+        if (values->Count == 0 || (values->Count == 1 && values[0] == textBox->Text)) {
+            Hide();
+            return;
+        }
+        Show(values);
+    }
+
+    void TextBox_KeyDown(Object^ sender, KeyEventArgs^ e)
+    {
+        if (!list->Visible) return;
+        switch (e->KeyCode) {
+        case Keys::Down:
+            list->SelectedIndex = Math::Min(list->SelectedIndex + 1, list->Items->Count - 1);
+            e->SuppressKeyPress = true;
+            break;
+        case Keys::Up:
+            list->SelectedIndex = Math::Max(list->SelectedIndex - 1, -1);
+            e->SuppressKeyPress = true;
+            break;
+        case Keys::Enter:
+            if (list->SelectedIndex >= 0) {
+                Accept(list->SelectedIndex);
+                e->SuppressKeyPress = true;
+            }
+            break;
+        case Keys::Escape:
+            Hide();
+            e->SuppressKeyPress = true;
+            break;
+        }
+    }
+
+    void List_MouseClick(Object^ sender, MouseEventArgs^ e)
+    {
+        Accept(list->IndexFromPoint(e->Location));
+        textBox->Focus();
+    }
+
+    // Фокус переходит после Leave: список закрывается, если он ушел
+    // не на сам список (щелчок по подсказке)
+    void TextBox_Leave(Object^ sender, EventArgs^ e)
+    {
+        form->BeginInvoke(gcnew MethodInvoker(this, &CompletionPopup::HideUnlessFocused));
+    }
+
+    void HideUnlessFocused()
+    {
+        if (!textBox->Focused && !list->Focused) Hide();
+    }
+};
+
+}
@@ -0,0 +1,228 @@
+#pragma once
+#include "../utils/MemoryAccounting.h"
+
+namespace NBapp {
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Diagnostics;
+using namespace System::Drawing;
+using namespace System::IO;
+using namespace System::Windows::Forms;
+
+// Окно диагностики: память по подсистемам (обновляется раз в секунду),
+// бюджеты и выгрузка отчета в JSON
+public ref class DiagnosticsForm : public System::Windows::Forms::Form
+{
+public:
+    DiagnosticsForm(MemoryAccounting^ memory, String^ budgetsPath)
+    {
+        this->memory = memory;
+        this->budgetsPath = budgetsPath;
+        InitializeComponent();
+        RefreshView();
+        refreshTimer->Start();
+    }
+
+protected:
+    ~DiagnosticsForm()
+    {
+        refreshTimer->Stop();
+        if (components)
+        {
+            delete components;
+        }
+    }
+
+private:
+    MemoryAccounting^ memory;
+    String^ budgetsPath;
+    System::ComponentModel::Container^ components;
+
+    System::Windows::Forms::ListView^ consumersListView;
+    System::Windows::Forms::Label^ processLabel;
+    System::Windows::Forms::NumericUpDown^ budgetUpDown;
+    System::Windows::Forms::Button^ setBudgetButton;
+    System::Windows::Forms::Button^ trimButton;
+    System::Windows::Forms::Button^ saveJsonButton;
+    System::Windows::Forms::Timer^ refreshTimer;
+
+    static String^ FormatMegabytes(long long bytes)
+    {
+        return (bytes / (1024.0 * 1024.0)).ToString("N1") + " MB";
+    }
+
+    void InitializeComponent(void)
+    {
+        this->components = gcnew System::ComponentModel::Container();
+        this->Size = System::Drawing::Size(820, 400);
+        this->Text = "Memory Diagnostics";
+        this->StartPosition = FormStartPosition::CenterParent;
+        this->Font = gcnew System::Drawing::Font("Microsoft Sans Serif", 9);
+
+        this->consumersListView = gcnew ListView();
+        this->consumersListView->Location = Point(10, 10);
+        this->consumersListView->Size = System::Drawing::Size(785, 250);
+        this->consumersListView->Anchor = static_cast<AnchorStyles>(AnchorStyles::Top | AnchorStyles::Left | AnchorStyles::Right | AnchorStyles::Bottom);
+        this->consumersListView->View = View::Details;
+        this->consumersListView->FullRowSelect = true;
+        this->consumersListView->MultiSelect = false;
+        this->consumersListView->Columns->Add("Subsystem", 190);
+        this->consumersListView->Columns->Add("Size", 100, HorizontalAlignment::Right);
+        this->consumersListView->Columns->Add("Budget", 100, HorizontalAlignment::Right);
+        this->consumersListView->Columns->Add("Evictions", 80, HorizontalAlignment::Right);
+        this->consumersListView->Columns->Add("Details", 255);
+        this->consumersListView->SelectedIndexChanged += gcnew EventHandler(this, &DiagnosticsForm::Consumers_SelectedIndexChanged);
+
+        this->processLabel = gcnew Label();
+        this->processLabel->Location = Point(10, 270);
+        this->processLabel->Size = System::Drawing::Size(785, 40);
+        this->processLabel->Anchor = static_cast<AnchorStyles>(AnchorStyles::Left | AnchorStyles::Right | AnchorStyles::Bottom);
+
+        Label^ budgetLabel = gcnew Label();
+        budgetLabel->Text = "Budget, MB (0 - none):";
+        budgetLabel->Location = Point(10, 322);
+        budgetLabel->Size = System::Drawing::Size(135, 20);
+        budgetLabel->Anchor = static_cast<AnchorStyles>(AnchorStyles::Left | AnchorStyles::Bottom);
+
+        this->budgetUpDown = gcnew NumericUpDown();
+        this->budgetUpDown->Location = Point(150, 320);
+        this->budgetUpDown->Size = System::Drawing::Size(80, 25);
+        this->budgetUpDown->Maximum = 1024 * 1024;
+        this->budgetUpDown->Anchor = static_cast<AnchorStyles>(AnchorStyles::Left | AnchorStyles::Bottom);
+
+        this->setBudgetButton = gcnew Button();
+        this->setBudgetButton->Text = "Set Budget";
+        this->setBudgetButton->Location = Point(240, 318);
+        this->setBudgetButton->Size = System::Drawing::Size(90, 27);
+        this->setBudgetButton->Anchor = static_cast<AnchorStyles>(AnchorStyles::Left | AnchorStyles::Bottom);
+        this->setBudgetButton->Click += gcnew EventHandler(this, &DiagnosticsForm::SetBudgetButton_Click);
+
+        this->trimButton = gcnew Button();
+        this->trimButton->Text = "Trim Now";
+        this->trimButton->Location = Point(340, 318);
+        this->trimButton->Size = System::Drawing::Size(90, 27);
+        this->trimButton->Anchor = static_cast<AnchorStyles>(AnchorStyles::Left | AnchorStyles::Bottom);
+        this->trimButton->Click += gcnew EventHandler(this, &DiagnosticsForm::TrimButton_Click);
+
+        this->saveJsonButton = gcnew Button();
+        this->saveJsonButton->Text = "Save JSON...";
+        this->saveJsonButton->Location = Point(700, 318);
+        this->saveJsonButton->Size = System::Drawing::Size(95, 27);
+        this->saveJsonButton->Anchor = static_cast<AnchorStyles>(AnchorStyles::Right | AnchorStyles::Bottom);
+        this->saveJsonButton->Click += gcnew EventHandler(this, &DiagnosticsForm::SaveJsonButton_Click);
+
+        this->refreshTimer = gcnew System::Windows::Forms::Timer(this->components);
+        this->refreshTimer->Interval = 1000;
+        this->refreshTimer->Tick += gcnew EventHandler(this, &DiagnosticsForm::RefreshTimer_Tick);
+
+        this->Controls->Add(this->consumersListView);
+        this->Controls->Add(this->processLabel);
+        this->Controls->Add(budgetLabel);
+        this->Controls->Add(this->budgetUpDown);
+        this->Controls->Add(this->setBudgetButton);
+        this->Controls->Add(this->trimButton);
+        this->Controls->Add(this->saveJsonButton);
+    }
+
+    // Строки обновляются на месте, чтобы не сбрасывать выделение
+    void RefreshView()
+    {
+        List<MemoryConsumer^>^ consumers = memory->GetConsumers();
+        consumersListView->BeginUpdate();
+        while (consumersListView->Items->Count > consumers->Count) {
+            consumersListView->Items->RemoveAt(consumersListView->Items->Count - 1);
+        }
+        long long tracked = 0;
+        for (int i = 0; i < consumers->Count; i++) {
+            MemoryConsumer^ consumer = consumers[i];
+            long long bytes = memory->Estimate(consumer);
+            tracked += bytes;
+            array<String^>^ values = {
+                consumer->name,
+                FormatMegabytes(bytes),
+                consumer->budgetBytes > 0 ? FormatMegabytes(consumer->budgetBytes) : (consumer->trim != nullptr ? "none" : "-"),
+                consumer->evictions.ToString(),
+                memory->Describe(consumer)
+            };
+            if (i < consumersListView->Items->Count) {
+                ListViewItem^ item = consumersListView->Items[i];
+                for (int column = 0; column < values->Length; column++) {
+                    item->SubItems[column]->Text = values[column];
+                }
+                item->Tag = consumer;
+            }
+            else {
+                ListViewItem^ item = gcnew ListViewItem(values);
+                item->Tag = consumer;
+                consumersListView->Items->Add(item);
+            }
+        }
+        consumersListView->EndUpdate();
+
+        Process^ process = Process::GetCurrentProcess();
+        processLabel->Text = String::Format("Tracked: {0}    Managed heap: {1}\nWorking set: {2}    Private: {3}",
+            FormatMegabytes(tracked), FormatMegabytes(GC::GetTotalMemory(false)),
+            FormatMegabytes(process->WorkingSet64), FormatMegabytes(process->PrivateMemorySize64));
+    }
+
+    MemoryConsumer^ SelectedConsumer()
+    {
+        if (consumersListView->SelectedItems->Count == 0) return nullptr;
+        return safe_cast<MemoryConsumer^>(consumersListView->SelectedItems[0]->Tag);
+    }
+
+    void RefreshTimer_Tick(Object^ sender, EventArgs^ e)
+    {
+        RefreshView();
+    }
+
+    void Consumers_SelectedIndexChanged(Object^ sender, EventArgs^ e)
+    {
+        MemoryConsumer^ consumer = SelectedConsumer();
+        bool evictable = consumer != nullptr && consumer->trim != nullptr;
+        budgetUpDown->Enabled = evictable;
+        setBudgetButton->Enabled = evictable;
+        if (evictable) {
+            budgetUpDown->Value = Decimal(consumer->budgetBytes / (1024 * 1024));
+        }
+    }
+
+    void SetBudgetButton_Click(Object^ sender, EventArgs^ e)
+    {
+        MemoryConsumer^ consumer = SelectedConsumer();
+        if (consumer == nullptr) return;
+        try {
+            memory->SetBudget(consumer->name, Decimal::ToInt64(budgetUpDown->Value) * 1024 * 1024);
+            memory->SaveBudgets(budgetsPath);
+            memory->EnforceBudgets();
+            RefreshView();
+        }
+        catch (Exception^ ex) {
+            MessageBox::Show(ex->Message, "Error", MessageBoxButtons::OK, MessageBoxIcon::Error);
+        }
+    }
+
+    void TrimButton_Click(Object^ sender, EventArgs^ e)
+    {
+        memory->EnforceBudgets();
+        GC::Collect();
+        RefreshView();
+    }
+
+    void SaveJsonButton_Click(Object^ sender, EventArgs^ e)
+    {
+        SaveFileDialog^ dialog = gcnew SaveFileDialog();
+        dialog->Filter = "JSON files (*.json)|*.json";
+        dialog->FileName = "memory-report.json";
+        if (dialog->ShowDialog(this) != System::Windows::Forms::DialogResult::OK) return;
+        try {
+            File::WriteAllText(dialog->FileName, memory->ToJson());
+        }
+        catch (Exception^ ex) {
+            MessageBox::Show(ex->Message, "Error", MessageBoxButtons::OK, MessageBoxIcon::Error);
+        }
+    }
+};
+
+}
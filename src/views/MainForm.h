@@ -1,5 +1,14 @@
 #pragma once
 #include "../controllers/NotebookManager.h"
+#include "../controllers/BookFileWatcher.h"
+#include "../controllers/BookStatistics.h"
+#include "../controllers/FieldCompletions.h"
+#include "../controllers/StorageLoader.h"
+#include "CompletionPopup.h"
+#include "DiagnosticsForm.h"
+#include "../utils/MemoryAccounting.h"
+#include "../utils/ParallelExporter.h"
+#include "../utils/StartupTimeline.h"
 #include "../utils/ValidationUtils.h"
 
 namespace NBapp {
@@ -19,26 +28,62 @@ public ref class MainForm : public System::Windows::Forms::Form
 public:
     MainForm(void)
     {
+        timeline = gcnew StartupTimeline();
+
         // Инициализация компонентов формы
         InitializeComponent();
         
-        // Инициализация менеджера записей
-        manager = gcnew NotebookManager();
+        // Инициализация менеджера записей: книга загружается в фоне после
+        // показа формы, до этого операции над книгой недоступны
+        manager = gcnew NotebookManager("contacts.json", true, true);
+        manager->Changed += gcnew EventHandler<NotebookChangedEventArgs^>(this, &MainForm::Manager_Changed);
+
+        // Операции сразу пишутся в журнал, а contacts.json публикуется
+        // целиком после паузы в работе и при закрытии окна
+        manager->EnableJournal();
+        // Адреса и заметки хранятся сжатыми вне записей, в ячейки таблицы
+        // они попадают только для видимых строк (DataGridView_CellFormatting)
+        manager->EnableColdFields();
+        checkpointTimer = gcnew System::Windows::Forms::Timer(components);
+        checkpointTimer->Interval = CheckpointDelayMs;
+        checkpointTimer->Tick += gcnew EventHandler(this, &MainForm::CheckpointTimer_Tick);
+        this->FormClosing += gcnew FormClosingEventHandler(this, &MainForm::MainForm_FormClosing);
+
+        // Статистика обновляется по тем же событиям, что и таблица
+        statistics = gcnew BookStatistics(manager);
+        statistics->Updated += gcnew EventHandler(this, &MainForm::Statistics_Updated);
+        RefreshStatistics();
+
+        // Подсказки полей ввода - тоже по событиям менеджера
+        completions = gcnew FieldCompletions(manager);
         
-        // Установим начальный ID
-        // Если в списке уже есть записи (загруженные из JSON), используем максимальный ID + 1
-        currentId = manager->GetMaxId() + 1;
+        // Начальный ID уточняется после загрузки
+        currentId = 1;
         
         // Настройка обработчиков ввода
         SetupInputHandlers();
-        
-        // Обновляем dataGridView
-        RefreshDataGrid();
+
+        loadingStorage = true;
+        SetBookControlsEnabled(false);
+        storageLoader = gcnew StorageLoader(manager->GetStoragePath(), manager->GetColdFields());
+        storageLoader->BatchLoaded += gcnew EventHandler<StorageBatchEventArgs^>(this, &MainForm::Storage_BatchLoaded);
+        storageLoader->LoadCompleted += gcnew EventHandler(this, &MainForm::Storage_LoadCompleted);
+        this->Shown += gcnew EventHandler(this, &MainForm::MainForm_Shown);
+
+        SetupMemoryAccounting();
+    }
+
+    // Замер времени запуска: после загрузки отметки дописываются строкой JSON
+    // в startup-bench.json, и приложение закрывается (ключ --startup-bench)
+    void EnableStartupBenchmark()
+    {
+        startupBenchmark = true;
     }
 
 protected:
     ~MainForm()
     {
+        delete storageWatcher;
         if (components)
         {
             delete components;
@@ -47,7 +92,25 @@ protected:
 
 private:
     NotebookManager^ manager;
+    BookFileWatcher^ storageWatcher;
+    BookStatistics^ statistics;
+    FieldCompletions^ completions;
+    StorageLoader^ storageLoader;
+    StartupTimeline^ timeline;
+    MemoryAccounting^ memory;
+    System::Windows::Forms::Timer^ budgetTimer;
+    System::Windows::Forms::Timer^ checkpointTimer;
+    // Экспорт в CSV, JSON Lines или vCard идет в фоне
+    BackgroundWorker^ exportWorker;
+    // Идет начальная загрузка: таблица заполняется порциями из StorageLoader
+    bool loadingStorage;
+    bool startupBenchmark;
     int currentId;
+
+    // Таблица показывает результаты поиска, а не весь список
+    bool showingSearchResults;
+    String^ searchQuery;
+    int searchType;
     System::ComponentModel::Container^ components;
 
     // Компоненты формы
@@ -56,12 +119,19 @@ private:
     System::Windows::Forms::ToolStripMenuItem^ newFileMenuItem;
     System::Windows::Forms::ToolStripMenuItem^ openFileMenuItem;
     System::Windows::Forms::ToolStripMenuItem^ saveFileMenuItem;
+    System::Windows::Forms::ToolStripMenuItem^ importVCardMenuItem;
     System::Windows::Forms::ToolStripMenuItem^ exportMenu;
     System::Windows::Forms::ToolStripMenuItem^ exportExcelMenuItem;
     System::Windows::Forms::ToolStripMenuItem^ exportExcelNewMenuItem;
     System::Windows::Forms::ToolStripMenuItem^ exportExcelExistingMenuItem;
+    System::Windows::Forms::ToolStripMenuItem^ exportRecordsMenuItem;
     System::Windows::Forms::ToolStripSeparator^ toolStripSeparator;
     System::Windows::Forms::ToolStripMenuItem^ exitMenuItem;
+    System::Windows::Forms::ToolStripMenuItem^ editMenu;
+    System::Windows::Forms::ToolStripMenuItem^ undoMenuItem;
+    System::Windows::Forms::ToolStripMenuItem^ redoMenuItem;
+    System::Windows::Forms::ToolStripMenuItem^ toolsMenu;
+    System::Windows::Forms::ToolStripMenuItem^ memoryDiagnosticsMenuItem;
 
     System::Windows::Forms::DataGridView^ dataGridView;
     System::Windows::Forms::GroupBox^ searchGroupBox;
@@ -75,6 +145,10 @@ private:
     System::Windows::Forms::Button^ sortByFirstNameButton;
     System::Windows::Forms::Button^ sortByLastNameButton;
 
+    // Панель статистики
+    System::Windows::Forms::GroupBox^ statsGroupBox;
+    System::Windows::Forms::ListView^ statsListView;
+
     System::Windows::Forms::GroupBox^ addEntryGroupBox;
     System::Windows::Forms::TextBox^ firstNameTextBox;
     System::Windows::Forms::TextBox^ lastNameTextBox;
@@ -83,8 +157,11 @@ private:
     System::Windows::Forms::TextBox^ emailTextBox;
     System::Windows::Forms::TextBox^ addressTextBox;
     System::Windows::Forms::TextBox^ notesTextBox;
+    System::Windows::Forms::TextBox^ tagsTextBox;
     System::Windows::Forms::Button^ addButton;
     System::Windows::Forms::Button^ deleteButton;
+    System::Windows::Forms::Button^ tagButton;
+    System::Windows::Forms::Button^ untagButton;
 
     void InitializeComponent(void)
     {
@@ -104,12 +181,21 @@ private:
         this->newFileMenuItem = gcnew ToolStripMenuItem("New");
         this->openFileMenuItem = gcnew ToolStripMenuItem("Open");
         this->saveFileMenuItem = gcnew ToolStripMenuItem("Save");
+        this->importVCardMenuItem = gcnew ToolStripMenuItem("Import vCard...");
         this->exportMenu = gcnew ToolStripMenuItem("Export");
         this->exportExcelMenuItem = gcnew ToolStripMenuItem("Export to Excel");
         this->exportExcelNewMenuItem = gcnew ToolStripMenuItem("New File");
         this->exportExcelExistingMenuItem = gcnew ToolStripMenuItem("Existing File");
+        this->exportRecordsMenuItem = gcnew ToolStripMenuItem("CSV, JSON Lines or vCard...");
         this->toolStripSeparator = gcnew ToolStripSeparator();
         this->exitMenuItem = gcnew ToolStripMenuItem("Exit");
+        this->editMenu = gcnew ToolStripMenuItem("Edit");
+        this->undoMenuItem = gcnew ToolStripMenuItem("Undo");
+        this->redoMenuItem = gcnew ToolStripMenuItem("Redo");
+        this->toolsMenu = gcnew ToolStripMenuItem("Tools");
+        this->memoryDiagnosticsMenuItem = gcnew ToolStripMenuItem("Memory Diagnostics...");
+        this->undoMenuItem->ShortcutKeys = static_cast<Keys>(Keys::Control | Keys::Z);
+        this->redoMenuItem->ShortcutKeys = static_cast<Keys>(Keys::Control | Keys::Y);
 
         // Настраиваем подменю экспорта
         this->exportExcelMenuItem->DropDownItems->AddRange(gcnew cli::array< System::Windows::Forms::ToolStripItem^  >(2) {
@@ -117,20 +203,30 @@ private:
             this->exportExcelExistingMenuItem
         });
 
-        this->exportMenu->DropDownItems->AddRange(gcnew cli::array< System::Windows::Forms::ToolStripItem^  >(1) {
-            this->exportExcelMenuItem
+        this->exportMenu->DropDownItems->AddRange(gcnew cli::array< System::Windows::Forms::ToolStripItem^  >(2) {
+            this->exportExcelMenuItem,
+            this->exportRecordsMenuItem
         });
 
-        this->fileMenu->DropDownItems->AddRange(gcnew cli::array< System::Windows::Forms::ToolStripItem^  >(6) {
+        this->fileMenu->DropDownItems->AddRange(gcnew cli::array< System::Windows::Forms::ToolStripItem^  >(7) {
             this->newFileMenuItem,
             this->openFileMenuItem,
             this->saveFileMenuItem,
+            this->importVCardMenuItem,
             this->exportMenu,
             this->toolStripSeparator,
             this->exitMenuItem
         });
 
+        this->editMenu->DropDownItems->AddRange(gcnew cli::array< System::Windows::Forms::ToolStripItem^  >(2) {
+            this->undoMenuItem,
+            this->redoMenuItem
+        });
+
         this->menuStrip->Items->Add(this->fileMenu);
+        this->menuStrip->Items->Add(this->editMenu);
+        this->toolsMenu->DropDownItems->Add(this->memoryDiagnosticsMenuItem);
+        this->menuStrip->Items->Add(this->toolsMenu);
         this->Controls->Add(this->menuStrip);
 
         // Инициализация DataGridView
@@ -140,21 +236,20 @@ private:
         this->dataGridView->AllowUserToAddRows = false;
         this->dataGridView->AllowUserToDeleteRows = false;
         this->dataGridView->ReadOnly = true;
-        this->dataGridView->MultiSelect = false;
+        this->dataGridView->MultiSelect = true;
         this->dataGridView->SelectionMode = DataGridViewSelectionMode::FullRowSelect;
         this->dataGridView->AutoSizeColumnsMode = DataGridViewAutoSizeColumnsMode::Fill;
         this->dataGridView->Anchor = static_cast<AnchorStyles>(AnchorStyles::Top | AnchorStyles::Left | AnchorStyles::Right | AnchorStyles::Bottom);
         this->dataGridView->ScrollBars = ScrollBars::Both;
 
         // Добавление столбцов
-        this->dataGridView->Columns->Add("Id", "ID");
-        this->dataGridView->Columns->Add("FirstName", "First Name");
-        this->dataGridView->Columns->Add("LastName", "Last Name");
-        this->dataGridView->Columns->Add("Phone", "Phone");
-        this->dataGridView->Columns->Add("BirthDate", "Birth Date");
-        this->dataGridView->Columns->Add("Email", "Email");
-        this->dataGridView->Columns->Add("Address", "Address");
-        this->dataGridView->Columns->Add("Notes", "Notes");
+        for (int i = 0; i < EntrySchema::FieldCount; i++) {
+            this->dataGridView->Columns->Add(EntrySchema::GetColumnName(i), EntrySchema::GetHeader(i));
+        }
+        // Метки - последняя колонка, значение берется из записи строки
+        this->dataGridView->Columns->Add("Tags", "Tags");
+        this->dataGridView->CellFormatting += gcnew DataGridViewCellFormattingEventHandler(this, &MainForm::DataGridView_CellFormatting);
+        this->dataGridView->SortCompare += gcnew DataGridViewSortCompareEventHandler(this, &MainForm::DataGridView_SortCompare);
 
         // Инициализация группы поиска
         this->searchGroupBox = gcnew GroupBox();
@@ -166,12 +261,14 @@ private:
         this->searchTypeComboBox = gcnew ComboBox();
         this->searchTypeComboBox->Location = Point(10, 20);
         this->searchTypeComboBox->Size = System::Drawing::Size(150, 25);
-        this->searchTypeComboBox->Items->AddRange(gcnew cli::array<String^>(5) { 
+        this->searchTypeComboBox->Items->AddRange(gcnew cli::array<String^>(7) { 
             "By First Name", 
             "By Last Name", 
             "By Phone", 
             "By Email", 
-            "By Address" 
+            "By Address",
+            "Name Sounds Like",
+            "By Tags (a & !b)"
         });
         this->searchTypeComboBox->SelectedIndex = 0;
 
@@ -213,6 +310,22 @@ private:
         this->sortGroupBox->Controls->Add(this->sortByFirstNameButton);
         this->sortGroupBox->Controls->Add(this->sortByLastNameButton);
 
+        // Инициализация панели статистики
+        this->statsGroupBox = gcnew GroupBox();
+        this->statsGroupBox->Text = "Statistics";
+        this->statsGroupBox->Location = Point(820, 100);
+        this->statsGroupBox->Size = System::Drawing::Size(180, 400);
+        this->statsGroupBox->Anchor = static_cast<AnchorStyles>(AnchorStyles::Top | AnchorStyles::Right | AnchorStyles::Bottom);
+
+        this->statsListView = gcnew ListView();
+        this->statsListView->Dock = DockStyle::Fill;
+        this->statsListView->View = View::Details;
+        this->statsListView->FullRowSelect = true;
+        this->statsListView->HeaderStyle = ColumnHeaderStyle::Nonclickable;
+        this->statsListView->Columns->Add("Group", 105);
+        this->statsListView->Columns->Add("Count", 50, HorizontalAlignment::Right);
+        this->statsGroupBox->Controls->Add(this->statsListView);
+
         // Инициализация группы добавления записи
         this->addEntryGroupBox = gcnew GroupBox();
         this->addEntryGroupBox->Text = "Add Entry";
@@ -278,11 +391,20 @@ private:
         Label^ notesLabel = gcnew Label();
         notesLabel->Text = "Notes:";
         notesLabel->Location = Point(10, 100);
-        notesLabel->Size = System::Drawing::Size(780, 20);
+        notesLabel->Size = System::Drawing::Size(470, 20);
 
         this->notesTextBox = gcnew TextBox();
         this->notesTextBox->Location = Point(10, 120);
-        this->notesTextBox->Size = System::Drawing::Size(780, 25);
+        this->notesTextBox->Size = System::Drawing::Size(470, 25);
+
+        Label^ tagsLabel = gcnew Label();
+        tagsLabel->Text = "Tags (comma separated):";
+        tagsLabel->Location = Point(490, 100);
+        tagsLabel->Size = System::Drawing::Size(300, 20);
+
+        this->tagsTextBox = gcnew TextBox();
+        this->tagsTextBox->Location = Point(490, 120);
+        this->tagsTextBox->Size = System::Drawing::Size(300, 25);
 
         // Кнопки
         this->addButton = gcnew Button();
@@ -297,11 +419,25 @@ private:
         this->deleteButton->Size = System::Drawing::Size(100, 30);
         this->deleteButton->Click += gcnew EventHandler(this, &MainForm::DeleteButton_Click);
 
+        // Метки из поля Tags - выделенным записям
+        this->tagButton = gcnew Button();
+        this->tagButton->Text = "Tag Selected";
+        this->tagButton->Location = Point(230, 160);
+        this->tagButton->Size = System::Drawing::Size(110, 30);
+        this->tagButton->Click += gcnew EventHandler(this, &MainForm::TagButton_Click);
+
+        this->untagButton = gcnew Button();
+        this->untagButton->Text = "Untag Selected";
+        this->untagButton->Location = Point(350, 160);
+        this->untagButton->Size = System::Drawing::Size(110, 30);
+        this->untagButton->Click += gcnew EventHandler(this, &MainForm::TagButton_Click);
+
         // Добавление элементов управления на форму
         this->Controls->Add(this->menuStrip);
         this->Controls->Add(this->dataGridView);
         this->Controls->Add(this->searchGroupBox);
         this->Controls->Add(this->sortGroupBox);
+        this->Controls->Add(this->statsGroupBox);
         this->Controls->Add(this->addEntryGroupBox);
 
         // Добавление элементов в группу поиска
@@ -318,6 +454,7 @@ private:
         this->addEntryGroupBox->Controls->Add(emailLabel);
         this->addEntryGroupBox->Controls->Add(addressLabel);
         this->addEntryGroupBox->Controls->Add(notesLabel);
+        this->addEntryGroupBox->Controls->Add(tagsLabel);
         this->addEntryGroupBox->Controls->Add(this->firstNameTextBox);
         this->addEntryGroupBox->Controls->Add(this->lastNameTextBox);
         this->addEntryGroupBox->Controls->Add(this->phoneTextBox);
@@ -325,16 +462,25 @@ private:
         this->addEntryGroupBox->Controls->Add(this->emailTextBox);
         this->addEntryGroupBox->Controls->Add(this->addressTextBox);
         this->addEntryGroupBox->Controls->Add(this->notesTextBox);
+        this->addEntryGroupBox->Controls->Add(this->tagsTextBox);
         this->addEntryGroupBox->Controls->Add(this->addButton);
         this->addEntryGroupBox->Controls->Add(this->deleteButton);
+        this->addEntryGroupBox->Controls->Add(this->tagButton);
+        this->addEntryGroupBox->Controls->Add(this->untagButton);
 
         // Привязка обработчиков событий меню
         this->newFileMenuItem->Click += gcnew EventHandler(this, &MainForm::NewFile_Click);
         this->openFileMenuItem->Click += gcnew EventHandler(this, &MainForm::OpenFile_Click);
         this->saveFileMenuItem->Click += gcnew EventHandler(this, &MainForm::SaveFile_Click);
+        this->importVCardMenuItem->Click += gcnew EventHandler(this, &MainForm::ImportVCard_Click);
         this->exportExcelNewMenuItem->Click += gcnew EventHandler(this, &MainForm::ExportExcel_Click);
         this->exportExcelExistingMenuItem->Click += gcnew EventHandler(this, &MainForm::ExportExcel_Click);
+        this->exportRecordsMenuItem->Click += gcnew EventHandler(this, &MainForm::ExportRecords_Click);
         this->exitMenuItem->Click += gcnew EventHandler(this, &MainForm::Exit_Click);
+        this->editMenu->DropDownOpening += gcnew EventHandler(this, &MainForm::EditMenu_DropDownOpening);
+        this->undoMenuItem->Click += gcnew EventHandler(this, &MainForm::Undo_Click);
+        this->redoMenuItem->Click += gcnew EventHandler(this, &MainForm::Redo_Click);
+        this->memoryDiagnosticsMenuItem->Click += gcnew EventHandler(this, &MainForm::MemoryDiagnostics_Click);
     }
 
     // Настройка обработчиков ввода
@@ -346,6 +492,32 @@ private:
         
         // Обработчик для телефона (не буквы)
         this->phoneTextBox->KeyPress += gcnew KeyPressEventHandler(this, &MainForm::PhoneField_KeyPress);
+
+        // Подсказки по значениям, уже встречающимся в книге
+        gcnew CompletionPopup(this, firstNameTextBox, gcnew Func<String^, List<String^>^>(this, &MainForm::CompleteFirstName));
+        gcnew CompletionPopup(this, lastNameTextBox, gcnew Func<String^, List<String^>^>(this, &MainForm::CompleteLastName));
+        gcnew CompletionPopup(this, emailTextBox, gcnew Func<String^, List<String^>^>(this, &MainForm::CompleteEmail));
+        gcnew CompletionPopup(this, addressTextBox, gcnew Func<String^, List<String^>^>(this, &MainForm::CompleteAddress));
+    }
+
+    List<String^>^ CompleteFirstName(String^ prefix)
+    {
+        return completions->Complete(CompletionField::FirstName, prefix, CompletionPopup::MaxItems);
+    }
+
+    List<String^>^ CompleteLastName(String^ prefix)
+    {
+        return completions->Complete(CompletionField::LastName, prefix, CompletionPopup::MaxItems);
+    }
+
+    List<String^>^ CompleteEmail(String^ prefix)
+    {
+        return completions->Complete(CompletionField::Email, prefix, CompletionPopup::MaxItems);
+    }
+
+    List<String^>^ CompleteAddress(String^ prefix)
+    {
+        return completions->Complete(CompletionField::Address, prefix, CompletionPopup::MaxItems);
     }
 
     // Обработчик ввода для полей имени и фамилии
@@ -391,13 +563,11 @@ private:
             addressTextBox->Text,
             notesTextBox->Text
         );
+        entry->SetTags(TagList());
 
-        // Добавление записи
+        // Добавление записи (таблица обновится по событию Changed)
         manager->AddEntry(entry);
 
-        // Обновление таблицы
-        RefreshDataGrid();
-
         // Очистка полей ввода
         ClearInputFields();
     }
@@ -405,39 +575,57 @@ private:
     System::Void DeleteButton_Click(System::Object^ sender, System::EventArgs^ e)
     {
         if (dataGridView->SelectedRows->Count > 0) {
-            if (MessageBox::Show("Are you sure you want to delete the selected entry?", "Confirmation",
+            if (MessageBox::Show("Are you sure you want to delete the selected entries?", "Confirmation",
                 MessageBoxButtons::YesNo, MessageBoxIcon::Question) == System::Windows::Forms::DialogResult::Yes)
             {
-                int id = Convert::ToInt32(dataGridView->SelectedRows[0]->Cells["Id"]->Value);
-                if (manager->RemoveEntry(id)) {
-                    RefreshDataGrid();
+                // Все выделенные строки удаляются одной операцией (один шаг отмены)
+                List<int>^ ids = gcnew List<int>();
+                for each (DataGridViewRow^ row in dataGridView->SelectedRows) {
+                    ids->Add(Convert::ToInt32(row->Cells["Id"]->Value));
                 }
+                manager->RemoveEntries(ids);
             }
         }
     }
 
-    System::Void SearchButton_Click(System::Object^ sender, System::EventArgs^ e)
+    // Метки из поля Tags: через запятую, регистр и пробелы по краям не важны
+    array<String^>^ TagList()
     {
-        // Поиск с использованием выбранного фильтра
-        List<NotebookEntry<int>^>^ results = manager->SearchByAnyField(
-            searchTextBox->Text, 
-            searchTypeComboBox->SelectedIndex
-        );
+        return NotebookEntry<int>::NormalizeTags(tagsTextBox->Text->Split(L','));
+    }
 
-        // Отображение результатов
-        dataGridView->Rows->Clear();
-        for each (NotebookEntry<int>^ entry in results) {
-            dataGridView->Rows->Add(
-                entry->GetId(),
-                entry->GetFirstName(),
-                entry->GetLastName(),
-                entry->GetPhoneNumber(),
-                entry->GetBirthDate(),
-                entry->GetEmail(),
-                entry->GetAddress(),
-                entry->GetNotes()
-            );
+    // Добавление (Tag Selected) или снятие (Untag Selected) меток одной операцией
+    System::Void TagButton_Click(System::Object^ sender, System::EventArgs^ e)
+    {
+        array<String^>^ tags = TagList();
+        if (tags == nullptr || dataGridView->SelectedRows->Count == 0) {
+            MessageBox::Show("Select entries and enter tags first.", "Information",
+                MessageBoxButtons::OK, MessageBoxIcon::Information);
+            return;
+        }
+        List<int>^ ids = gcnew List<int>();
+        for each (DataGridViewRow^ row in dataGridView->SelectedRows) {
+            ids->Add(Convert::ToInt32(row->Cells["Id"]->Value));
+        }
+        manager->TagEntries(ids, tags, sender == tagButton);
+    }
+
+    System::Void SearchButton_Click(System::Object^ sender, System::EventArgs^ e)
+    {
+        // Выражение меток проверяется до поиска: ошибка - сообщение, а не пустая таблица
+        if (searchTypeComboBox->SelectedIndex == EntrySchema::TagSearchType) {
+            try {
+                TagExpression::Parse(searchTextBox->Text->ToLower());
+            }
+            catch (FormatException^ ex) {
+                MessageBox::Show(ex->Message, "Error", MessageBoxButtons::OK, MessageBoxIcon::Error);
+                return;
+            }
         }
+        // Поиск с использованием выбранного фильтра
+        searchQuery = searchTextBox->Text;
+        searchType = searchTypeComboBox->SelectedIndex;
+        ShowSearchResults();
     }
 
     System::Void ShowAllButton_Click(System::Object^ sender, System::EventArgs^ e)
@@ -453,7 +641,6 @@ private:
     {
         try {
             manager->SortByFirstName(true); // Сортировка от А до Я
-            RefreshDataGrid();
             MessageBox::Show("Contacts sorted by first name", "Information", 
                 MessageBoxButtons::OK, MessageBoxIcon::Information);
         }
@@ -467,7 +654,6 @@ private:
     {
         try {
             manager->SortByLastName(true); // Сортировка от А до Я
-            RefreshDataGrid();
             MessageBox::Show("Contacts sorted by last name", "Information", 
                 MessageBoxButtons::OK, MessageBoxIcon::Information);
         }
@@ -479,26 +665,24 @@ private:
 
     System::Void NewFile_Click(System::Object^ sender, System::EventArgs^ e)
     {
-        if (MessageBox::Show("Create a new file? Unsaved data will be lost.", "Confirmation",
+        if (MessageBox::Show("Create a new file? All entries will be removed (Edit > Undo restores them).", "Confirmation",
             MessageBoxButtons::YesNo, MessageBoxIcon::Question) == System::Windows::Forms::DialogResult::Yes)
         {
-            manager = gcnew NotebookManager();
+            manager->Clear();
             currentId = 1;
-            RefreshDataGrid();
         }
     }
 
     System::Void OpenFile_Click(System::Object^ sender, System::EventArgs^ e)
     {
         OpenFileDialog^ openFileDialog = gcnew OpenFileDialog();
-        openFileDialog->Filter = "Text files (*.txt)|*.txt|JSON files (*.json)|*.json|All files (*.*)|*.*";
+        openFileDialog->Filter = "Text files (*.txt)|*.txt|JSON files (*.json)|*.json|Compressed snapshots (*.nbz)|*.nbz|All files (*.*)|*.*";
         openFileDialog->Title = "Open File";
 
         if (openFileDialog->ShowDialog() == System::Windows::Forms::DialogResult::OK) {
             try {
                 manager->LoadFromFile(openFileDialog->FileName);
-                RefreshDataGrid();
-                
+
                 // Обновляем currentId на максимальный ID + 1
                 currentId = manager->GetMaxId() + 1;
             }
@@ -511,7 +695,7 @@ private:
     System::Void SaveFile_Click(System::Object^ sender, System::EventArgs^ e)
     {
         SaveFileDialog^ saveFileDialog = gcnew SaveFileDialog();
-        saveFileDialog->Filter = "JSON files (*.json)|*.json|Text files (*.txt)|*.txt|All files (*.*)|*.*";
+        saveFileDialog->Filter = "JSON files (*.json)|*.json|Text files (*.txt)|*.txt|Compressed snapshots (*.nbz)|*.nbz|All files (*.*)|*.*";
         saveFileDialog->Title = "Save File";
         saveFileDialog->DefaultExt = "json";
 
@@ -527,6 +711,29 @@ private:
         }
     }
 
+    System::Void ImportVCard_Click(System::Object^ sender, System::EventArgs^ e)
+    {
+        OpenFileDialog^ openFileDialog = gcnew OpenFileDialog();
+        openFileDialog->Filter = "vCard files (*.vcf)|*.vcf|All files (*.*)|*.*";
+        openFileDialog->Title = "Import vCard";
+
+        if (openFileDialog->ShowDialog() == System::Windows::Forms::DialogResult::OK) {
+            this->Cursor = Cursors::WaitCursor;
+            try {
+                // Карточки добавляются к книге одной операцией (отменяется одним Undo)
+                int added = manager->ImportVCard(openFileDialog->FileName);
+                this->Cursor = Cursors::Default;
+                MessageBox::Show(String::Format("Imported {0} contacts.", added), "Information",
+                    MessageBoxButtons::OK, MessageBoxIcon::Information);
+            }
+            catch (Exception^ ex) {
+                this->Cursor = Cursors::Default;
+                MessageBox::Show("Import error: " + ex->Message, "Error",
+                    MessageBoxButtons::OK, MessageBoxIcon::Error);
+            }
+        }
+    }
+
     System::Void ExportExcel_Click(System::Object^ sender, System::EventArgs^ e)
     {
         SaveFileDialog^ saveFileDialog = gcnew SaveFileDialog();
@@ -562,29 +769,574 @@ private:
         }
     }
 
+    System::Void ExportRecords_Click(System::Object^ sender, System::EventArgs^ e)
+    {
+        SaveFileDialog^ saveFileDialog = gcnew SaveFileDialog();
+        saveFileDialog->Filter = "CSV files (*.csv)|*.csv|JSON Lines (*.jsonl)|*.jsonl|vCard (*.vcf)|*.vcf";
+        saveFileDialog->Title = "Export Records";
+        saveFileDialog->DefaultExt = "csv";
+        if (saveFileDialog->ShowDialog() != System::Windows::Forms::DialogResult::OK) return;
+
+        IRecordFormatter^ formatter = RecordFormatters::ForPath(saveFileDialog->FileName);
+        if (formatter == nullptr) {
+            MessageBox::Show("Unsupported export format. Use .csv, .jsonl or .vcf.", "Error",
+                MessageBoxButtons::OK, MessageBoxIcon::Error);
+            return;
+        }
+
+        // Снимок берется сейчас: правки во время экспорта в файл не попадут
+        List<NotebookEntry<int>^>^ snapshot = manager->GetSnapshot()->ToList();
+        exportWorker = gcnew BackgroundWorker();
+        exportWorker->DoWork += gcnew DoWorkEventHandler(this, &MainForm::ExportWorker_DoWork);
+        exportWorker->RunWorkerCompleted += gcnew RunWorkerCompletedEventHandler(this, &MainForm::ExportWorker_Completed);
+        exportRecordsMenuItem->Enabled = false;
+        exportWorker->RunWorkerAsync(gcnew array<Object^> { gcnew ParallelExporter(formatter), snapshot, saveFileDialog->FileName });
+    }
+
+    void ExportWorker_DoWork(Object^ sender, DoWorkEventArgs^ e)
+    {
+        array<Object^>^ job = safe_cast<array<Object^>^>(e->Argument);
+        ParallelExporter^ exporter = safe_cast<ParallelExporter^>(job[0]);
+        e->Result = exporter->Export(safe_cast<List<NotebookEntry<int>^>^>(job[1]), safe_cast<String^>(job[2]));
+    }
+
+    void ExportWorker_Completed(Object^ sender, RunWorkerCompletedEventArgs^ e)
+    {
+        exportWorker = nullptr;
+        exportRecordsMenuItem->Enabled = true;
+        if (e->Error != nullptr) {
+            MessageBox::Show("Export error: " + e->Error->Message, "Error",
+                MessageBoxButtons::OK, MessageBoxIcon::Error);
+            return;
+        }
+        ExportResult^ result = safe_cast<ExportResult^>(e->Result);
+        MessageBox::Show(String::Format("Exported {0} records ({1:N1} MB) in {2:N1} s.", result->rows,
+            result->bytes / 1048576.0, result->elapsedMilliseconds / 1000.0), "Information",
+            MessageBoxButtons::OK, MessageBoxIcon::Information);
+    }
+
     System::Void Exit_Click(System::Object^ sender, System::EventArgs^ e)
     {
         this->Close();
     }
 
+    System::Void EditMenu_DropDownOpening(System::Object^ sender, System::EventArgs^ e)
+    {
+        // Подписи пунктов показывают, какая операция будет отменена/повторена
+        NotebookHistory^ history = manager->GetHistory();
+        undoMenuItem->Enabled = history->CanUndo();
+        undoMenuItem->Text = history->CanUndo() ? "Undo " + history->GetUndoDescription() : "Undo";
+        redoMenuItem->Enabled = history->CanRedo();
+        redoMenuItem->Text = history->CanRedo() ? "Redo " + history->GetRedoDescription() : "Redo";
+    }
+
+    System::Void Undo_Click(System::Object^ sender, System::EventArgs^ e)
+    {
+        try {
+            if (manager->Undo()) {
+                // ID новых записей не должны совпадать с восстановленными
+                currentId = Math::Max(currentId, manager->GetMaxId() + 1);
+            }
+        }
+        catch (Exception^ ex) {
+            MessageBox::Show(ex->Message, "Error", MessageBoxButtons::OK, MessageBoxIcon::Error);
+        }
+    }
+
+    System::Void Redo_Click(System::Object^ sender, System::EventArgs^ e)
+    {
+        try {
+            if (manager->Redo()) {
+                currentId = Math::Max(currentId, manager->GetMaxId() + 1);
+            }
+        }
+        catch (Exception^ ex) {
+            MessageBox::Show(ex->Message, "Error", MessageBoxButtons::OK, MessageBoxIcon::Error);
+        }
+    }
+
+    // Файл бюджетов памяти (Tools > Memory Diagnostics)
+    literal String^ MemoryBudgetsPath = "memory-budgets.json";
+    // Бюджет кэша разметки файла хранения по умолчанию
+    literal long long SpanCacheBudgetBytes = 64LL * 1024 * 1024;
+    // Приблизительный размер строки таблицы: объект строки с коллекцией
+    // ячеек и ячейка с упакованным значением на каждый столбец
+    literal int GridRowBytes = 160;
+    literal int GridCellBytes = 96;
+
+    // Учет памяти по подсистемам; бюджеты проверяются раз в 5 секунд
+    void SetupMemoryAccounting()
+    {
+        memory = gcnew MemoryAccounting();
+        memory->Register("Entries", gcnew Func<long long>(manager, &NotebookManager::EstimateEntryBytes));
+        NotebookHistory^ history = manager->GetHistory();
+        memory->Register("Undo history", gcnew Func<long long>(history, &NotebookHistory::GetUsedBytes),
+            gcnew Func<long long, long long>(history, &NotebookHistory::TrimTo), NotebookHistory::DefaultBudgetBytes);
+        memory->Register("Storage span cache", gcnew Func<long long>(manager, &NotebookManager::EstimateSpanCacheBytes),
+            gcnew Func<long long, long long>(manager, &NotebookManager::TrimSpanCache), SpanCacheBudgetBytes);
+        memory->Register("Name index", gcnew Func<long long>(manager, &NotebookManager::EstimateNameIndexBytes),
+            gcnew Func<long long, long long>(manager, &NotebookManager::TrimNameIndex), 0);
+        memory->Register("Tag index", gcnew Func<long long>(manager, &NotebookManager::EstimateTagIndexBytes),
+            gcnew Func<long long, long long>(manager, &NotebookManager::TrimTagIndex), 0);
+        memory->Register("Query cache", gcnew Func<long long>(manager, &NotebookManager::EstimateQueryCacheBytes),
+            gcnew Func<long long, long long>(manager, &NotebookManager::TrimQueryCache), QueryCache::DefaultBudgetBytes,
+            gcnew Func<String^>(manager, &NotebookManager::DescribeQueryCache));
+        memory->Register("Cold fields", gcnew Func<long long>(manager, &NotebookManager::EstimateColdFieldBytes),
+            nullptr, 0, gcnew Func<String^>(manager, &NotebookManager::DescribeColdFields));
+        memory->Register("Statistics", gcnew Func<long long>(statistics, &BookStatistics::EstimateBytes));
+        memory->Register("Completions", gcnew Func<long long>(completions, &FieldCompletions::EstimateBytes));
+        memory->Register("Grid rows", gcnew Func<long long>(this, &MainForm::EstimateGridBytes));
+        memory->Register("Load buffers", gcnew Func<long long>(this, &MainForm::EstimateLoadBytes));
+        try {
+            memory->LoadBudgets(MemoryBudgetsPath);
+        }
+        catch (Exception^) {
+            // Поврежденный файл бюджетов: остаются бюджеты по умолчанию
+        }
+
+        budgetTimer = gcnew System::Windows::Forms::Timer(components);
+        budgetTimer->Interval = 5000;
+        budgetTimer->Tick += gcnew EventHandler(this, &MainForm::BudgetTimer_Tick);
+        budgetTimer->Start();
+    }
+
+    long long EstimateGridBytes()
+    {
+        return (long long)dataGridView->Rows->Count * (GridRowBytes + GridCellBytes * (EntrySchema::FieldCount + 1));
+    }
+
+    long long EstimateLoadBytes()
+    {
+        return storageLoader == nullptr ? 0 : storageLoader->EstimateBytes();
+    }
+
+    void BudgetTimer_Tick(Object^ sender, EventArgs^ e)
+    {
+        memory->EnforceBudgets();
+    }
+
+    System::Void MemoryDiagnostics_Click(System::Object^ sender, System::EventArgs^ e)
+    {
+        DiagnosticsForm^ form = gcnew DiagnosticsForm(memory, MemoryBudgetsPath);
+        form->Show(this);
+    }
+
+    // Загрузка начинается после первой отрисовки формы
+    void MainForm_Shown(Object^ sender, EventArgs^ e)
+    {
+        timeline->Mark("shown");
+        storageLoader->Start();
+    }
+
+    // Очередная порция загруженных записей сразу попадает в таблицу
+    void Storage_BatchLoaded(Object^ sender, StorageBatchEventArgs^ e)
+    {
+        if (IsDisposed) return;
+        for each (NotebookEntry<int>^ entry in e->entries) {
+            AddRow(entry);
+        }
+        this->Text = String::Format("My Notebook - loading {0} of {1}", e->loaded, e->total);
+        if (dataGridView->Rows->Count == e->entries->Count) {
+            dataGridView->Update();
+            timeline->Mark("first_rows");
+        }
+    }
+
+    void Storage_LoadCompleted(Object^ sender, EventArgs^ e)
+    {
+        if (IsDisposed) return;
+        Exception^ error = storageLoader->GetError();
+        // Строки уже в таблице: событие Reset от CompleteLoad ее не перерисовывает
+        manager->CompleteLoad(storageLoader->GetEntries(), storageLoader->GetText());
+        // Текст файла и список записей загрузчика больше не нужны
+        storageLoader = nullptr;
+        loadingStorage = false;
+        JournalRecovery^ recovery = manager->GetRecovery();
+        if (error != nullptr || (recovery != nullptr && recovery->replayedOperations > 0)) {
+            RefreshDataGrid();
+        }
+        currentId = manager->GetMaxId() + 1;
+
+        // Перечитывание файла хранения при изменении другой программой
+        storageWatcher = gcnew BookFileWatcher(manager->GetStoragePath(), this);
+        storageWatcher->Changed += gcnew EventHandler(this, &MainForm::StorageFile_Changed);
+        storageWatcher->Start();
+
+        this->Text = "My Notebook";
+        SetBookControlsEnabled(true);
+        timeline->Mark("loaded");
+
+        if (startupBenchmark) {
+            File::AppendAllText("startup-bench.json", timeline->ToJson(manager->GetCount()) + Environment::NewLine);
+            this->Close();
+            return;
+        }
+        if (error != nullptr) {
+            String^ message = "Error loading contacts: " + error->Message;
+            if (recovery != nullptr && recovery->restoredFromBackup) {
+                message += "\nThe previous version of the file was restored (" + manager->GetCount() + " contacts).";
+            }
+            if (recovery != nullptr && recovery->damagedCopyPath != nullptr) {
+                message += "\nThe damaged file was kept as " + recovery->damagedCopyPath + ".";
+            }
+            MessageBox::Show(message, "Error", MessageBoxButtons::OK, MessageBoxIcon::Error);
+        }
+    }
+
+    // Пауза в работе, после которой contacts.json догоняет журнал
+    literal int CheckpointDelayMs = 2000;
+
+    void CheckpointTimer_Tick(Object^ sender, EventArgs^ e)
+    {
+        checkpointTimer->Stop();
+        if (!manager->HasPendingOperations()) return;
+        try {
+            manager->Checkpoint();
+        }
+        catch (Exception^) {
+            // Операции сохранены в журнале; повторим после следующей паузы
+            checkpointTimer->Start();
+        }
+    }
+
+    void MainForm_FormClosing(Object^ sender, FormClosingEventArgs^ e)
+    {
+        checkpointTimer->Stop();
+        if (!manager->HasPendingOperations()) return;
+        try {
+            manager->Checkpoint();
+        }
+        catch (Exception^ ex) {
+            MessageBox::Show("Error saving contacts: " + ex->Message +
+                "\nThe changes are kept in the journal and will be restored on the next start.",
+                "Error", MessageBoxButtons::OK, MessageBoxIcon::Warning);
+        }
+    }
+
+    // Операции над книгой (до окончания загрузки недоступны)
+    void SetBookControlsEnabled(bool enabled)
+    {
+        searchGroupBox->Enabled = enabled;
+        sortGroupBox->Enabled = enabled;
+        addEntryGroupBox->Enabled = enabled;
+        editMenu->Enabled = enabled;
+        newFileMenuItem->Enabled = enabled;
+        openFileMenuItem->Enabled = enabled;
+        saveFileMenuItem->Enabled = enabled;
+        importVCardMenuItem->Enabled = enabled;
+        exportMenu->Enabled = enabled;
+    }
+
+    // Число строк в каждом разделе панели статистики
+    literal int StatsTopGroups = 10;
+
+    void Statistics_Updated(Object^ sender, EventArgs^ e)
+    {
+        RefreshStatistics();
+    }
+
+    static void AddStatsRow(ListView^ view, ListViewGroup^ group, String^ name, long long count)
+    {
+        ListViewItem^ item = gcnew ListViewItem(name, group);
+        item->SubItems->Add(count.ToString());
+        view->Items->Add(item);
+    }
+
+    static void AddStatsGroup(ListView^ view, String^ header, GroupCounter^ counter)
+    {
+        ListViewGroup^ group = gcnew ListViewGroup(header + " (" + counter->Count() + ")");
+        view->Groups->Add(group);
+        for each (KeyValuePair<String^, int> pair in counter->Top(StatsTopGroups)) {
+            AddStatsRow(view, group, pair.Key, pair.Value);
+        }
+    }
+
+    // Перерисовка панели по готовым счетчикам (без обхода записей)
+    void RefreshStatistics()
+    {
+        statsListView->BeginUpdate();
+        statsListView->Items->Clear();
+        statsListView->Groups->Clear();
+
+        ListViewGroup^ summary = gcnew ListViewGroup("Summary");
+        statsListView->Groups->Add(summary);
+        AddStatsRow(statsListView, summary, "Contacts", statistics->GetTotal());
+        AddStatsRow(statsListView, summary, "No email", statistics->GetMissingEmail());
+        AddStatsRow(statsListView, summary, "No birth date", statistics->GetMissingBirthDate());
+        AddStatsRow(statsListView, summary, "Emails (approx.)", statistics->EstimateDistinctEmails());
+        AddStatsRow(statsListView, summary, "Phones (approx.)", statistics->EstimateDistinctPhones());
+
+        AddStatsGroup(statsListView, "Email domains", statistics->GetDomains());
+        AddStatsGroup(statsListView, "Cities", statistics->GetCities());
+        AddStatsGroup(statsListView, "Birth decades", statistics->GetDecades());
+        statsListView->EndUpdate();
+    }
+
+    // Файл хранения изменен извне: в таблицу попадает только разница
+    // через Manager_Changed. Пока файл занят или дописывается - повтор
+    void StorageFile_Changed(Object^ sender, EventArgs^ e)
+    {
+        try {
+            if (manager->ReloadExternalChanges() > 0) {
+                currentId = Math::Max(currentId, manager->GetMaxId() + 1);
+            }
+        }
+        catch (IOException^) {
+            storageWatcher->Retry();
+        }
+        catch (InvalidDataException^) {
+            storageWatcher->Retry();
+        }
+        catch (Exception^ ex) {
+            if (!storageWatcher->Retry()) {
+                MessageBox::Show("Error reloading contacts: " + ex->Message, "Error",
+                    MessageBoxButtons::OK, MessageBoxIcon::Error);
+            }
+        }
+    }
+
+    // Применение изменений менеджера к таблице: затрагиваются только
+    // измененные строки, полная перерисовка - при сортировке и загрузке.
+    // Пока таблица отсортирована щелчком по заголовку, порядок строк не
+    // совпадает с порядком списка: строки ищутся по записи в Tag, а
+    // новые добавляются в конец. Таблица сортируется заново после вставок
+    // и после правок, изменивших значение в отсортированной колонке
+    void Manager_Changed(Object^ sender, NotebookChangedEventArgs^ e)
+    {
+        if (loadingStorage) {
+            return;
+        }
+        checkpointTimer->Stop();
+        checkpointTimer->Start();
+        if (showingSearchResults) {
+            ApplyChangesToSearchResults(e);
+            return;
+        }
+
+        DataGridViewColumn^ sortedColumn = dataGridView->SortedColumn;
+        Dictionary<NotebookEntry<int>^, DataGridViewRow^>^ rowsByEntry = sortedColumn == nullptr ? nullptr : RowsByEntry();
+        bool resort = false;
+        dataGridView->SuspendLayout();
+        try {
+            for each (NotebookChange^ change in e->changes) {
+                switch (change->kind) {
+                case NotebookChangeKind::Inserted:
+                    for (int i = 0; i < change->count; i++) {
+                        if (rowsByEntry != nullptr) {
+                            AddRow(change->entries[i]);
+                            rowsByEntry[change->entries[i]] = dataGridView->Rows[dataGridView->Rows->Count - 1];
+                        }
+                        else {
+                            InsertRow(change->index + i, change->entries[i]);
+                        }
+                    }
+                    resort = true;
+                    break;
+                case NotebookChangeKind::Removed:
+                    for (int i = change->count - 1; i >= 0; i--) {
+                        DataGridViewRow^ row;
+                        if (rowsByEntry == nullptr) {
+                            dataGridView->Rows->RemoveAt(change->index + i);
+                        }
+                        else if (rowsByEntry->TryGetValue(change->entries[i], row)) {
+                            dataGridView->Rows->Remove(row);
+                            rowsByEntry->Remove(change->entries[i]);
+                        }
+                    }
+                    break;
+                case NotebookChangeKind::Updated:
+                    for (int i = 0; i < change->count; i++) {
+                        DataGridViewRow^ row;
+                        if (rowsByEntry == nullptr) {
+                            SetRow(dataGridView->Rows[change->index + i], change->entries[i]);
+                        }
+                        else if (rowsByEntry->TryGetValue(change->oldEntries[i], row)) {
+                            Object^ sortedValue = SortValue(row, sortedColumn->Index);
+                            SetRow(row, change->entries[i]);
+                            resort = resort || !Object::Equals(sortedValue, SortValue(row, sortedColumn->Index));
+                            rowsByEntry->Remove(change->oldEntries[i]);
+                            rowsByEntry[change->entries[i]] = row;
+                        }
+                    }
+                    break;
+                default:
+                    RefreshDataGrid();
+                    return;
+                }
+            }
+            if (resort && sortedColumn != nullptr) {
+                dataGridView->Sort(sortedColumn, dataGridView->SortOrder == System::Windows::Forms::SortOrder::Descending
+                    ? ListSortDirection::Descending : ListSortDirection::Ascending);
+            }
+        }
+        finally {
+            dataGridView->ResumeLayout();
+        }
+    }
+
+    // Строки таблицы по записям в Tag (ссылки на записи списка)
+    Dictionary<NotebookEntry<int>^, DataGridViewRow^>^ RowsByEntry()
+    {
+        Dictionary<NotebookEntry<int>^, DataGridViewRow^>^ rows =
+            gcnew Dictionary<NotebookEntry<int>^, DataGridViewRow^>(dataGridView->Rows->Count);
+        for each (DataGridViewRow^ row in dataGridView->Rows) {
+            NotebookEntry<int>^ entry = dynamic_cast<NotebookEntry<int>^>(row->Tag);
+            if (entry != nullptr) rows[entry] = row;
+        }
+        return rows;
+    }
+
+    // Результаты поиска: новые и измененные записи проверяются только
+    // по текущему запросу, удаленные - убираются по ID
+    void ApplyChangesToSearchResults(NotebookChangedEventArgs^ e)
+    {
+        if (e->IsReset()) {
+            ShowSearchResults();
+            return;
+        }
+
+        HashSet<int>^ gone = gcnew HashSet<int>();
+        List<NotebookEntry<int>^>^ candidates = gcnew List<NotebookEntry<int>^>();
+        for each (NotebookChange^ change in e->changes) {
+            if (change->kind == NotebookChangeKind::Removed || change->kind == NotebookChangeKind::Updated) {
+                for each (NotebookEntry<int>^ entry in (change->kind == NotebookChangeKind::Removed ? change->entries : change->oldEntries)) {
+                    gone->Add(entry->GetId());
+                }
+            }
+            if (change->kind == NotebookChangeKind::Inserted || change->kind == NotebookChangeKind::Updated) {
+                candidates->AddRange(change->entries);
+            }
+            if (change->kind == NotebookChangeKind::Reordered) {
+                // Порядок результатов повторяет порядок списка
+                ShowSearchResults();
+                return;
+            }
+        }
+
+        Dictionary<int, NotebookEntry<int>^>^ matched = gcnew Dictionary<int, NotebookEntry<int>^>();
+        for each (NotebookEntry<int>^ entry in NotebookManager::SearchIn(candidates, searchQuery, searchType)) {
+            matched[entry->GetId()] = entry;
+        }
+
+        dataGridView->SuspendLayout();
+        try {
+            for (int i = dataGridView->Rows->Count - 1; i >= 0; i--) {
+                DataGridViewRow^ row = dataGridView->Rows[i];
+                if (row->IsNewRow) continue;
+                int id = Convert::ToInt32(row->Cells["Id"]->Value);
+                NotebookEntry<int>^ entry;
+                if (matched->TryGetValue(id, entry)) {
+                    SetRow(row, entry);
+                    matched->Remove(id);
+                }
+                else if (gone->Contains(id)) {
+                    dataGridView->Rows->RemoveAt(i);
+                }
+            }
+            for each (NotebookEntry<int>^ entry in matched->Values) {
+                AddRow(entry);
+            }
+        }
+        finally {
+            dataGridView->ResumeLayout();
+        }
+    }
+
     // Вспомогательные методы
-    void RefreshDataGrid()
+
+    // Строки таблицы хранят запись в Tag, а холодные колонки пусты: их
+    // значения берутся из записи при отрисовке и сортировке
+    static array<Object^>^ RowValues(NotebookEntry<int>^ entry)
+    {
+        return EntrySchema::ToHotRow(entry);
+    }
+
+    void AddRow(NotebookEntry<int>^ entry)
+    {
+        int index = dataGridView->Rows->Add(RowValues(entry));
+        dataGridView->Rows[index]->Tag = entry;
+    }
+
+    void InsertRow(int index, NotebookEntry<int>^ entry)
+    {
+        dataGridView->Rows->Insert(index, RowValues(entry));
+        dataGridView->Rows[index]->Tag = entry;
+    }
+
+    void SetRow(DataGridViewRow^ row, NotebookEntry<int>^ entry)
+    {
+        row->SetValues(RowValues(entry));
+        row->Tag = entry;
+    }
+
+    static Object^ ColdValue(DataGridViewRow^ row, int column)
+    {
+        NotebookEntry<int>^ entry = dynamic_cast<NotebookEntry<int>^>(row->Tag);
+        return entry == nullptr ? nullptr : EntrySchema::BoxField(column, entry);
+    }
+
+    static Object^ TagsValue(DataGridViewRow^ row)
+    {
+        NotebookEntry<int>^ entry = dynamic_cast<NotebookEntry<int>^>(row->Tag);
+        return entry == nullptr || entry->GetTags() == nullptr ? String::Empty : String::Join(", ", entry->GetTags());
+    }
+
+    // Колонка за полями схемы - метки
+    static bool IsRecordColumn(int column)
+    {
+        return column == EntrySchema::FieldCount || EntrySchema::IsColdColumn(column);
+    }
+
+    static Object^ RecordValue(DataGridViewRow^ row, int column)
+    {
+        return column == EntrySchema::FieldCount ? TagsValue(row) : ColdValue(row, column);
+    }
+
+    // Значение, по которому сортируется колонка: для холодных колонок и
+    // меток - из записи, для остальных - из ячейки
+    static Object^ SortValue(DataGridViewRow^ row, int column)
+    {
+        return IsRecordColumn(column) ? RecordValue(row, column) : row->Cells[column]->Value;
+    }
+
+    // Значения холодных колонок и меток берутся из записи только для видимой ячейки
+    void DataGridView_CellFormatting(Object^ sender, DataGridViewCellFormattingEventArgs^ e)
+    {
+        if (e->RowIndex < 0 || e->Value != nullptr || !IsRecordColumn(e->ColumnIndex)) return;
+        e->Value = RecordValue(dataGridView->Rows[e->RowIndex], e->ColumnIndex);
+        e->FormattingApplied = true;
+    }
+
+    // Сортировка щелчком по заголовку холодной колонки или меток - по значениям записей
+    void DataGridView_SortCompare(Object^ sender, DataGridViewSortCompareEventArgs^ e)
+    {
+        if (!IsRecordColumn(e->Column->Index)) return;
+        e->SortResult = String::Compare(
+            safe_cast<String^>(RecordValue(dataGridView->Rows[e->RowIndex1], e->Column->Index)),
+            safe_cast<String^>(RecordValue(dataGridView->Rows[e->RowIndex2], e->Column->Index)));
+        e->Handled = true;
+    }
+
+    void FillDataGrid(IEnumerable<NotebookEntry<int>^>^ source)
     {
         dataGridView->Rows->Clear();
-        for each (NotebookEntry<int>^ entry in manager->GetAllEntries()) {
-            dataGridView->Rows->Add(
-                entry->GetId(),
-                entry->GetFirstName(),
-                entry->GetLastName(),
-                entry->GetPhoneNumber(),
-                entry->GetBirthDate(),
-                entry->GetEmail(),
-                entry->GetAddress(),
-                entry->GetNotes()
-            );
+        for each (NotebookEntry<int>^ entry in source) {
+            AddRow(entry);
         }
     }
 
+    void ShowSearchResults()
+    {
+        showingSearchResults = true;
+        FillDataGrid(manager->SearchByAnyField(searchQuery, searchType));
+    }
+
+    void RefreshDataGrid()
+    {
+        showingSearchResults = false;
+        FillDataGrid(manager->GetAllEntries());
+    }
+
     void ClearInputFields()
     {
         firstNameTextBox->Clear();
@@ -594,6 +1346,7 @@ private:
         emailTextBox->Clear();
         addressTextBox->Clear();
         notesTextBox->Clear();
+        tagsTextBox->Clear();
     }
 };
 } 
\ No newline at end of file